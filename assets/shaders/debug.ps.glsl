@@ -0,0 +1,8 @@
+#version 330 core
+in vec4 LineColor;
+
+out vec4 FragColor;
+
+void main() {
+	FragColor = LineColor;
+}
\ No newline at end of file
@@ -0,0 +1,3 @@
+float4 main(float4 Color : COLOR0) : COLOR0 {
+    return Color;
+}
\ No newline at end of file
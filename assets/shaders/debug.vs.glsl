@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec4 aColor;
+
+out vec4 LineColor;
+
+void main() {
+    gl_Position = vec4(aPos, 0.0, 1.0);
+    LineColor = aColor;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+struct VS_INPUT {
+    float2 Pos   : POSITION;
+    float4 Color : COLOR0;
+};
+
+struct VS_OUTPUT {
+    float4 Pos   : POSITION;
+    float4 Color : COLOR0;
+};
+
+VS_OUTPUT main(VS_INPUT input) {
+    VS_OUTPUT output;
+
+    output.Pos   = float4(input.Pos, 0.0, 1.0);
+    output.Color = input.Color;
+    return output;
+}
\ No newline at end of file
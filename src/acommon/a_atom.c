@@ -0,0 +1,327 @@
+#include "a_atom.h"
+
+#include <assert.h>
+
+#include "a_atomic.h"
+#include "a_string.h"
+#include "z_mem.h"
+
+// Each atom's text follows a header with its hash and length, so an atom
+// is a pointer just past its header. They're bump-allocated out of blocks
+// that are only freed all at once.
+//
+// The table is open-addressing with linear probing, and doubles whenever it
+// gets half full. Each slot keeps the atom's hash next to it, so probing past
+// the wrong atoms doesn't have to touch them. Nothing's ever removed, so
+// there's no deletion to handle. One spinlock guards all of it; interning
+// is rare next to lookups, and a lookup holds it for a probe or two.
+typedef struct AAtomHeader {
+    uint32_t hash;
+    uint32_t len;
+} AAtomHeader;
+
+typedef struct AAtomSlot {
+    uint32_t hash;
+    aatom_t  atom;
+} AAtomSlot;
+
+typedef struct AAtomBlock {
+    struct AAtomBlock* next;
+    size_t             size; // usable bytes after the header
+    size_t             used;
+} AAtomBlock;
+
+#define A_ATOM_BLOCK_SIZE     (64 * 1024)
+#define A_ATOM_MIN_TABLE_SIZE 1024
+
+struct AAtomTable {
+    volatile int32_t lock;
+    AAtomBlock*      blocks;
+    AAtomSlot*       table;
+    size_t           table_size;
+    size_t           count;
+    size_t           atom_bytes;
+    size_t           pool_bytes;
+};
+
+// Private tables are allocated the same way as the global one.
+static AAtomAllocFn s_atomAlloc;
+static AAtomFreeFn  s_atomFree;
+static AAtomTable   s_atoms;
+
+// Z_Alloc and Z_Free can be macros when allocations are traced.
+static void* A_AtomZAlloc(size_t n) {
+    return Z_Alloc(n);
+}
+
+static void A_AtomZFree(void* p) {
+    Z_Free(p);
+}
+
+static uint8_t A_AtomFold(char c) {
+    uint8_t u = (uint8_t)c;
+    return (u >= 'A' && u <= 'Z') ? (uint8_t)(u + ('a' - 'A')) : u;
+}
+
+static const AAtomHeader* A_AtomHeader(aatom_t a) {
+    return (const AAtomHeader*)(const void*)a - 1;
+}
+
+void A_AtomInit(AAtomAllocFn alloc, AAtomFreeFn free) {
+    assert(s_atoms.count == 0);
+    A_memset(&s_atoms, 0, sizeof(s_atoms));
+    s_atomAlloc = alloc ? alloc : A_AtomZAlloc;
+    s_atomFree  = free  ? free  : A_AtomZFree;
+}
+
+static void A_AtomEnsureInit(void) {
+    if (s_atomAlloc == NULL) {
+        s_atomAlloc = A_AtomZAlloc;
+        s_atomFree  = A_AtomZFree;
+    }
+}
+
+// NULL is the global table.
+static AAtomTable* A_AtomTableOrGlobal(AAtomTable* t) {
+    return t ? t : &s_atoms;
+}
+
+static bool A_AtomEquals(aatom_t a, const char* s, size_t len, bool fold) {
+    if (A_AtomHeader(a)->len != len)
+        return false;
+    if (!fold)
+        return A_memcmp(a, s, len);
+
+    for (size_t i = 0; i < len; i++) {
+        if ((uint8_t)a[i] != A_AtomFold(s[i]))
+            return false;
+    }
+    return true;
+}
+
+// Must be called with the lock held. Returns the slot holding the atom for
+// `s`, or the empty one its probe sequence ends at.
+static AAtomSlot* A_AtomFindSlot(AAtomTable* t, uint32_t hash,
+                                 const char* s, size_t len, bool fold
+) {
+    size_t mask = t->table_size - 1;
+    size_t i    = hash & mask;
+    while (t->table[i].atom != NULL) {
+        if (t->table[i].hash == hash &&
+            A_AtomEquals(t->table[i].atom, s, len, fold))
+            break;
+        i = (i + 1) & mask;
+    }
+    return &t->table[i];
+}
+
+static bool A_AtomGrowTable(AAtomTable* t) {
+    size_t size = t->table_size ? t->table_size * 2 : A_ATOM_MIN_TABLE_SIZE;
+    AAtomSlot* table = (AAtomSlot*)s_atomAlloc(size * sizeof(*table));
+    assert(table);
+    if (!table)
+        return false;
+
+    A_memset((void*)table, 0, size * sizeof(*table));
+    for (size_t i = 0; i < t->table_size; i++) {
+        if (t->table[i].atom == NULL)
+            continue;
+        size_t j = t->table[i].hash & (size - 1);
+        while (table[j].atom != NULL)
+            j = (j + 1) & (size - 1);
+        table[j] = t->table[i];
+    }
+
+    if (t->table)
+        s_atomFree((void*)t->table);
+    t->table      = table;
+    t->table_size = size;
+    return true;
+}
+
+static AAtomHeader* A_AtomAllocate(AAtomTable* t, size_t n) {
+    n = (n + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+    AAtomBlock* b = t->blocks;
+    if (b == NULL || b->size - b->used < n) {
+        size_t size = A_ATOM_BLOCK_SIZE > n ? A_ATOM_BLOCK_SIZE : n;
+        b = (AAtomBlock*)s_atomAlloc(sizeof(*b) + size);
+        assert(b);
+        if (!b)
+            return NULL;
+
+        b->size = size;
+        b->used = 0;
+        // A block too big for the usual size goes behind the current one,
+        // so the current one's space isn't wasted.
+        if (t->blocks && size > A_ATOM_BLOCK_SIZE) {
+            b->next = t->blocks->next;
+            t->blocks->next = b;
+        } else {
+            b->next = t->blocks;
+            t->blocks = b;
+        }
+        t->pool_bytes += sizeof(*b) + size;
+    }
+
+    AAtomHeader* h = (AAtomHeader*)((char*)(b + 1) + b->used);
+    b->used += n;
+    t->atom_bytes += n;
+    return h;
+}
+
+static aatom_t A_AtomIntern(AAtomTable* t, const char* s, bool fold,
+                            bool add
+) {
+    assert(s);
+    uint32_t hash = fold ? A_cstrihash(s) : A_cstrhash(s);
+    size_t   len  = A_cstrlen(s);
+    assert(len < 0xFFFFFFFFu);
+
+    t = A_AtomTableOrGlobal(t);
+    A_spin_lock(&t->lock);
+    A_AtomEnsureInit();
+    AAtomSlot* slot = NULL;
+    if (t->table) {
+        slot = A_AtomFindSlot(t, hash, s, len, fold);
+        if (slot->atom != NULL || !add) {
+            aatom_t a = slot->atom;
+            A_spin_unlock(&t->lock);
+            return a;
+        }
+    } else if (!add) {
+        A_spin_unlock(&t->lock);
+        return NULL;
+    }
+
+    if (t->count + 1 > t->table_size / 2) {
+        if (!A_AtomGrowTable(t)) {
+            A_spin_unlock(&t->lock);
+            return NULL;
+        }
+        slot = A_AtomFindSlot(t, hash, s, len, fold);
+    }
+
+    AAtomHeader* h = A_AtomAllocate(t, sizeof(*h) + len + 1);
+    if (h == NULL) {
+        A_spin_unlock(&t->lock);
+        return NULL;
+    }
+
+    h->hash = hash;
+    h->len  = (uint32_t)len;
+    char* text = (char*)(h + 1);
+    if (fold) {
+        for (size_t i = 0; i < len; i++)
+            text[i] = (char)A_AtomFold(s[i]);
+    } else {
+        A_memcpy(text, s, len);
+    }
+    text[len] = '\0';
+
+    slot->hash = hash;
+    slot->atom = text;
+    t->count++;
+    A_spin_unlock(&t->lock);
+    return text;
+}
+
+A_NO_DISCARD aatom_t A_atom(const char* s) {
+    return A_AtomIntern(NULL, s, false, true);
+}
+
+A_NO_DISCARD aatom_t A_atomi(const char* s) {
+    return A_AtomIntern(NULL, s, true, true);
+}
+
+A_NO_DISCARD aatom_t A_atom_find(const char* s) {
+    return A_AtomIntern(NULL, s, false, false);
+}
+
+A_NO_DISCARD aatom_t A_atomi_find(const char* s) {
+    return A_AtomIntern(NULL, s, true, false);
+}
+
+A_NO_DISCARD aatom_t A_atom_in(AAtomTable* t, const char* s) {
+    return A_AtomIntern(t, s, false, true);
+}
+
+A_NO_DISCARD aatom_t A_atomi_in(AAtomTable* t, const char* s) {
+    return A_AtomIntern(t, s, true, true);
+}
+
+A_NO_DISCARD aatom_t A_atom_find_in(AAtomTable* t, const char* s) {
+    return A_AtomIntern(t, s, false, false);
+}
+
+A_NO_DISCARD aatom_t A_atomi_find_in(AAtomTable* t, const char* s) {
+    return A_AtomIntern(t, s, true, false);
+}
+
+A_NO_DISCARD uint32_t A_atom_hash(aatom_t a) {
+    assert(a);
+    return A_AtomHeader(a)->hash;
+}
+
+A_NO_DISCARD size_t A_atom_len(aatom_t a) {
+    assert(a);
+    return A_AtomHeader(a)->len;
+}
+
+void A_AtomGetTableStats(AAtomTable* t, A_OUT AAtomStats* stats) {
+    assert(stats);
+    t = A_AtomTableOrGlobal(t);
+    A_spin_lock(&t->lock);
+    stats->count       = t->count;
+    stats->atom_bytes  = t->atom_bytes;
+    stats->pool_bytes  = t->pool_bytes;
+    stats->table_bytes = t->table_size * sizeof(*t->table);
+    A_spin_unlock(&t->lock);
+}
+
+void A_AtomGetStats(A_OUT AAtomStats* stats) {
+    A_AtomGetTableStats(NULL, stats);
+}
+
+// Must be called with the lock held.
+static void A_AtomFreeTable(AAtomTable* t) {
+    AAtomBlock* b = t->blocks;
+    while (b) {
+        AAtomBlock* next = b->next;
+        s_atomFree(b);
+        b = next;
+    }
+    if (t->table)
+        s_atomFree((void*)t->table);
+
+    t->blocks     = NULL;
+    t->table      = NULL;
+    t->table_size = 0;
+    t->count      = 0;
+    t->atom_bytes = 0;
+    t->pool_bytes = 0;
+}
+
+void A_AtomShutdown(void) {
+    A_spin_lock(&s_atoms.lock);
+    A_AtomEnsureInit();
+    A_AtomFreeTable(&s_atoms);
+    A_spin_unlock(&s_atoms.lock);
+}
+
+A_NO_DISCARD AAtomTable* A_AtomCreateTable(void) {
+    A_AtomEnsureInit();
+    AAtomTable* t = (AAtomTable*)s_atomAlloc(sizeof(*t));
+    assert(t);
+    if (t)
+        A_memset(t, 0, sizeof(*t));
+    return t;
+}
+
+void A_AtomDestroyTable(AAtomTable* t) {
+    assert(t && t != &s_atoms);
+    if (t == NULL || t == &s_atoms)
+        return;
+
+    A_AtomFreeTable(t);
+    s_atomFree(t);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "acommon.h"
+
+// ============================================================================
+// Interned strings. Every string equal to another interns to the same atom,
+// a pointer to one NUL-terminated copy in a global pool, so two atoms are
+// equal exactly when the pointers are, and each one's hash is stored with
+// it. Atoms live until A_AtomShutdown, so they can be kept anywhere without
+// copying or freeing them.
+//
+// All of it is thread-safe.
+typedef const char* aatom_t;
+
+typedef void* (*AAtomAllocFn)(size_t n);
+typedef void  (*AAtomFreeFn )(void* p);
+
+// The pool and its table are allocated with `alloc` and freed with `free`,
+// or Z_Alloc and Z_Free if they're NULL. Call it before anything's interned
+// and before there are other threads. A_AtomShutdown frees every atom.
+A_EXTERN_C void A_AtomInit    (AAtomAllocFn alloc, AAtomFreeFn free);
+A_EXTERN_C void A_AtomShutdown(void);
+
+// Interns `s`. `A_atomi` interns it with ASCII letters lowercased, for names
+// that are case-insensitive.
+A_EXTERN_C A_NO_DISCARD aatom_t A_atom (const char* s);
+A_EXTERN_C A_NO_DISCARD aatom_t A_atomi(const char* s);
+// The atom `s` would intern to, or NULL if it hasn't been, for looking a
+// name up without adding it.
+A_EXTERN_C A_NO_DISCARD aatom_t A_atom_find (const char* s);
+A_EXTERN_C A_NO_DISCARD aatom_t A_atomi_find(const char* s);
+
+// A_cstrhash of the atom's text, without rehashing it.
+A_EXTERN_C A_NO_DISCARD uint32_t A_atom_hash(aatom_t a);
+A_EXTERN_C A_NO_DISCARD size_t   A_atom_len (aatom_t a);
+
+typedef struct AAtomStats {
+    size_t count;
+    size_t atom_bytes;  // every atom's text and header
+    size_t pool_bytes;  // the blocks they're in
+    size_t table_bytes;
+} AAtomStats;
+
+A_EXTERN_C void A_AtomGetStats(A_OUT AAtomStats* stats);
+
+// A table apart from the global one, for atoms that shouldn't last until
+// shutdown, like a benchmark's thousands of made-up names. An atom from one
+// is only equal to atoms from the same table, and they're all freed with
+// it. A NULL table is the global one. It's allocated the same way the
+// global one is.
+typedef struct AAtomTable AAtomTable;
+
+A_EXTERN_C A_NO_DISCARD AAtomTable* A_AtomCreateTable (void);
+A_EXTERN_C              void        A_AtomDestroyTable(AAtomTable* t);
+
+A_EXTERN_C A_NO_DISCARD aatom_t A_atom_in      (AAtomTable* t, const char* s);
+A_EXTERN_C A_NO_DISCARD aatom_t A_atomi_in     (AAtomTable* t, const char* s);
+A_EXTERN_C A_NO_DISCARD aatom_t A_atom_find_in (AAtomTable* t, const char* s);
+A_EXTERN_C A_NO_DISCARD aatom_t A_atomi_find_in(AAtomTable* t, const char* s);
+
+A_EXTERN_C void A_AtomGetTableStats(AAtomTable* t, A_OUT AAtomStats* stats);
+// ============================================================================
@@ -0,0 +1,155 @@
+#include "a_atomic.h"
+
+#include <assert.h>
+
+#if !A_TARGET_OS_IS_WINDOWS
+#include <sched.h>
+#endif // !A_TARGET_OS_IS_WINDOWS
+
+#if A_COMPILER_IS_GCC_COMPATIBLE
+A_NO_DISCARD int32_t A_atomic_load32(const volatile int32_t* p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+void A_atomic_store32(volatile int32_t* p, int32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+int32_t A_atomic_fetch_add32(volatile int32_t* p, int32_t v) {
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+int32_t A_atomic_exchange32(volatile int32_t* p, int32_t v) {
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+bool A_atomic_cas32(volatile int32_t* p, int32_t expected, int32_t desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+A_NO_DISCARD void* A_atomic_load_ptr(void* const volatile* p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+void A_atomic_store_ptr(void* volatile* p, void* v) {
+    __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+void* A_atomic_exchange_ptr(void* volatile* p, void* v) {
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+bool A_atomic_cas_ptr(void* volatile* p, void* expected, void* desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+A_NO_DISCARD size_t A_atomic_load_size(const volatile size_t* p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+size_t A_atomic_fetch_add_size(volatile size_t* p, size_t v) {
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+bool A_atomic_cas_size(volatile size_t* p, size_t expected, size_t desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif A_COMPILER_IS_MSVC
+A_NO_DISCARD int32_t A_atomic_load32(const volatile int32_t* p) {
+    return (int32_t)InterlockedCompareExchange((volatile LONG*)p, 0, 0);
+}
+
+void A_atomic_store32(volatile int32_t* p, int32_t v) {
+    InterlockedExchange((volatile LONG*)p, (LONG)v);
+}
+
+int32_t A_atomic_fetch_add32(volatile int32_t* p, int32_t v) {
+    return (int32_t)InterlockedExchangeAdd((volatile LONG*)p, (LONG)v);
+}
+
+int32_t A_atomic_exchange32(volatile int32_t* p, int32_t v) {
+    return (int32_t)InterlockedExchange((volatile LONG*)p, (LONG)v);
+}
+
+bool A_atomic_cas32(volatile int32_t* p, int32_t expected, int32_t desired) {
+    return InterlockedCompareExchange(
+        (volatile LONG*)p, (LONG)desired, (LONG)expected
+    ) == (LONG)expected;
+}
+
+A_NO_DISCARD void* A_atomic_load_ptr(void* const volatile* p) {
+    return InterlockedCompareExchangePointer((void* volatile*)p, NULL, NULL);
+}
+
+void A_atomic_store_ptr(void* volatile* p, void* v) {
+    InterlockedExchangePointer(p, v);
+}
+
+void* A_atomic_exchange_ptr(void* volatile* p, void* v) {
+    return InterlockedExchangePointer(p, v);
+}
+
+bool A_atomic_cas_ptr(void* volatile* p, void* expected, void* desired) {
+    return InterlockedCompareExchangePointer(p, desired, expected) == expected;
+}
+
+#ifdef _WIN64
+A_NO_DISCARD size_t A_atomic_load_size(const volatile size_t* p) {
+    return (size_t)InterlockedCompareExchange64((volatile LONG64*)p, 0, 0);
+}
+
+size_t A_atomic_fetch_add_size(volatile size_t* p, size_t v) {
+    return (size_t)InterlockedExchangeAdd64((volatile LONG64*)p, (LONG64)v);
+}
+
+bool A_atomic_cas_size(volatile size_t* p, size_t expected, size_t desired) {
+    return InterlockedCompareExchange64(
+        (volatile LONG64*)p, (LONG64)desired, (LONG64)expected
+    ) == (LONG64)expected;
+}
+#else
+A_NO_DISCARD size_t A_atomic_load_size(const volatile size_t* p) {
+    return (size_t)InterlockedCompareExchange((volatile LONG*)p, 0, 0);
+}
+
+size_t A_atomic_fetch_add_size(volatile size_t* p, size_t v) {
+    return (size_t)InterlockedExchangeAdd((volatile LONG*)p, (LONG)v);
+}
+
+bool A_atomic_cas_size(volatile size_t* p, size_t expected, size_t desired) {
+    return InterlockedCompareExchange(
+        (volatile LONG*)p, (LONG)desired, (LONG)expected
+    ) == (LONG)expected;
+}
+#endif // _WIN64
+#else
+#error "A_atomic: unsupported compiler"
+#endif // A_COMPILER_IS_GCC_COMPATIBLE
+
+#define A_SPIN_COUNT 64
+
+bool A_spin_trylock(volatile int32_t* lock) {
+    return A_atomic_load32(lock) == 0 && A_atomic_exchange32(lock, 1) == 0;
+}
+
+void A_spin_lock(volatile int32_t* lock) {
+    for (;;) {
+        for (int i = 0; i < A_SPIN_COUNT; i++) {
+            if (A_spin_trylock(lock))
+                return;
+        }
+#if A_TARGET_OS_IS_WINDOWS
+        Sleep(0);
+#else
+        sched_yield();
+#endif // A_TARGET_OS_IS_WINDOWS
+    }
+}
+
+void A_spin_unlock(volatile int32_t* lock) {
+    assert(A_atomic_load32(lock) == 1);
+    A_atomic_store32(lock, 0);
+}
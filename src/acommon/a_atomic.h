@@ -0,0 +1,34 @@
+#pragma once
+
+#include "acommon.h"
+
+// Sequentially-consistent atomics on 32-bit integers and pointers. These are
+// deliberately minimal and backed by compiler builtins (GCC/Clang) or the
+// Interlocked API (MSVC/Xbox), since neither C11 atomics nor C++11 atomics
+// are available on every compiler we target.
+
+A_EXTERN_C A_NO_DISCARD int32_t A_atomic_load32(const volatile int32_t* p);
+A_EXTERN_C void    A_atomic_store32    (volatile int32_t* p, int32_t v);
+A_EXTERN_C int32_t A_atomic_fetch_add32(volatile int32_t* p, int32_t v);
+A_EXTERN_C int32_t A_atomic_exchange32 (volatile int32_t* p, int32_t v);
+A_EXTERN_C bool    A_atomic_cas32      (volatile int32_t* p,
+                                        int32_t expected, int32_t desired);
+
+A_EXTERN_C A_NO_DISCARD void* A_atomic_load_ptr(void* const volatile* p);
+A_EXTERN_C void  A_atomic_store_ptr   (void* volatile* p, void* v);
+A_EXTERN_C void* A_atomic_exchange_ptr(void* volatile* p, void* v);
+A_EXTERN_C bool  A_atomic_cas_ptr     (void* volatile* p,
+                                       void* expected, void* desired);
+
+// Pointer-sized counters, for byte counts that can outgrow 32 bits.
+A_EXTERN_C A_NO_DISCARD size_t A_atomic_load_size(const volatile size_t* p);
+A_EXTERN_C size_t A_atomic_fetch_add_size(volatile size_t* p, size_t v);
+A_EXTERN_C bool   A_atomic_cas_size      (volatile size_t* p,
+                                          size_t expected, size_t desired);
+
+// A test-and-test-and-set spinlock on a zero-initialized int32_t. Only for
+// short critical sections: after spinning for a while it yields the rest
+// of its timeslice, in case the holder was preempted.
+A_EXTERN_C void A_spin_lock   (volatile int32_t* lock);
+A_EXTERN_C bool A_spin_trylock(volatile int32_t* lock);
+A_EXTERN_C void A_spin_unlock (volatile int32_t* lock);
@@ -23,6 +23,10 @@ A_NO_DISCARD size_t A_ppow2(size_t n) {
     return A_npow2(n) >> 1;
 }
 
+A_NO_DISCARD bool A_HashSlotBetween(size_t k, size_t i, size_t j) {
+    return i <= j ? (i < k && k <= j) : (i < k || k <= j);
+}
+
 A_NO_RETURN A_exit(int ec) {
     exit(ec);
 }
@@ -0,0 +1,80 @@
+#include "a_cpu.h"
+
+#if A_CPU_CAN_BUILD_SSE2 && A_COMPILER_IS_GCC_COMPATIBLE
+#include <cpuid.h>
+#elif A_CPU_CAN_BUILD_SSE2 && A_COMPILER_IS_MSVC
+#include <intrin.h>
+#endif // A_CPU_CAN_BUILD_SSE2 && A_COMPILER_IS_GCC_COMPATIBLE
+
+static ACpuFeatures s_cpuFeatures;
+static bool         s_cpuFeaturesKnown;
+
+#if A_CPU_CAN_BUILD_SSE2
+// Returns false if the CPU doesn't have `leaf`.
+static bool A_Cpuid(uint32_t leaf, uint32_t subleaf, A_OUT uint32_t regs[4]) {
+#if A_COMPILER_IS_GCC_COMPATIBLE
+    if (__get_cpuid_max(0, NULL) < leaf)
+        return false;
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#else
+    int r[4];
+    __cpuid(r, 0);
+    if ((uint32_t)r[0] < leaf)
+        return false;
+    __cpuidex(r, (int)leaf, (int)subleaf);
+    regs[0] = (uint32_t)r[0];
+    regs[1] = (uint32_t)r[1];
+    regs[2] = (uint32_t)r[2];
+    regs[3] = (uint32_t)r[3];
+#endif // A_COMPILER_IS_GCC_COMPATIBLE
+    return true;
+}
+
+// A CPU can support AVX without the OS saving the upper halves of the
+// YMM registers on a context switch, in which case it can't be used.
+static bool A_OsSavesYmm(void) {
+#if A_COMPILER_IS_GCC_COMPATIBLE
+    uint32_t eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (eax & 6) == 6;
+#elif A_COMPILER_IS_MSVC && _MSC_VER >= 1600
+    return (_xgetbv(0) & 6) == 6;
+#else
+    return false;
+#endif // A_COMPILER_IS_GCC_COMPATIBLE
+}
+
+static void A_DetectCpuFeatures(A_OUT ACpuFeatures* f) {
+    uint32_t regs[4];
+    if (!A_Cpuid(1, 0, regs))
+        return;
+
+    f->sse2 = (regs[3] & (1u << 26)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx     = (regs[2] & (1u << 28)) != 0;
+    if (!osxsave || !avx || !A_OsSavesYmm())
+        return;
+
+    if (A_Cpuid(7, 0, regs))
+        f->avx2 = (regs[1] & (1u << 5)) != 0;
+}
+#elif A_CPU_CAN_BUILD_NEON
+static void A_DetectCpuFeatures(A_OUT ACpuFeatures* f) {
+    f->neon = true;
+}
+#else
+static void A_DetectCpuFeatures(A_OUT ACpuFeatures* f) {
+    A_UNUSED(f);
+}
+#endif // A_CPU_CAN_BUILD_SSE2
+
+A_NO_DISCARD const ACpuFeatures* A_CpuFeatures(void) {
+    if (!s_cpuFeaturesKnown) {
+        s_cpuFeatures.sse2 = false;
+        s_cpuFeatures.avx2 = false;
+        s_cpuFeatures.neon = false;
+        A_DetectCpuFeatures(&s_cpuFeatures);
+        s_cpuFeaturesKnown = true;
+    }
+    return &s_cpuFeatures;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "acommon.h"
+
+// Whether this build can compile kernels for an instruction set at all,
+// which is separate from whether the CPU it ends up running on supports
+// it. The Xbox's Pentium III predates SSE2, so there's no point there.
+#if A_TARGET_ARCH_IS_X86 && !A_TARGET_PLATFORM_IS_XBOX && \
+    (A_COMPILER_IS_GCC_COMPATIBLE || (A_COMPILER_IS_MSVC && _MSC_VER >= 1500))
+#define A_CPU_CAN_BUILD_SSE2 1
+#else
+#define A_CPU_CAN_BUILD_SSE2 0
+#endif // A_TARGET_ARCH_IS_X86 && !A_TARGET_PLATFORM_IS_XBOX && ...
+
+#if A_CPU_CAN_BUILD_SSE2 && \
+    ((A_COMPILER_IS_GCC_COMPATIBLE && (__GNUC__ >= 5 || defined(__clang__))) || \
+     (A_COMPILER_IS_MSVC && _MSC_VER >= 1700))
+#define A_CPU_CAN_BUILD_AVX2 1
+#else
+#define A_CPU_CAN_BUILD_AVX2 0
+#endif // A_CPU_CAN_BUILD_SSE2 && ...
+
+// NEON is part of the baseline on AArch64.
+#if A_TARGET_ARCH_IS_ARM64
+#define A_CPU_CAN_BUILD_NEON 1
+#else
+#define A_CPU_CAN_BUILD_NEON 0
+#endif // A_TARGET_ARCH_IS_ARM64
+
+// Lets a function use an instruction set the rest of the file isn't
+// compiled for. MSVC allows any intrinsic anywhere, so it doesn't need it.
+#if A_COMPILER_IS_GCC_COMPATIBLE
+#define A_TARGET_FEATURE(f) __attribute__((target(f)))
+#else
+#define A_TARGET_FEATURE(f)
+#endif // A_COMPILER_IS_GCC_COMPATIBLE
+
+// For kernels that read whole aligned blocks past the end of a string.
+// An aligned block can't straddle a page boundary, so that's safe, but
+// the address sanitizer can't know it.
+#if defined(__clang__) || (A_COMPILER_IS_GCC_COMPATIBLE && __GNUC__ >= 8)
+#define A_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#elif A_COMPILER_IS_MSVC && _MSC_VER >= 1928
+#define A_NO_SANITIZE_ADDRESS __declspec(no_sanitize_address)
+#else
+#define A_NO_SANITIZE_ADDRESS
+#endif // defined(__clang__) || ...
+
+// What the CPU supports, including whether the OS saves the registers it
+// needs. Worked out on the first call, which should be made before there
+// are other threads.
+typedef struct ACpuFeatures {
+    bool sse2;
+    bool avx2;
+    bool neon;
+} ACpuFeatures;
+
+A_EXTERN_C A_NO_DISCARD const ACpuFeatures* A_CpuFeatures(void);
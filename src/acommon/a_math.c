@@ -3,6 +3,8 @@
 #include <assert.h>
 #include <math.h>
 
+#include "a_cpu.h"
+#include "a_math_simd.h"
 #include "a_string.h"
 
 #define A_PI 3.14159265359
@@ -135,6 +137,9 @@ A_NO_DISCARD avec2f_t A_vec2f_normalize(avec2f_t v) {
 
 A_NO_DISCARD avec3f_t A_vec3f_normalize(avec3f_t v) {
 	float m = A_vec3f_length(v);
+	if (m <= 0.0f)
+		return A_VEC3F_ZERO;
+
 	avec3f_t ret;
 	ret.x = v.x / m;
 	ret.y = v.y / m;
@@ -188,7 +193,7 @@ A_NO_DISCARD avec3f_t A_vec3f_cross(avec3f_t a, avec3f_t b) {
 	avec3f_t ret = A_vec3(
 		(a.y * b.z) - (a.z * b.y), 
 		(a.z * b.x) - (a.x * b.z), 
-		(a.x * b.y) * (a.y * b.z)
+		(a.x * b.y) - (a.y * b.x)
 	);
 	return ret;
 }
@@ -225,16 +230,208 @@ A_NO_DISCARD amat4f_t A_mat4f_scale_vec3(amat4f_t m, avec3f_t v) {
 	return m;
 }
 
+// ============================================================================
+// The scalar reference implementations. See a_math_simd.c for the others,
+// which add and multiply in the same order so that, apart from the inverse,
+// they give exactly the same results.
+static void A_mat4f_mul_scalar(const amat4f_t* a, const amat4f_t* b,
+	                           A_OUT amat4f_t* out
+) {
+	amat4f_t ret;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			ret.m[i][j] = a->m[i][0] * b->m[0][j] + a->m[i][1] * b->m[1][j] +
+			              a->m[i][2] * b->m[2][j] + a->m[i][3] * b->m[3][j];
+		}
+	}
+	*out = ret;
+}
+
+// Cofactors from the 2x2 determinants of the top and bottom two rows.
+static bool A_mat4f_inverse_scalar(const amat4f_t* m, A_OUT amat4f_t* out) {
+	float a00 = m->m[0][0], a01 = m->m[0][1], a02 = m->m[0][2], a03 = m->m[0][3];
+	float a10 = m->m[1][0], a11 = m->m[1][1], a12 = m->m[1][2], a13 = m->m[1][3];
+	float a20 = m->m[2][0], a21 = m->m[2][1], a22 = m->m[2][2], a23 = m->m[2][3];
+	float a30 = m->m[3][0], a31 = m->m[3][1], a32 = m->m[3][2], a33 = m->m[3][3];
+
+	float s0 = a00 * a11 - a10 * a01;
+	float s1 = a00 * a12 - a10 * a02;
+	float s2 = a00 * a13 - a10 * a03;
+	float s3 = a01 * a12 - a11 * a02;
+	float s4 = a01 * a13 - a11 * a03;
+	float s5 = a02 * a13 - a12 * a03;
+
+	float c0 = a20 * a31 - a30 * a21;
+	float c1 = a20 * a32 - a30 * a22;
+	float c2 = a20 * a33 - a30 * a23;
+	float c3 = a21 * a32 - a31 * a22;
+	float c4 = a21 * a33 - a31 * a23;
+	float c5 = a22 * a33 - a32 * a23;
+
+	float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	if (det == 0.0f)
+		return false;
+
+	float r = 1.0f / det;
+	out->m[0][0] = ( a11 * c5 - a12 * c4 + a13 * c3) * r;
+	out->m[0][1] = (-a01 * c5 + a02 * c4 - a03 * c3) * r;
+	out->m[0][2] = ( a31 * s5 - a32 * s4 + a33 * s3) * r;
+	out->m[0][3] = (-a21 * s5 + a22 * s4 - a23 * s3) * r;
+	out->m[1][0] = (-a10 * c5 + a12 * c2 - a13 * c1) * r;
+	out->m[1][1] = ( a00 * c5 - a02 * c2 + a03 * c1) * r;
+	out->m[1][2] = (-a30 * s5 + a32 * s2 - a33 * s1) * r;
+	out->m[1][3] = ( a20 * s5 - a22 * s2 + a23 * s1) * r;
+	out->m[2][0] = ( a10 * c4 - a11 * c2 + a13 * c0) * r;
+	out->m[2][1] = (-a00 * c4 + a01 * c2 - a03 * c0) * r;
+	out->m[2][2] = ( a30 * s4 - a31 * s2 + a33 * s0) * r;
+	out->m[2][3] = (-a20 * s4 + a21 * s2 - a23 * s0) * r;
+	out->m[3][0] = (-a10 * c3 + a11 * c1 - a12 * c0) * r;
+	out->m[3][1] = ( a00 * c3 - a01 * c1 + a02 * c0) * r;
+	out->m[3][2] = (-a30 * s3 + a31 * s1 - a32 * s0) * r;
+	out->m[3][3] = ( a20 * s3 - a21 * s1 + a22 * s0) * r;
+	return true;
+}
+
+static void A_mat4f_transform_points3_scalar(const amat4f_t* m,
+	                                         const avec3f_t* in,
+	                                         A_OUT avec3f_t* out, size_t n
+) {
+	for (size_t i = 0; i < n; i++) {
+		avec3f_t p = in[i];
+		out[i].x = p.x * m->m[0][0] + p.y * m->m[1][0] + p.z * m->m[2][0] + m->m[3][0];
+		out[i].y = p.x * m->m[0][1] + p.y * m->m[1][1] + p.z * m->m[2][1] + m->m[3][1];
+		out[i].z = p.x * m->m[0][2] + p.y * m->m[1][2] + p.z * m->m[2][2] + m->m[3][2];
+	}
+}
+
+static void A_mat4f_transform_vec4_scalar(const amat4f_t* m,
+	                                      const avec4f_t* in,
+	                                      A_OUT avec4f_t* out, size_t n
+) {
+	for (size_t i = 0; i < n; i++) {
+		avec4f_t v = in[i];
+		for (int j = 0; j < 4; j++) {
+			out[i].array[j] = v.x * m->m[0][j] + v.y * m->m[1][j] +
+			                  v.z * m->m[2][j] + v.w * m->m[3][j];
+		}
+	}
+}
+
+static void A_vec3f_normalize_scalar(const avec3f_t* in, A_OUT avec3f_t* out,
+	                                 size_t n
+) {
+	for (size_t i = 0; i < n; i++)
+		out[i] = A_vec3f_normalize(in[i]);
+}
+
+static const AMathKernels s_mathKernelsScalar = {
+	/*.name              =*/ "scalar",
+	/*.mat4_mul          =*/ A_mat4f_mul_scalar,
+	/*.mat4_inverse      =*/ A_mat4f_inverse_scalar,
+	/*.transform_points3 =*/ A_mat4f_transform_points3_scalar,
+	/*.transform_vec4    =*/ A_mat4f_transform_vec4_scalar,
+	/*.normalize3        =*/ A_vec3f_normalize_scalar,
+};
+
+static const AMathKernels* s_mathKernels = &s_mathKernelsScalar;
+static AMathImpl           s_mathImpl    = A_MATH_IMPL_SCALAR;
+
+A_NO_DISCARD const AMathKernels* A_MathKernels(AMathImpl impl) {
+	const ACpuFeatures* cpu = A_CpuFeatures();
+	switch (impl) {
+	case A_MATH_IMPL_SCALAR:
+		return &s_mathKernelsScalar;
+#if A_CPU_CAN_BUILD_SSE2
+	case A_MATH_IMPL_SSE2:
+		return cpu->sse2 ? &A__priv__mathKernelsSse2 : NULL;
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_NEON
+	case A_MATH_IMPL_NEON:
+		return cpu->neon ? &A__priv__mathKernelsNeon : NULL;
+#endif // A_CPU_CAN_BUILD_NEON
+	default:
+		A_UNUSED(cpu);
+		return NULL;
+	}
+}
+
+void A_MathInit(void) {
+	static const AMathImpl order[] = {
+		A_MATH_IMPL_SSE2, A_MATH_IMPL_NEON, A_MATH_IMPL_SCALAR
+	};
+	for (size_t i = 0; i < A_countof(order); i++) {
+		const AMathKernels* k = A_MathKernels(order[i]);
+		if (k != NULL) {
+			s_mathKernels = k;
+			s_mathImpl    = order[i];
+			return;
+		}
+	}
+}
+
+A_NO_DISCARD AMathImpl A_MathImpl(void) {
+	return s_mathImpl;
+}
+// ============================================================================
+
 A_NO_DISCARD amat4f_t A_mat4f_mul(amat4f_t a, amat4f_t b) {
-	amat4f_t ret = A_MAT4F_ZERO;
+	amat4f_t ret;
+	s_mathKernels->mat4_mul(&a, &b, &ret);
+	return ret;
+}
+
+A_NO_DISCARD amat4f_t A_mat4f_transpose(amat4f_t m) {
+	amat4f_t ret;
 	for (int i = 0; i < 4; i++) {
 		for (int j = 0; j < 4; j++)
-			for (int k = 0; k < 4; k++)
-				ret.m[i][j] += a.m[i][k] * b.m[k][j];
+			ret.m[i][j] = m.m[j][i];
 	}
 	return ret;
 }
 
+A_NO_DISCARD bool A_mat4f_inverse(amat4f_t m, A_OUT amat4f_t* inverse) {
+	return s_mathKernels->mat4_inverse(&m, inverse);
+}
+
+A_NO_DISCARD avec3f_t A_mat4f_transform_point3(amat4f_t m, avec3f_t p) {
+	avec3f_t ret;
+	A_mat4f_transform_points3_scalar(&m, &p, &ret, 1);
+	return ret;
+}
+
+void A_mat4f_transform_points3(const amat4f_t* m, const avec3f_t* in,
+	                           A_OUT avec3f_t* out, size_t n
+) {
+	s_mathKernels->transform_points3(m, in, out, n);
+}
+
+void A_mat4f_transform_planes(const amat4f_t* m, const aplane3f_t* in,
+	                          A_OUT aplane3f_t* out, size_t n
+) {
+	// A plane is the row (n, -w), which has to go through the inverse
+	// transpose of `m` to stay in step with points going through `m`.
+	// Rather than flip w on the way in and out, flip the last row and
+	// column of the matrix.
+	amat4f_t inverse;
+	bool b = A_mat4f_inverse(*m, &inverse);
+	assert(b);
+	if (!b)
+		return;
+
+	amat4f_t t = A_mat4f_transpose(inverse);
+	for (int i = 0; i < 3; i++) {
+		t.m[i][3] = -t.m[i][3];
+		t.m[3][i] = -t.m[3][i];
+	}
+	s_mathKernels->transform_vec4(&t, (const avec4f_t*)in, (avec4f_t*)out, n);
+}
+
+void A_vec3f_normalize_array(const avec3f_t* in, A_OUT avec3f_t* out,
+	                         size_t n
+) {
+	s_mathKernels->normalize3(in, out, n);
+}
+
 A_NO_DISCARD amat4f_t A_mat4f_euler(avec3f_t angles) {
 	float sx = A_sinf(angles.x);
 	float cx = A_cosf(angles.x);
@@ -279,31 +476,83 @@ A_NO_DISCARD amat4f_t A_mat4f_euler(avec3f_t angles) {
 	return A_mat4f_mul(ret, roll);
 }
 
-//A_NO_DISCARD amat4f_t A_mat4f_look_at(avec3f_t eye, 
-//	                                  avec3f_t center, 
-//	                                  avec3f_t up
-//) {
-//	avec3f_t f = A_vec3f_normalize(A_vec3f_sub(center, eye));
-//	avec3f_t s = A_vec3f_normalize(A_vec3f_cross(f, up));
-//	avec3f_t u = A_vec3f_cross(s, f);
-//
-//	amat4f_t mat = A_MAT4F_IDENTITY;
-//	mat.m[0][0] =  s.x;
-//	mat.m[0][1] =  s.y;
-//	mat.m[0][2] =  s.z;
-//	mat.m[1][0] =  u.x;
-//	mat.m[1][1] =  u.y;
-//	mat.m[1][2] =  u.z;
-//	mat.m[2][0] = -f.x;
-//	mat.m[2][1] = -f.y;
-//	mat.m[2][2] = -f.z;
-//	mat.m[0][3] = -A_vec3f_dot(s, eye);
-//	mat.m[1][3] = -A_vec3f_dot(u, eye);
-//	mat.m[2][3] =  A_vec3f_dot(f, eye);
-//
-//	return mat;
-//}
-//
+A_NO_DISCARD amat4f_t A_mat4f_look_at(avec3f_t eye, 
+	                                  avec3f_t center, 
+	                                  avec3f_t up
+) {
+	avec3f_t f = A_vec3f_normalize(A_vec3f_sub(center, eye));
+	avec3f_t s = A_vec3f_normalize(A_vec3f_cross(f, up));
+	avec3f_t u = A_vec3f_cross(s, f);
+
+	amat4f_t mat = A_MAT4F_IDENTITY;
+	mat.m[0][0] =  s.x;
+	mat.m[0][1] =  u.x;
+	mat.m[0][2] = -f.x;
+	mat.m[1][0] =  s.y;
+	mat.m[1][1] =  u.y;
+	mat.m[1][2] = -f.y;
+	mat.m[2][0] =  s.z;
+	mat.m[2][1] =  u.z;
+	mat.m[2][2] = -f.z;
+	mat.m[3][0] = -A_vec3f_dot(s, eye);
+	mat.m[3][1] = -A_vec3f_dot(u, eye);
+	mat.m[3][2] =  A_vec3f_dot(f, eye);
+
+	return mat;
+}
+
+A_NO_DISCARD amat4f_t A_mat4f_look_at_lh(avec3f_t eye, 
+	                                     avec3f_t center, 
+	                                     avec3f_t up
+) {
+	avec3f_t z = A_vec3f_normalize(A_vec3f_sub(center, eye));
+	avec3f_t x = A_vec3f_normalize(A_vec3f_cross(up, z));
+	avec3f_t y = A_vec3f_cross(z, x);
+
+	amat4f_t mat = A_MAT4F_IDENTITY;
+	mat.m[0][0] =  x.x;
+	mat.m[0][1] =  y.x;
+	mat.m[0][2] =  z.x;
+	mat.m[1][0] =  x.y;
+	mat.m[1][1] =  y.y;
+	mat.m[1][2] =  z.y;
+	mat.m[2][0] =  x.z;
+	mat.m[2][1] =  y.z;
+	mat.m[2][2] =  z.z;
+	mat.m[3][0] = -A_vec3f_dot(x, eye);
+	mat.m[3][1] = -A_vec3f_dot(y, eye);
+	mat.m[3][2] = -A_vec3f_dot(z, eye);
+
+	return mat;
+}
+
+A_NO_DISCARD amat4f_t A_mat4f_perspective(float fovy, float aspect, 
+	                                      float z_near, float z_far
+) {
+	float f  = 1.0f / A_tanf(fovy * 0.5f);
+	float fn = 1.0f / (z_near - z_far);
+	amat4f_t perspective = A_MAT4F_ZERO;
+	perspective.m[0][0] = f / aspect;
+	perspective.m[1][1] = f;
+	perspective.m[2][2] = (z_near + z_far) * fn;
+	perspective.m[2][3] = -1.0f;
+	perspective.m[3][2] = 2.0f * z_near * z_far * fn;
+	return perspective;
+}
+
+A_NO_DISCARD amat4f_t A_mat4f_perspective_lh(float fovy, float aspect, 
+	                                         float z_near, float z_far
+) {
+	float f = 1.0f / A_tanf(fovy * 0.5f);
+	amat4f_t perspective = A_MAT4F_ZERO;
+	perspective.m[0][0] = f / aspect;
+	perspective.m[1][1] = f;
+	perspective.m[2][2] = z_far / (z_far - z_near);
+	perspective.m[2][3] = 1.0f;
+	perspective.m[3][2] = -z_near * z_far / (z_far - z_near);
+	return perspective;
+}
+
 //A_NO_DISCARD amat4f_t A_mat4f_ortho(float left, float right, 
 //	                                float top, float bottom
 //) {
@@ -315,16 +564,3 @@ A_NO_DISCARD amat4f_t A_mat4f_euler(avec3f_t angles) {
 //	ortho.m[1][3] = -(top + bottom) / (top - bottom);
 //	return ortho;
 //}
-//
-//A_NO_DISCARD amat4f_t A_mat4f_perspective(float fovy, float aspect, 
-//	                                      float z_near, float z_far
-//) {
-//	float f = A_cotf(fovy / 2.0f);
-//	amat4f_t perspective = A_MAT4F_ZERO;
-//	perspective.m[0][0] = f / aspect;
-//	perspective.m[1][1] = f;
-//	perspective.m[2][2] = (z_far + z_near) / (z_near - z_far);
-//	perspective.m[2][3] = (2.0f * z_far * z_near) / (z_near - z_far);
-//	perspective.m[3][2] = -1.0f;
-//	return perspective;
-//}
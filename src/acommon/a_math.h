@@ -239,17 +239,94 @@ A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_translate_vec3(amat4f_t m,
                                                           avec3f_t v);
 A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_scale_vec3    (amat4f_t m,   
                                                           avec3f_t v);
+// ============================================================================
+// Matrices are laid out the same as cglm's mat4 and D3DX's D3DXMATRIX, so
+// they can be handed to either backend as they are: m[i] is the i-th basis
+// vector, with the translation in m[3], and a point transforms as
+// p * m = p.x * m[0] + p.y * m[1] + p.z * m[2] + m[3].
+
+// Transforms by `a`, then by `b`. (D3DXMatrixMultiply(a, b), or
+// glm_mat4_mul(b, a).)
 A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_mul(amat4f_t a, amat4f_t b);
 A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_euler(avec3f_t angles);
+A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_transpose(amat4f_t m);
+// Returns false, leaving `inverse` alone, if `m` is singular.
+A_EXTERN_C A_NO_DISCARD bool       A_mat4f_inverse(amat4f_t m,
+                                                   A_OUT amat4f_t* inverse);
+
+// Right-handed, for clip space z in [-1, 1], like glm_lookat and
+// glm_perspective.
+A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_look_at       (avec3f_t eye, 
+                                                          avec3f_t center, 
+                                                          avec3f_t up);
+A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_perspective   (float fovy,   
+                                                          float aspect,
+                                                          float z_near, 
+                                                          float z_far);
+// Left-handed, for clip space z in [0, 1], like D3DXMatrixLookAtLH and
+// D3DXMatrixPerspectiveFovLH.
+A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_look_at_lh    (avec3f_t eye, 
+                                                          avec3f_t center, 
+                                                          avec3f_t up);
+A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_perspective_lh(float fovy,   
+                                                          float aspect,
+                                                          float z_near, 
+                                                          float z_far);
+
+// The point (p, 1) through `m`, without dividing by w.
+A_EXTERN_C A_NO_DISCARD avec3f_t   A_mat4f_transform_point3(amat4f_t m,
+                                                            avec3f_t p);
+
+// Batch versions, which go four at a time where the CPU can. `in` and
+// `out` may be the same array, but mustn't otherwise overlap.
+A_EXTERN_C void A_mat4f_transform_points3(const amat4f_t* m,
+                                          const avec3f_t* in,
+                                          A_OUT avec3f_t* out, size_t n);
+// Moves planes (n.p = w) by `m`, a transform of points, so that anything
+// on a plane before is on it after. They're only still normalized if `m`
+// doesn't scale.
+A_EXTERN_C void A_mat4f_transform_planes (const amat4f_t* m,
+                                          const aplane3f_t* in,
+                                          A_OUT aplane3f_t* out, size_t n);
+// Zero-length vectors stay zero.
+A_EXTERN_C void A_vec3f_normalize_array  (const avec3f_t* in,
+                                          A_OUT avec3f_t* out, size_t n);
+
+// Like the string functions, the matrix multiply and inverse and the batch
+// functions have SIMD implementations chosen from the CPU's features. The
+// scalar one is used everywhere else and is the reference the others are
+// tested against.
+typedef enum AMathImpl {
+    A_MATH_IMPL_SCALAR,
+    A_MATH_IMPL_SSE2,
+    A_MATH_IMPL_NEON,
+
+    A_MATH_IMPL_COUNT
+} AMathImpl;
+
+typedef struct AMathKernels {
+    const char* name;
+    void (*mat4_mul)         (const amat4f_t* a, const amat4f_t* b,
+                              A_OUT amat4f_t* out);
+    bool (*mat4_inverse)     (const amat4f_t* m, A_OUT amat4f_t* out);
+    void (*transform_points3)(const amat4f_t* m, const avec3f_t* in,
+                              A_OUT avec3f_t* out, size_t n);
+    // (x, y, z, w) * m for each of `in`.
+    void (*transform_vec4)   (const amat4f_t* m, const avec4f_t* in,
+                              A_OUT avec4f_t* out, size_t n);
+    void (*normalize3)       (const avec3f_t* in, A_OUT avec3f_t* out,
+                              size_t n);
+} AMathKernels;
+
+// Picks the implementation. Until it's called, the scalar one is used.
+// Call it once, before there are other threads.
+A_EXTERN_C void A_MathInit(void);
+// NULL if `impl` isn't built for this target or the CPU doesn't support it.
+A_EXTERN_C A_NO_DISCARD const AMathKernels* A_MathKernels(AMathImpl impl);
+A_EXTERN_C A_NO_DISCARD AMathImpl           A_MathImpl   (void);
+// ============================================================================
 
-//A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_look_at       (avec3f_t eye, 
-//                                                          avec3f_t center, 
-//                                                          avec3f_t up);
 //A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_ortho         (float left,   
 //                                                          float right, 
 //                                                          float top,    
 //                                                          float bottom);
-//A_EXTERN_C A_NO_DISCARD amat4f_t   A_mat4f_perspective   (float fovy,   
-//                                                          float aspect,
-//                                                          float z_near, 
-//                                                          float z_far);
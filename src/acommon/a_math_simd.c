@@ -0,0 +1,360 @@
+#include "a_math_simd.h"
+
+#if A_CPU_CAN_BUILD_SSE2
+#include <emmintrin.h>
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_NEON
+#include <arm_neon.h>
+#endif // A_CPU_CAN_BUILD_NEON
+
+// Everything here adds and multiplies in the same order as the scalar
+// versions in a_math.c, and doesn't fuse them, so the results are exactly
+// the same. The exception is the SSE2 inverse, which works in 2x2 blocks
+// and only matches to within rounding.
+//
+// The batch kernels go four at a time and leave whatever's left over to
+// the scalar ones.
+
+// ============================================================================
+// SSE2
+#if A_CPU_CAN_BUILD_SSE2
+// Lanes x and y of `a` followed by lanes z and w of `b`, lowest first.
+#define A_SHUFFLE(a, b, x, y, z, w) \
+    _mm_shuffle_ps((a), (b), _MM_SHUFFLE((w), (z), (y), (x)))
+#define A_SWIZZLE(a, x, y, z, w) A_SHUFFLE((a), (a), (x), (y), (z), (w))
+
+A_TARGET_FEATURE("sse2")
+static void A_mat4f_mul_sse2(const amat4f_t* a, const amat4f_t* b,
+                             A_OUT amat4f_t* out
+) {
+    __m128 b0 = _mm_loadu_ps(b->m[0]);
+    __m128 b1 = _mm_loadu_ps(b->m[1]);
+    __m128 b2 = _mm_loadu_ps(b->m[2]);
+    __m128 b3 = _mm_loadu_ps(b->m[3]);
+
+    // All of `a` is read before anything's written, since `out` can be
+    // either of them.
+    __m128 r[4];
+    for (int i = 0; i < 4; i++) {
+        __m128 x = _mm_mul_ps(_mm_set1_ps(a->m[i][0]), b0);
+        x = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(a->m[i][1]), b1));
+        x = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(a->m[i][2]), b2));
+        x = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(a->m[i][3]), b3));
+        r[i] = x;
+    }
+    for (int i = 0; i < 4; i++)
+        _mm_storeu_ps(out->m[i], r[i]);
+}
+
+// 2x2 matrices, one per register, row by row.
+// a * b
+A_TARGET_FEATURE("sse2")
+static __m128 A_Mat2Mul(__m128 a, __m128 b) {
+    return _mm_add_ps(
+        _mm_mul_ps(a,                       A_SWIZZLE(b, 0, 3, 0, 3)),
+        _mm_mul_ps(A_SWIZZLE(a, 1, 0, 3, 2), A_SWIZZLE(b, 2, 1, 2, 1))
+    );
+}
+
+// adj(a) * b
+A_TARGET_FEATURE("sse2")
+static __m128 A_Mat2AdjMul(__m128 a, __m128 b) {
+    return _mm_sub_ps(
+        _mm_mul_ps(A_SWIZZLE(a, 3, 3, 0, 0), b),
+        _mm_mul_ps(A_SWIZZLE(a, 1, 1, 2, 2), A_SWIZZLE(b, 2, 3, 0, 1))
+    );
+}
+
+// a * adj(b)
+A_TARGET_FEATURE("sse2")
+static __m128 A_Mat2MulAdj(__m128 a, __m128 b) {
+    return _mm_sub_ps(
+        _mm_mul_ps(a,                       A_SWIZZLE(b, 3, 0, 3, 0)),
+        _mm_mul_ps(A_SWIZZLE(a, 1, 0, 3, 2), A_SWIZZLE(b, 2, 1, 2, 1))
+    );
+}
+
+// Blockwise inversion: with m = | A B |, the inverse comes out of the
+//                               | C D |
+// determinants and adjugates of the 2x2 blocks without any division but
+// the one by the determinant of m.
+A_TARGET_FEATURE("sse2")
+static bool A_mat4f_inverse_sse2(const amat4f_t* m, A_OUT amat4f_t* out) {
+    __m128 r0 = _mm_loadu_ps(m->m[0]);
+    __m128 r1 = _mm_loadu_ps(m->m[1]);
+    __m128 r2 = _mm_loadu_ps(m->m[2]);
+    __m128 r3 = _mm_loadu_ps(m->m[3]);
+
+    __m128 A = _mm_movelh_ps(r0, r1);
+    __m128 B = _mm_movehl_ps(r1, r0);
+    __m128 C = _mm_movelh_ps(r2, r3);
+    __m128 D = _mm_movehl_ps(r3, r2);
+
+    // (|A|, |B|, |C|, |D|)
+    __m128 det_sub = _mm_sub_ps(
+        _mm_mul_ps(A_SHUFFLE(r0, r2, 0, 2, 0, 2), A_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+        _mm_mul_ps(A_SHUFFLE(r0, r2, 1, 3, 1, 3), A_SHUFFLE(r1, r3, 0, 2, 0, 2))
+    );
+    __m128 det_a = A_SWIZZLE(det_sub, 0, 0, 0, 0);
+    __m128 det_b = A_SWIZZLE(det_sub, 1, 1, 1, 1);
+    __m128 det_c = A_SWIZZLE(det_sub, 2, 2, 2, 2);
+    __m128 det_d = A_SWIZZLE(det_sub, 3, 3, 3, 3);
+
+    __m128 d_c = A_Mat2AdjMul(D, C);
+    __m128 a_b = A_Mat2AdjMul(A, B);
+
+    // The adjugates of the blocks of the inverse, X, Y, Z and W.
+    __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, A), A_Mat2Mul(B, d_c));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, D), A_Mat2Mul(C, a_b));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, C), A_Mat2MulAdj(D, a_b));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, B), A_Mat2MulAdj(A, d_c));
+
+    // |m| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    __m128 tr = _mm_mul_ps(a_b, A_SWIZZLE(d_c, 0, 2, 1, 3));
+    tr = _mm_add_ps(tr, A_SWIZZLE(tr, 2, 3, 0, 1));
+    tr = _mm_add_ps(tr, A_SWIZZLE(tr, 1, 0, 3, 2));
+    __m128 det = _mm_sub_ps(
+        _mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), tr
+    );
+    if (_mm_cvtss_f32(det) == 0.0f)
+        return false;
+
+    __m128 r = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+    x = _mm_mul_ps(x, r);
+    y = _mm_mul_ps(y, r);
+    z = _mm_mul_ps(z, r);
+    w = _mm_mul_ps(w, r);
+
+    // Undo the adjugates and put the blocks back into rows in one go.
+    _mm_storeu_ps(out->m[0], A_SHUFFLE(x, y, 3, 1, 3, 1));
+    _mm_storeu_ps(out->m[1], A_SHUFFLE(x, y, 2, 0, 2, 0));
+    _mm_storeu_ps(out->m[2], A_SHUFFLE(z, w, 3, 1, 3, 1));
+    _mm_storeu_ps(out->m[3], A_SHUFFLE(z, w, 2, 0, 2, 0));
+    return true;
+}
+
+// Four packed avec3f_t's, in three registers, to a register each of their
+// x, y and z, and back.
+A_TARGET_FEATURE("sse2")
+static void A_Vec3fDeinterleave(const float* p, A_OUT __m128* x,
+                                A_OUT __m128* y, A_OUT __m128* z
+) {
+    __m128 a = _mm_loadu_ps(p);     // x0 y0 z0 x1
+    __m128 b = _mm_loadu_ps(p + 4); // y1 z1 x2 y2
+    __m128 c = _mm_loadu_ps(p + 8); // z2 x3 y3 z3
+    __m128 xy23 = A_SHUFFLE(b, c, 2, 3, 1, 2);
+    __m128 yz01 = A_SHUFFLE(a, b, 1, 2, 0, 1);
+    *x = A_SHUFFLE(a,    xy23, 0, 3, 0, 2);
+    *y = A_SHUFFLE(yz01, xy23, 0, 2, 1, 3);
+    *z = A_SHUFFLE(yz01, c,    1, 3, 0, 3);
+}
+
+A_TARGET_FEATURE("sse2")
+static void A_Vec3fInterleave(float* p, __m128 x, __m128 y, __m128 z) {
+    __m128 xy01 = _mm_unpacklo_ps(x, y);
+    __m128 xy23 = _mm_unpackhi_ps(x, y);
+    __m128 zx   = A_SHUFFLE(z,    xy01, 0, 0, 2, 2);
+    __m128 yz   = A_SHUFFLE(xy01, z,    3, 3, 1, 1);
+    __m128 zx23 = A_SHUFFLE(z,    xy23, 2, 2, 2, 2);
+    __m128 yz33 = A_SHUFFLE(xy23, z,    3, 3, 3, 3);
+    _mm_storeu_ps(p,     A_SHUFFLE(xy01, zx,   0, 1, 0, 2));
+    _mm_storeu_ps(p + 4, A_SHUFFLE(yz,   xy23, 0, 2, 0, 1));
+    _mm_storeu_ps(p + 8, A_SHUFFLE(zx23, yz33, 0, 2, 0, 2));
+}
+
+A_TARGET_FEATURE("sse2")
+static void A_mat4f_transform_points3_sse2(const amat4f_t* m,
+                                           const avec3f_t* in,
+                                           A_OUT avec3f_t* out, size_t n
+) {
+    __m128 m00 = _mm_set1_ps(m->m[0][0]);
+    __m128 m01 = _mm_set1_ps(m->m[0][1]);
+    __m128 m02 = _mm_set1_ps(m->m[0][2]);
+    __m128 m10 = _mm_set1_ps(m->m[1][0]);
+    __m128 m11 = _mm_set1_ps(m->m[1][1]);
+    __m128 m12 = _mm_set1_ps(m->m[1][2]);
+    __m128 m20 = _mm_set1_ps(m->m[2][0]);
+    __m128 m21 = _mm_set1_ps(m->m[2][1]);
+    __m128 m22 = _mm_set1_ps(m->m[2][2]);
+    __m128 m30 = _mm_set1_ps(m->m[3][0]);
+    __m128 m31 = _mm_set1_ps(m->m[3][1]);
+    __m128 m32 = _mm_set1_ps(m->m[3][2]);
+
+    size_t i = 0;
+    for (; n - i >= 4; i += 4) {
+        __m128 x, y, z;
+        A_Vec3fDeinterleave(in[i].array, &x, &y, &z);
+
+        __m128 ox = _mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10));
+        __m128 oy = _mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11));
+        __m128 oz = _mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12));
+        ox = _mm_add_ps(_mm_add_ps(ox, _mm_mul_ps(z, m20)), m30);
+        oy = _mm_add_ps(_mm_add_ps(oy, _mm_mul_ps(z, m21)), m31);
+        oz = _mm_add_ps(_mm_add_ps(oz, _mm_mul_ps(z, m22)), m32);
+
+        A_Vec3fInterleave(out[i].array, ox, oy, oz);
+    }
+    if (i < n) {
+        A_MathKernels(A_MATH_IMPL_SCALAR)->transform_points3(
+            m, in + i, out + i, n - i
+        );
+    }
+}
+
+A_TARGET_FEATURE("sse2")
+static void A_mat4f_transform_vec4_sse2(const amat4f_t* m,
+                                        const avec4f_t* in,
+                                        A_OUT avec4f_t* out, size_t n
+) {
+    __m128 r0 = _mm_loadu_ps(m->m[0]);
+    __m128 r1 = _mm_loadu_ps(m->m[1]);
+    __m128 r2 = _mm_loadu_ps(m->m[2]);
+    __m128 r3 = _mm_loadu_ps(m->m[3]);
+    for (size_t i = 0; i < n; i++) {
+        __m128 v = _mm_loadu_ps(in[i].array);
+        __m128 o = _mm_mul_ps(A_SWIZZLE(v, 0, 0, 0, 0), r0);
+        o = _mm_add_ps(o, _mm_mul_ps(A_SWIZZLE(v, 1, 1, 1, 1), r1));
+        o = _mm_add_ps(o, _mm_mul_ps(A_SWIZZLE(v, 2, 2, 2, 2), r2));
+        o = _mm_add_ps(o, _mm_mul_ps(A_SWIZZLE(v, 3, 3, 3, 3), r3));
+        _mm_storeu_ps(out[i].array, o);
+    }
+}
+
+A_TARGET_FEATURE("sse2")
+static void A_vec3f_normalize_sse2(const avec3f_t* in, A_OUT avec3f_t* out,
+                                   size_t n
+) {
+    __m128 zero = _mm_setzero_ps();
+    size_t i = 0;
+    for (; n - i >= 4; i += 4) {
+        __m128 x, y, z;
+        A_Vec3fDeinterleave(in[i].array, &x, &y, &z);
+
+        __m128 d = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(d, _mm_mul_ps(z, z)));
+        // The scalar version returns zero for len <= 0, and lets NaN
+        // through.
+        __m128 keep = _mm_cmpnle_ps(len, zero);
+        x = _mm_and_ps(_mm_div_ps(x, len), keep);
+        y = _mm_and_ps(_mm_div_ps(y, len), keep);
+        z = _mm_and_ps(_mm_div_ps(z, len), keep);
+
+        A_Vec3fInterleave(out[i].array, x, y, z);
+    }
+    if (i < n)
+        A_MathKernels(A_MATH_IMPL_SCALAR)->normalize3(in + i, out + i, n - i);
+}
+
+const AMathKernels A__priv__mathKernelsSse2 = {
+    /*.name              =*/ "sse2",
+    /*.mat4_mul          =*/ A_mat4f_mul_sse2,
+    /*.mat4_inverse      =*/ A_mat4f_inverse_sse2,
+    /*.transform_points3 =*/ A_mat4f_transform_points3_sse2,
+    /*.transform_vec4    =*/ A_mat4f_transform_vec4_sse2,
+    /*.normalize3        =*/ A_vec3f_normalize_sse2,
+};
+#endif // A_CPU_CAN_BUILD_SSE2
+// ============================================================================
+
+// ============================================================================
+// NEON
+//
+// vld3q/vst3q do the (de)interleaving of packed avec3f_t's that takes
+// shuffles on SSE2. There's no NEON inverse; it's the scalar one.
+#if A_CPU_CAN_BUILD_NEON
+static void A_mat4f_mul_neon(const amat4f_t* a, const amat4f_t* b,
+                             A_OUT amat4f_t* out
+) {
+    float32x4_t b0 = vld1q_f32(b->m[0]);
+    float32x4_t b1 = vld1q_f32(b->m[1]);
+    float32x4_t b2 = vld1q_f32(b->m[2]);
+    float32x4_t b3 = vld1q_f32(b->m[3]);
+
+    float32x4_t r[4];
+    for (int i = 0; i < 4; i++) {
+        float32x4_t x = vmulq_n_f32(b0, a->m[i][0]);
+        x = vaddq_f32(x, vmulq_n_f32(b1, a->m[i][1]));
+        x = vaddq_f32(x, vmulq_n_f32(b2, a->m[i][2]));
+        x = vaddq_f32(x, vmulq_n_f32(b3, a->m[i][3]));
+        r[i] = x;
+    }
+    for (int i = 0; i < 4; i++)
+        vst1q_f32(out->m[i], r[i]);
+}
+
+static bool A_mat4f_inverse_neon(const amat4f_t* m, A_OUT amat4f_t* out) {
+    return A_MathKernels(A_MATH_IMPL_SCALAR)->mat4_inverse(m, out);
+}
+
+static void A_mat4f_transform_points3_neon(const amat4f_t* m,
+                                           const avec3f_t* in,
+                                           A_OUT avec3f_t* out, size_t n
+) {
+    size_t i = 0;
+    for (; n - i >= 4; i += 4) {
+        float32x4x3_t p = vld3q_f32(in[i].array);
+        float32x4x3_t o;
+        for (int j = 0; j < 3; j++) {
+            float32x4_t v = vaddq_f32(vmulq_n_f32(p.val[0], m->m[0][j]),
+                                      vmulq_n_f32(p.val[1], m->m[1][j]));
+            v = vaddq_f32(v, vmulq_n_f32(p.val[2], m->m[2][j]));
+            o.val[j] = vaddq_f32(v, vdupq_n_f32(m->m[3][j]));
+        }
+        vst3q_f32(out[i].array, o);
+    }
+    if (i < n) {
+        A_MathKernels(A_MATH_IMPL_SCALAR)->transform_points3(
+            m, in + i, out + i, n - i
+        );
+    }
+}
+
+static void A_mat4f_transform_vec4_neon(const amat4f_t* m,
+                                        const avec4f_t* in,
+                                        A_OUT avec4f_t* out, size_t n
+) {
+    float32x4_t r0 = vld1q_f32(m->m[0]);
+    float32x4_t r1 = vld1q_f32(m->m[1]);
+    float32x4_t r2 = vld1q_f32(m->m[2]);
+    float32x4_t r3 = vld1q_f32(m->m[3]);
+    for (size_t i = 0; i < n; i++) {
+        avec4f_t v = in[i];
+        float32x4_t o = vmulq_n_f32(r0, v.x);
+        o = vaddq_f32(o, vmulq_n_f32(r1, v.y));
+        o = vaddq_f32(o, vmulq_n_f32(r2, v.z));
+        o = vaddq_f32(o, vmulq_n_f32(r3, v.w));
+        vst1q_f32(out[i].array, o);
+    }
+}
+
+static void A_vec3f_normalize_neon(const avec3f_t* in, A_OUT avec3f_t* out,
+                                   size_t n
+) {
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; n - i >= 4; i += 4) {
+        float32x4x3_t p = vld3q_f32(in[i].array);
+        float32x4_t d = vaddq_f32(vmulq_f32(p.val[0], p.val[0]),
+                                  vmulq_f32(p.val[1], p.val[1]));
+        float32x4_t len = vsqrtq_f32(vaddq_f32(d, vmulq_f32(p.val[2], p.val[2])));
+        uint32x4_t keep = vmvnq_u32(vcleq_f32(len, zero));
+        for (int j = 0; j < 3; j++) {
+            uint32x4_t v = vreinterpretq_u32_f32(vdivq_f32(p.val[j], len));
+            p.val[j] = vreinterpretq_f32_u32(vandq_u32(v, keep));
+        }
+        vst3q_f32(out[i].array, p);
+    }
+    if (i < n)
+        A_MathKernels(A_MATH_IMPL_SCALAR)->normalize3(in + i, out + i, n - i);
+}
+
+const AMathKernels A__priv__mathKernelsNeon = {
+    /*.name              =*/ "neon",
+    /*.mat4_mul          =*/ A_mat4f_mul_neon,
+    /*.mat4_inverse      =*/ A_mat4f_inverse_neon,
+    /*.transform_points3 =*/ A_mat4f_transform_points3_neon,
+    /*.transform_vec4    =*/ A_mat4f_transform_vec4_neon,
+    /*.normalize3        =*/ A_vec3f_normalize_neon,
+};
+#endif // A_CPU_CAN_BUILD_NEON
+// ============================================================================
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "acommon.h"
+#include "a_cpu.h"
+#include "a_math.h"
+
+// The implementations in a_math_simd.c, for A_MathKernels to choose from.
+// Only the ones this build can compile are defined.
+#if A_CPU_CAN_BUILD_SSE2
+A_EXTERN_C const AMathKernels A__priv__mathKernelsSse2;
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_NEON
+A_EXTERN_C const AMathKernels A__priv__mathKernelsNeon;
+#endif // A_CPU_CAN_BUILD_NEON
@@ -12,12 +12,16 @@
 #define vsnprintf _vsnprintf
 #endif // defined(_MSC_VER) && _MSC_VER < 1900
 
+#include "a_cpu.h"
+#include "a_string_simd.h"
 #include "z_mem.h"
 
-A_NO_DISCARD bool A_memcmp(const void* A_RESTRICT a, 
-                           const void* A_RESTRICT b, size_t n
+// The byte-at-a-time reference implementations. See a_string_simd.c for
+// the ones that are actually used.
+static bool A_memcmp_byte(const void* A_RESTRICT a, 
+                          const void* A_RESTRICT b, size_t n
 ) {
-    for(int i = 0; i < n; i++) {
+    for(size_t i = 0; i < n; i++) {
         if(((char* A_RESTRICT)a)[i] != ((char* A_RESTRICT)b)[i])
             return false;
     }
@@ -25,12 +29,14 @@ A_NO_DISCARD bool A_memcmp(const void* A_RESTRICT a,
     return true;
 }
 
-void A_memcpy(void* A_RESTRICT dest, const void* A_RESTRICT src, size_t n) {
+static void A_memcpy_byte(void* A_RESTRICT dest, const void* A_RESTRICT src,
+                          size_t n
+) {
     for(size_t i = 0; i < n; i++)
         ((char* A_RESTRICT)dest)[i] = ((char* A_RESTRICT)src)[i];
 }
 
-A_NO_DISCARD void* A_memchr(const void* A_RESTRICT p, char c, size_t n) {
+static void* A_memchr_byte(const void* A_RESTRICT p, char c, size_t n) {
     for(size_t i = 0; i < n; i++) {
         if(((char* A_RESTRICT)p)[i] == c)
             return (void* A_RESTRICT)((const char*)p + i);
@@ -39,18 +45,100 @@ A_NO_DISCARD void* A_memchr(const void* A_RESTRICT p, char c, size_t n) {
     return NULL;
 }
 
+static void A_memset_byte(void* A_RESTRICT p, char c, size_t n) {
+    for(size_t i = 0; i < n; i++)
+        ((char* A_RESTRICT)p)[i] = c;
+}
+
+static size_t A_cstrlen_byte(const char* A_RESTRICT s) {
+    size_t i = 0;
+    while (s[i] != '\0')
+        i++;
+    return i;
+}
+
+static const AStringKernels s_stringKernelsByte = {
+    /*.name    =*/ "byte",
+    /*.compare =*/ A_memcmp_byte,
+    /*.copy    =*/ A_memcpy_byte,
+    /*.find    =*/ A_memchr_byte,
+    /*.fill    =*/ A_memset_byte,
+    /*.length  =*/ A_cstrlen_byte,
+};
+
+static const AStringKernels* s_stringKernels = &A__priv__stringKernelsWord;
+static AStringImpl           s_stringImpl    = A_STRING_IMPL_WORD;
+
+A_NO_DISCARD const AStringKernels* A_StringKernels(AStringImpl impl) {
+    const ACpuFeatures* cpu = A_CpuFeatures();
+    switch (impl) {
+    case A_STRING_IMPL_BYTE:
+        return &s_stringKernelsByte;
+    case A_STRING_IMPL_WORD:
+        return &A__priv__stringKernelsWord;
+#if A_CPU_CAN_BUILD_SSE2
+    case A_STRING_IMPL_SSE2:
+        return cpu->sse2 ? &A__priv__stringKernelsSse2 : NULL;
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_AVX2
+    case A_STRING_IMPL_AVX2:
+        return cpu->avx2 ? &A__priv__stringKernelsAvx2 : NULL;
+#endif // A_CPU_CAN_BUILD_AVX2
+#if A_CPU_CAN_BUILD_NEON
+    case A_STRING_IMPL_NEON:
+        return cpu->neon ? &A__priv__stringKernelsNeon : NULL;
+#endif // A_CPU_CAN_BUILD_NEON
+    default:
+        A_UNUSED(cpu);
+        return NULL;
+    }
+}
+
+void A_StringInit(void) {
+    // Best first.
+    static const AStringImpl order[] = {
+        A_STRING_IMPL_AVX2, A_STRING_IMPL_SSE2, A_STRING_IMPL_NEON,
+        A_STRING_IMPL_WORD
+    };
+    for (size_t i = 0; i < A_countof(order); i++) {
+        const AStringKernels* k = A_StringKernels(order[i]);
+        if (k != NULL) {
+            s_stringKernels = k;
+            s_stringImpl    = order[i];
+            return;
+        }
+    }
+}
+
+A_NO_DISCARD AStringImpl A_StringImpl(void) {
+    return s_stringImpl;
+}
+
+A_NO_DISCARD bool A_memcmp(const void* A_RESTRICT a, 
+                           const void* A_RESTRICT b, size_t n
+) {
+    return s_stringKernels->compare(a, b, n);
+}
+
+void A_memcpy(void* A_RESTRICT dest, const void* A_RESTRICT src, size_t n) {
+    s_stringKernels->copy(dest, src, n);
+}
+
+A_NO_DISCARD void* A_memchr(const void* A_RESTRICT p, char c, size_t n) {
+    return s_stringKernels->find(p, c, n);
+}
+
 A_NO_DISCARD void* A_memrchr(const void* A_RESTRICT p, char c, size_t n) {
     for(size_t i = n; i > 0; i--) {
-        if(((char* A_RESTRICT)p)[i] == c)
-            return (void* A_RESTRICT)((const char*)p + i);
+        if(((char* A_RESTRICT)p)[i - 1] == c)
+            return (void* A_RESTRICT)((const char*)p + i - 1);
     }
 
     return NULL;
 }
 
 void A_memset(void* A_RESTRICT p, char c, size_t n) {
-    for(size_t i = 0; i < n; i++)
-        ((char* A_RESTRICT)p)[i] = c;
+    s_stringKernels->fill(p, c, n);
 }
 
 void A_memzero(void* A_RESTRICT p, size_t n) {
@@ -63,25 +151,56 @@ A_NO_DISCARD bool A_cstrcmp(const char* A_RESTRICT a,
     return strcmp(a, b) == 0;
 }
 
+// The engine never calls setlocale, so A_tolower only ever folds ASCII.
+// Doing it inline keeps a function call out of every byte of the compares
+// and hashes the dvar and command tables do on each lookup.
+static uint8_t A_FoldAscii(char c) {
+    uint8_t u = (uint8_t)c;
+    return (u >= 'A' && u <= 'Z') ? (uint8_t)(u + ('a' - 'A')) : u;
+}
+
 A_NO_DISCARD bool A_cstricmp(const char* A_RESTRICT a, 
                              const char* A_RESTRICT b
 ) {
-    size_t a_len = A_cstrlen(a);
-    size_t b_len = A_cstrlen(b);
+    for (;; a++, b++) {
+        if (A_FoldAscii(*a) != A_FoldAscii(*b))
+            return false;
+        if (*a == '\0')
+            return true;
+    }
+}
 
-    if (a_len != b_len)
-        return false;
+static uint32_t A_HashFinalize(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
 
-    for (size_t i = 0; i < a_len; i++) {
-        if (A_tolower(a[i]) != A_tolower(b[i]))
-            return false;
+A_NO_DISCARD uint32_t A_cstrhash(const char* A_RESTRICT s) {
+    assert(s);
+    uint32_t h = 2166136261u;
+    for (; *s != '\0'; s++) {
+        h ^= (uint8_t)*s;
+        h *= 16777619u;
     }
-    
-    return true;
+    return A_HashFinalize(h);
+}
+
+A_NO_DISCARD uint32_t A_cstrihash(const char* A_RESTRICT s) {
+    assert(s);
+    uint32_t h = 2166136261u;
+    for (; *s != '\0'; s++) {
+        h ^= A_FoldAscii(*s);
+        h *= 16777619u;
+    }
+    return A_HashFinalize(h);
 }
 
 A_NO_DISCARD size_t A_cstrlen(const char* A_RESTRICT s) {
-    return strlen(s);
+    return s_stringKernels->length(s);
 }
 
 A_NO_DISCARD char* A_cstrdup(const char* A_RESTRICT s) {
@@ -109,7 +228,7 @@ void A_cstrncpyz(char* A_RESTRICT dest, const char* A_RESTRICT src, size_t n) {
 }
 
 A_NO_DISCARD size_t A_cstrchr(const char* A_RESTRICT s, char c) {
-    const char* A_RESTRICT p = (const char*)memchr(s, c, A_cstrlen(s));
+    const char* A_RESTRICT p = (const char*)A_memchr(s, c, A_cstrlen(s));
     return p == NULL ? A_NPOS : p - s;
 }
 
@@ -145,7 +264,7 @@ bool A_atob(const char* A_RESTRICT s, A_OUT bool* b) {
 }
 
 size_t A_itoa(int i, char* A_RESTRICT p, size_t n) {
-    int ret = snprintf(p, n, "%*d", (int)n, i);
+    int ret = snprintf(p, n, "%d", i);
     assert(ret <= n);
     return ret;
 }
@@ -165,7 +284,7 @@ bool A_atoi(const char* A_RESTRICT s, A_OUT int* i) {
 }
 
 size_t A_ftoa(float f, char* A_RESTRICT p, size_t n) {
-    int ret = snprintf(p, n, "%*f", (int)n, f);
+    int ret = snprintf(p, n, "%f", f);
     assert(ret <= n);
     return ret;
 }
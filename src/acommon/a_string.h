@@ -30,6 +30,41 @@ A_EXTERN_C void   A_memset(void* A_RESTRICT p, char c, size_t n);
 A_EXTERN_C void   A_memzero(void* A_RESTRICT p, size_t n);
 // ============================================================================
 
+// ============================================================================
+// A_memcmp, A_memcpy, A_memchr, A_memset and A_cstrlen have several
+// implementations, and call whichever is the fastest one the CPU supports.
+// The byte-at-a-time one is the reference the others are tested against;
+// it's never picked.
+typedef enum AStringImpl {
+    A_STRING_IMPL_BYTE,
+    A_STRING_IMPL_WORD, // a machine word at a time; works everywhere
+    A_STRING_IMPL_SSE2,
+    A_STRING_IMPL_AVX2,
+    A_STRING_IMPL_NEON,
+
+    A_STRING_IMPL_COUNT
+} AStringImpl;
+
+typedef struct AStringKernels {
+    const char* name;
+    bool   (*compare)(const void* A_RESTRICT a, const void* A_RESTRICT b,
+                      size_t n);
+    void   (*copy)   (void* A_RESTRICT dest, const void* A_RESTRICT src,
+                      size_t n);
+    void*  (*find)   (const void* A_RESTRICT p, char c, size_t n);
+    void   (*fill)   (void* A_RESTRICT p, char c, size_t n);
+    size_t (*length) (const char* A_RESTRICT s);
+} AStringKernels;
+
+// Picks the implementation from the CPU's features. Until it's called,
+// the word-at-a-time one is used. Call it once, before there are other
+// threads.
+A_EXTERN_C void A_StringInit(void);
+// NULL if `impl` isn't built for this target or the CPU doesn't support it.
+A_EXTERN_C A_NO_DISCARD const AStringKernels* A_StringKernels(AStringImpl impl);
+A_EXTERN_C A_NO_DISCARD AStringImpl           A_StringImpl   (void);
+// ============================================================================
+
 // Analogous to std::string::npos.
 #define A_NPOS (~(size_t)0)
 
@@ -38,6 +73,13 @@ A_EXTERN_C A_NO_DISCARD bool A_cstrcmp (const char* A_RESTRICT a,
 A_EXTERN_C A_NO_DISCARD bool A_cstricmp(const char* A_RESTRICT a, 
                                         const char* A_RESTRICT b);
 
+// 32-bit FNV-1a with a murmur3 finalizer, so every bit of the result depends
+// on every byte and the low bits are fit to mask a power-of-two table with.
+// `A_cstrihash` lowercases first, to go with `A_cstricmp`. Equal hashes
+// don't mean equal strings; compare them as well.
+A_EXTERN_C A_NO_DISCARD uint32_t A_cstrhash (const char* A_RESTRICT s);
+A_EXTERN_C A_NO_DISCARD uint32_t A_cstrihash(const char* A_RESTRICT s);
+
 // This is its own function, rather than being an overload of `A_strlen` 
 // because it's O(n) rather than O(1). It should only ever really be used to
 // create a `str_t` from a C-style string.
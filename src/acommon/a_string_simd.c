@@ -0,0 +1,660 @@
+#include "a_string_simd.h"
+
+#if A_CPU_CAN_BUILD_SSE2
+#include <emmintrin.h>
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_AVX2
+#include <immintrin.h>
+#endif // A_CPU_CAN_BUILD_AVX2
+#if A_CPU_CAN_BUILD_NEON
+#include <arm_neon.h>
+#endif // A_CPU_CAN_BUILD_NEON
+#if (A_CPU_CAN_BUILD_SSE2 || A_CPU_CAN_BUILD_AVX2) && A_COMPILER_IS_MSVC
+#include <intrin.h>
+#endif // (A_CPU_CAN_BUILD_SSE2 || A_CPU_CAN_BUILD_AVX2) && A_COMPILER_IS_MSVC
+
+// Every kernel here only reads and writes within the range it's given,
+// except A_cstrlen's, which read whole aligned blocks and so can read past
+// the terminator (see A_NO_SANITIZE_ADDRESS).
+
+// ============================================================================
+// A machine word at a time.
+#if A_COMPILER_IS_GCC_COMPATIBLE
+typedef size_t __attribute__((__may_alias__))                 AWord;
+typedef size_t __attribute__((__may_alias__, __aligned__(1))) AWordUnaligned;
+#else
+typedef size_t AWord;
+typedef size_t AWordUnaligned;
+#endif // A_COMPILER_IS_GCC_COMPATIBLE
+
+#define A_WORD_SIZE  sizeof(size_t)
+#define A_WORD_ONES  (~(size_t)0 / 0xFF)
+#define A_WORD_HIGHS (A_WORD_ONES * 0x80)
+// Nonzero if any byte of `w` is zero.
+#define A_WORD_HAS_ZERO(w) (((w) - A_WORD_ONES) & ~(w) & A_WORD_HIGHS)
+
+static bool A_IsWordAligned(const void* p) {
+    return ((uintptr_t)p & (A_WORD_SIZE - 1)) == 0;
+}
+
+static bool A_memcmp_word(const void* A_RESTRICT a, const void* A_RESTRICT b,
+                          size_t n
+) {
+    const unsigned char* x = (const unsigned char*)a;
+    const unsigned char* y = (const unsigned char*)b;
+    for (; n >= A_WORD_SIZE; n -= A_WORD_SIZE) {
+        if (*(const AWordUnaligned*)x != *(const AWordUnaligned*)y)
+            return false;
+        x += A_WORD_SIZE;
+        y += A_WORD_SIZE;
+    }
+    for (; n > 0; n--) {
+        if (*x++ != *y++)
+            return false;
+    }
+    return true;
+}
+
+static void A_memcpy_word(void* A_RESTRICT dest, const void* A_RESTRICT src,
+                          size_t n
+) {
+    unsigned char*       d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+    for (; n > 0 && !A_IsWordAligned(d); n--)
+        *d++ = *s++;
+    for (; n >= A_WORD_SIZE; n -= A_WORD_SIZE) {
+        *(AWord*)d = *(const AWordUnaligned*)s;
+        d += A_WORD_SIZE;
+        s += A_WORD_SIZE;
+    }
+    for (; n > 0; n--)
+        *d++ = *s++;
+}
+
+static void* A_memchr_word(const void* A_RESTRICT p, char c, size_t n) {
+    const unsigned char* s = (const unsigned char*)p;
+    unsigned char        b = (unsigned char)c;
+    for (; n > 0 && !A_IsWordAligned(s); n--, s++) {
+        if (*s == b)
+            return (void*)s;
+    }
+
+    size_t splat = A_WORD_ONES * b;
+    for (; n >= A_WORD_SIZE; n -= A_WORD_SIZE, s += A_WORD_SIZE) {
+        size_t w = *(const AWord*)s ^ splat;
+        if (A_WORD_HAS_ZERO(w))
+            break;
+    }
+    for (; n > 0; n--, s++) {
+        if (*s == b)
+            return (void*)s;
+    }
+    return NULL;
+}
+
+static void A_memset_word(void* A_RESTRICT p, char c, size_t n) {
+    unsigned char* d = (unsigned char*)p;
+    unsigned char  b = (unsigned char)c;
+    for (; n > 0 && !A_IsWordAligned(d); n--)
+        *d++ = b;
+
+    size_t splat = A_WORD_ONES * b;
+    for (; n >= A_WORD_SIZE; n -= A_WORD_SIZE, d += A_WORD_SIZE)
+        *(AWord*)d = splat;
+    for (; n > 0; n--)
+        *d++ = b;
+}
+
+A_NO_SANITIZE_ADDRESS
+static size_t A_cstrlen_word(const char* A_RESTRICT str) {
+    const char* s = str;
+    for (; !A_IsWordAligned(s); s++) {
+        if (*s == '\0')
+            return (size_t)(s - str);
+    }
+    for (;;) {
+        size_t w = *(const AWord*)s;
+        if (A_WORD_HAS_ZERO(w))
+            break;
+        s += A_WORD_SIZE;
+    }
+    while (*s != '\0')
+        s++;
+    return (size_t)(s - str);
+}
+
+const AStringKernels A__priv__stringKernelsWord = {
+    /*.name    =*/ "word",
+    /*.compare =*/ A_memcmp_word,
+    /*.copy    =*/ A_memcpy_word,
+    /*.find    =*/ A_memchr_word,
+    /*.fill    =*/ A_memset_word,
+    /*.length  =*/ A_cstrlen_word,
+};
+// ============================================================================
+
+#if A_CPU_CAN_BUILD_SSE2 || A_CPU_CAN_BUILD_AVX2
+// Index of the lowest set bit. `x` mustn't be 0.
+static uint32_t A_Ctz32(uint32_t x) {
+#if A_COMPILER_IS_GCC_COMPATIBLE
+    return (uint32_t)__builtin_ctz(x);
+#else
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return (uint32_t)i;
+#endif // A_COMPILER_IS_GCC_COMPATIBLE
+}
+#endif // A_CPU_CAN_BUILD_SSE2 || A_CPU_CAN_BUILD_AVX2
+
+// ============================================================================
+// SSE2, 16 bytes at a time.
+//
+// Anything 16 bytes or longer is done in whole blocks, with the last one
+// overlapping the one before it rather than finishing a byte at a time.
+#if A_CPU_CAN_BUILD_SSE2
+A_TARGET_FEATURE("sse2")
+static bool A_memcmp_sse2(const void* A_RESTRICT a, const void* A_RESTRICT b,
+                          size_t n
+) {
+    if (n < 16)
+        return A_memcmp_word(a, b, n);
+
+    const unsigned char* x = (const unsigned char*)a;
+    const unsigned char* y = (const unsigned char*)b;
+    for (; n > 64; n -= 64, x += 64, y += 64) {
+        __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)x),
+                                    _mm_loadu_si128((const __m128i*)y));
+        __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(x + 16)),
+                                    _mm_loadu_si128((const __m128i*)(y + 16)));
+        __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(x + 32)),
+                                    _mm_loadu_si128((const __m128i*)(y + 32)));
+        __m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(x + 48)),
+                                    _mm_loadu_si128((const __m128i*)(y + 48)));
+        __m128i e = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+        if (_mm_movemask_epi8(e) != 0xFFFF)
+            return false;
+    }
+    for (; n > 16; n -= 16, x += 16, y += 16) {
+        __m128i e = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)x),
+                                   _mm_loadu_si128((const __m128i*)y));
+        if (_mm_movemask_epi8(e) != 0xFFFF)
+            return false;
+    }
+    __m128i e = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(x + n - 16)),
+                               _mm_loadu_si128((const __m128i*)(y + n - 16)));
+    return _mm_movemask_epi8(e) == 0xFFFF;
+}
+
+A_TARGET_FEATURE("sse2")
+static void A_memcpy_sse2(void* A_RESTRICT dest, const void* A_RESTRICT src,
+                          size_t n
+) {
+    if (n < 16) {
+        A_memcpy_word(dest, src, n);
+        return;
+    }
+
+    unsigned char*       d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+    __m128i last = _mm_loadu_si128((const __m128i*)(s + n - 16));
+
+    // Store the first block unaligned, then carry on from the first
+    // aligned address in the destination.
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    _mm_storeu_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= 64; n -= 64, d += 64, s += 64) {
+        __m128i x0 = _mm_loadu_si128((const __m128i*)s);
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i x2 = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i x3 = _mm_loadu_si128((const __m128i*)(s + 48));
+        _mm_store_si128((__m128i*)d,        x0);
+        _mm_store_si128((__m128i*)(d + 16), x1);
+        _mm_store_si128((__m128i*)(d + 32), x2);
+        _mm_store_si128((__m128i*)(d + 48), x3);
+    }
+    for (; n >= 16; n -= 16, d += 16, s += 16)
+        _mm_store_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+    _mm_storeu_si128((__m128i*)(d + n - 16), last);
+}
+
+A_TARGET_FEATURE("sse2")
+static void* A_memchr_sse2(const void* A_RESTRICT p, char c, size_t n) {
+    if (n < 16)
+        return A_memchr_word(p, c, n);
+
+    const unsigned char* s   = (const unsigned char*)p;
+    const unsigned char* end = s + n;
+    __m128i v = _mm_set1_epi8(c);
+    // Four blocks at a time until there's a match, then one at a time to
+    // find it.
+    for (; end - s >= 64; s += 64) {
+        __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)s), v);
+        __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s + 16)), v);
+        __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s + 32)), v);
+        __m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s + 48)), v);
+        __m128i e  = _mm_or_si128(_mm_or_si128(e0, e1), _mm_or_si128(e2, e3));
+        if (_mm_movemask_epi8(e) != 0)
+            break;
+    }
+    for (; end - s >= 16; s += 16) {
+        int m = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)s), v)
+        );
+        if (m != 0)
+            return (void*)(s + A_Ctz32((uint32_t)m));
+    }
+    if (s == end)
+        return NULL;
+
+    s = end - 16;
+    int m = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)s), v)
+    );
+    return m != 0 ? (void*)(s + A_Ctz32((uint32_t)m)) : NULL;
+}
+
+A_TARGET_FEATURE("sse2")
+static void A_memset_sse2(void* A_RESTRICT p, char c, size_t n) {
+    if (n < 16) {
+        A_memset_word(p, c, n);
+        return;
+    }
+
+    unsigned char* d = (unsigned char*)p;
+    __m128i v = _mm_set1_epi8(c);
+    _mm_storeu_si128((__m128i*)(d + n - 16), v);
+
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    _mm_storeu_si128((__m128i*)d, v);
+    d += head;
+    n -= head;
+
+    for (; n >= 64; n -= 64, d += 64) {
+        _mm_store_si128((__m128i*)d,        v);
+        _mm_store_si128((__m128i*)(d + 16), v);
+        _mm_store_si128((__m128i*)(d + 32), v);
+        _mm_store_si128((__m128i*)(d + 48), v);
+    }
+    for (; n >= 16; n -= 16, d += 16)
+        _mm_store_si128((__m128i*)d, v);
+}
+
+A_NO_SANITIZE_ADDRESS A_TARGET_FEATURE("sse2")
+static size_t A_cstrlen_sse2(const char* A_RESTRICT str) {
+    // Start from the aligned block containing `str`, ignoring whatever
+    // comes before it.
+    uint32_t    skip = (uint32_t)((uintptr_t)str & 15);
+    const char* s    = str - skip;
+    __m128i     zero = _mm_setzero_si128();
+    uint32_t m = (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)s), zero)
+    ) >> skip;
+    if (m != 0)
+        return A_Ctz32(m);
+
+    // One block at a time up to a 64 byte boundary, then four at a time.
+    // The four never straddle a page, so the terminator can be looked
+    // for in all of them at once.
+    for (s += 16; ((uintptr_t)s & 63) != 0; s += 16) {
+        m = (uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)s), zero)
+        );
+        if (m != 0)
+            return (size_t)(s - str) + A_Ctz32(m);
+    }
+    for (;; s += 64) {
+        __m128i x = _mm_min_epu8(
+            _mm_min_epu8(_mm_load_si128((const __m128i*)s),
+                         _mm_load_si128((const __m128i*)(s + 16))),
+            _mm_min_epu8(_mm_load_si128((const __m128i*)(s + 32)),
+                         _mm_load_si128((const __m128i*)(s + 48)))
+        );
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0)
+            break;
+    }
+    for (;; s += 16) {
+        m = (uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)s), zero)
+        );
+        if (m != 0)
+            return (size_t)(s - str) + A_Ctz32(m);
+    }
+}
+
+const AStringKernels A__priv__stringKernelsSse2 = {
+    /*.name    =*/ "sse2",
+    /*.compare =*/ A_memcmp_sse2,
+    /*.copy    =*/ A_memcpy_sse2,
+    /*.find    =*/ A_memchr_sse2,
+    /*.fill    =*/ A_memset_sse2,
+    /*.length  =*/ A_cstrlen_sse2,
+};
+#endif // A_CPU_CAN_BUILD_SSE2
+// ============================================================================
+
+// ============================================================================
+// AVX2, 32 bytes at a time, in the same shape as the SSE2 kernels. Anything
+// shorter than a block goes to those, since a CPU with AVX2 has SSE2.
+#if A_CPU_CAN_BUILD_AVX2
+A_TARGET_FEATURE("avx2")
+static bool A_memcmp_avx2(const void* A_RESTRICT a, const void* A_RESTRICT b,
+                          size_t n
+) {
+    if (n < 32)
+        return A_memcmp_sse2(a, b, n);
+
+    const unsigned char* x = (const unsigned char*)a;
+    const unsigned char* y = (const unsigned char*)b;
+    for (; n > 128; n -= 128, x += 128, y += 128) {
+        __m256i e0 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)x),
+            _mm256_loadu_si256((const __m256i*)y));
+        __m256i e1 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(x + 32)),
+            _mm256_loadu_si256((const __m256i*)(y + 32)));
+        __m256i e2 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(x + 64)),
+            _mm256_loadu_si256((const __m256i*)(y + 64)));
+        __m256i e3 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(x + 96)),
+            _mm256_loadu_si256((const __m256i*)(y + 96)));
+        __m256i e = _mm256_and_si256(_mm256_and_si256(e0, e1),
+                                     _mm256_and_si256(e2, e3));
+        if ((uint32_t)_mm256_movemask_epi8(e) != 0xFFFFFFFFu)
+            return false;
+    }
+    for (; n > 32; n -= 32, x += 32, y += 32) {
+        __m256i e = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)x),
+                                      _mm256_loadu_si256((const __m256i*)y));
+        if ((uint32_t)_mm256_movemask_epi8(e) != 0xFFFFFFFFu)
+            return false;
+    }
+    __m256i e = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i*)(x + n - 32)),
+        _mm256_loadu_si256((const __m256i*)(y + n - 32)));
+    return (uint32_t)_mm256_movemask_epi8(e) == 0xFFFFFFFFu;
+}
+
+A_TARGET_FEATURE("avx2")
+static void A_memcpy_avx2(void* A_RESTRICT dest, const void* A_RESTRICT src,
+                          size_t n
+) {
+    if (n < 32) {
+        A_memcpy_sse2(dest, src, n);
+        return;
+    }
+
+    unsigned char*       d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+    __m256i last = _mm256_loadu_si256((const __m256i*)(s + n - 32));
+
+    size_t head = (32 - ((uintptr_t)d & 31)) & 31;
+    _mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= 128; n -= 128, d += 128, s += 128) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)s);
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(s + 32));
+        __m256i x2 = _mm256_loadu_si256((const __m256i*)(s + 64));
+        __m256i x3 = _mm256_loadu_si256((const __m256i*)(s + 96));
+        _mm256_store_si256((__m256i*)d,        x0);
+        _mm256_store_si256((__m256i*)(d + 32), x1);
+        _mm256_store_si256((__m256i*)(d + 64), x2);
+        _mm256_store_si256((__m256i*)(d + 96), x3);
+    }
+    for (; n >= 32; n -= 32, d += 32, s += 32)
+        _mm256_store_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+    _mm256_storeu_si256((__m256i*)(d + n - 32), last);
+}
+
+A_TARGET_FEATURE("avx2")
+static void* A_memchr_avx2(const void* A_RESTRICT p, char c, size_t n) {
+    if (n < 32)
+        return A_memchr_sse2(p, c, n);
+
+    const unsigned char* s   = (const unsigned char*)p;
+    const unsigned char* end = s + n;
+    __m256i v = _mm256_set1_epi8(c);
+    for (; end - s >= 128; s += 128) {
+        __m256i e0 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)s), v);
+        __m256i e1 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(s + 32)), v);
+        __m256i e2 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(s + 64)), v);
+        __m256i e3 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(s + 96)), v);
+        __m256i e  = _mm256_or_si256(_mm256_or_si256(e0, e1),
+                                     _mm256_or_si256(e2, e3));
+        if (_mm256_movemask_epi8(e) != 0)
+            break;
+    }
+    for (; end - s >= 32; s += 32) {
+        uint32_t m = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)s), v)
+        );
+        if (m != 0)
+            return (void*)(s + A_Ctz32(m));
+    }
+    if (s == end)
+        return NULL;
+
+    s = end - 32;
+    uint32_t m = (uint32_t)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)s), v)
+    );
+    return m != 0 ? (void*)(s + A_Ctz32(m)) : NULL;
+}
+
+A_TARGET_FEATURE("avx2")
+static void A_memset_avx2(void* A_RESTRICT p, char c, size_t n) {
+    if (n < 32) {
+        A_memset_sse2(p, c, n);
+        return;
+    }
+
+    unsigned char* d = (unsigned char*)p;
+    __m256i v = _mm256_set1_epi8(c);
+    _mm256_storeu_si256((__m256i*)(d + n - 32), v);
+
+    size_t head = (32 - ((uintptr_t)d & 31)) & 31;
+    _mm256_storeu_si256((__m256i*)d, v);
+    d += head;
+    n -= head;
+
+    for (; n >= 128; n -= 128, d += 128) {
+        _mm256_store_si256((__m256i*)d,        v);
+        _mm256_store_si256((__m256i*)(d + 32), v);
+        _mm256_store_si256((__m256i*)(d + 64), v);
+        _mm256_store_si256((__m256i*)(d + 96), v);
+    }
+    for (; n >= 32; n -= 32, d += 32)
+        _mm256_store_si256((__m256i*)d, v);
+}
+
+A_NO_SANITIZE_ADDRESS A_TARGET_FEATURE("avx2")
+static size_t A_cstrlen_avx2(const char* A_RESTRICT str) {
+    uint32_t    skip = (uint32_t)((uintptr_t)str & 31);
+    const char* s    = str - skip;
+    __m256i     zero = _mm256_setzero_si256();
+    uint32_t m = (uint32_t)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)s), zero)
+    ) >> skip;
+    if (m != 0)
+        return A_Ctz32(m);
+
+    for (s += 32; ((uintptr_t)s & 127) != 0; s += 32) {
+        m = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)s), zero)
+        );
+        if (m != 0)
+            return (size_t)(s - str) + A_Ctz32(m);
+    }
+    for (;; s += 128) {
+        __m256i x = _mm256_min_epu8(
+            _mm256_min_epu8(_mm256_load_si256((const __m256i*)s),
+                            _mm256_load_si256((const __m256i*)(s + 32))),
+            _mm256_min_epu8(_mm256_load_si256((const __m256i*)(s + 64)),
+                            _mm256_load_si256((const __m256i*)(s + 96)))
+        );
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, zero)) != 0)
+            break;
+    }
+    for (;; s += 32) {
+        m = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)s), zero)
+        );
+        if (m != 0)
+            return (size_t)(s - str) + A_Ctz32(m);
+    }
+}
+
+const AStringKernels A__priv__stringKernelsAvx2 = {
+    /*.name    =*/ "avx2",
+    /*.compare =*/ A_memcmp_avx2,
+    /*.copy    =*/ A_memcpy_avx2,
+    /*.find    =*/ A_memchr_avx2,
+    /*.fill    =*/ A_memset_avx2,
+    /*.length  =*/ A_cstrlen_avx2,
+};
+#endif // A_CPU_CAN_BUILD_AVX2
+// ============================================================================
+
+// ============================================================================
+// NEON, 16 bytes at a time, in the same shape as the SSE2 kernels. NEON
+// has no movemask, so a block with a match is searched a byte at a time.
+#if A_CPU_CAN_BUILD_NEON
+static bool A_memcmp_neon(const void* A_RESTRICT a, const void* A_RESTRICT b,
+                          size_t n
+) {
+    if (n < 16)
+        return A_memcmp_word(a, b, n);
+
+    const unsigned char* x = (const unsigned char*)a;
+    const unsigned char* y = (const unsigned char*)b;
+    for (; n > 64; n -= 64, x += 64, y += 64) {
+        uint8x16_t e0 = vceqq_u8(vld1q_u8(x),      vld1q_u8(y));
+        uint8x16_t e1 = vceqq_u8(vld1q_u8(x + 16), vld1q_u8(y + 16));
+        uint8x16_t e2 = vceqq_u8(vld1q_u8(x + 32), vld1q_u8(y + 32));
+        uint8x16_t e3 = vceqq_u8(vld1q_u8(x + 48), vld1q_u8(y + 48));
+        uint8x16_t e  = vandq_u8(vandq_u8(e0, e1), vandq_u8(e2, e3));
+        if (vminvq_u8(e) != 0xFF)
+            return false;
+    }
+    for (; n > 16; n -= 16, x += 16, y += 16) {
+        if (vminvq_u8(vceqq_u8(vld1q_u8(x), vld1q_u8(y))) != 0xFF)
+            return false;
+    }
+    return vminvq_u8(vceqq_u8(vld1q_u8(x + n - 16), vld1q_u8(y + n - 16))) ==
+           0xFF;
+}
+
+static void A_memcpy_neon(void* A_RESTRICT dest, const void* A_RESTRICT src,
+                          size_t n
+) {
+    if (n < 16) {
+        A_memcpy_word(dest, src, n);
+        return;
+    }
+
+    unsigned char*       d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+    uint8x16_t last = vld1q_u8(s + n - 16);
+
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    vst1q_u8(d, vld1q_u8(s));
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= 64; n -= 64, d += 64, s += 64) {
+        uint8x16_t x0 = vld1q_u8(s);
+        uint8x16_t x1 = vld1q_u8(s + 16);
+        uint8x16_t x2 = vld1q_u8(s + 32);
+        uint8x16_t x3 = vld1q_u8(s + 48);
+        vst1q_u8(d,      x0);
+        vst1q_u8(d + 16, x1);
+        vst1q_u8(d + 32, x2);
+        vst1q_u8(d + 48, x3);
+    }
+    for (; n >= 16; n -= 16, d += 16, s += 16)
+        vst1q_u8(d, vld1q_u8(s));
+    vst1q_u8(d + n - 16, last);
+}
+
+static void* A_memchr_neon(const void* A_RESTRICT p, char c, size_t n) {
+    if (n < 16)
+        return A_memchr_word(p, c, n);
+
+    const unsigned char* s   = (const unsigned char*)p;
+    const unsigned char* end = s + n;
+    uint8x16_t v = vdupq_n_u8((unsigned char)c);
+    for (; end - s >= 16; s += 16) {
+        if (vmaxvq_u8(vceqq_u8(vld1q_u8(s), v)) != 0)
+            return A_memchr_word(s, c, 16);
+    }
+    if (s == end)
+        return NULL;
+
+    s = end - 16;
+    if (vmaxvq_u8(vceqq_u8(vld1q_u8(s), v)) != 0)
+        return A_memchr_word(s, c, 16);
+    return NULL;
+}
+
+static void A_memset_neon(void* A_RESTRICT p, char c, size_t n) {
+    if (n < 16) {
+        A_memset_word(p, c, n);
+        return;
+    }
+
+    unsigned char* d = (unsigned char*)p;
+    uint8x16_t v = vdupq_n_u8((unsigned char)c);
+    vst1q_u8(d + n - 16, v);
+
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    vst1q_u8(d, v);
+    d += head;
+    n -= head;
+
+    for (; n >= 64; n -= 64, d += 64) {
+        vst1q_u8(d,      v);
+        vst1q_u8(d + 16, v);
+        vst1q_u8(d + 32, v);
+        vst1q_u8(d + 48, v);
+    }
+    for (; n >= 16; n -= 16, d += 16)
+        vst1q_u8(d, v);
+}
+
+A_NO_SANITIZE_ADDRESS
+static size_t A_cstrlen_neon(const char* A_RESTRICT str) {
+    const char* s = str;
+    for (; ((uintptr_t)s & 15) != 0; s++) {
+        if (*s == '\0')
+            return (size_t)(s - str);
+    }
+    // The smallest byte is zero exactly when there's a terminator.
+    while (vminvq_u8(vld1q_u8((const uint8_t*)s)) != 0)
+        s += 16;
+    while (*s != '\0')
+        s++;
+    return (size_t)(s - str);
+}
+
+const AStringKernels A__priv__stringKernelsNeon = {
+    /*.name    =*/ "neon",
+    /*.compare =*/ A_memcmp_neon,
+    /*.copy    =*/ A_memcpy_neon,
+    /*.find    =*/ A_memchr_neon,
+    /*.fill    =*/ A_memset_neon,
+    /*.length  =*/ A_cstrlen_neon,
+};
+#endif // A_CPU_CAN_BUILD_NEON
+// ============================================================================
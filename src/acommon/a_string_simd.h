@@ -0,0 +1,18 @@
+#pragma once
+
+#include "acommon.h"
+#include "a_cpu.h"
+#include "a_string.h"
+
+// The implementations in a_string_simd.c, for A_StringKernels to choose
+// from. Only the ones this build can compile are defined.
+A_EXTERN_C const AStringKernels A__priv__stringKernelsWord;
+#if A_CPU_CAN_BUILD_SSE2
+A_EXTERN_C const AStringKernels A__priv__stringKernelsSse2;
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_AVX2
+A_EXTERN_C const AStringKernels A__priv__stringKernelsAvx2;
+#endif // A_CPU_CAN_BUILD_AVX2
+#if A_CPU_CAN_BUILD_NEON
+A_EXTERN_C const AStringKernels A__priv__stringKernelsNeon;
+#endif // A_CPU_CAN_BUILD_NEON
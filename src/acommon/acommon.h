@@ -109,6 +109,20 @@
 #define A_TARGET_PLATFORM_IS_XBOX 0
 #endif // _XBOX
 
+// 32- or 64-bit x86. The Xbox is x86 too.
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+    defined(_M_X64) || defined(_XBOX)
+#define A_TARGET_ARCH_IS_X86 1
+#else
+#define A_TARGET_ARCH_IS_X86 0
+#endif // defined(__i386__) || defined(__x86_64__) || ...
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define A_TARGET_ARCH_IS_ARM64 1
+#else
+#define A_TARGET_ARCH_IS_ARM64 0
+#endif // defined(__aarch64__) || defined(_M_ARM64)
+
 #ifdef __GNUC__
 #define A_COMPILER_IS_GCC_COMPATIBLE 1
 #else
@@ -232,6 +246,18 @@ typedef uint32_t size_t;
 #define A_RESTRICT
 #endif // __cplusplus
 
+#if A_CXX11
+#define A_THREAD_LOCAL thread_local
+#elif A_C11
+#define A_THREAD_LOCAL _Thread_local
+#elif A_COMPILER_IS_MSVC
+#define A_THREAD_LOCAL __declspec(thread)
+#elif A_COMPILER_IS_GCC_COMPATIBLE
+#define A_THREAD_LOCAL __thread
+#else
+#error "A_THREAD_LOCAL: unsupported compiler"
+#endif // A_CXX11
+
 #define A_UNUSED(a) (void)(a)
 
 #define A_EXPAND(a) a
@@ -327,4 +353,9 @@ typedef uint32_t size_t;
 
 A_EXTERN_C A_NO_DISCARD size_t A_npow2(size_t n);
 A_EXTERN_C A_NO_DISCARD size_t A_ppow2(size_t n);
+// For backward-shift deletion from an open-addressing table with linear
+// probing: whether home slot `k` lies cyclically in (i, j]. An entry at `j`
+// whose home slot does is still reachable with slot `i` emptied, so it
+// stays put; any other has to shift back into `i`.
+A_EXTERN_C A_NO_DISCARD bool   A_HashSlotBetween(size_t k, size_t i, size_t j);
 A_EXTERN_C A_NO_RETURN  A_exit(int ec);
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include "a_atomic.h"
 #include "a_string.h"
 
 #ifndef _WIN32
@@ -28,35 +29,96 @@ NtAllocateVirtualMemory(
 #include <Xtl.h>
 #endif // _WIN32
 
+#if Z_TRACE_ENABLED
+// The definitions below are the real thing.
+#undef Z_Alloc
+#undef Z_Zalloc
+#undef Z_Realloc
+#endif // Z_TRACE_ENABLED
+
+static volatile int32_t s_heapCalls;
+
 A_NO_DISCARD void* Z_Alloc(size_t n) {
+    A_atomic_fetch_add32(&s_heapCalls, 1);
     return malloc(n);
 }
 
 A_NO_DISCARD void* Z_Zalloc(size_t n) {
+    A_atomic_fetch_add32(&s_heapCalls, 1);
     return calloc(n, 1);
 }
 
 A_NO_DISCARD void* Z_Realloc(void* p, size_t n) {
+    A_atomic_fetch_add32(&s_heapCalls, 1);
     return realloc(p, n);
 }
 
 void Z_Free(void* p) {
+    A_atomic_fetch_add32(&s_heapCalls, 1);
     free(p);
 }
 
+A_NO_DISCARD uint32_t Z_HeapCalls(void) {
+    return (uint32_t)A_atomic_load32(&s_heapCalls);
+}
+
+#if Z_TRACE_ENABLED
+// Set once at startup, before there are other threads.
+static ZTraceFn s_traceFn;
+
+void Z_SetTraceFn(ZTraceFn fn) {
+    s_traceFn = fn;
+}
+
+void Z_Trace(const char* file, int line, size_t n, int type) {
+    if (s_traceFn)
+        s_traceFn(file, line, n, type);
+}
+
+A_NO_DISCARD void* Z_AllocTraced(size_t n, const char* file, int line) {
+    Z_Trace(file, line, n, Z_TRACE_NO_TYPE);
+    return Z_Alloc(n);
+}
+
+A_NO_DISCARD void* Z_ZallocTraced(size_t n, const char* file, int line) {
+    Z_Trace(file, line, n, Z_TRACE_NO_TYPE);
+    return Z_Zalloc(n);
+}
+
+A_NO_DISCARD void* Z_ReallocTraced(void* p, size_t n,
+                                   const char* file, int line
+) {
+    Z_Trace(file, line, n, Z_TRACE_NO_TYPE);
+    return Z_Realloc(p, n);
+}
+#endif // Z_TRACE_ENABLED
+
 #if !defined(_WIN32)
+#if defined(__linux__) && !defined(MAP_FIXED_NOREPLACE)
+// Missing from older headers. Kernels before 4.17 don't know it and treat
+// the address as a hint instead, which Z_MapNoReplace checks for.
+#define MAP_FIXED_NOREPLACE 0x100000
+#elif !defined(MAP_FIXED_NOREPLACE)
+#define MAP_FIXED_NOREPLACE 0
+#endif // defined(__linux__) && !defined(MAP_FIXED_NOREPLACE)
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif // MAP_NORESERVE
+
 static char s_proc_path_buf[A_OS_MAX_PATH];
 
 bool Z_FileExists(const char* path) {
-    return access("/proc/self", F_OK) == 0;
+    return access(path, F_OK) == 0;
 }
 
 const char* Z_BuildProcfsSelfPath(const char* path) {
     if (Z_FileExists("/proc/self")) {
-        A_snprintf(s_proc_path_buf, sizeof(s_proc_path_buf), "/proc/self");
+        A_snprintf(s_proc_path_buf, sizeof(s_proc_path_buf), "/proc/self/%s",
+                   path);
     } else {
         int pid = getpid();
-        A_snprintf(s_proc_path_buf, sizeof(s_proc_path_buf), "/proc/%d", pid);
+        A_snprintf(s_proc_path_buf, sizeof(s_proc_path_buf), "/proc/%d/%s",
+                   pid, path);
         bool b = Z_FileExists(s_proc_path_buf);
         assert(b);
         if (!b)
@@ -67,15 +129,271 @@ const char* Z_BuildProcfsSelfPath(const char* path) {
 }
 #endif // !defined(_WIN32)
 
+#define Z_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct ZReservation {
+    uintptr_t begin; // 0 if the slot is free
+    uintptr_t end;
+    // What commits and decommits round out to: the huge page size if the
+    // reservation is huge page aligned and the kernel will back it with
+    // huge pages, or else the page size. Both have to round the same way,
+    // or a decommit can leave part of a committed huge page behind.
+    uintptr_t granularity;
+} ZReservation;
+// Reservations are made at startup, before there are other threads, so
+// lookups don't need a lock.
+static ZReservation s_reservations[Z_MAX_RESERVATIONS];
+
+static uintptr_t Z_AlignDown(uintptr_t x, uintptr_t align) {
+    return x & ~(align - 1);
+}
+
+static uintptr_t Z_AlignUp(uintptr_t x, uintptr_t align) {
+    return (x + align - 1) & ~(align - 1);
+}
+
+static size_t Z_PageSize(void) {
+#if A_TARGET_PLATFORM_IS_XBOX
+    return 4096;
+#elif defined(_WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (size_t)si.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif // A_TARGET_PLATFORM_IS_XBOX
+}
+
+static ZReservation* Z_FindReservation(const void* p, size_t n) {
+    uintptr_t begin = (uintptr_t)p;
+    uintptr_t end   = begin + n;
+    for (int i = 0; i < Z_MAX_RESERVATIONS; i++) {
+        ZReservation* r = &s_reservations[i];
+        if (r->begin != 0 && begin >= r->begin && end <= r->end)
+            return r;
+    }
+    return NULL;
+}
+
+static ZReservation* Z_NewReservation(void) {
+    for (int i = 0; i < Z_MAX_RESERVATIONS; i++) {
+        if (s_reservations[i].begin == 0)
+            return &s_reservations[i];
+    }
+    return NULL;
+}
+
+// Touching a byte in every page is the portable way to fault them in.
+static void Z_TouchPages(const void* p, size_t n) {
+    size_t page = Z_PageSize();
+    volatile char* c = (volatile char*)p;
+    for (size_t i = 0; i < n; i += page)
+        c[i] = c[i];
+    if (n > 0)
+        c[n - 1] = c[n - 1];
+}
+
+// [p, p + n) rounded out to the reservation's granularity, but no further
+// than the reservation itself.
+static void Z_ReservedSpan(const ZReservation* r, const void* p, size_t n,
+                           A_OUT uintptr_t* begin, A_OUT uintptr_t* end
+) {
+    *begin = Z_AlignDown((uintptr_t)p, r->granularity);
+    *end   = Z_AlignUp((uintptr_t)p + n, r->granularity);
+    if (*begin < r->begin)
+        *begin = r->begin;
+    if (*end > r->end)
+        *end = r->end;
+}
+
+#ifdef _WIN32
+static bool Z_CommitReserved(const ZReservation* r, const void* p, size_t n) {
+    (void)r;
+    return VirtualAlloc((void*)p, n, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+static bool Z_DecommitReserved(const ZReservation* r, const void* p,
+                               size_t n
+) {
+    (void)r;
+    BOOL b = VirtualFree((void*)p, n, MEM_DECOMMIT);
+    assert(b != FALSE);
+    return b != FALSE;
+}
+
+A_NO_DISCARD void* Z_ReserveAt(const void* p, size_t n) {
+    ZReservation* r = Z_NewReservation();
+    assert(r);
+    if (r == NULL)
+        return NULL;
+
+    void* alloc = VirtualAlloc((void*)p, n, MEM_RESERVE, PAGE_NOACCESS);
+    if (alloc == NULL)
+        return NULL;
+    // Reservations start on an allocation granularity boundary, which can
+    // be below `p`, but never above it.
+    assert((uintptr_t)alloc <= (uintptr_t)p);
+    if ((uintptr_t)alloc > (uintptr_t)p) {
+        VirtualFree(alloc, 0, MEM_RELEASE);
+        return NULL;
+    }
+
+    r->begin       = (uintptr_t)alloc;
+    r->end         = (uintptr_t)p + n;
+    r->granularity = Z_PageSize();
+    return (void*)p;
+}
+
+bool Z_ReleaseAt(const void* p, size_t n) {
+    ZReservation* r = Z_FindReservation(p, n);
+    assert(r);
+    if (r == NULL)
+        return false;
+
+    BOOL b = VirtualFree((void*)r->begin, 0, MEM_RELEASE);
+    assert(b != FALSE);
+    r->begin       = 0;
+    r->end         = 0;
+    r->granularity = 0;
+    return b != FALSE;
+}
+#else
+// Maps exactly [begin, end), and fails if anything is already mapped there.
+static bool Z_MapNoReplace(uintptr_t begin, uintptr_t end, int prot,
+                           int flags
+) {
+    void* alloc = mmap((void*)begin, end - begin, prot,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | flags,
+                       -1, 0);
+    if (alloc == MAP_FAILED)
+        return false;
+    if ((uintptr_t)alloc != begin) {
+        munmap(alloc, end - begin);
+        return false;
+    }
+    return true;
+}
+
+static void Z_AdviseHugePages(uintptr_t begin, uintptr_t end) {
+#ifdef MADV_HUGEPAGE
+    // Fails if transparent huge pages are disabled, in which case these
+    // are just ordinary pages.
+    madvise((void*)begin, end - begin, MADV_HUGEPAGE);
+#else
+    (void)begin;
+    (void)end;
+#endif // MADV_HUGEPAGE
+}
+
+// Whether the kernel will give out transparent huge pages for a range
+// that's been madvise'd for them. The setting reads like
+// "always [madvise] never", with the active mode in brackets.
+static bool Z_HugePagesEnabled(void) {
+#ifdef MADV_HUGEPAGE
+    FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f == NULL)
+        return false;
+
+    char buf[64];
+    bool enabled = false;
+    if (fgets(buf, sizeof(buf), f) != NULL) {
+        for (size_t i = 0; buf[i] != '\0'; i++) {
+            if (buf[i] == '[') {
+                enabled = !A_memcmp(&buf[i], "[never]", 7);
+                break;
+            }
+        }
+    }
+    fclose(f);
+    return enabled;
+#else
+    return false;
+#endif // MADV_HUGEPAGE
+}
+
+static bool Z_CommitReserved(const ZReservation* r, const void* p, size_t n) {
+    // Commit out to huge page boundaries where the reservation allows, so
+    // the ends of the range can be huge pages too. What's past the ends
+    // is never touched, so it costs nothing.
+    uintptr_t begin, end;
+    Z_ReservedSpan(r, p, n, &begin, &end);
+
+    if (mprotect((void*)begin, end - begin, PROT_READ | PROT_WRITE) != 0)
+        return false;
+    Z_AdviseHugePages(begin, end);
+    return true;
+}
+
+static bool Z_DecommitReserved(const ZReservation* r, const void* p,
+                               size_t n
+) {
+    // Exactly what Z_CommitReserved committed for the same range, so a
+    // huge page is never split and nothing committed is left behind.
+    uintptr_t begin, end;
+    Z_ReservedSpan(r, p, n, &begin, &end);
+    // The pages go back to the OS, and read as zero if committed again.
+    int i = madvise((void*)begin, end - begin, MADV_DONTNEED);
+    assert(i == 0);
+    if (i == 0)
+        i = mprotect((void*)begin, end - begin, PROT_NONE);
+    assert(i == 0);
+    return i == 0;
+}
+
+A_NO_DISCARD void* Z_ReserveAt(const void* p, size_t n) {
+    ZReservation* r = Z_NewReservation();
+    assert(r);
+    if (r == NULL)
+        return NULL;
+
+    // Round out to huge page boundaries if there's room, and just to page
+    // boundaries if there isn't.
+    uintptr_t granularity = Z_HUGE_PAGE_SIZE;
+    uintptr_t begin       = Z_AlignDown((uintptr_t)p, granularity);
+    uintptr_t end         = Z_AlignUp((uintptr_t)p + n, granularity);
+    if (!Z_MapNoReplace(begin, end, PROT_NONE, MAP_NORESERVE)) {
+        granularity = Z_PageSize();
+        begin       = Z_AlignDown((uintptr_t)p, granularity);
+        end         = Z_AlignUp((uintptr_t)p + n, granularity);
+        if (!Z_MapNoReplace(begin, end, PROT_NONE, MAP_NORESERVE))
+            return NULL;
+    }
+    if (!Z_HugePagesEnabled())
+        granularity = Z_PageSize();
+
+    r->begin       = begin;
+    r->end         = end;
+    r->granularity = granularity;
+    return (void*)p;
+}
+
+bool Z_ReleaseAt(const void* p, size_t n) {
+    ZReservation* r = Z_FindReservation(p, n);
+    assert(r);
+    if (r == NULL)
+        return false;
+
+    int i = munmap((void*)r->begin, r->end - r->begin);
+    assert(i == 0);
+    r->begin       = 0;
+    r->end         = 0;
+    r->granularity = 0;
+    return i == 0;
+}
+#endif // _WIN32
+
 #if defined(_WIN32) && !defined(_XBOX)
 A_NO_DISCARD void* Z_AllocAt(const void* p, size_t n) {
+    const ZReservation* r = Z_FindReservation(p, n);
+    if (r != NULL)
+        return Z_CommitReserved(r, p, n) ? (void*)p : NULL;
+
     HANDLE   hProcess = GetCurrentProcess();
     PVOID    alloc    = (PVOID)p;
     ULONG    size     = (ULONG)n;
     NTSTATUS status   = NtAllocateVirtualMemory(hProcess, &alloc, 0, &size, 
                                                 MEM_RESERVE | MEM_COMMIT, 
                                                 PAGE_READWRITE);
-    assert(status == STATUS_SUCCESS);
     if (status != STATUS_SUCCESS)
         return NULL;
     assert(alloc);
@@ -93,10 +411,13 @@ A_NO_DISCARD void* Z_AllocAt(const void* p, size_t n) {
 }
 #elif defined(_XBOX)
 A_NO_DISCARD void* Z_AllocAt(const void* p, size_t n) {
+    const ZReservation* r = Z_FindReservation(p, n);
+    if (r != NULL)
+        return Z_CommitReserved(r, p, n) ? (void*)p : NULL;
+
 	void* alloc = VirtualAlloc((void*)p, n, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
 	if (alloc == p)
 		return alloc;
-	assert(alloc);
 	if (alloc == NULL)
 		return NULL;
 
@@ -115,41 +436,17 @@ A_NO_DISCARD void* Z_AllocAt(const void* p, size_t n) {
 }
 #else 
 A_NO_DISCARD void* Z_AllocAt(const void* p, size_t n) {
-    void* alloc = mmap(
-        (void*)(intptr_t)p, n, PROT_READ | PROT_WRITE,
-        MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-
-    if (alloc == p)
-        return alloc;
-
-    FILE* f = fopen(Z_BuildProcfsSelfPath("maps"), "r");
-    assert(f);
-    if (f == NULL) {
-        munmap(alloc, n);
+    const ZReservation* r = Z_FindReservation(p, n);
+    if (r != NULL)
+        return Z_CommitReserved(r, p, n) ? (void*)p : NULL;
+
+    assert(((uintptr_t)p & (Z_PageSize() - 1)) == 0);
+    uintptr_t begin = (uintptr_t)p;
+    uintptr_t end   = Z_AlignUp(begin + n, Z_PageSize());
+    if (!Z_MapNoReplace(begin, end, PROT_READ | PROT_WRITE, 0))
         return NULL;
-    }
-
-    char buf[A_OS_MAX_PATH + 64];
-    while (fgets(buf, sizeof(buf), f) != NULL && !feof(f)) {
-        void* begin = NULL;
-        void* end   = NULL;
-
-        if (scanf(buf, "%p-%p", &begin, &end) != 2)
-            continue;
-
-        if (begin == NULL || end == NULL)
-            continue;
-
-        if (p >= begin && p < end) {
-            fclose(f);
-            assert((uintptr_t)p + n <= (uintptr_t)end);
-            if ((uintptr_t)p + n <= (uintptr_t)end)
-                return p; 
-            
-            munmap(alloc, n);
-            return NULL;
-        }
-    }
+    Z_AdviseHugePages(begin, end);
+    return (void*)p;
 }
 #endif // _WIN32
 
@@ -165,7 +462,9 @@ A_NO_DISCARD void* Z_ZallocAt(const void* p, size_t n) {
 
 #ifdef _WIN32
 bool Z_FreeAt(const void* p, size_t n) {
-    (void)n;
+    const ZReservation* r = Z_FindReservation(p, n);
+    if (r != NULL)
+        return Z_DecommitReserved(r, p, n);
 
     if (VirtualFree((void*)(intptr_t)p, 0, MEM_RELEASE) != FALSE)
         return true;
@@ -187,12 +486,107 @@ bool Z_FreeAt(const void* p, size_t n) {
 }
 #else
 bool Z_FreeAt(const void* p, size_t n) {
+    const ZReservation* r = Z_FindReservation(p, n);
+    if (r != NULL)
+        return Z_DecommitReserved(r, p, n);
+
     int i = munmap((void*)(intptr_t)p, n);
     assert(i == 0);
     return i == 0;
 }
 #endif // _WIN32
 
+void Z_PrefaultAt(const void* p, size_t n) {
+#ifdef MADV_POPULATE_WRITE
+    // Faults everything in with one call on 5.14 and later; older kernels
+    // fail with EINVAL and get the fallback.
+    uintptr_t begin = Z_AlignDown((uintptr_t)p, Z_PageSize());
+    uintptr_t end   = Z_AlignUp((uintptr_t)p + n, Z_PageSize());
+    if (madvise((void*)begin, end - begin, MADV_POPULATE_WRITE) == 0)
+        return;
+#endif // MADV_POPULATE_WRITE
+    Z_TouchPages(p, n);
+}
+
+#ifdef _WIN32
+bool Z_QueryMappingAt(const void* p, A_OUT size_t* begin, A_OUT size_t* end) {
+    MEMORY_BASIC_INFORMATION mi;
+    if (VirtualQuery(p, &mi, sizeof(mi)) == 0 || mi.State == MEM_FREE)
+        return false;
+
+    *begin = (size_t)mi.AllocationBase;
+    *end   = (size_t)mi.BaseAddress + mi.RegionSize;
+    return true;
+}
+
+bool Z_QueryRegion(const void* p, size_t n, A_OUT ZRegionInfo* info) {
+    (void)p;
+    (void)n;
+    info->resident_bytes  = 0;
+    info->huge_page_bytes = 0;
+    return false;
+}
+#else
+bool Z_QueryMappingAt(const void* p, A_OUT size_t* begin, A_OUT size_t* end) {
+    const char* path = Z_BuildProcfsSelfPath("maps");
+    if (path == NULL)
+        return false;
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+        return false;
+
+    bool found = false;
+    char buf[A_OS_MAX_PATH + 128];
+    while (!found && fgets(buf, sizeof(buf), f) != NULL) {
+        unsigned long b = 0, e = 0;
+        if (sscanf(buf, "%lx-%lx", &b, &e) != 2)
+            continue;
+
+        if ((uintptr_t)p >= b && (uintptr_t)p < e) {
+            *begin = (size_t)b;
+            *end   = (size_t)e;
+            found  = true;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+bool Z_QueryRegion(const void* p, size_t n, A_OUT ZRegionInfo* info) {
+    info->resident_bytes  = 0;
+    info->huge_page_bytes = 0;
+
+    const char* path = Z_BuildProcfsSelfPath("smaps");
+    if (path == NULL)
+        return false;
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+        return false;
+
+    // Each mapping's line is followed by its fields, one per line.
+    uintptr_t begin  = (uintptr_t)p;
+    uintptr_t end    = begin + n;
+    bool      inside = false;
+    char buf[A_OS_MAX_PATH + 128];
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        unsigned long b = 0, e = 0, kib = 0;
+        if (sscanf(buf, "%lx-%lx", &b, &e) == 2) {
+            inside = b < end && e > begin;
+            continue;
+        }
+        if (!inside)
+            continue;
+
+        if (sscanf(buf, "Rss: %lu kB", &kib) == 1)
+            info->resident_bytes += (size_t)kib * 1024;
+        else if (sscanf(buf, "AnonHugePages: %lu kB", &kib) == 1)
+            info->huge_page_bytes += (size_t)kib * 1024;
+    }
+    fclose(f);
+    return true;
+}
+#endif // _WIN32
+
 #if A_TARGET_OS_IS_WINDOWS && !A_TARGET_PLATFORM_IS_XBOX
 A_NO_DISCARD FileMapping Z_MapFile(const char* filename) {
     FileMapping f;
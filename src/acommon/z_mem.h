@@ -27,10 +27,77 @@ A_EXTERN_C A_NO_DISCARD void* Z_Alloc   (size_t n);
 A_EXTERN_C A_NO_DISCARD void* Z_Zalloc  (size_t n);
 A_EXTERN_C A_NO_DISCARD void* Z_Realloc (void* p, size_t n); 
 A_EXTERN_C              void  Z_Free    (void* p);
+// How many times Z_Alloc/Z_Zalloc/Z_Realloc/Z_Free have been called, from
+// any thread. Wraps around, so only differences are meaningful.
+A_EXTERN_C A_NO_DISCARD uint32_t Z_HeapCalls(void);
 
-A_EXTERN_C A_NO_DISCARD void* Z_AllocAt (const void* p, size_t n);
-A_EXTERN_C A_NO_DISCARD void* Z_ZallocAt(const void* p, size_t n);
-A_EXTERN_C              bool  Z_FreeAt  (const void* p, size_t n);
+// Allocation tracing, for finding allocations in hot paths. It's compiled
+// out entirely unless Z_TRACE_ENABLED is set, in which case Z_Alloc,
+// Z_Zalloc and Z_Realloc become macros that pass their call site along,
+// and every call is reported to the function set with Z_SetTraceFn.
+#ifndef Z_TRACE_ENABLED
+#define Z_TRACE_ENABLED 0
+#endif // Z_TRACE_ENABLED
+
+#if Z_TRACE_ENABLED
+// `type` is whatever the layer above passes to Z_Trace, or Z_TRACE_NO_TYPE
+// for calls made directly through Z_*.
+#define Z_TRACE_NO_TYPE -1
+
+typedef void (*ZTraceFn)(const char* file, int line, size_t n, int type);
+
+A_EXTERN_C void Z_SetTraceFn(ZTraceFn fn);
+A_EXTERN_C void Z_Trace     (const char* file, int line, size_t n, int type);
+
+A_EXTERN_C A_NO_DISCARD void* Z_AllocTraced  (size_t n,
+                                              const char* file, int line);
+A_EXTERN_C A_NO_DISCARD void* Z_ZallocTraced (size_t n,
+                                              const char* file, int line);
+A_EXTERN_C A_NO_DISCARD void* Z_ReallocTraced(void* p, size_t n,
+                                              const char* file, int line);
+
+#define Z_Alloc(n)      Z_AllocTraced  ((n),      __FILE__, __LINE__)
+#define Z_Zalloc(n)     Z_ZallocTraced ((n),      __FILE__, __LINE__)
+#define Z_Realloc(p, n) Z_ReallocTraced((p), (n), __FILE__, __LINE__)
+#endif // Z_TRACE_ENABLED
+
+// Fixed-address regions can be reserved up front, before anything else in
+// the process gets a chance to map over them. Z_AllocAt inside a
+// reservation then just commits the pages (and Z_FreeAt decommits them),
+// so the address is still free for the next allocation. Outside a
+// reservation, Z_AllocAt maps fresh pages, and fails rather than replace
+// whatever is already mapped there.
+//
+// On Linux, reservations are rounded out to huge page boundaries and
+// committed pages are marked for transparent huge pages. While those are
+// enabled, Z_AllocAt and Z_FreeAt both round out to whole huge pages, so
+// what a free decommits is exactly what the matching alloc committed.
+// Windows only gives out large pages with a privilege most users don't
+// have, so there they're ordinary pages.
+#define Z_MAX_RESERVATIONS 4
+
+A_EXTERN_C A_NO_DISCARD void* Z_ReserveAt(const void* p, size_t n);
+A_EXTERN_C              bool  Z_ReleaseAt(const void* p, size_t n);
+
+A_EXTERN_C A_NO_DISCARD void* Z_AllocAt  (const void* p, size_t n);
+A_EXTERN_C A_NO_DISCARD void* Z_ZallocAt (const void* p, size_t n);
+A_EXTERN_C              bool  Z_FreeAt   (const void* p, size_t n);
+// Faults in every page of [p, p + n) now, so accessing it later doesn't.
+A_EXTERN_C              void  Z_PrefaultAt(const void* p, size_t n);
+
+// Whatever is mapped at `p`, for explaining why Z_ReserveAt or Z_AllocAt
+// failed. Returns false if nothing is.
+A_EXTERN_C bool Z_QueryMappingAt(const void* p, A_OUT size_t* begin,
+                                 A_OUT size_t* end);
+
+typedef struct ZRegionInfo {
+    size_t resident_bytes;
+    size_t huge_page_bytes;
+} ZRegionInfo;
+// How much of the mappings overlapping [p, p + n) is resident, and how
+// much of that is in huge pages. Returns false where the OS doesn't say.
+A_EXTERN_C bool Z_QueryRegion(const void* p, size_t n,
+                              A_OUT ZRegionInfo* info);
 
 #if !A_TARGET_PLATFORM_IS_XBOX
 A_EXTERN_C A_NO_DISCARD FileMapping Z_MapFile  (const char* filename);
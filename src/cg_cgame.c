@@ -4,7 +4,9 @@
 
 #include "acommon/a_string.h"
 
+#include "cl_demo.h"
 #include "cmd_commands.h"
+#include "com_perf.h"
 #include "com_print.h"
 #include "dvar.h"
 #include "gfx_defs.h"
@@ -28,6 +30,7 @@ extern dvar_t* vid_height;
 
 #if !A_TARGET_PLATFORM_IS_XBOX
 void CG_Teleport_f(void);
+void CG_Noclip_f(void);
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 
 cg_t* CG_GetLocalClientGlobals(size_t localClientNum) {
@@ -54,6 +57,7 @@ void CG_Init(void) {
 	s_lastMouseY = IN_Mouse_Y(0);
 
 	Cmd_AddCommand("teleport", CG_Teleport_f);
+	Cmd_AddCommand("noclip", CG_Noclip_f);
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 	s_lastGPadRX = IN_GPad_StickX(0, IN_GPAD_STICK_RIGHT);
 	s_lastGPadRY = IN_GPad_StickY(0, IN_GPAD_STICK_RIGHT);
@@ -115,6 +119,14 @@ void CG_Teleport_f(void) {
 	A_atof(Cmd_Argv(3), &p.z);
 	CG_Teleport(CL_ClientWithKbmFocus(), p);
 }
+
+// Switches between flying through the world and sliding along it.
+void CG_Noclip_f(void) {
+	playerState_t* ps = PM_GetLocalClientGlobals(CL_ClientWithKbmFocus())->pm.ps;
+	ps->pm_type = ps->pm_type == PM_NOCLIP ? PM_SPECTATOR : PM_NOCLIP;
+	Com_Println(CON_DEST_CLIENT, "noclip %s", 
+				ps->pm_type == PM_NOCLIP ? "ON" : "OFF");
+}
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 
 void CG_SetSpawn(size_t localClientNum, apoint3f_t spawn, float facing) {
@@ -148,10 +160,16 @@ extern dvar_t* cl_splitscreen;
 void CG_Frame(uint64_t deltaTime) {
 	A_UNUSED(deltaTime);
 
+	bool demo = CL_DemoBeginFrame();
 	for (size_t localClientNum = 0; 
 		 localClientNum < MAX_LOCAL_CLIENTS; 
 		 localClientNum++
 	) {
+		// This frame's the one that shows whatever input came in for it.
+		uint64_t inputTime = IN_TakeEventTime(localClientNum);
+		if (inputTime != 0)
+			Com_PerfMarkInput(inputTime);
+
 		cg_t* cg = CG_GetLocalClientGlobals(localClientNum);
 		float w = cg->viewport.w * (float)Dvar_GetInt(vid_width);
 		float h = cg->viewport.h * (float)Dvar_GetInt(vid_height);
@@ -159,6 +177,14 @@ void CG_Frame(uint64_t deltaTime) {
 		cg->fovy = R_FovHorzToVertical(Dvar_GetFloat(cg->fov), aspect_inv);
 		
 		pm_t* pm = PM_GetLocalClientGlobals(localClientNum);
+		// A demo that's playing moves every client, instead of input.
+		if (demo) {
+			CL_DemoPlayClient(localClientNum);
+			cg->camera.pos   = pm->pm.ps->origin;
+			cg->camera.front = pm->pml.forward;
+			continue;
+		}
+
 #if !A_TARGET_PLATFORM_IS_XBOX
 		if (CL_HasKbmFocus(localClientNum) && 
 			CL_KeyFocus(localClientNum) == KF_GAME
@@ -243,6 +269,7 @@ void CG_Frame(uint64_t deltaTime) {
 			}
 
 			pm->pm.cmd.serverTime = Sys_Milliseconds();
+			CL_DemoRecordCmd(localClientNum);
 			Pmove(&pm->pm, &pm->pml);
 		} 
 		
@@ -294,8 +321,10 @@ void CG_Frame(uint64_t deltaTime) {
 		cg->camera.pos   = pm->pm.ps->origin;
 		cg->camera.front = pm->pml.forward;
 	}
+	CL_DemoEndFrame();
 }
 
 void CG_Shutdown(void) {
 	Cmd_RemoveCommand("teleport");
+	Cmd_RemoveCommand("noclip");
 }
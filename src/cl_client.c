@@ -10,6 +10,7 @@
 #include "acommon/z_mem.h"
 
 #include "cg_cgame.h"
+#include "cl_demo.h"
 #include "cl_map.h"
 #include "com_print.h"
 #include "dvar.h"
@@ -83,6 +84,7 @@ A_EXTERN_C void CL_Init(void) {
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 	
 	CL_InitMap();
+	CL_DemoInit();
 
 	bool b = CL_LoadMap("c40_xbox.map");
 	assert(b);
@@ -205,6 +207,7 @@ A_EXTERN_C void CL_SetKeyFocus(size_t localClientNum, KeyFocus f) {
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 
 A_EXTERN_C void CL_Shutdown(void) {
+	CL_DemoShutdown();
 	CL_ShutdownMap();
 	Dvar_SetBool(cl_splitscreen, false);
 	Dvar_Unregister("cl_splitscreen");
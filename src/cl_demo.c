@@ -0,0 +1,688 @@
+#include "cl_demo.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include "acommon/a_math.h"
+#include "acommon/a_string.h"
+
+#include "cg_cgame.h"
+#include "cl_client.h"
+#include "cl_map.h"
+#include "cmd_commands.h"
+#include "com_perf.h"
+#include "com_print.h"
+#include "dvar.h"
+#include "fs_files.h"
+#include "m_math.h"
+#include "pm_pmove.h"
+#include "vm_vmem.h"
+
+#define CL_DEMO_MAGIC    0x4D454441 // "ADEM"
+#define CL_DEMO_VERSION  1
+#define CL_DEMO_EXT      ".dem"
+#define CL_DEMO_MAX_PATH 256
+// Com_Frame waits in whole milliseconds, so anything faster than this
+// would round down to not waiting at all.
+#define CL_DEMO_MAX_FPS  1000
+// GPU times only land in the perf ring a few frames after the frame
+// they're for, so playback takes each frame's samples this many frames
+// later.
+#define CL_DEMO_PERF_LAG 8
+// How far a client can end up from where it did when recording before
+// it's counted as having drifted and put back.
+#define CL_DEMO_DRIFT_EPSILON 0.001f
+
+// Client masks are a byte.
+A_STATIC_ASSERT(MAX_LOCAL_CLIENTS <= 8);
+
+// A demo is a header, a CLDemoState for each client, then frames to the
+// end of the file. Each frame is a CLDemoFrame followed by a CLDemoMove
+// for each client in its `moved` mask, lowest first. Everything's 4-byte
+// fields, in the recording machine's byte order.
+typedef struct CLDemoHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t clients;  // MAX_LOCAL_CLIENTS when it was recorded
+	uint32_t reserved;
+	char     map[64];  // empty if none was loaded
+} CLDemoHeader;
+A_STATIC_ASSERT(sizeof(CLDemoHeader) == 80);
+
+// Where a client was when recording started. Times in a demo are msec
+// since then.
+typedef struct CLDemoState {
+	float    origin[3];
+	float    velocity[3];
+	float    angles[3]; // yaw, pitch, roll
+	uint32_t pm_type;
+	uint32_t pm_flags;
+	int32_t  commandTime;
+} CLDemoState;
+A_STATIC_ASSERT(sizeof(CLDemoState) == 48);
+
+typedef enum CLDemoFrameFlags {
+	CL_DEMO_FRAME_SPLITSCREEN = 0x01,
+} CLDemoFrameFlags;
+
+typedef struct CLDemoFrame {
+	uint32_t msec;   // since the frame before, when it was recorded
+	uint8_t  flags;  // CLDemoFrameFlags
+	uint8_t  active; // clients that were active
+	uint8_t  moved;  // clients that Pmoved
+	uint8_t  pad;
+} CLDemoFrame;
+A_STATIC_ASSERT(sizeof(CLDemoFrame) == 8);
+
+// A usercmd, and where it left the client.
+typedef struct CLDemoMove {
+	float    vel[3];
+	float    yaw, pitch, roll;
+	uint32_t serverTime;
+	float    origin[3];
+	float    angles[3];
+} CLDemoMove;
+A_STATIC_ASSERT(sizeof(CLDemoMove) == 52);
+
+typedef struct CLDemoRecord {
+	bool       active;
+	bool       failed;
+	StreamFile f;
+	char       path[CL_DEMO_MAX_PATH];
+	uint64_t   start_msec;
+	uint32_t   frames;
+	size_t     bytes;
+	uint8_t    moved;
+	usercmd_t  cmds[MAX_LOCAL_CLIENTS];
+} CLDemoRecord;
+
+typedef struct CLDemoPlayback {
+	bool        active;
+	char        path[CL_DEMO_MAX_PATH];
+	uint8_t*    data;
+	size_t      size;
+	size_t      pos;        // of the next frame
+	uint32_t    frames;     // counted when it was loaded
+	uint32_t    frame;      // being played, or the next to be
+	CLDemoFrame cur;
+	size_t      cur_moves;  // offset of `cur`'s moves
+	uint64_t    frame_msec; // 0 for as fast as possible
+	uint64_t    base_msec;  // what times in the demo are relative to
+	uint64_t    start_usec;
+	uint64_t    perf_first; // the perf frame the first frame was
+	uint64_t    perf_next;  // the next to take samples from
+	uint32_t*   samples;    // `frames` for each perf phase
+	size_t      counts[COM_PERF_PHASE_COUNT];
+	uint32_t    drifted;    // moves that didn't end where they did
+	float       max_drift;
+} CLDemoPlayback;
+
+static CLDemoRecord   s_demoRecord;
+static CLDemoPlayback s_demoPlay;
+
+static dvar_t* cl_timedemoQuit;
+
+extern dvar_t* cl_splitscreen;
+
+static void CL_DemoRecord_f    (void);
+static void CL_DemoStopRecord_f(void);
+static void CL_DemoTimedemo_f  (void);
+static void CL_DemoStop_f      (void);
+
+void CL_DemoInit(void) {
+	A_memset(&s_demoRecord, 0, sizeof(s_demoRecord));
+	A_memset(&s_demoPlay,   0, sizeof(s_demoPlay));
+	cl_timedemoQuit = Dvar_RegisterBool("cl_timedemoQuit", DVAR_FLAG_NONE,
+	                                    false);
+	Cmd_AddCommand("record",     CL_DemoRecord_f);
+	Cmd_AddCommand("stoprecord", CL_DemoStopRecord_f);
+	Cmd_AddCommand("timedemo",   CL_DemoTimedemo_f);
+	Cmd_AddCommand("stopdemo",   CL_DemoStop_f);
+}
+
+static void CL_DemoPath(const char* name, A_OUT char* path, size_t n) {
+	size_t len = A_cstrlen(name);
+	size_t ext = A_cstrlen(CL_DEMO_EXT);
+	if (len > ext && A_cstricmp(name + len - ext, CL_DEMO_EXT))
+		A_cstrncpyz(path, name, n);
+	else
+		A_snprintf(path, n, "%s%s", name, CL_DEMO_EXT);
+}
+
+static uint32_t CL_DemoMaskCount(uint8_t mask) {
+	uint32_t n = 0;
+	for (; mask; mask &= mask - 1)
+		n++;
+	return n;
+}
+
+static void CL_DemoSetCmdTime(size_t localClientNum, uint64_t msec) {
+	PM_GetLocalClientGlobals(localClientNum)->pm.ps->commandTime = msec;
+}
+
+// ============================================================================
+// Recording
+A_NO_DISCARD bool CL_DemoIsRecording(void) {
+	return s_demoRecord.active;
+}
+
+static bool CL_DemoWrite(const void* p, size_t n) {
+	if (s_demoRecord.failed)
+		return false;
+
+	if (!FS_WriteStream(&s_demoRecord.f, p, n)) {
+		Com_Println(CON_DEST_ERR, "record: failed to write '%s'.",
+		            s_demoRecord.path);
+		s_demoRecord.failed = true;
+		return false;
+	}
+	s_demoRecord.bytes += n;
+	return true;
+}
+
+static bool CL_DemoStartRecording(const char* name) {
+	CLDemoRecord* r = &s_demoRecord;
+	assert(!r->active);
+	A_memset(r, 0, sizeof(*r));
+	CL_DemoPath(name, r->path, sizeof(r->path));
+	r->f = FS_StreamFile(r->path, FS_SEEK_BEGIN, FS_STREAM_WRITE_NEW, 0);
+	if (r->f.f == NULL) {
+		Com_Println(CON_DEST_CLIENT, "record: couldn't open '%s'.", r->path);
+		return false;
+	}
+	r->active     = true;
+	r->start_msec = Sys_Milliseconds();
+
+	CLDemoHeader h;
+	A_memset(&h, 0, sizeof(h));
+	h.magic   = CL_DEMO_MAGIC;
+	h.version = CL_DEMO_VERSION;
+	h.clients = MAX_LOCAL_CLIENTS;
+	const char* map = CL_Map_Name();
+	if (map)
+		A_cstrncpyz(h.map, map, sizeof(h.map));
+	CL_DemoWrite(&h, sizeof(h));
+
+	for (size_t i = 0; i < MAX_LOCAL_CLIENTS; i++) {
+		const playerState_t* ps = PM_GetLocalClientGlobals(i)->pm.ps;
+		CLDemoState s;
+		s.origin[0]   = ps->origin.x;
+		s.origin[1]   = ps->origin.y;
+		s.origin[2]   = ps->origin.z;
+		s.velocity[0] = ps->velocity.x;
+		s.velocity[1] = ps->velocity.y;
+		s.velocity[2] = ps->velocity.z;
+		s.angles[0]   = ps->viewyaw;
+		s.angles[1]   = ps->viewpitch;
+		s.angles[2]   = ps->viewroll;
+		s.pm_type     = (uint32_t)ps->pm_type;
+		s.pm_flags    = (uint32_t)ps->pm_flags;
+		s.commandTime = (int32_t)((int64_t)ps->commandTime -
+		                          (int64_t)r->start_msec);
+		CL_DemoWrite(&s, sizeof(s));
+	}
+
+	if (r->failed) {
+		FS_CloseStream(&r->f);
+		r->active = false;
+		return false;
+	}
+	Com_Println(CON_DEST_CLIENT, "record: recording to '%s'.", r->path);
+	return true;
+}
+
+static void CL_DemoStopRecording(void) {
+	CLDemoRecord* r = &s_demoRecord;
+	if (!r->active)
+		return;
+
+	FS_CloseStream(&r->f);
+	r->active = false;
+	Com_Println(CON_DEST_CLIENT,
+	            "record: wrote %u frames (%zu KiB) to '%s'%s.",
+	            r->frames, r->bytes / 1024, r->path,
+	            r->failed ? ", then failed" : "");
+}
+
+void CL_DemoRecordCmd(size_t localClientNum) {
+	assert(localClientNum < MAX_LOCAL_CLIENTS);
+	if (!s_demoRecord.active)
+		return;
+
+	s_demoRecord.cmds[localClientNum] =
+		PM_GetLocalClientGlobals(localClientNum)->pm.cmd;
+	s_demoRecord.moved |= (uint8_t)(1u << localClientNum);
+}
+
+static void CL_DemoRecordFrame(void) {
+	CLDemoRecord* r = &s_demoRecord;
+	uint8_t buf[sizeof(CLDemoFrame) + MAX_LOCAL_CLIENTS * sizeof(CLDemoMove)];
+
+	CLDemoFrame fr;
+	A_memset(&fr, 0, sizeof(fr));
+	fr.msec  = (uint32_t)Com_LastFrameTimeDelta();
+	fr.flags = Dvar_GetBool(cl_splitscreen) ? CL_DEMO_FRAME_SPLITSCREEN : 0;
+	fr.moved = r->moved;
+	for (size_t i = 0; i < MAX_LOCAL_CLIENTS; i++) {
+		if (CG_LocalClientIsActive(i))
+			fr.active |= (uint8_t)(1u << i);
+	}
+	A_memcpy(buf, &fr, sizeof(fr));
+	size_t n = sizeof(fr);
+
+	for (size_t i = 0; i < MAX_LOCAL_CLIENTS; i++) {
+		if (!(r->moved & (1u << i)))
+			continue;
+
+		const usercmd_t*     cmd = &r->cmds[i];
+		const playerState_t* ps  = PM_GetLocalClientGlobals(i)->pm.ps;
+		CLDemoMove m;
+		m.vel[0]     = cmd->vel.x;
+		m.vel[1]     = cmd->vel.y;
+		m.vel[2]     = cmd->vel.z;
+		m.yaw        = cmd->yaw;
+		m.pitch      = cmd->pitch;
+		m.roll       = cmd->roll;
+		m.serverTime = (uint32_t)(cmd->serverTime - r->start_msec);
+		m.origin[0]  = ps->origin.x;
+		m.origin[1]  = ps->origin.y;
+		m.origin[2]  = ps->origin.z;
+		m.angles[0]  = ps->viewyaw;
+		m.angles[1]  = ps->viewpitch;
+		m.angles[2]  = ps->viewroll;
+		A_memcpy(buf + n, &m, sizeof(m));
+		n += sizeof(m);
+	}
+
+	r->moved = 0;
+	if (CL_DemoWrite(buf, n))
+		r->frames++;
+}
+// ============================================================================
+
+// ============================================================================
+// Playback
+A_NO_DISCARD bool CL_DemoIsPlaying(void) {
+	return s_demoPlay.active;
+}
+
+A_NO_DISCARD uint64_t CL_DemoFrameMsec(void) {
+	return s_demoPlay.frame_msec;
+}
+
+// Counts the frames, and makes sure each one's all there. A frame cut off
+// by the recording dying is dropped.
+static uint32_t CL_DemoCountFrames(const uint8_t* data, size_t size,
+                                   size_t pos
+) {
+	uint32_t frames = 0;
+	while (size - pos >= sizeof(CLDemoFrame)) {
+		CLDemoFrame fr;
+		A_memcpy(&fr, data + pos, sizeof(fr));
+		size_t n = sizeof(fr) + CL_DemoMaskCount(fr.moved) * sizeof(CLDemoMove);
+		if (size - pos < n)
+			break;
+		pos += n;
+		frames++;
+	}
+	if (pos != size) {
+		Com_Println(CON_DEST_CLIENT,
+		            "timedemo: %zu bytes at the end aren't a whole frame.",
+		            size - pos);
+	}
+	return frames;
+}
+
+static void CL_DemoRestoreState(size_t localClientNum, const CLDemoState* s) {
+	pm_t*          pm = PM_GetLocalClientGlobals(localClientNum);
+	playerState_t* ps = pm->pm.ps;
+	ps->origin.x    = s->origin[0];
+	ps->origin.y    = s->origin[1];
+	ps->origin.z    = s->origin[2];
+	ps->velocity.x  = s->velocity[0];
+	ps->velocity.y  = s->velocity[1];
+	ps->velocity.z  = s->velocity[2];
+	ps->viewyaw     = s->angles[0];
+	ps->viewpitch   = s->angles[1];
+	ps->viewroll    = s->angles[2];
+	ps->pm_type     = (pmType_t)s->pm_type;
+	ps->pm_flags    = (int)s->pm_flags;
+	ps->commandTime = (uint64_t)((int64_t)s_demoPlay.base_msec +
+	                             s->commandTime);
+	A_memset(&pm->pm.cmd, 0, sizeof(pm->pm.cmd));
+	M_AngleVectors(ps->viewyaw, ps->viewpitch, ps->viewroll,
+	               &pm->pml.forward, &pm->pml.right, &pm->pml.up);
+}
+
+// Checks the header, and counts the frames.
+static bool CL_DemoParse(A_INOUT CLDemoPlayback* p) {
+	CLDemoHeader h;
+	size_t       states = MAX_LOCAL_CLIENTS * sizeof(CLDemoState);
+	if (p->size < sizeof(h) + states) {
+		Com_Println(CON_DEST_CLIENT, "timedemo: '%s' is too short.", p->path);
+		return false;
+	}
+	A_memcpy(&h, p->data, sizeof(h));
+	h.map[sizeof(h.map) - 1] = '\0';
+	if (h.magic != CL_DEMO_MAGIC || h.version != CL_DEMO_VERSION) {
+		Com_Println(CON_DEST_CLIENT,
+		            "timedemo: '%s' isn't a version %d demo.",
+		            p->path, CL_DEMO_VERSION);
+		return false;
+	}
+	if (h.clients != MAX_LOCAL_CLIENTS) {
+		Com_Println(CON_DEST_CLIENT,
+		            "timedemo: '%s' was recorded with %u local clients, "
+		            "not %d.", p->path, h.clients, MAX_LOCAL_CLIENTS);
+		return false;
+	}
+
+	const char* map = CL_Map_Name();
+	if (!A_cstrcmp(h.map, map ? map : "")) {
+		Com_Println(CON_DEST_CLIENT,
+		            "timedemo: '%s' was recorded on '%s', not '%s'.",
+		            p->path, h.map, map ? map : "");
+	}
+
+	p->pos    = sizeof(h) + states;
+	p->frames = CL_DemoCountFrames(p->data, p->size, p->pos);
+	if (p->frames == 0) {
+		Com_Println(CON_DEST_CLIENT, "timedemo: '%s' has no frames.",
+		            p->path);
+		return false;
+	}
+	return true;
+}
+
+static bool CL_DemoStartPlayback(const char* name, int fps) {
+	CLDemoPlayback* p = &s_demoPlay;
+	assert(!p->active);
+	A_memset(p, 0, sizeof(*p));
+	CL_DemoPath(name, p->path, sizeof(p->path));
+
+	p->data = (uint8_t*)FS_ReadFile(p->path, &p->size);
+	if (p->data == NULL) {
+		Com_Println(CON_DEST_CLIENT, "timedemo: couldn't read '%s'.",
+		            p->path);
+		return false;
+	}
+	if (CL_DemoParse(p)) {
+		p->samples = (uint32_t*)VM_Alloc(
+			(size_t)p->frames * COM_PERF_PHASE_COUNT * sizeof(*p->samples),
+			VM_ALLOC_DEMO
+		);
+		if (p->samples == NULL) {
+			Com_Println(CON_DEST_CLIENT,
+			            "timedemo: not enough memory for %u frames' "
+			            "samples.", p->frames);
+		}
+	}
+	if (p->samples == NULL) {
+		FS_FreeFile(p->data);
+		p->data = NULL;
+		return false;
+	}
+
+	p->base_msec = Sys_Milliseconds();
+	for (size_t i = 0; i < MAX_LOCAL_CLIENTS; i++) {
+		CLDemoState s;
+		A_memcpy(&s, p->data + sizeof(CLDemoHeader) + i * sizeof(s),
+		         sizeof(s));
+		CL_DemoRestoreState(i, &s);
+	}
+
+	p->frame_msec = fps > 0 ? (uint64_t)(1000 / fps) : 0;
+	p->active     = true;
+	Com_Println(CON_DEST_CLIENT, "timedemo: playing %u frames of '%s'.",
+	            p->frames, p->path);
+	return true;
+}
+
+// Takes the perf samples for the demo's frames before `end`.
+static void CL_DemoTakeSamples(uint64_t end) {
+	CLDemoPlayback* p = &s_demoPlay;
+	end = A_MIN(end, p->perf_first + p->frame);
+	for (; p->perf_next < end; p->perf_next++) {
+		for (int i = 0; i < COM_PERF_PHASE_COUNT; i++) {
+			uint32_t usec;
+			if (!Com_PerfGetSample(p->perf_next, (ComPerfPhase)i, &usec))
+				continue;
+			p->samples[(size_t)i * p->frames + p->counts[i]++] = usec;
+		}
+	}
+}
+
+static void CL_DemoReport(void) {
+	CLDemoPlayback* p   = &s_demoPlay;
+	double          sec = (double)(Sys_Microseconds() - p->start_usec) / 1e6;
+
+	ComPerfStats stats[COM_PERF_PHASE_COUNT];
+	for (int i = 0; i < COM_PERF_PHASE_COUNT; i++) {
+		A_memset(&stats[i], 0, sizeof(stats[i]));
+		if (p->counts[i] > 0) {
+			Com_PerfComputeStats(p->samples + (size_t)i * p->frames,
+			                     p->counts[i], &stats[i]);
+		}
+	}
+
+	const ComPerfStats* f = &stats[COM_PERF_PHASE_FRAME];
+	Com_Println(CON_DEST_CLIENT,
+	            "timedemo: %s: %u frames in %.3f s, %.1f fps average, "
+	            "%.1f fps min, %.1f fps at p99.",
+	            p->path, p->frame, sec, sec > 0.0 ? p->frame / sec : 0.0,
+	            f->max ? 1e6 / f->max : 0.0, f->p99 ? 1e6 / f->p99 : 0.0);
+
+	Com_Println(CON_DEST_CLIENT, "timedemo: %-13s %9s %9s %9s %9s %9s  (msec)",
+	            "phase", "avg", "p50", "p95", "p99", "max");
+	for (int i = 0; i < COM_PERF_PHASE_COUNT; i++) {
+		const ComPerfStats* s = &stats[i];
+		if (s->samples == 0)
+			continue;
+
+		Com_Println(CON_DEST_CLIENT,
+		            "timedemo: %-13s %9.3f %9.3f %9.3f %9.3f %9.3f",
+		            Com_PerfPhaseName((ComPerfPhase)i),
+		            s->avg / 1000.0, s->p50 / 1000.0, s->p95 / 1000.0,
+		            s->p99 / 1000.0, s->max / 1000.0);
+	}
+
+	if (p->drifted == 0) {
+		Com_Println(CON_DEST_CLIENT,
+		            "timedemo: every move matched the recording.");
+	} else {
+		Com_Println(CON_DEST_CLIENT,
+		            "timedemo: %u moves drifted from the recording, by up "
+		            "to %.4f.", p->drifted, p->max_drift);
+	}
+}
+
+static void CL_DemoStopPlayback(bool report) {
+	CLDemoPlayback* p = &s_demoPlay;
+	if (!p->active)
+		return;
+
+	if (report && p->frame > 0) {
+		CL_DemoTakeSamples(Com_PerfFrameCount());
+		CL_DemoReport();
+	}
+
+	VM_Free(p->samples, VM_ALLOC_DEMO);
+	FS_FreeFile(p->data);
+	p->samples = NULL;
+	p->data    = NULL;
+	p->active  = false;
+
+	// Playback can get ahead of the clock, and Pmove won't move a client
+	// whose last command is in the future.
+	for (size_t i = 0; i < MAX_LOCAL_CLIENTS; i++)
+		CL_DemoSetCmdTime(i, Sys_Milliseconds());
+}
+
+static void CL_DemoApplyFrame(const CLDemoFrame* fr) {
+	bool splitscreen = (fr->flags & CL_DEMO_FRAME_SPLITSCREEN) != 0;
+	if (splitscreen != Dvar_GetBool(cl_splitscreen)) {
+		Dvar_SetBool(cl_splitscreen, splitscreen);
+		Dvar_ClearModified(cl_splitscreen);
+		if (splitscreen)
+			CL_EnterSplitscreen(0);
+		else
+			CL_LeaveSplitscreen(0);
+	}
+
+	for (size_t i = 0; i < MAX_LOCAL_CLIENTS; i++) {
+		if (fr->active & (1u << i))
+			CG_ActivateLocalClient(i);
+		else
+			CG_DectivateLocalClient(i);
+	}
+}
+
+void CL_DemoPlayClient(size_t localClientNum) {
+	assert(localClientNum < MAX_LOCAL_CLIENTS);
+	CLDemoPlayback* p   = &s_demoPlay;
+	uint8_t         bit = (uint8_t)(1u << localClientNum);
+	if (!p->active || !(p->cur.moved & bit))
+		return;
+
+	CLDemoMove m;
+	size_t     i = CL_DemoMaskCount((uint8_t)(p->cur.moved & (bit - 1)));
+	A_memcpy(&m, p->data + p->cur_moves + i * sizeof(m), sizeof(m));
+
+	pm_t* pm = PM_GetLocalClientGlobals(localClientNum);
+	pm->pm.cmd.vel.x      = m.vel[0];
+	pm->pm.cmd.vel.y      = m.vel[1];
+	pm->pm.cmd.vel.z      = m.vel[2];
+	pm->pm.cmd.yaw        = m.yaw;
+	pm->pm.cmd.pitch      = m.pitch;
+	pm->pm.cmd.roll       = m.roll;
+	pm->pm.cmd.serverTime = p->base_msec + m.serverTime;
+	Pmove(&pm->pm, &pm->pml);
+
+	playerState_t* ps = pm->pm.ps;
+	float dx    = ps->origin.x - m.origin[0];
+	float dy    = ps->origin.y - m.origin[1];
+	float dz    = ps->origin.z - m.origin[2];
+	float drift = sqrtf(dx * dx + dy * dy + dz * dz);
+	float turn  = A_MAX(fabsf(ps->viewyaw   - m.angles[0]),
+	              A_MAX(fabsf(ps->viewpitch - m.angles[1]),
+	                    fabsf(ps->viewroll  - m.angles[2])));
+	if (drift <= CL_DEMO_DRIFT_EPSILON && turn <= CL_DEMO_DRIFT_EPSILON)
+		return;
+
+	// Put it back, so one bad move doesn't send the rest of the demo
+	// somewhere else.
+	p->drifted++;
+	p->max_drift = A_MAX(p->max_drift, drift);
+	ps->origin.x  = m.origin[0];
+	ps->origin.y  = m.origin[1];
+	ps->origin.z  = m.origin[2];
+	ps->viewyaw   = m.angles[0];
+	ps->viewpitch = m.angles[1];
+	ps->viewroll  = m.angles[2];
+	M_AngleVectors(ps->viewyaw, ps->viewpitch, ps->viewroll,
+	               &pm->pml.forward, &pm->pml.right, &pm->pml.up);
+}
+// ============================================================================
+
+bool CL_DemoBeginFrame(void) {
+	CLDemoPlayback* p = &s_demoPlay;
+	if (!p->active)
+		return false;
+
+	uint64_t perf_frame = Com_PerfFrameCount();
+	if (p->frame == 0) {
+		p->start_usec = Sys_Microseconds();
+		p->perf_first = perf_frame;
+		p->perf_next  = perf_frame;
+	} else if (perf_frame > CL_DEMO_PERF_LAG) {
+		CL_DemoTakeSamples(perf_frame - CL_DEMO_PERF_LAG);
+	}
+
+	if (p->frame == p->frames) {
+		CL_DemoStopPlayback(true);
+		if (Dvar_GetBool(cl_timedemoQuit))
+			Sys_NormalExit(0);
+		return false;
+	}
+
+	A_memcpy(&p->cur, p->data + p->pos, sizeof(p->cur));
+	p->cur_moves = p->pos + sizeof(p->cur);
+	p->pos       = p->cur_moves +
+	               CL_DemoMaskCount(p->cur.moved) * sizeof(CLDemoMove);
+	CL_DemoApplyFrame(&p->cur);
+	return true;
+}
+
+void CL_DemoEndFrame(void) {
+	if (s_demoPlay.active)
+		s_demoPlay.frame++;
+	else if (s_demoRecord.active)
+		CL_DemoRecordFrame();
+}
+
+static void CL_DemoRecord_f(void) {
+	if (Cmd_Argc() != 2) {
+		Com_Println(CON_DEST_CLIENT, "USAGE: record <name>");
+		return;
+	}
+	if (s_demoPlay.active) {
+		Com_Println(CON_DEST_CLIENT,
+		            "record: can't record while a demo's playing.");
+		return;
+	}
+
+	CL_DemoStopRecording();
+	CL_DemoStartRecording(Cmd_Argv(1));
+}
+
+static void CL_DemoStopRecord_f(void) {
+	if (!s_demoRecord.active) {
+		Com_Println(CON_DEST_CLIENT, "stoprecord: not recording.");
+		return;
+	}
+	CL_DemoStopRecording();
+}
+
+static void CL_DemoTimedemo_f(void) {
+	int argc = Cmd_Argc();
+	int fps  = 0;
+	// Leaving the fps off is how to play as fast as possible, so one that's
+	// given has to be a rate Com_Frame can actually hold.
+	if (argc < 2 || argc > 3 ||
+	    (argc == 3 && (!A_atoi(Cmd_Argv(2), &fps) ||
+	                   fps < 1 || fps > CL_DEMO_MAX_FPS))
+	) {
+		Com_Println(CON_DEST_CLIENT, "USAGE: timedemo <name> [fps]");
+		Com_Println(CON_DEST_CLIENT,
+		            "fps is 1 to %d, or left off to play as fast as "
+		            "possible.", CL_DEMO_MAX_FPS);
+		return;
+	}
+	if (s_demoRecord.active) {
+		Com_Println(CON_DEST_CLIENT,
+		            "timedemo: can't play a demo while recording.");
+		return;
+	}
+
+	CL_DemoStopPlayback(false);
+	CL_DemoStartPlayback(Cmd_Argv(1), fps);
+}
+
+static void CL_DemoStop_f(void) {
+	if (!s_demoPlay.active) {
+		Com_Println(CON_DEST_CLIENT, "stopdemo: no demo's playing.");
+		return;
+	}
+	CL_DemoStopPlayback(true);
+}
+
+void CL_DemoShutdown(void) {
+	CL_DemoStopRecording();
+	CL_DemoStopPlayback(false);
+	Cmd_RemoveCommand("stopdemo");
+	Cmd_RemoveCommand("timedemo");
+	Cmd_RemoveCommand("stoprecord");
+	Cmd_RemoveCommand("record");
+	Dvar_Unregister("cl_timedemoQuit");
+	cl_timedemoQuit = NULL;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "acommon/acommon.h"
+
+#include "com_defs.h"
+
+// ============================================================================
+// Demos: every local client's usercmds and where they ended up, frame by
+// frame, so a flight through a map can be replayed exactly and timed.
+//
+// `record <name>` writes <name>.dem until `stoprecord`. `timedemo <name>
+// [fps]` replays it, as fast as frames can be drawn or at `fps` (1 to 1000),
+// and prints the total time, average and minimum FPS, and percentiles for
+// each perf phase when it's done (or when `stopdemo` cuts it short). With
+// cl_timedemoQuit set, the process exits once the report's printed, so a
+// script can run one and read the results.
+//
+// Playback runs the recorded usercmds through Pmove, with the recorded
+// times, and checks where each client ends up against where it did when
+// recording. Nothing depends on the renderer, so it times whatever
+// backend is in use.
+A_EXTERN_C void CL_DemoInit    (void);
+A_EXTERN_C void CL_DemoShutdown(void);
+
+A_EXTERN_C A_NO_DISCARD bool CL_DemoIsRecording(void);
+A_EXTERN_C A_NO_DISCARD bool CL_DemoIsPlaying  (void);
+// How long Com_Frame should hold each frame to while a demo's playing,
+// 0 for as fast as possible.
+A_EXTERN_C A_NO_DISCARD uint64_t CL_DemoFrameMsec(void);
+
+// CG_Frame brackets each frame with these. While playing, BeginFrame
+// restores the frame's splitscreen and active clients and returns true,
+// and the clients should be moved with CL_DemoPlayClient instead of input.
+A_EXTERN_C bool CL_DemoBeginFrame (void);
+A_EXTERN_C void CL_DemoEndFrame   (void);
+// Called with the usercmd a client is about to Pmove with.
+A_EXTERN_C void CL_DemoRecordCmd  (size_t localClientNum);
+A_EXTERN_C void CL_DemoPlayClient (size_t localClientNum);
+// ============================================================================
@@ -11,14 +11,24 @@
 #include "acommon/a_string.h"
 
 #include "cg_cgame.h"
+#include "cm_trace.h"
+#include "cmd_commands.h"
+#include "com_memtrace.h"
 #include "com_print.h"
+#include "com_prof.h"
 #include "db_files.h"
+#include "dvar.h"
 #include "fs_files.h"
 #include "gfx.h"
 #include "vm_vmem.h"
 
 #define BSP_MAX_SKIES 8
 
+#define CL_MAP_SOAK_DEFAULT_COUNT 100
+// How much RSS may grow between the first and last reload of map_soak
+// before it's reported as a leak, to allow for allocator and driver noise.
+#define CL_MAP_SOAK_RSS_SLACK     (4 * 1024 * 1024)
+
 struct MapLoadData {
 	StreamFile  		       f;
 	const char* 		       map_name;
@@ -46,6 +56,11 @@ struct MapLoadData {
 	uint32_t                   scenario_scenery_palette_count;
 
 	BSPScenarioStructureBSP* bsp_ptr;
+	BSPCollisionBSP*         coll;
+	BSPCollisionMaterial*    coll_materials;
+	uint32_t                 coll_material_count;
+
+	VmArena                    arena;
 } g_load;
 
 static void CL_DecompressVector(A_OUT avec3f_t* decompressed, uint32_t compressed);
@@ -86,8 +101,52 @@ static bool CL_LoadMap_Sky(TagId id);
 static bool CL_LoadMap_Model(TagId id);
 static bool CL_LoadMap_Object(TagId id);
 
+static char s_mapName[A_OS_MAX_PATH];
+// Only the counters that can't be worked out from g_load.
+static MapMemStats s_mapMemStats;
+
+static void CL_MapSoak_f(void);
+
+// Fault in all of the tag data when it's allocated, rather than as it's
+// first touched. Tag data is read all over the place while loading, so
+// this trades a little load time for fewer stalls later.
+static dvar_t* cl_prefaulttags;
+
+static void CL_ReserveTagSpaceAt(const void* p, size_t n, const char* engine) {
+	if (Z_ReserveAt(p, n) == p) {
+		Com_DPrintln(CON_DEST_CLIENT,
+			"CL_ReserveTagSpace: Reserved 0x%08zX-0x%08zX for %s tag data.",
+			(size_t)p, (size_t)p + n, engine);
+		return;
+	}
+
+	// Not fatal yet: it might be free again by the time a map needs it.
+	size_t begin = 0, end = 0;
+	if (Z_QueryMappingAt(p, &begin, &end)) {
+		Com_Println(CON_DEST_CLIENT,
+			"CL_ReserveTagSpace: Couldn't reserve 0x%08zX for %s tag data, "
+			"0x%08zX-0x%08zX is already mapped.",
+			(size_t)p, engine, begin, end);
+	} else {
+		Com_Println(CON_DEST_CLIENT,
+			"CL_ReserveTagSpace: Couldn't reserve 0x%08zX for %s tag data.",
+			(size_t)p, engine);
+	}
+}
+
+void CL_ReserveTagSpace(void) {
+	CL_ReserveTagSpaceAt((const void*)TAGS_BASE_ADDR_XBOX,
+		TAGS_MAX_SIZE_XBOX, "Xbox");
+	CL_ReserveTagSpaceAt((const void*)TAGS_BASE_ADDR_GEARBOX,
+		TAGS_MAX_SIZE_GEARBOX, "Gearbox");
+}
+
 void CL_InitMap(void) {
 	A_memset((void*)&g_load, 0, sizeof(g_load));
+	A_memset(&s_mapMemStats, 0, sizeof(s_mapMemStats));
+	VM_ArenaInit(&g_load.arena, VM_ARENA_DEFAULT_CHUNK_SIZE);
+	Cmd_AddCommand("map_soak", CL_MapSoak_f);
+	cl_prefaulttags = Dvar_RegisterBool("cl_prefaulttags", DVAR_FLAG_NONE, false);
 #if !A_TARGET_PLATFORM_IS_XBOX
 	Com_DPrintln(CON_DEST_CLIENT,
 		"CL_Init: Successfully mapped bitmaps.map at 0x%08X (%zu bytes)",
@@ -96,14 +155,59 @@ void CL_InitMap(void) {
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 }
 
+static bool CL_LoadMapInternal(const char* map_name);
+
+// Page faults are what random access across tag data costs on first touch,
+// and huge pages are what keeps it from thrashing the TLB afterwards.
+static void CL_ReportLoadFaults(const SysPageFaults* before) {
+	SysPageFaults after;
+	if (!Sys_PageFaults(&after))
+		return;
+
+	ZRegionInfo region;
+	if (g_load.p && Z_QueryRegion(g_load.p, g_load.n, &region)) {
+		Com_Println(CON_DEST_CLIENT,
+			"CL_LoadMap: %llu minor, %llu major page faults; tag data "
+			"%zu KiB resident, %zu KiB in huge pages.",
+			(unsigned long long)(after.minor - before->minor),
+			(unsigned long long)(after.major - before->major),
+			region.resident_bytes / 1024, region.huge_page_bytes / 1024);
+	} else {
+		Com_Println(CON_DEST_CLIENT,
+			"CL_LoadMap: %llu minor, %llu major page faults.",
+			(unsigned long long)(after.minor - before->minor),
+			(unsigned long long)(after.major - before->major));
+	}
+}
+
 bool CL_LoadMap(const char* map_name) {
+	COM_PROF_BEGIN("CL_LoadMap");
+	SysPageFaults faults;
+	bool have_faults = Sys_PageFaults(&faults);
+	Com_MemTraceBeginLoad();
+	bool b = CL_LoadMapInternal(map_name);
+	Com_MemTraceEndLoad();
+	if (b && have_faults)
+		CL_ReportLoadFaults(&faults);
+	COM_PROF_END();
+	return b;
+}
+
+static bool CL_LoadMapInternal(const char* map_name) {
+	if (map_name != s_mapName)
+		A_cstrncpyz(s_mapName, map_name, sizeof(s_mapName));
+	g_load.map_name = s_mapName;
+
 	g_load.f = DB_LoadMap_Stream(map_name);
 	if (g_load.f.f == NULL) {
 		return false;
 	}
 
 	MapHeader header;
-	if (!CL_LoadMap_Header(&header)) return false;
+	COM_PROF_BEGIN("CL_LoadMap_Header");
+	bool b = CL_LoadMap_Header(&header);
+	COM_PROF_END();
+	if (!b) return false;
 
 	bool is_xbox = header.engine == MAP_ENGINE_XBOX;
 	bool is_gearbox = header.engine == MAP_ENGINE_GEARBOX;
@@ -113,7 +217,9 @@ bool CL_LoadMap(const char* map_name) {
 			Com_Errorln(-1, "CL_LoadMap: Wrong engine version.");
 		}
 
+		COM_PROF_BEGIN("CL_LoadMap_Decompress");
 		CL_LoadMap_Decompress(map_name, &header);
+		COM_PROF_END();
 	} else {
 #if !A_TARGET_PLATFORM_IS_XBOX
 		g_load.bitmaps_map = DB_LoadMap_Mmap("bitmaps.map");
@@ -122,9 +228,15 @@ bool CL_LoadMap(const char* map_name) {
 	}
 
 	TagHeader tag_header;
-	if (!CL_LoadMap_TagHeader(&header, is_xbox, &tag_header)) return false;
+	COM_PROF_BEGIN("CL_LoadMap_TagHeader");
+	b = CL_LoadMap_TagHeader(&header, is_xbox, &tag_header);
+	COM_PROF_END();
+	if (!b) return false;
 	g_load.tag_count = tag_header.common.tag_count;
-	if (!CL_LoadMap_TagData(&header, &tag_header, is_xbox)) return false;
+	COM_PROF_BEGIN("CL_LoadMap_TagData");
+	b = CL_LoadMap_TagData(&header, &tag_header, is_xbox);
+	COM_PROF_END();
+	if (!b) return false;
 	if (is_xbox) {
 		BSPModelPartVerticesIndirect* vert_ind = (BSPModelPartVerticesIndirect*)tag_header.xbox.vertex_data_ptr;
 		g_load.model_vertices = (BSPModelCompressedVertex*)vert_ind->vertices;
@@ -133,7 +245,10 @@ bool CL_LoadMap(const char* map_name) {
 	}
 
 	BSPScenario* scenario = NULL;
-	if (!CL_LoadMap_Scenario(&tag_header, &scenario)) return false;
+	COM_PROF_BEGIN("CL_LoadMap_Scenario");
+	b = CL_LoadMap_Scenario(&tag_header, &scenario);
+	COM_PROF_END();
+	if (!b) return false;
 
 	ScenarioPlayerSpawn* spawns =
 		(ScenarioPlayerSpawn*)scenario->player_starting_locations.pointer;
@@ -149,19 +264,35 @@ bool CL_LoadMap(const char* map_name) {
 	const ScenarioBSP* sbsps =
 		(ScenarioBSP*)scenario->structure_bsps.pointer;
 	BSPHeader* bsp_header = NULL;
-	if (!CL_LoadMap_BSPHeader(&sbsps[0], &bsp_header)) return false;
+	COM_PROF_BEGIN("CL_LoadMap_BSPHeader");
+	b = CL_LoadMap_BSPHeader(&sbsps[0], &bsp_header);
+	COM_PROF_END();
+	if (!b) return false;
 	g_load.rendered_vertices = (BSPRenderedVertex*)bsp_header->rendered_vertices;
 	g_load.lightmap_vertices = (BSPLightmapVertex*)bsp_header->lightmap_vertices;
 
 	BSPScenarioStructureBSP* bsp = NULL;
-	if (!CL_LoadMap_BSP(&sbsps[0], bsp_header, &bsp)) return false;
+	COM_PROF_BEGIN("CL_LoadMap_BSP");
+	b = CL_LoadMap_BSP(&sbsps[0], bsp_header, &bsp);
+	COM_PROF_END();
+	if (!b) return false;
 	assert(bsp);
 	g_load.bsp_ptr = bsp;
 	g_load.surfs = (BSPSurf*)bsp->surfaces.pointer;
 	g_load.surf_count = bsp->surfaces.count;
 	g_load.lightmaps = (BSPLightmap*)bsp->lightmaps.pointer;
 	g_load.lightmap_count = bsp->lightmaps.count;
+	g_load.coll = bsp->collision_bsp.count > 0
+		? (BSPCollisionBSP*)bsp->collision_bsp.pointer : NULL;
+	g_load.coll_materials =
+		(BSPCollisionMaterial*)bsp->collision_materials.pointer;
+	g_load.coll_material_count = bsp->collision_materials.count;
 
+	COM_PROF_BEGIN("CM_LoadMap");
+	CM_LoadMap();
+	COM_PROF_END();
+
+	COM_PROF_BEGIN("CL_LoadMap_Materials");
 	size_t total_vertex_count = 0;
 	BSPScenarioStructureBSPLightmap* lightmaps =
 		(BSPScenarioStructureBSPLightmap*)bsp->lightmaps.pointer;
@@ -205,7 +336,8 @@ bool CL_LoadMap(const char* map_name) {
 			size_t decompressed_vertices_size =
 				decompressed_rendered_vertices_size + decompressed_lightmap_vertices_size;
 
-			void* decompressed_vertices = VM_Alloc(decompressed_vertices_size, VM_ALLOC_BSP);
+			void* decompressed_vertices = CL_Map_Alloc(decompressed_vertices_size, VM_ALLOC_BSP);
+			s_mapMemStats.bsp_vertex_bytes += decompressed_vertices_size;
 			material->uncompressed_vertices.pointer = decompressed_vertices;
 			material->uncompressed_vertices.size    = decompressed_vertices_size;
 			BSPRenderedVertex* rendered_vertices =
@@ -238,8 +370,10 @@ bool CL_LoadMap(const char* map_name) {
 			CL_LoadMap_Shader(shader_tag->tag_id);
 		}
 	}
+	COM_PROF_END();
 	Com_DPrintln(CON_DEST_CLIENT, "CL_LoadMap: Total Vertex Count=%zu.", total_vertex_count);
 
+	COM_PROF_BEGIN("CL_LoadMap_Skies");
 	TagDependency* sky_dependencies = 
 		(TagDependency*)scenario->skies.pointer;
 	for (int i = 0; i < scenario->skies.count; i++) {
@@ -249,6 +383,7 @@ bool CL_LoadMap(const char* map_name) {
 		g_load.skies[i] = (BSPSky*)CL_Map_Tag(sky_id)->tag_data;
 	}
 	g_load.skies_count = scenario->skies.count;
+	COM_PROF_END();
 
 	BSPScenarioObjectName* object_names = 
 		(BSPScenarioObjectName*)scenario->object_names.pointer;
@@ -261,6 +396,7 @@ bool CL_LoadMap(const char* map_name) {
 	BSPScenarioSceneryPalette* scenery_palette_tags = 
 		(BSPScenarioSceneryPalette*)scenario->scenery_palette.pointer;
 	int scenery_palette_count = scenario->scenery_palette.count;
+	COM_PROF_BEGIN("CL_LoadMap_Objects");
 	for (int i = 0; i < scenery_palette_count; i++) {
 		BSPScenarioSceneryPalette* scenery_palette_tag = &scenery_palette_tags[i];
 		if (scenery_palette_tag->name.fourcc == 0)
@@ -274,16 +410,19 @@ bool CL_LoadMap(const char* map_name) {
 					"CL_LoadMap: found scenery %s", 
 					scenery_palette_tag->name.path_pointer);
 
-		bool b = CL_LoadMap_Object(scenery_palette_tag->name.id);
+		b = CL_LoadMap_Object(scenery_palette_tag->name.id);
 		assert(b);
 	}
+	COM_PROF_END();
 
 	g_load.scenario_scenery = (BSPScenarioScenery*)scenario->scenery.pointer;
 	g_load.scenario_scenery_count = scenario->scenery.count;
 	g_load.scenario_scenery_palette = (BSPScenarioSceneryPalette*)scenario->scenery_palette.pointer;
 	g_load.scenario_scenery_palette_count = scenario->scenery_palette.count;
 
+	COM_PROF_BEGIN("R_LoadMap");
 	R_LoadMap();
+	COM_PROF_END();
 
 	for (size_t localClientNum = 0;
 		localClientNum < MAX_LOCAL_CLIENTS;
@@ -301,9 +440,8 @@ void CL_UnloadModel(BSPModel* model) {
 		BSPModelGeometry* geometry = &geometries[i];
 		BSPModelGeometryPart* parts = (BSPModelGeometryPart*)geometry->parts.pointer;
 		for (int j = 0; j < geometry->parts.count; j++) {
-			BSPModelGeometryPart* part = &parts[i];
-			// FIXME: more heap corruption
-			//VM_Free(part->decompressed_vertices.pointer, VM_ALLOC_MODEL);
+			BSPModelGeometryPart* part = &parts[j];
+			// The vertices themselves are released with the map arena.
 			part->decompressed_vertices.count = 0;
 			part->decompressed_vertices.pointer = NULL;
 		}
@@ -319,170 +457,19 @@ void CL_UnloadScenery(BSPScenery* scenery) {
 
 bool CL_UnloadMap(void) {
 	R_UnloadMap();
+	CM_UnloadMap();
 	DB_UnloadMap_Stream(&g_load.f);
 
+	// Everything decompressed or streamed in by CL_LoadMap (vertices, 
+	// bitmap pixels) lives in the map arena, so it all goes at once here
+	// instead of being walked and freed piece by piece. Bitmaps shared by
+	// several shaders used to be freed more than once that way.
+	VM_ArenaReset(&g_load.arena);
+	A_memset(&s_mapMemStats, 0, sizeof(s_mapMemStats));
+
 	if (!g_load.bsp_ptr)
 		return false;
 
-	BSPSky** skies = g_load.skies;
-	for (int i = 0; i < g_load.skies_count; i++) {
-		BSPSky* sky = skies[i];
-		TagId id = sky->model.id;
-		if (id.index == 0xFFFF)
-			continue;
-
-		Tag* model_tag = CL_Map_Tag(id);
-		assert(model_tag->primary_class == TAG_FOURCC_MODEL);
-		BSPModel* model = (BSPModel*)model_tag->tag_data;
-		BSPModelGeometry* geoms = (BSPModelGeometry*)model->geometries.pointer;
-		for (int j = 0; j < model->geometries.count; j++) {
-			BSPModelGeometry* geom = &geoms[j];
-			BSPModelGeometryPart* parts =
-				(BSPModelGeometryPart*)geom->parts.pointer;
-			for (int k = 0; k < geom->parts.count; k++) {
-				BSPModelGeometryPart* part = &parts[k];
-				assert(part->compressed_vertices.count ==
-					part->decompressed_vertices.count);
-				VM_Free(part->decompressed_vertices.pointer, VM_ALLOC_MODEL);
-			}
-		}
-	}
-
-	BSPScenarioStructureBSPLightmap* lightmaps =
-		(BSPScenarioStructureBSPLightmap*)g_load.bsp_ptr->lightmaps.pointer;
-	for (uint32_t i = 0; i < g_load.bsp_ptr->lightmaps.count; i++) {
-		BSPScenarioStructureBSPLightmap* lightmap = &lightmaps[i];
-		BSPMaterial* materials = (BSPMaterial*)lightmap->materials.pointer;
-		for (uint32_t j = 0; j < lightmap->materials.count; j++) {
-			BSPMaterial* material = &materials[j];
-			VM_Free(material->uncompressed_vertices.pointer, VM_ALLOC_BSP);
-
-			if (material->shader.id.index == 0xFFFF)
-				continue;
-			Tag* shader_tag = CL_Map_Tag(material->shader.id);
-			assert(shader_tag);
-			assert(shader_tag->tag_data);
-
-			assert(shader_tag->secondary_class == TAG_FOURCC_SHADER);
-			if (shader_tag->primary_class == TAG_FOURCC_SHADER_ENVIRONMENT) {
-				BSPShaderEnvironment* shader =
-					(BSPShaderEnvironment*)shader_tag->tag_data;
-
-				if (shader->base_map.id.index != 0xFFFF) {
-					Tag* base_map_tag = CL_Map_Tag(shader->base_map.id);
-					assert(base_map_tag->primary_class == TAG_FOURCC_BITMAP);
-					BSPBitmap* base_map_bitmap = (BSPBitmap*)base_map_tag->tag_data;
-					BSPBitmapData* bitmap_data =
-						(BSPBitmapData*)base_map_bitmap->bitmap_data.pointer;
-					for (uint32_t k = 0;
-						k < base_map_bitmap->bitmap_data.count;
-						k++
-						) {
-						if (bitmap_data[k].type !=
-							BSP_BITMAP_DATA_TYPE_2D_TEXTURE &&
-							bitmap_data[k].type !=
-							BSP_BITMAP_DATA_TYPE_3D_TEXTURE
-							) {
-							continue;
-						}
-
-						assert(bitmap_data[k].pixels &&
-							bitmap_data[k].pixels != (void*)0xFFFFFFFF);
-						// FIXME: leak is intentional for now 
-						// this call to Z_Free is corrupting the heap somehow
-						//VM_Free(bitmap_data[k].pixels, VM_ALLOC_BITMAP);
-					}
-				}
-
-				if (shader->primary_detail_map.id.index != 0xFFFF) {
-					Tag* primary_detail_map_tag =
-						CL_Map_Tag(shader->primary_detail_map.id);
-					assert(primary_detail_map_tag->primary_class ==
-						TAG_FOURCC_BITMAP);
-					BSPBitmap* primary_detail_map_bitmap =
-						(BSPBitmap*)primary_detail_map_tag->tag_data;
-					BSPBitmapData* bitmap_data =
-						(BSPBitmapData*)
-						primary_detail_map_bitmap->bitmap_data.pointer;
-					for (uint32_t k = 0;
-						k < primary_detail_map_bitmap->bitmap_data.count;
-						k++
-					) {
-						if (bitmap_data[k].type !=
-							BSP_BITMAP_DATA_TYPE_2D_TEXTURE &&
-							bitmap_data[k].type !=
-							BSP_BITMAP_DATA_TYPE_3D_TEXTURE
-							) {
-							continue;
-						}
-
-						assert(bitmap_data[k].pixels &&
-							bitmap_data[k].pixels != (void*)0xFFFFFFFF);
-						// FIXME: leak is intentional for now 
-						// this call to Z_Free is corrupting the heap somehow
-						//VM_Free(bitmap_data[k].pixels, VM_ALLOC_BITMAP);
-					}
-				}
-
-				if (shader->secondary_detail_map.id.index != 0xFFFF) {
-					Tag* secondary_detail_map_tag =
-						CL_Map_Tag(shader->secondary_detail_map.id);
-					assert(secondary_detail_map_tag->primary_class ==
-						TAG_FOURCC_BITMAP);
-					BSPBitmap* secondary_detail_map_bitmap =
-						(BSPBitmap*)secondary_detail_map_tag->tag_data;
-					BSPBitmapData* bitmap_data =
-						(BSPBitmapData*)
-						secondary_detail_map_bitmap->bitmap_data.pointer;
-					for (uint32_t k = 0;
-						k < secondary_detail_map_bitmap->bitmap_data.count;
-						k++
-					) {
-						if (bitmap_data[k].type != BSP_BITMAP_DATA_TYPE_2D_TEXTURE &&
-							bitmap_data[k].type != BSP_BITMAP_DATA_TYPE_3D_TEXTURE
-							) {
-							continue;
-						}
-
-						assert(bitmap_data[k].pixels &&
-							bitmap_data[k].pixels != (void*)0xFFFFFFFF);
-						// FIXME: leak is intentional for now 
-						// this call to Z_Free is corrupting the heap somehow
-						//VM_Free(bitmap_data[k].pixels, VM_ALLOC_BITMAP);
-					}
-				}
-
-				if (shader->micro_detail_map.id.index != 0xFFFF) {
-					Tag* micro_detail_map_tag =
-						CL_Map_Tag(shader->micro_detail_map.id);
-					assert(micro_detail_map_tag->primary_class ==
-						TAG_FOURCC_BITMAP);
-					BSPBitmap* micro_detail_map_bitmap =
-						(BSPBitmap*)micro_detail_map_tag->tag_data;
-					BSPBitmapData* bitmap_data =
-						(BSPBitmapData*)
-						micro_detail_map_bitmap->bitmap_data.pointer;
-					for (uint32_t k = 0;
-						k < micro_detail_map_bitmap->bitmap_data.count;
-						k++
-					) {
-						if (bitmap_data[k].type != BSP_BITMAP_DATA_TYPE_2D_TEXTURE &&
-							bitmap_data[k].type != BSP_BITMAP_DATA_TYPE_3D_TEXTURE
-						) {
-							continue;
-						}
-
-						assert(bitmap_data[k].pixels &&
-							bitmap_data[k].pixels != (void*)0xFFFFFFFF);
-						// FIXME: leak is intentional for now 
-						// this call to Z_Free is corrupting the heap somehow
-						//VM_Free(bitmap_data[k].pixels, VM_ALLOC_BITMAP);
-					}
-				}
-			}
-		}
-	}
-
 	for (int i = 0; i < CL_Map_ScenarioSceneryPaletteCount(); i++) {
 		BSPScenarioSceneryPalette* palette = CL_Map_ScenarioSceneryPalette(i);
 		Tag* scenery_tag = CL_Map_Tag(palette->name.id);
@@ -501,12 +488,73 @@ bool CL_UnloadMap(void) {
 		g_load.lightmaps                = NULL;
 		g_load.scenario_scenery         = NULL;
 		g_load.scenario_scenery_palette = NULL;
+		g_load.bsp_ptr                  = NULL;
+		g_load.coll                     = NULL;
+		g_load.coll_materials           = NULL;
+		g_load.coll_material_count      = 0;
+		g_load.skies_count              = 0;
 	}
 
 	return true;
 }
 
+// Reloads the current map `count` times and checks that neither VM's
+// accounting nor the process' RSS grows from one load to the next. The first
+// load is skipped, since drivers and the C runtime grow their own caches.
+static void CL_MapSoak_f(void) {
+	int count = CL_MAP_SOAK_DEFAULT_COUNT;
+	if (Cmd_Argc() > 1 && (!A_atoi(Cmd_Argv(1), &count) || count < 2)) {
+		Com_Println(CON_DEST_CLIENT, "USAGE: map_soak [count >= 2]");
+		return;
+	}
+
+	if (!g_load.map_name) {
+		Com_Println(CON_DEST_CLIENT, "map_soak: no map loaded.");
+		return;
+	}
+
+	uint64_t first_rss = 0, last_rss = 0, max_rss = 0;
+	size_t   first_vm  = 0, last_vm  = 0;
+	uint64_t start     = Sys_Milliseconds();
+	for (int i = 0; i < count; i++) {
+		CL_UnloadMap();
+		if (!CL_LoadMap(s_mapName)) {
+			Com_Println(CON_DEST_CLIENT, 
+			            "map_soak: failed to load %s on iteration %d.",
+			            s_mapName, i);
+			return;
+		}
+
+		last_rss = Sys_ResidentBytes();
+		last_vm  = VM_GetTotalAllocStats()->bytes;
+		if (i == 1) {
+			first_rss = last_rss;
+			first_vm  = last_vm;
+		}
+		max_rss = A_MAX(max_rss, last_rss);
+	}
+
+	bool rss_ok = last_rss <= first_rss + CL_MAP_SOAK_RSS_SLACK;
+	bool vm_ok  = last_vm == first_vm;
+	Com_Println(CON_DEST_CLIENT,
+	            "map_soak: %d loads of %s in %llu ms.",
+	            count, s_mapName, 
+	            (unsigned long long)(Sys_Milliseconds() - start));
+	Com_Println(CON_DEST_CLIENT,
+	            "map_soak: RSS %llu KiB -> %llu KiB (max %llu KiB), "
+	            "VM %zu KiB -> %zu KiB.",
+	            (unsigned long long)(first_rss / 1024), 
+	            (unsigned long long)(last_rss  / 1024),
+	            (unsigned long long)(max_rss   / 1024),
+	            first_vm / 1024, last_vm / 1024);
+	Com_Println(CON_DEST_CLIENT, "map_soak: %s", 
+	            rss_ok && vm_ok ? "PASS" : "FAIL: memory grew across reloads");
+}
+
 void CL_ShutdownMap(void) {
+	Cmd_RemoveCommand("map_soak");
+	Dvar_Unregister("cl_prefaulttags");
+	cl_prefaulttags = NULL;
 	CL_UnloadMap();
 #if !A_TARGET_PLATFORM_IS_XBOX
 	DB_UnloadMap_Mmap(&g_load.bitmaps_map);
@@ -514,10 +562,33 @@ void CL_ShutdownMap(void) {
 	A_memset((void*)&g_load, 0, sizeof(g_load));
 }
 
+A_NO_DISCARD void* CL_Map_Alloc(size_t n, VmAllocType type) {
+	return VM_ArenaAlloc(&g_load.arena, n, type);
+}
+
+A_NO_DISCARD void* CL_Map_Zalloc(size_t n, VmAllocType type) {
+	return VM_ArenaZalloc(&g_load.arena, n, type);
+}
+
 bool CL_IsMapLoaded(void) {
 	return g_load.f.f && g_load.p && g_load.n > 0;
 }
 
+const char* CL_Map_Name(void) {
+	return CL_IsMapLoaded() ? g_load.map_name : NULL;
+}
+
+void CL_Map_MemStats(A_OUT MapMemStats* stats) {
+	assert(stats);
+	*stats = s_mapMemStats;
+	stats->map_name       = CL_IsMapLoaded() ? g_load.map_name : NULL;
+	stats->tag_data_bytes = g_load.n;
+	stats->arena_reserved = g_load.arena.reserved;
+	stats->arena_used     = 0;
+	for (int i = 0; i < VM_ALLOC_COUNT; i++)
+		stats->arena_used += g_load.arena.bytes[i];
+}
+
 bool CL_BitmapDataFormatIsCompressed(BSPBitmapDataFormat format) {
 	switch (format) {
 	case BSP_BITMAP_DATA_FORMAT_DXT1:
@@ -559,6 +630,50 @@ BSPLightmapVertex* CL_Map_LightmapVertices(void) {
 	return g_load.lightmap_vertices;
 }
 
+BSPCollisionBSP* CL_Map_CollisionBSP(void) {
+	return g_load.coll;
+}
+
+BSPCollisionMaterial* CL_Map_CollisionMaterial(uint16_t i) {
+	assert(g_load.coll_materials);
+	assert(i < g_load.coll_material_count);
+	return &g_load.coll_materials[i];
+}
+
+uint32_t CL_Map_CollisionMaterialCount(void) {
+	return g_load.coll_material_count;
+}
+
+BSPCollSurf* CL_Map_CollSurfs(void) {
+	assert(g_load.coll);
+	return (BSPCollSurf*)g_load.coll->surfs.pointer;
+}
+
+uint32_t CL_Map_CollSurfCount(void) {
+	assert(g_load.coll);
+	return g_load.coll->surfs.count;
+}
+
+BSPCollEdge* CL_Map_CollEdges(void) {
+	assert(g_load.coll);
+	return (BSPCollEdge*)g_load.coll->edges.pointer;
+}
+
+uint32_t CL_Map_CollEdgeCount(void) {
+	assert(g_load.coll);
+	return g_load.coll->edges.count;
+}
+
+BSPCollVertex* CL_Map_CollVertices(void) {
+	assert(g_load.coll);
+	return (BSPCollVertex*)g_load.coll->vertices.pointer;
+}
+
+uint32_t CL_Map_CollVertexCount(void) {
+	assert(g_load.coll);
+	return g_load.coll->vertices.count;
+}
+
 BSPLightmap* CL_Map_Lightmap(uint16_t i) {
 	assert(g_load.lightmaps);
 	assert(i < g_load.lightmap_count);
@@ -777,7 +892,19 @@ static bool CL_LoadMap_TagData(
 		total_tag_space);
 	g_load.n = total_tag_space;
 	g_load.p = VM_AllocAt(tag_base, g_load.n, VM_ALLOC_TAG_DATA);
-	assert(g_load.p == tag_base);
+	if (g_load.p != tag_base) {
+		size_t begin = 0, end = 0;
+		if (Z_QueryMappingAt(tag_base, &begin, &end)) {
+			Com_Errorln(-1,
+				"CL_LoadMap: Failed to allocate tag data at 0x%08zX, "
+				"0x%08zX-0x%08zX is already mapped.",
+				(size_t)tag_base, begin, end);
+		}
+		Com_Errorln(-1, "CL_LoadMap: Failed to allocate tag data at 0x%08zX.",
+			(size_t)tag_base);
+	}
+	if (Dvar_GetBool(cl_prefaulttags))
+		Z_PrefaultAt(g_load.p, g_load.n);
 	A_memcpy(g_load.p, tag_header, tag_header_size);
 	bool b = FS_ReadStream(&g_load.f, (char*)g_load.p + tag_header_size, (size_t)header->tag_data_size);
 	assert(b);
@@ -908,8 +1035,12 @@ static bool CL_LoadMap_Bitmap(TagId tag_id) {
 
 		bitmap_data[i].actual_size = CL_BitmapDataSize(&bitmap_data[i]);
 		assert(bitmap_data[i].actual_size < 4 * 1024 * 1024);
-		bitmap_data[i].pixels = VM_Alloc(bitmap_data[i].actual_size, VM_ALLOC_BITMAP);
+		bitmap_data[i].pixels = CL_Map_Alloc(bitmap_data[i].actual_size, VM_ALLOC_BITMAP);
 		assert(bitmap_data[i].pixels);
+		if (bitmap_data[i].format < BSP_BITMAP_DATA_FORMAT_COUNT) {
+			s_mapMemStats.bitmap_bytes[bitmap_data[i].format] += bitmap_data[i].actual_size;
+			s_mapMemStats.bitmap_count[bitmap_data[i].format]++;
+		}
 		long long pos = FS_SeekStream(&g_load.f, FS_SEEK_BEGIN, bitmap_data[i].pixel_data_offset);
 		assert(pos == bitmap_data[i].pixel_data_offset);
 		(void)pos;
@@ -1016,8 +1147,9 @@ static bool CL_LoadMap_Model(TagId id) {
 			assert(part->tri_buffer_type == BSP_MODEL_TRI_BUFFER_TYPE_TRIANGLE_LIST ||
 				part->tri_buffer_type == BSP_MODEL_TRI_BUFFER_TYPE_TRIANGLE_STRIP);
 			BSPModelDecompressedVertex* decompressed_verts = (BSPModelDecompressedVertex*)
-				VM_Alloc(part->vertex_count * sizeof(*decompressed_verts), VM_ALLOC_MODEL);
+				CL_Map_Alloc(part->vertex_count * sizeof(*decompressed_verts), VM_ALLOC_MODEL);
 			assert(decompressed_verts);
+			s_mapMemStats.model_vertex_bytes += part->vertex_count * sizeof(*decompressed_verts);
             BSPModelCompressedVertex* compressed_verts = (BSPModelCompressedVertex*)part->vertex_offset;
 			assert(part->vertex_type == BSP_VERTEX_TYPE_COMPRESSED_MODEL);
 			//uint16_t* tri_indices = (uint16_t*)part->tri_offset;
@@ -1048,6 +1180,26 @@ static bool CL_LoadMap_Object(TagId id) {
 	return CL_LoadMap_Model(object->model.id);
 }
 
+const char* CL_BitmapDataFormatName(BSPBitmapDataFormat format) {
+	switch (format) {
+	case BSP_BITMAP_DATA_FORMAT_A8:       return "A8";
+	case BSP_BITMAP_DATA_FORMAT_Y8:       return "Y8";
+	case BSP_BITMAP_DATA_FORMAT_AY8:      return "AY8";
+	case BSP_BITMAP_DATA_FORMAT_A8Y8:     return "A8Y8";
+	case BSP_BITMAP_DATA_FORMAT_R5G6B5:   return "R5G6B5";
+	case BSP_BITMAP_DATA_FORMAT_A1R5G5B5: return "A1R5G5B5";
+	case BSP_BITMAP_DATA_FORMAT_A4R4G4B4: return "A4R4G4B4";
+	case BSP_BITMAP_DATA_FORMAT_X8R8G8B8: return "X8R8G8B8";
+	case BSP_BITMAP_DATA_FORMAT_A8R8G8B8: return "A8R8G8B8";
+	case BSP_BITMAP_DATA_FORMAT_DXT1:     return "DXT1";
+	case BSP_BITMAP_DATA_FORMAT_DXT3:     return "DXT3";
+	case BSP_BITMAP_DATA_FORMAT_DXT5:     return "DXT5";
+	case BSP_BITMAP_DATA_FORMAT_P8_BUMP:  return "P8_BUMP";
+	case BSP_BITMAP_DATA_FORMAT_BC7:      return "BC7";
+	default:                              return NULL;
+	}
+}
+
 size_t CL_BitmapDataFormatBPP(BSPBitmapDataFormat format) {
 	switch (format) {
 	case BSP_BITMAP_DATA_FORMAT_A8R8G8B8:
@@ -3,6 +3,8 @@
 #include "acommon/acommon.h"
 #include "acommon/a_math.h"
 
+#include "vm_vmem.h"
+
 #define TAGS_BASE_ADDR_XBOX    0x803A6000
 #define TAGS_BASE_ADDR_GEARBOX 0x40440000
 
@@ -419,6 +421,66 @@ A_PACK(struct BSPCollSurf {
 typedef struct BSPCollSurf BSPCollSurf;
 A_STATIC_ASSERT(sizeof(BSPCollSurf) == 12);
 
+typedef enum BSPCollSurfFlags {
+	BSP_COLL_SURF_FLAG_TWO_SIDED = 0x01,
+	BSP_COLL_SURF_FLAG_INVISIBLE = 0x02,
+	BSP_COLL_SURF_FLAG_CLIMBABLE = 0x04,
+	BSP_COLL_SURF_FLAG_BREAKABLE = 0x08,
+} BSPCollSurfFlags;
+
+// Indices with the high bit set refer to something other than the array
+// they'd usually index (e.g. a 3D node's child is a leaf instead of another
+// node), and BSP_COLL_NONE to nothing at all.
+#define BSP_COLL_NONE     0xFFFFFFFFu
+#define BSP_COLL_FLAG_BIT 0x80000000u
+#define BSP_COLL_INDEX(i) ((i) & ~BSP_COLL_FLAG_BIT)
+
+// Children with BSP_COLL_FLAG_BIT set are leaves, and BSP_COLL_NONE is
+// solid.
+A_PACK(struct BSPColl3dNode {
+	uint32_t plane;
+	uint32_t back_child;
+	uint32_t front_child;
+});
+typedef struct BSPColl3dNode BSPColl3dNode;
+A_STATIC_ASSERT(sizeof(BSPColl3dNode) == 12);
+
+// Points p with dot(normal, p) >= d are in front.
+A_PACK(struct BSPCollPlane {
+	avec3f_t normal;
+	float    d;
+});
+typedef struct BSPCollPlane BSPCollPlane;
+A_STATIC_ASSERT(sizeof(BSPCollPlane) == 16);
+
+A_PACK(struct BSPCollLeaf {
+	uint16_t flags;
+	uint16_t bsp2d_ref_count;
+	uint32_t first_bsp2d_ref;
+});
+typedef struct BSPCollLeaf BSPCollLeaf;
+A_STATIC_ASSERT(sizeof(BSPCollLeaf) == 8);
+
+// A 2D BSP of the surfaces on one of a leaf's planes. `bsp2d_node` with
+// BSP_COLL_FLAG_BIT set is a surface, for a plane with only one.
+A_PACK(struct BSPColl2dRef {
+	uint32_t plane;
+	uint32_t bsp2d_node;
+});
+typedef struct BSPColl2dRef BSPColl2dRef;
+A_STATIC_ASSERT(sizeof(BSPColl2dRef) == 8);
+
+// Children with BSP_COLL_FLAG_BIT set are surfaces.
+A_PACK(struct BSPColl2dNode {
+	float    i;
+	float    j;
+	float    d;
+	uint32_t left_child;
+	uint32_t right_child;
+});
+typedef struct BSPColl2dNode BSPColl2dNode;
+A_STATIC_ASSERT(sizeof(BSPColl2dNode) == 20);
+
 A_PACK(struct BSPCollEdge {
 	uint32_t start_vert;
 	uint32_t end_vert;
@@ -437,6 +499,19 @@ A_PACK(struct BSPCollVertex {
 typedef struct BSPCollVertex BSPCollVertex;
 A_STATIC_ASSERT(sizeof(BSPCollVertex) == 16);
 
+A_PACK(struct BSPCollisionBSP {
+	TagReflexive bsp3d_nodes;
+	TagReflexive planes;
+	TagReflexive leaves;
+	TagReflexive bsp2d_refs;
+	TagReflexive bsp2d_nodes;
+	TagReflexive surfs;
+	TagReflexive edges;
+	TagReflexive vertices;
+});
+typedef struct BSPCollisionBSP BSPCollisionBSP;
+A_STATIC_ASSERT(sizeof(BSPCollisionBSP) == 96);
+
 typedef enum BSPMaterialType {
 	BSP_MATERIAL_DIRT,
 	BSP_MATERIAL_SAND,
@@ -1547,16 +1622,30 @@ A_PACK(struct BSPScenarioSceneryPalette {
 typedef struct BSPScenarioSceneryPalette BSPScenarioSceneryPalette;
 A_STATIC_ASSERT(sizeof(BSPScenarioSceneryPalette) == 48);
 
+// Reserves the fixed addresses tag data is loaded at, for the life of the
+// process. Call it first thing, before anything else can map over them.
+A_EXTERN_C void                       CL_ReserveTagSpace(void);
 A_EXTERN_C void                       CL_InitMap(void);
 A_EXTERN_C bool                       CL_LoadMap(const char* map_name);
 A_EXTERN_C bool                       CL_UnloadMap(void);
 A_EXTERN_C void                       CL_ShutdownMap(void);
+
+// Allocations that live until the map is unloaded. They're never freed
+// individually.
+A_EXTERN_C A_NO_DISCARD void*         CL_Map_Alloc (size_t n, VmAllocType type);
+A_EXTERN_C A_NO_DISCARD void*         CL_Map_Zalloc(size_t n, VmAllocType type);
+// The loaded map's name, NULL if there isn't one.
+A_EXTERN_C A_NO_DISCARD const char*   CL_Map_Name(void);
 							          
 A_EXTERN_C Tag*                       CL_Map_Tag(TagId id);
 A_EXTERN_C BSPSurf*                   CL_Map_Surfs(void);
 A_EXTERN_C uint32_t       	          CL_Map_SurfCount(void);
 A_EXTERN_C BSPRenderedVertex*         CL_Map_RenderedVertices(void);
 A_EXTERN_C BSPLightmapVertex*         CL_Map_LightmapVertices(void);
+// NULL if there's no map or it has no collision.
+A_EXTERN_C BSPCollisionBSP*           CL_Map_CollisionBSP(void);
+A_EXTERN_C BSPCollisionMaterial*      CL_Map_CollisionMaterial(uint16_t i);
+A_EXTERN_C uint32_t                   CL_Map_CollisionMaterialCount(void);
 A_EXTERN_C BSPCollSurf*               CL_Map_CollSurfs(void);
 A_EXTERN_C uint32_t       	          CL_Map_CollSurfCount(void);
 A_EXTERN_C BSPCollEdge*               CL_Map_CollEdges(void);
@@ -1572,3 +1661,20 @@ A_EXTERN_C uint32_t                   CL_Map_ScenarioSceneryPaletteCount(void);
 
 A_EXTERN_C bool                       CL_BitmapDataFormatIsCompressed(BSPBitmapDataFormat format);
 A_EXTERN_C size_t                     CL_BitmapDataFormatBPP(BSPBitmapDataFormat format);
+// NULL for values that aren't formats.
+A_EXTERN_C const char*                CL_BitmapDataFormatName(BSPBitmapDataFormat format);
+
+// What the loaded map is using, for meminfo. Vertex bytes are for the
+// decompressed copies, since the compressed ones are part of the tag data.
+typedef struct MapMemStats {
+	const char* map_name; // NULL if no map is loaded
+	size_t      tag_data_bytes;
+	size_t      bsp_vertex_bytes;
+	size_t      model_vertex_bytes;
+	size_t      bitmap_bytes[BSP_BITMAP_DATA_FORMAT_COUNT];
+	uint32_t    bitmap_count[BSP_BITMAP_DATA_FORMAT_COUNT];
+	size_t      arena_used;
+	size_t      arena_reserved;
+} MapMemStats;
+
+A_EXTERN_C void                       CL_Map_MemStats(A_OUT MapMemStats* stats);
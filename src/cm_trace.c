@@ -0,0 +1,1041 @@
+#include "cm_trace.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include "acommon/a_cpu.h"
+#include "acommon/a_string.h"
+
+#include "cg_cgame.h"
+#include "cl_client.h"
+#include "cl_map.h"
+#include "cmd_commands.h"
+#include "com_print.h"
+#include "vm_vmem.h"
+
+#if A_CPU_CAN_BUILD_SSE2
+#include <emmintrin.h>
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_NEON
+#include <arm_neon.h>
+#endif // A_CPU_CAN_BUILD_NEON
+
+// Nothing in a real map comes close. It's only there so bad data can't walk
+// the edges forever.
+#define CM_MAX_SURF_VERTS       64
+#define CM_MAX_2D_DEPTH         256
+// How far outside a surface's edges a hit can land and still count, so
+// there aren't cracks between neighbours.
+#define CM_EDGE_EPSILON         0.001f
+// How close to a node's plane counts as on both sides of it.
+#define CM_PLANE_EPSILON        0.001f
+// How far short of what they hit traces stop, so the end of one isn't
+// already touching it when the next one starts.
+#define CM_SURFACE_CLIP_EPSILON 0.001f
+
+#define CM_TRACE_DEFAULT_DISTANCE 100.0f
+#define CM_BENCH_DEFAULT_COUNT    1000000
+#define CM_BENCH_STARTS           4096
+#define CM_BENCH_RADIUS           0.2f
+
+// A 3D node with its plane inline. Children that are >= 0 are nodes,
+// CM_CHILD_SOLID is solid, and anything else is leaf CM_CHILD_LEAF(child).
+#define CM_CHILD_SOLID   (-1)
+#define CM_CHILD_LEAF(c) (-2 - (c))
+
+typedef struct CMNode {
+	avec3f_t normal;
+	float    d;
+	int32_t  children[2]; // front, back
+} CMNode;
+
+// A run of leaf_surfs: every surface on the leaf's boundary.
+typedef struct CMLeaf {
+	uint32_t first_surf;
+	uint32_t surf_count;
+} CMLeaf;
+
+// Four of a surface's edges' planes, facing into it. The last quad of each
+// surface is padded out with planes everything's in front of.
+typedef struct CMEdgeQuad {
+	float nx[4];
+	float ny[4];
+	float nz[4];
+	float d[4];
+} CMEdgeQuad;
+
+// Traces don't care which way a surface faces: they're stopped by whichever
+// side they come at it from, which in a map they start inside of is always
+// the open side.
+typedef struct CMSurf {
+	avec3f_t normal;
+	float    d;
+	uint32_t first_quad;
+	uint32_t first_vert;
+	uint16_t quad_count; // 0 for surfaces too degenerate to hit
+	uint16_t vert_count;
+	uint16_t material;   // 0xFFFF if none
+	uint8_t  flags;      // BSPCollSurfFlags
+} CMSurf;
+
+typedef bool (*CMInPolygonFn)(const CMEdgeQuad* quads, uint32_t count,
+                              avec3f_t p);
+
+static struct {
+	bool          loaded;
+	CMNode*       nodes;
+	uint32_t      node_count;
+	CMLeaf*       leaves;
+	uint32_t      leaf_count;
+	uint32_t*     leaf_surfs;
+	uint32_t      leaf_surf_count;
+	CMSurf*       surfs;
+	uint32_t      surf_count;
+	CMEdgeQuad*   quads;
+	uint32_t      quad_count;
+	avec3f_t*     verts;
+	uint32_t      vert_count;
+	avec3f_t      mins, maxs;
+	size_t        bytes;
+	CMInPolygonFn in_polygon;
+	const char*   in_polygon_name;
+} s_cm;
+
+static void CM_Trace_f   (void);
+static void CM_Contents_f(void);
+static void CM_Bench_f   (void);
+
+// ============================================================================
+// Small vector helpers, so the hot loops don't call out to a_math.
+static avec3f_t CM_Vec3(float x, float y, float z) {
+	avec3f_t v;
+	v.x = x;
+	v.y = y;
+	v.z = z;
+	return v;
+}
+
+static float CM_Dot(avec3f_t a, avec3f_t b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static avec3f_t CM_Sub(avec3f_t a, avec3f_t b) {
+	return CM_Vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+// a + b * s
+static avec3f_t CM_Madd(avec3f_t a, avec3f_t b, float s) {
+	return CM_Vec3(a.x + b.x * s, a.y + b.y * s, a.z + b.z * s);
+}
+
+static avec3f_t CM_Cross(avec3f_t a, avec3f_t b) {
+	return CM_Vec3(a.y * b.z - a.z * b.y,
+	               a.z * b.x - a.x * b.z,
+	               a.x * b.y - a.y * b.x);
+}
+
+// The zero vector stays zero.
+static avec3f_t CM_Normalize(avec3f_t v) {
+	float len = sqrtf(CM_Dot(v, v));
+	if (len < 1e-12f)
+		return CM_Vec3(0.0f, 0.0f, 0.0f);
+	return CM_Vec3(v.x / len, v.y / len, v.z / len);
+}
+
+// The client's space is the map's with y and z swapped, which is its own
+// inverse.
+static avec3f_t CM_SwapYZ(avec3f_t v) {
+	return CM_Vec3(v.x, v.z, v.y);
+}
+
+static avec3f_t CM_FromPoint(apoint3f_t p) {
+	return CM_Vec3(p.x, p.z, p.y);
+}
+
+static apoint3f_t CM_ToPoint(avec3f_t v) {
+	apoint3f_t p;
+	p.x = v.x;
+	p.y = v.z;
+	p.z = v.y;
+	return p;
+}
+// ============================================================================
+
+// ============================================================================
+// Whether `p`, on a surface's plane, is inside all of its edges.
+static bool CM_InPolygonScalar(const CMEdgeQuad* q, uint32_t count,
+                               avec3f_t p
+) {
+	for (uint32_t i = 0; i < count; i++) {
+		for (int j = 0; j < 4; j++) {
+			float d = q[i].nx[j] * p.x + q[i].ny[j] * p.y +
+			          q[i].nz[j] * p.z - q[i].d[j];
+			if (d < -CM_EDGE_EPSILON)
+				return false;
+		}
+	}
+	return true;
+}
+
+#if A_CPU_CAN_BUILD_SSE2
+A_TARGET_FEATURE("sse2")
+static bool CM_InPolygonSse2(const CMEdgeQuad* q, uint32_t count,
+                             avec3f_t p
+) {
+	__m128 px  = _mm_set1_ps(p.x);
+	__m128 py  = _mm_set1_ps(p.y);
+	__m128 pz  = _mm_set1_ps(p.z);
+	__m128 eps = _mm_set1_ps(-CM_EDGE_EPSILON);
+	for (uint32_t i = 0; i < count; i++) {
+		__m128 d = _mm_mul_ps(_mm_loadu_ps(q[i].nx), px);
+		d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(q[i].ny), py));
+		d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(q[i].nz), pz));
+		d = _mm_sub_ps(d, _mm_loadu_ps(q[i].d));
+		if (_mm_movemask_ps(_mm_cmplt_ps(d, eps)) != 0)
+			return false;
+	}
+	return true;
+}
+#endif // A_CPU_CAN_BUILD_SSE2
+
+#if A_CPU_CAN_BUILD_NEON
+static bool CM_InPolygonNeon(const CMEdgeQuad* q, uint32_t count,
+                             avec3f_t p
+) {
+	float32x4_t px  = vdupq_n_f32(p.x);
+	float32x4_t py  = vdupq_n_f32(p.y);
+	float32x4_t pz  = vdupq_n_f32(p.z);
+	float32x4_t eps = vdupq_n_f32(-CM_EDGE_EPSILON);
+	for (uint32_t i = 0; i < count; i++) {
+		float32x4_t d = vmulq_f32(vld1q_f32(q[i].nx), px);
+		d = vaddq_f32(d, vmulq_f32(vld1q_f32(q[i].ny), py));
+		d = vaddq_f32(d, vmulq_f32(vld1q_f32(q[i].nz), pz));
+		d = vsubq_f32(d, vld1q_f32(q[i].d));
+		if (vmaxvq_u32(vcltq_f32(d, eps)) != 0)
+			return false;
+	}
+	return true;
+}
+#endif // A_CPU_CAN_BUILD_NEON
+// ============================================================================
+
+void CM_Init(void) {
+	A_memset(&s_cm, 0, sizeof(s_cm));
+	s_cm.in_polygon      = CM_InPolygonScalar;
+	s_cm.in_polygon_name = "scalar";
+
+	const ACpuFeatures* cpu = A_CpuFeatures();
+#if A_CPU_CAN_BUILD_SSE2
+	if (cpu->sse2) {
+		s_cm.in_polygon      = CM_InPolygonSse2;
+		s_cm.in_polygon_name = "sse2";
+	}
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_NEON
+	if (cpu->neon) {
+		s_cm.in_polygon      = CM_InPolygonNeon;
+		s_cm.in_polygon_name = "neon";
+	}
+#endif // A_CPU_CAN_BUILD_NEON
+	A_UNUSED(cpu);
+
+	Cmd_AddCommand("cm_trace",    CM_Trace_f);
+	Cmd_AddCommand("cm_contents", CM_Contents_f);
+	Cmd_AddCommand("cm_bench",    CM_Bench_f);
+}
+
+void CM_Shutdown(void) {
+	Cmd_RemoveCommand("cm_trace");
+	Cmd_RemoveCommand("cm_contents");
+	Cmd_RemoveCommand("cm_bench");
+	CM_UnloadMap();
+}
+
+// ============================================================================
+// Loading
+typedef struct CMLoad {
+	const BSPColl3dNode* nodes;
+	uint32_t             node_count;
+	const BSPCollPlane*  planes;
+	uint32_t             plane_count;
+	const BSPCollLeaf*   leaves;
+	uint32_t             leaf_count;
+	const BSPColl2dRef*  refs;
+	uint32_t             ref_count;
+	const BSPColl2dNode* nodes2d;
+	uint32_t             node2d_count;
+	const BSPCollSurf*   surfs;
+	uint32_t             surf_count;
+	const BSPCollEdge*   edges;
+	uint32_t             edge_count;
+	const BSPCollVertex* verts;
+	uint32_t             vert_count;
+	uint32_t*            stamps; // per surface, the last leaf + 1 it was in
+	size_t               max_verts;
+	size_t               max_quads;
+} CMLoad;
+
+static void* CM_Alloc(size_t n) {
+	s_cm.bytes += n;
+	return CL_Map_Alloc(n, VM_ALLOC_COLLISION);
+}
+
+// What's been built so far is in the map's arena, so unloading is all
+// there is to clean up.
+static bool CM_LoadOutOfMemory(const char* what) {
+	Com_Println(CON_DEST_CLIENT, "CM_LoadMap: not enough memory for %s.",
+	            what);
+	CM_UnloadMap();
+	return false;
+}
+
+static bool CM_LoadChild(const CMLoad* ld, uint32_t c, A_OUT int32_t* child) {
+	if (c == BSP_COLL_NONE) {
+		*child = CM_CHILD_SOLID;
+		return true;
+	}
+	if (c & BSP_COLL_FLAG_BIT) {
+		*child = CM_CHILD_LEAF((int32_t)BSP_COLL_INDEX(c));
+		return BSP_COLL_INDEX(c) < ld->leaf_count;
+	}
+	*child = (int32_t)c;
+	return c < ld->node_count;
+}
+
+// Walks the edges around surface `s`, the way the tools wrote them: each
+// edge is either the surface's left or its right, which says which way
+// round to go next. Returns how many vertices there are, or 0 if the loop
+// doesn't close.
+static uint32_t CM_SurfVerts(const CMLoad* ld, uint32_t s,
+                             A_OUT uint32_t* verts
+) {
+	uint32_t first = ld->surfs[s].first_edge;
+	uint32_t e     = first;
+	uint32_t n     = 0;
+	do {
+		if (e >= ld->edge_count || n == CM_MAX_SURF_VERTS)
+			return 0;
+
+		const BSPCollEdge* edge = &ld->edges[e];
+		uint32_t v;
+		if (edge->left_surf == s) {
+			v = edge->start_vert;
+			e = edge->forward_edge;
+		} else {
+			v = edge->end_vert;
+			e = edge->reverse_edge;
+		}
+		if (v >= ld->vert_count)
+			return 0;
+		verts[n++] = v;
+	} while (e != first);
+	return n;
+}
+
+static void CM_LoadSurf(const CMLoad* ld, uint32_t s) {
+	const BSPCollSurf* in  = &ld->surfs[s];
+	CMSurf*            out = &s_cm.surfs[s];
+
+	uint32_t plane = BSP_COLL_INDEX(in->plane);
+	if (plane < ld->plane_count) {
+		out->normal = ld->planes[plane].normal;
+		out->d      = ld->planes[plane].d;
+	}
+	out->flags    = in->flags;
+	out->material = in->material < CL_Map_CollisionMaterialCount()
+		? in->material : 0xFFFF;
+
+	uint32_t idx[CM_MAX_SURF_VERTS];
+	uint32_t n = CM_SurfVerts(ld, s, idx);
+	uint32_t quads = (n + 3) / 4;
+	out->first_vert = s_cm.vert_count;
+	out->first_quad = s_cm.quad_count;
+	if (n < 3 || plane >= ld->plane_count ||
+		s_cm.vert_count + n > ld->max_verts ||
+		s_cm.quad_count + quads > ld->max_quads)
+		return;
+
+	avec3f_t* v = &s_cm.verts[s_cm.vert_count];
+	for (uint32_t i = 0; i < n; i++)
+		v[i] = ld->verts[idx[i]].point;
+
+	// Newell's normal, whichever way the edges happen to wind, so the edge
+	// planes face in.
+	avec3f_t winding = CM_Vec3(0.0f, 0.0f, 0.0f);
+	for (uint32_t i = 0; i < n; i++) {
+		avec3f_t a = v[i];
+		avec3f_t b = v[(i + 1) % n];
+		winding.x += (a.y - b.y) * (a.z + b.z);
+		winding.y += (a.z - b.z) * (a.x + b.x);
+		winding.z += (a.x - b.x) * (a.y + b.y);
+	}
+	winding = CM_Normalize(winding);
+	if (CM_Dot(winding, winding) == 0.0f)
+		return;
+
+	CMEdgeQuad* q = &s_cm.quads[s_cm.quad_count];
+	for (uint32_t i = 0; i < quads * 4; i++) {
+		avec3f_t m = CM_Vec3(0.0f, 0.0f, 0.0f);
+		float    d = -1.0f;
+		if (i < n) {
+			m = CM_Normalize(CM_Cross(winding, CM_Sub(v[(i + 1) % n], v[i])));
+			d = CM_Dot(m, v[i]);
+			// A repeated vertex gives an edge with no direction, which
+			// mustn't rule anything out.
+			if (CM_Dot(m, m) == 0.0f)
+				d = -1.0f;
+		}
+		q[i / 4].nx[i % 4] = m.x;
+		q[i / 4].ny[i % 4] = m.y;
+		q[i / 4].nz[i % 4] = m.z;
+		q[i / 4].d [i % 4] = d;
+	}
+
+	out->vert_count  = (uint16_t)n;
+	out->quad_count  = (uint16_t)quads;
+	s_cm.vert_count += n;
+	s_cm.quad_count += quads;
+}
+
+// Adds the surfaces under a leaf's 2D BSP child `c` that it doesn't have
+// yet, or only counts them if `out` is NULL.
+static void CM_LoadLeafSurfs(const CMLoad* ld, uint32_t c, uint32_t stamp,
+                             int depth, A_INOUT uint32_t* count,
+                             A_OUT uint32_t* out
+) {
+	if (c == BSP_COLL_NONE || depth > CM_MAX_2D_DEPTH)
+		return;
+
+	if (c & BSP_COLL_FLAG_BIT) {
+		uint32_t s = BSP_COLL_INDEX(c);
+		if (s >= ld->surf_count || ld->stamps[s] == stamp)
+			return;
+		ld->stamps[s] = stamp;
+		if (out)
+			out[*count] = s;
+		(*count)++;
+		return;
+	}
+
+	if (c >= ld->node2d_count)
+		return;
+	const BSPColl2dNode* node = &ld->nodes2d[c];
+	CM_LoadLeafSurfs(ld, node->left_child,  stamp, depth + 1, count, out);
+	CM_LoadLeafSurfs(ld, node->right_child, stamp, depth + 1, count, out);
+}
+
+static uint32_t CM_LoadLeaf(const CMLoad* ld, uint32_t l, uint32_t stamp,
+                            A_OUT uint32_t* out
+) {
+	const BSPCollLeaf* leaf = &ld->leaves[l];
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < leaf->bsp2d_ref_count; i++) {
+		uint32_t r = leaf->first_bsp2d_ref + i;
+		if (r >= ld->ref_count)
+			break;
+		CM_LoadLeafSurfs(ld, ld->refs[r].bsp2d_node, stamp, 0, &count, out);
+	}
+	return count;
+}
+
+bool CM_LoadMap(void) {
+	CM_UnloadMap();
+
+	const BSPCollisionBSP* coll = CL_Map_CollisionBSP();
+	if (coll == NULL || coll->bsp3d_nodes.count == 0) {
+		Com_Println(CON_DEST_CLIENT, "CM_LoadMap: map has no collision BSP.");
+		return false;
+	}
+
+	CMLoad ld;
+	ld.nodes        = (const BSPColl3dNode*)coll->bsp3d_nodes.pointer;
+	ld.node_count   = coll->bsp3d_nodes.count;
+	ld.planes       = (const BSPCollPlane*)coll->planes.pointer;
+	ld.plane_count  = coll->planes.count;
+	ld.leaves       = (const BSPCollLeaf*)coll->leaves.pointer;
+	ld.leaf_count   = coll->leaves.count;
+	ld.refs         = (const BSPColl2dRef*)coll->bsp2d_refs.pointer;
+	ld.ref_count    = coll->bsp2d_refs.count;
+	ld.nodes2d      = (const BSPColl2dNode*)coll->bsp2d_nodes.pointer;
+	ld.node2d_count = coll->bsp2d_nodes.count;
+	ld.surfs        = (const BSPCollSurf*)coll->surfs.pointer;
+	ld.surf_count   = coll->surfs.count;
+	ld.edges        = (const BSPCollEdge*)coll->edges.pointer;
+	ld.edge_count   = coll->edges.count;
+	ld.verts        = (const BSPCollVertex*)coll->vertices.pointer;
+	ld.vert_count   = coll->vertices.count;
+
+	s_cm.node_count = ld.node_count;
+	s_cm.nodes      = (CMNode*)CM_Alloc(ld.node_count * sizeof(*s_cm.nodes));
+	if (s_cm.nodes == NULL)
+		return CM_LoadOutOfMemory("3D nodes");
+	for (uint32_t i = 0; i < ld.node_count; i++) {
+		const BSPColl3dNode* in  = &ld.nodes[i];
+		CMNode*              out = &s_cm.nodes[i];
+		uint32_t plane = BSP_COLL_INDEX(in->plane);
+		if (plane >= ld.plane_count ||
+			!CM_LoadChild(&ld, in->front_child, &out->children[0]) ||
+			!CM_LoadChild(&ld, in->back_child,  &out->children[1])
+		) {
+			Com_Println(CON_DEST_CLIENT,
+			            "CM_LoadMap: 3D node %u is out of range.", i);
+			CM_UnloadMap();
+			return false;
+		}
+		out->normal = ld.planes[plane].normal;
+		out->d      = ld.planes[plane].d;
+	}
+
+	// Every vertex is shared by the two surfaces either side of its edge,
+	// so there can't be more than twice as many as there are edges, and no
+	// surface wastes more than three lanes of its last quad.
+	s_cm.surf_count = ld.surf_count;
+	s_cm.surfs = (CMSurf*)CM_Alloc(ld.surf_count * sizeof(*s_cm.surfs));
+	if (s_cm.surfs == NULL)
+		return CM_LoadOutOfMemory("surfaces");
+	A_memset(s_cm.surfs, 0, ld.surf_count * sizeof(*s_cm.surfs));
+	ld.max_verts = (size_t)ld.edge_count * 2;
+	ld.max_quads = ld.max_verts / 4 + ld.surf_count;
+	s_cm.verts = (avec3f_t*)CM_Alloc(ld.max_verts * sizeof(*s_cm.verts));
+	s_cm.quads = (CMEdgeQuad*)CM_Alloc(ld.max_quads * sizeof(*s_cm.quads));
+	if (s_cm.verts == NULL || s_cm.quads == NULL)
+		return CM_LoadOutOfMemory("surface edges");
+	for (uint32_t i = 0; i < ld.surf_count; i++)
+		CM_LoadSurf(&ld, i);
+
+	s_cm.mins = CM_Vec3( 1e30f,  1e30f,  1e30f);
+	s_cm.maxs = CM_Vec3(-1e30f, -1e30f, -1e30f);
+	for (uint32_t i = 0; i < s_cm.vert_count; i++) {
+		s_cm.mins.x = A_MIN(s_cm.mins.x, s_cm.verts[i].x);
+		s_cm.mins.y = A_MIN(s_cm.mins.y, s_cm.verts[i].y);
+		s_cm.mins.z = A_MIN(s_cm.mins.z, s_cm.verts[i].z);
+		s_cm.maxs.x = A_MAX(s_cm.maxs.x, s_cm.verts[i].x);
+		s_cm.maxs.y = A_MAX(s_cm.maxs.y, s_cm.verts[i].y);
+		s_cm.maxs.z = A_MAX(s_cm.maxs.z, s_cm.verts[i].z);
+	}
+
+	// Counted first, so the lists can go in one allocation.
+	VmScratchMark mark = VM_ScratchMark();
+	ld.stamps = (uint32_t*)VM_ScratchZalloc(
+		(ld.surf_count + 1) * sizeof(*ld.stamps));
+	s_cm.leaf_count = ld.leaf_count;
+	s_cm.leaves = (CMLeaf*)CM_Alloc(ld.leaf_count * sizeof(*s_cm.leaves));
+	if (ld.stamps == NULL || s_cm.leaves == NULL) {
+		VM_ScratchRelease(mark);
+		return CM_LoadOutOfMemory("leaves");
+	}
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < ld.leaf_count; i++) {
+		s_cm.leaves[i].first_surf = total;
+		s_cm.leaves[i].surf_count = CM_LoadLeaf(&ld, i, i + 1, NULL);
+		total += s_cm.leaves[i].surf_count;
+	}
+
+	A_memset(ld.stamps, 0, (ld.surf_count + 1) * sizeof(*ld.stamps));
+	s_cm.leaf_surf_count = total;
+	s_cm.leaf_surfs = (uint32_t*)CM_Alloc(
+		(total + 1) * sizeof(*s_cm.leaf_surfs));
+	if (s_cm.leaf_surfs == NULL) {
+		VM_ScratchRelease(mark);
+		return CM_LoadOutOfMemory("leaf surfaces");
+	}
+	for (uint32_t i = 0; i < ld.leaf_count; i++) {
+		CM_LoadLeaf(&ld, i, i + 1,
+		            &s_cm.leaf_surfs[s_cm.leaves[i].first_surf]);
+	}
+	VM_ScratchRelease(mark);
+
+	s_cm.loaded = true;
+	Com_DPrintln(CON_DEST_CLIENT,
+	             "CM_LoadMap: %u nodes, %u leaves, %u surfaces, %u KiB.",
+	             s_cm.node_count, s_cm.leaf_count, s_cm.surf_count,
+	             (unsigned int)(s_cm.bytes / 1024));
+	return true;
+}
+
+void CM_UnloadMap(void) {
+	// It's all in the map's arena.
+	CMInPolygonFn in_polygon      = s_cm.in_polygon;
+	const char*   in_polygon_name = s_cm.in_polygon_name;
+	A_memset(&s_cm, 0, sizeof(s_cm));
+	s_cm.in_polygon      = in_polygon;
+	s_cm.in_polygon_name = in_polygon_name;
+}
+// ============================================================================
+
+// ============================================================================
+// Tracing
+typedef struct CMTraceWork {
+	avec3f_t      start; // in map space
+	avec3f_t      delta;
+	float         radius;
+	float         clip;  // CM_SURFACE_CLIP_EPSILON along the trace
+	CMInPolygonFn in_polygon;
+
+	float         t;     // of the nearest hit so far
+	float         fraction;
+	int32_t       surf;
+	avec3f_t      normal;
+} CMTraceWork;
+
+// `fraction` is `t` backed off from what was hit.
+static void CM_Hit(A_INOUT CMTraceWork* tw, float t, float fraction,
+                   uint32_t s, avec3f_t normal
+) {
+	tw->t        = t;
+	tw->fraction = fraction > 0.0f ? fraction : 0.0f;
+	tw->surf     = (int32_t)s;
+	tw->normal   = normal;
+}
+
+static void CM_TestSurfRay(A_INOUT CMTraceWork* tw, uint32_t s) {
+	const CMSurf* surf = &s_cm.surfs[s];
+	if (surf->quad_count == 0)
+		return;
+
+	// Facing whichever side the trace starts on.
+	float ds   = CM_Dot(surf->normal, tw->start) - surf->d;
+	float dd   = CM_Dot(surf->normal, tw->delta);
+	float side = ds >= 0.0f ? 1.0f : -1.0f;
+	ds *= side;
+	dd *= side;
+	if (dd >= 0.0f)
+		return;
+
+	float t = ds / -dd;
+	if (t >= tw->t)
+		return;
+
+	avec3f_t p = CM_Madd(tw->start, tw->delta, t);
+	if (!tw->in_polygon(&s_cm.quads[surf->first_quad], surf->quad_count, p))
+		return;
+
+	avec3f_t n = CM_Vec3(surf->normal.x * side, surf->normal.y * side,
+	                     surf->normal.z * side);
+	CM_Hit(tw, t, (ds - CM_SURFACE_CLIP_EPSILON) / -dd, s, n);
+}
+
+// The sphere against the cylinders around a surface's edges and the spheres
+// around its corners, for when it misses the face.
+static void CM_TestSurfEdges(A_INOUT CMTraceWork* tw, uint32_t s) {
+	const CMSurf*   surf = &s_cm.surfs[s];
+	const avec3f_t* v    = &s_cm.verts[surf->first_vert];
+	double r2 = (double)tw->radius * tw->radius;
+	double vv = CM_Dot(tw->delta, tw->delta);
+	for (uint32_t i = 0; i < surf->vert_count; i++) {
+		avec3f_t a = v[i];
+		avec3f_t e = CM_Sub(v[(i + 1) % surf->vert_count], a);
+		avec3f_t m = CM_Sub(tw->start, a);
+		double ee = CM_Dot(e, e);
+		double me = CM_Dot(m, e);
+		double ve = CM_Dot(tw->delta, e);
+		double mv = CM_Dot(m, tw->delta);
+		double mm = CM_Dot(m, m);
+
+		// Ray against the infinite cylinder, then whether the hit's
+		// between the ends. It's skipped if the trace runs parallel to the
+		// edge, which leaves it to the corners, or starts inside it, which
+		// lets it back out.
+		double qa = ee * vv - ve * ve;
+		double qb = ee * mv - ve * me;
+		double qc = ee * (mm - r2) - me * me;
+		if (qa > 1e-12 && qc > 0.0 && qb < 0.0) {
+			double disc = qb * qb - qa * qc;
+			if (disc >= 0.0) {
+				float t = (float)((-qb - sqrt(disc)) / qa);
+				float u = (float)(me + t * ve);
+				if (t >= 0.0f && t < tw->t && u >= 0.0f && u <= ee) {
+					avec3f_t c = CM_Madd(tw->start, tw->delta, t);
+					avec3f_t q = CM_Madd(a, e, u / (float)ee);
+					CM_Hit(tw, t, t - tw->clip, s,
+					       CM_Normalize(CM_Sub(c, q)));
+				}
+			}
+		}
+
+		// Ray against the sphere around the corner.
+		if (mm > r2 && mv < 0.0) {
+			double disc = mv * mv - vv * (mm - r2);
+			if (disc >= 0.0) {
+				float t = (float)((-mv - sqrt(disc)) / vv);
+				if (t >= 0.0f && t < tw->t) {
+					avec3f_t c = CM_Madd(tw->start, tw->delta, t);
+					CM_Hit(tw, t, t - tw->clip, s,
+					       CM_Normalize(CM_Sub(c, a)));
+				}
+			}
+		}
+	}
+}
+
+static void CM_TestSurfSphere(A_INOUT CMTraceWork* tw, uint32_t s) {
+	const CMSurf* surf = &s_cm.surfs[s];
+	if (surf->quad_count == 0)
+		return;
+
+	float r    = tw->radius;
+	float ds   = CM_Dot(surf->normal, tw->start) - surf->d;
+	float dd   = CM_Dot(surf->normal, tw->delta);
+	float side = ds >= 0.0f ? 1.0f : -1.0f;
+	ds *= side;
+	dd *= side;
+	// Moving away from it, or along it, never hits it. That includes
+	// starting out touching it, so something stuck can get back out.
+	if (dd >= 0.0f)
+		return;
+
+	// Nothing on the plane can be touched before the sphere reaches it.
+	float t = ds > r ? (ds - r) / -dd : 0.0f;
+	if (t > 1.0f || t >= tw->t)
+		return;
+
+	avec3f_t n = CM_Vec3(surf->normal.x * side, surf->normal.y * side,
+	                     surf->normal.z * side);
+	// Where the sphere touches the plane first, or the centre's projection
+	// onto it if the sphere's already through it.
+	avec3f_t p = ds > r
+		? CM_Madd(CM_Madd(tw->start, tw->delta, t), n, -r)
+		: CM_Madd(tw->start, n, -ds);
+	if (tw->in_polygon(&s_cm.quads[surf->first_quad], surf->quad_count, p)) {
+		CM_Hit(tw, t, (ds - r - CM_SURFACE_CLIP_EPSILON) / -dd, s, n);
+		return;
+	}
+
+	CM_TestSurfEdges(tw, s);
+}
+
+static void CM_TraceLeaf(A_INOUT CMTraceWork* tw, int32_t l) {
+	const CMLeaf*   leaf  = &s_cm.leaves[l];
+	const uint32_t* surfs = &s_cm.leaf_surfs[leaf->first_surf];
+	if (tw->radius > 0.0f) {
+		for (uint32_t i = 0; i < leaf->surf_count; i++)
+			CM_TestSurfSphere(tw, surfs[i]);
+	} else {
+		for (uint32_t i = 0; i < leaf->surf_count; i++)
+			CM_TestSurfRay(tw, surfs[i]);
+	}
+}
+
+// Visits every leaf the part of the trace from `t0` to `t1` comes within
+// the radius of, nearest first, and stops once what's left is further than
+// the nearest hit.
+static void CM_TraceNode(A_INOUT CMTraceWork* tw, int32_t child,
+                         float t0, float t1
+) {
+	while (child >= 0) {
+		const CMNode* node = &s_cm.nodes[child];
+		float ds = CM_Dot(node->normal, tw->start) - node->d;
+		float dd = CM_Dot(node->normal, tw->delta);
+		float d0 = ds + dd * t0;
+		float d1 = ds + dd * t1;
+		float r  = tw->radius + CM_PLANE_EPSILON;
+		if (d0 >= r && d1 >= r) {
+			child = node->children[0];
+			continue;
+		}
+		if (d0 < -r && d1 < -r) {
+			child = node->children[1];
+			continue;
+		}
+
+		// The parts within `r` of each side.
+		float f0 = t0, f1 = t1, b0 = t0, b1 = t1;
+		if (dd != 0.0f) {
+			float tf = (-r - ds) / dd;
+			float tb = ( r - ds) / dd;
+			if (dd > 0.0f) {
+				f0 = A_MAX(t0, tf);
+				b1 = A_MIN(t1, tb);
+			} else {
+				f1 = A_MIN(t1, tf);
+				b0 = A_MAX(t0, tb);
+			}
+		}
+
+		// Whichever side the start's on is where it starts.
+		int   near   = d0 >= 0.0f ? 0 : 1;
+		float near0  = near == 0 ? f0 : b0;
+		float near1  = near == 0 ? f1 : b1;
+		float far0   = near == 0 ? b0 : f0;
+		float far1   = near == 0 ? b1 : f1;
+		if (near0 <= near1 && near0 < tw->t)
+			CM_TraceNode(tw, node->children[near], near0, near1);
+		if (far0 > far1 || far0 >= tw->t)
+			return;
+
+		child = node->children[near ^ 1];
+		t0    = far0;
+		t1    = far1;
+	}
+
+	if (child != CM_CHILD_SOLID)
+		CM_TraceLeaf(tw, CM_CHILD_LEAF(child));
+}
+
+static CMContents CM_PointContentsMap(avec3f_t p) {
+	if (!s_cm.loaded)
+		return CM_CONTENTS_EMPTY;
+
+	int32_t child = 0;
+	while (child >= 0) {
+		const CMNode* node = &s_cm.nodes[child];
+		child = node->children[CM_Dot(node->normal, p) - node->d >= 0.0f
+		                       ? 0 : 1];
+	}
+	return child == CM_CHILD_SOLID ? CM_CONTENTS_SOLID : CM_CONTENTS_EMPTY;
+}
+
+A_NO_DISCARD CMContents CM_PointContents(apoint3f_t p) {
+	return CM_PointContentsMap(CM_FromPoint(p));
+}
+
+static void CM_TraceWith(A_OUT CMTrace* tr, apoint3f_t start,
+                         apoint3f_t end, float radius,
+                         CMInPolygonFn in_polygon
+) {
+	assert(tr);
+	assert(radius >= 0.0f);
+
+	CMTraceWork tw;
+	tw.start      = CM_FromPoint(start);
+	tw.delta      = CM_Sub(CM_FromPoint(end), tw.start);
+	tw.radius     = radius;
+	tw.in_polygon = in_polygon;
+	tw.t          = 1.0f;
+	tw.fraction   = 1.0f;
+	tw.surf       = -1;
+	tw.normal     = CM_Vec3(0.0f, 0.0f, 0.0f);
+
+	float len = sqrtf(CM_Dot(tw.delta, tw.delta));
+	tw.clip   = len > 0.0f ? CM_SURFACE_CLIP_EPSILON / len : 0.0f;
+
+	tr->startsolid = CM_PointContentsMap(tw.start) == CM_CONTENTS_SOLID;
+	if (s_cm.loaded && len > 0.0f)
+		CM_TraceNode(&tw, 0, 0.0f, 1.0f);
+
+	tr->fraction = tw.fraction;
+	tr->endpos   = CM_ToPoint(CM_Madd(tw.start, tw.delta, tw.fraction));
+	tr->normal   = CM_SwapYZ(tw.normal);
+	tr->surf     = tw.surf;
+	tr->material = tw.surf >= 0 && s_cm.surfs[tw.surf].material != 0xFFFF
+		? (int32_t)s_cm.surfs[tw.surf].material : -1;
+}
+
+void CM_TraceRay(A_OUT CMTrace* tr, apoint3f_t start, apoint3f_t end) {
+	CM_TraceWith(tr, start, end, 0.0f, s_cm.in_polygon);
+}
+
+void CM_TraceSphere(A_OUT CMTrace* tr, apoint3f_t start, apoint3f_t end,
+                    float radius
+) {
+	CM_TraceWith(tr, start, end, radius, s_cm.in_polygon);
+}
+// ============================================================================
+
+// ============================================================================
+// Commands
+static void CM_PrintTrace(const char* cmd, const CMTrace* tr, float dist) {
+	if (tr->surf < 0) {
+		Com_Println(CON_DEST_CLIENT, "%s: nothing within %.2f units%s.",
+		            cmd, dist, tr->startsolid ? " (started in solid)" : "");
+		return;
+	}
+
+	const char* shader = "none";
+	if (tr->material >= 0) {
+		const BSPCollisionMaterial* m =
+			CL_Map_CollisionMaterial((uint16_t)tr->material);
+		if (m->shader.id.index != 0xFFFF)
+			shader = (const char*)(uintptr_t)m->shader.path_pointer;
+	}
+
+	Com_Println(CON_DEST_CLIENT,
+	            "%s: hit surface %d after %.3f units%s, at (%.3f, %.3f, %.3f), "
+	            "normal (%.3f, %.3f, %.3f)",
+	            cmd, tr->surf, tr->fraction * dist,
+	            tr->startsolid ? " (started in solid)" : "",
+	            tr->endpos.x, tr->endpos.y, tr->endpos.z,
+	            tr->normal.x, tr->normal.y, tr->normal.z);
+	Com_Println(CON_DEST_CLIENT, "%s: material %d, shader %s.",
+	            cmd, tr->material, shader);
+}
+
+// From the camera of the client with the keyboard and mouse, along where
+// it's looking.
+static void CM_Trace_f(void) {
+	float radius = 0.0f;
+	float dist   = CM_TRACE_DEFAULT_DISTANCE;
+	if (Cmd_Argc() > 3 ||
+		(Cmd_Argc() > 1 && (!A_atof(Cmd_Argv(1), &radius) || radius < 0.0f)) ||
+		(Cmd_Argc() > 2 && (!A_atof(Cmd_Argv(2), &dist)   || dist <= 0.0f))
+	) {
+		Com_Println(CON_DEST_CLIENT, "USAGE: cm_trace [radius] [distance]");
+		return;
+	}
+
+	const cg_t* cg    = CG_GetLocalClientGlobals(CL_ClientWithKbmFocus());
+	apoint3f_t  start = cg->camera.pos;
+	avec3f_t    dir   = CM_Normalize(cg->camera.front);
+	apoint3f_t  end;
+	end.x = start.x + dir.x * dist;
+	end.y = start.y + dir.y * dist;
+	end.z = start.z + dir.z * dist;
+
+	CMTrace tr;
+	CM_TraceSphere(&tr, start, end, radius);
+	CM_PrintTrace("cm_trace", &tr, dist);
+}
+
+static void CM_Contents_f(void) {
+	apoint3f_t p;
+	if (Cmd_Argc() == 4) {
+		if (!A_atof(Cmd_Argv(1), &p.x) || !A_atof(Cmd_Argv(2), &p.y) ||
+			!A_atof(Cmd_Argv(3), &p.z)
+		) {
+			Com_Println(CON_DEST_CLIENT, "USAGE: cm_contents [x y z]");
+			return;
+		}
+	} else if (Cmd_Argc() == 1) {
+		p = CG_GetLocalClientGlobals(CL_ClientWithKbmFocus())->camera.pos;
+	} else {
+		Com_Println(CON_DEST_CLIENT, "USAGE: cm_contents [x y z]");
+		return;
+	}
+
+	Com_Println(CON_DEST_CLIENT, "cm_contents: (%.3f, %.3f, %.3f) is %s.",
+	            p.x, p.y, p.z,
+	            CM_PointContents(p) == CM_CONTENTS_SOLID ? "solid" : "empty");
+}
+
+static uint32_t s_cmBenchSeed;
+
+static float CM_BenchRandom(float lo, float hi) {
+	s_cmBenchSeed = s_cmBenchSeed * 1664525u + 1013904223u;
+	return lo + (hi - lo) * (float)(s_cmBenchSeed >> 8) / (float)(1u << 24);
+}
+
+static apoint3f_t CM_BenchPoint(void) {
+	return CM_ToPoint(CM_Vec3(CM_BenchRandom(s_cm.mins.x, s_cm.maxs.x),
+	                          CM_BenchRandom(s_cm.mins.y, s_cm.maxs.y),
+	                          CM_BenchRandom(s_cm.mins.z, s_cm.maxs.z)));
+}
+
+typedef struct CMBenchResult {
+	uint64_t ns;
+	uint32_t hits;
+	double   fractions; // summed, to compare implementations
+} CMBenchResult;
+
+// The same `count` traces each time: from points picked out of `starts`,
+// in random directions, up to a quarter of the way across the map.
+static void CM_BenchTraces(const apoint3f_t* starts, uint32_t start_count,
+                           int count, float radius, CMInPolygonFn in_polygon,
+                           A_OUT CMBenchResult* res
+) {
+	avec3f_t size   = CM_Sub(s_cm.maxs, s_cm.mins);
+	float    length = sqrtf(CM_Dot(size, size)) * 0.25f;
+
+	A_memset(res, 0, sizeof(*res));
+	s_cmBenchSeed = 0x12345678u;
+	uint64_t start_ns = Sys_Nanoseconds();
+	for (int i = 0; i < count; i++) {
+		apoint3f_t start = starts[s_cmBenchSeed % start_count];
+		avec3f_t   dir   = CM_Normalize(CM_Vec3(CM_BenchRandom(-1.0f, 1.0f),
+		                                        CM_BenchRandom(-1.0f, 1.0f),
+		                                        CM_BenchRandom(-1.0f, 1.0f)));
+		float      len   = CM_BenchRandom(0.0f, length);
+		apoint3f_t end;
+		end.x = start.x + dir.x * len;
+		end.y = start.y + dir.y * len;
+		end.z = start.z + dir.z * len;
+
+		CMTrace tr;
+		CM_TraceWith(&tr, start, end, radius, in_polygon);
+		if (tr.surf >= 0)
+			res->hits++;
+		res->fractions += tr.fraction;
+	}
+	res->ns = Sys_Nanoseconds() - start_ns;
+}
+
+static void CM_PrintBench(const char* name, int count,
+                          const CMBenchResult* res
+) {
+	double sec = (double)res->ns / 1e9;
+	Com_Println(CON_DEST_CLIENT,
+	            "cm_bench: %-14s %8.3f Mtraces/s (%.1f%% hit, %.3f s)",
+	            name, sec > 0.0 ? count / sec / 1e6 : 0.0,
+	            100.0 * res->hits / count, sec);
+}
+
+static void CM_Bench_f(void) {
+	int count = CM_BENCH_DEFAULT_COUNT;
+	if (Cmd_Argc() > 2 ||
+		(Cmd_Argc() == 2 && (!A_atoi(Cmd_Argv(1), &count) || count < 1))
+	) {
+		Com_Println(CON_DEST_CLIENT, "USAGE: cm_bench [count]");
+		return;
+	}
+
+	if (!s_cm.loaded) {
+		Com_Println(CON_DEST_CLIENT, "cm_bench: no map loaded.");
+		return;
+	}
+
+	Com_Println(CON_DEST_CLIENT,
+	            "cm_bench: %u nodes, %u leaves, %u surfaces, %u KiB.",
+	            s_cm.node_count, s_cm.leaf_count, s_cm.surf_count,
+	            (unsigned int)(s_cm.bytes / 1024));
+
+	// Traces start in the open, as they would in play.
+	VmScratchMark mark = VM_ScratchMark();
+	apoint3f_t* starts = (apoint3f_t*)VM_ScratchAlloc(
+		CM_BENCH_STARTS * sizeof(*starts));
+	uint32_t start_count = 0;
+	s_cmBenchSeed = 0x9E3779B9u;
+	for (int i = 0; i < CM_BENCH_STARTS * 64 &&
+	                start_count < CM_BENCH_STARTS; i++) {
+		apoint3f_t p = CM_BenchPoint();
+		if (CM_PointContents(p) == CM_CONTENTS_EMPTY)
+			starts[start_count++] = p;
+	}
+	if (start_count == 0) {
+		Com_Println(CON_DEST_CLIENT, "cm_bench: couldn't find open space.");
+		VM_ScratchRelease(mark);
+		return;
+	}
+
+	uint32_t solid = 0;
+	s_cmBenchSeed = 0x2545F491u;
+	uint64_t start_ns = Sys_Nanoseconds();
+	for (int i = 0; i < count; i++)
+		solid += CM_PointContents(CM_BenchPoint()) == CM_CONTENTS_SOLID;
+	double sec = (double)(Sys_Nanoseconds() - start_ns) / 1e9;
+	Com_Println(CON_DEST_CLIENT,
+	            "cm_bench: %-14s %8.3f Mpoints/s (%.1f%% solid, %.3f s)",
+	            "contents", sec > 0.0 ? count / sec / 1e6 : 0.0,
+	            100.0 * solid / count, sec);
+
+	CMBenchResult scalar, simd, sphere;
+	CM_BenchTraces(starts, start_count, count, 0.0f, CM_InPolygonScalar,
+	               &scalar);
+	CM_PrintBench("ray (scalar)", count, &scalar);
+	if (s_cm.in_polygon != CM_InPolygonScalar) {
+		char name[32];
+		A_snprintf(name, sizeof(name), "ray (%s)", s_cm.in_polygon_name);
+		CM_BenchTraces(starts, start_count, count, 0.0f, s_cm.in_polygon,
+		               &simd);
+		CM_PrintBench(name, count, &simd);
+		if (simd.hits != scalar.hits || simd.fractions != scalar.fractions) {
+			Com_Println(CON_DEST_CLIENT,
+			            "cm_bench: FAIL: %s and scalar disagree "
+			            "(%u vs %u hits).",
+			            s_cm.in_polygon_name, simd.hits, scalar.hits);
+		}
+	}
+	CM_BenchTraces(starts, start_count, count, CM_BENCH_RADIUS,
+	               s_cm.in_polygon, &sphere);
+	CM_PrintBench("sphere", count, &sphere);
+	VM_ScratchRelease(mark);
+}
+// ============================================================================
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "acommon/a_math.h"
+
+#include "com_defs.h"
+
+// ============================================================================
+// Collision against the loaded map's structure BSP.
+//
+// Everything here is in the space the client and renderer use, which is
+// the map's with y and z swapped. Traces only read what CM_LoadMap built,
+// so any thread can run them while the map stays loaded.
+typedef enum CMContents {
+	CM_CONTENTS_EMPTY,
+	CM_CONTENTS_SOLID,
+} CMContents;
+
+typedef struct CMTrace {
+	float      fraction;   // of the way to `end` it got, 1.0f if unblocked
+	apoint3f_t endpos;
+	avec3f_t   normal;     // of what blocked it, facing back along the trace
+	int32_t    surf;       // collision surface that blocked it, -1 if none
+	int32_t    material;   // the surface's collision material, -1 if none
+	bool       startsolid;
+} CMTrace;
+
+A_EXTERN_C void CM_Init     (void);
+A_EXTERN_C void CM_Shutdown (void);
+
+// Flattens the map's collision BSP into what the traces walk, out of the
+// map's arena. CL_LoadMap and CL_UnloadMap call these. Without a map
+// everything's empty and nothing blocks a trace.
+A_EXTERN_C bool CM_LoadMap  (void);
+A_EXTERN_C void CM_UnloadMap(void);
+
+A_EXTERN_C A_NO_DISCARD CMContents CM_PointContents(apoint3f_t p);
+// A point moved from `start` to `end`.
+A_EXTERN_C void CM_TraceRay   (A_OUT CMTrace* tr,
+                               apoint3f_t start, apoint3f_t end);
+// A sphere of `radius` moved from `start` to `end`. A radius of 0 is a ray.
+A_EXTERN_C void CM_TraceSphere(A_OUT CMTrace* tr,
+                               apoint3f_t start, apoint3f_t end,
+                               float radius);
+// ============================================================================
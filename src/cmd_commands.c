@@ -2,102 +2,126 @@
 
 #include <assert.h>
 
+#include "acommon/a_atom.h"
 #include "acommon/a_string.h"
 #include "acommon/a_type.h"
-#include "acommon/z_mem.h"
+
+#include "vm_vmem.h"
+
+// Commands are kept in an open-addressing hash table, like the dvars, with
+// linear probing and backward-shift deletion. It's twice CMD_MAX_COMMANDS,
+// so it's never more than half full. It's keyed by the atom of the name,
+// which is case-sensitive, so probing is a pointer compare.
+#define CMD_TABLE_SIZE (CMD_MAX_COMMANDS * 2)
+#define CMD_TABLE_MASK (CMD_TABLE_SIZE - 1)
+A_STATIC_ASSERT((CMD_TABLE_SIZE & CMD_TABLE_MASK) == 0);
 
 typedef struct Cmd {
-	bool free;
-	void (*cmd)(void);
-	char* name;
+	aatom_t name;
+	CmdFn   fn;
 } Cmd;
 
-Cmd s_cmds[CMD_MAX_COMMANDS];
-size_t s_cmds_idx;
+static Cmd    s_cmds[CMD_TABLE_SIZE];
+static size_t s_cmdCount;
 
+// The args point into s_cmdLine, which the tokenizer copies each line into
+// and splits in place, so tokenizing never allocates.
 typedef struct CmdArgs {
 	char* args[CMD_MAX_ARGS];
 	size_t idx;
 } CmdArgs;
 CmdArgs cmd_args;
 
+static char s_cmdLine[CMD_MAX_LINE + 1];
+
 void Cmd_Init(void) {
 	A_memset(s_cmds, 0, sizeof(s_cmds));
-	s_cmds_idx = 0;
+	s_cmdCount = 0;
+}
+
+// Returns the slot holding `name`, or the empty slot its probe sequence
+// ends at if it isn't registered.
+static Cmd* Cmd_Slot(aatom_t name) {
+	assert(name);
+	size_t i = A_atom_hash(name) & CMD_TABLE_MASK;
+	while (s_cmds[i].name != NULL && s_cmds[i].name != name)
+		i = (i + 1) & CMD_TABLE_MASK;
+
+	return &s_cmds[i];
+}
+
+// NULL if `cmdName` isn't registered. A name that was never interned can't
+// have been, so that's known without probing.
+static Cmd* Cmd_Find(const char* cmdName) {
+	assert(cmdName);
+	aatom_t name = A_atom_find(cmdName);
+	if (name == NULL)
+		return NULL;
+
+	Cmd* cmd = Cmd_Slot(name);
+	return cmd->name != NULL ? cmd : NULL;
 }
 
 void Cmd_ArgsPushFront(const char* s) {
 	assert(cmd_args.idx < CMD_MAX_ARGS);
-	cmd_args.args[cmd_args.idx++] = A_cstrdup(s);
+	cmd_args.args[cmd_args.idx++] = VM_FrameStrdup(s);
 }
 
 bool Cmd_AddCommand(const char* cmdName, void(*fn)(void)) {
-	if (Cmd_CommandExists(cmdName))
+	assert(fn);
+	if (fn == NULL || s_cmdCount >= CMD_MAX_COMMANDS)
 		return false;
-	
-	if (s_cmds_idx < CMD_MAX_COMMANDS) {
-		s_cmds[s_cmds_idx].cmd = fn;
-		s_cmds[s_cmds_idx].free = false;
-		s_cmds[s_cmds_idx].name = A_cstrdup(cmdName);
-		s_cmds_idx++;
-		
-		return true;
-	}
 
-	for (size_t i = 0; i < CMD_MAX_COMMANDS; i++) {
-		if (s_cmds[i].free) {
-			s_cmds[i].free = false;
-			s_cmds[i].cmd = fn;
-			s_cmds[i].name = A_cstrdup(cmdName);
-			return true;
-		}
-	}
+	aatom_t name = A_atom(cmdName);
+	Cmd*    cmd  = Cmd_Slot(name);
+	if (cmd->name != NULL)
+		return false;
 
-	return false;
+	cmd->name = name;
+	cmd->fn   = fn;
+	s_cmdCount++;
+	return true;
 }
 
 bool Cmd_CommandExists(const char* cmdName) {
-	for (size_t i = 0; i < s_cmds_idx; i++) {
-		if (A_cstrcmp(s_cmds[i].name, cmdName) == true)
-			return true;
-	}
-	return false;
+	return Cmd_Find(cmdName) != NULL;
 }
 
 CmdFn Cmd_FindCommand(const char* cmdName) {
-	if (!Cmd_CommandExists(cmdName))
-		return NULL;
-
-	for (size_t i = 0; i < CMD_MAX_COMMANDS; i++) {
-		if (A_cstrcmp(cmdName, s_cmds[i].name)) {
-			if (s_cmds[i].cmd)
-				return s_cmds[i].cmd;
-		}
-	}
-	
-	return NULL;
+	Cmd* cmd = Cmd_Find(cmdName);
+	return cmd ? cmd->fn : NULL;
 }
 
+// Empties the slot, then shifts back any later entries in its probe
+// sequence that would otherwise become unreachable.
 void Cmd_RemoveCommand(const char* cmdName) {
-	for (size_t i = 0; i < CMD_MAX_COMMANDS; i++) {
-		if (s_cmds[i].name && A_cstrcmp(cmdName, s_cmds[i].name)) {
-			A_cstrfree(s_cmds[i].name);
-			s_cmds[i].name = NULL;
-			s_cmds[i].cmd  = NULL;
-			s_cmds[i].free = true;
-			return;
-		}
+	Cmd* cmd = Cmd_Find(cmdName);
+	if (cmd == NULL)
+		return;
+
+	s_cmdCount--;
+
+	size_t i = (size_t)(cmd - s_cmds);
+	size_t j = i;
+	for (;;) {
+		j = (j + 1) & CMD_TABLE_MASK;
+		if (s_cmds[j].name == NULL)
+			break;
+
+		size_t k = A_atom_hash(s_cmds[j].name) & CMD_TABLE_MASK;
+		if (A_HashSlotBetween(k, i, j))
+			continue;
+
+		s_cmds[i] = s_cmds[j];
+		i = j;
 	}
+	s_cmds[i].name = NULL;
+	s_cmds[i].fn   = NULL;
 }
 
 void Cmd_ClearCommands(void) {
-	for (size_t i = 0; i < s_cmds_idx; i++) {
-		A_cstrfree(s_cmds[i].name);
-		s_cmds[i].name = NULL;
-		s_cmds[i].cmd  = NULL;
-		s_cmds[i].free = true;
-	}
-		
+	A_memset(s_cmds, 0, sizeof(s_cmds));
+	s_cmdCount = 0;
 }
 
 int Cmd_Argc(void) {
@@ -110,22 +134,55 @@ const char* Cmd_Argv(int i) {
 	return cmd_args.args[i];
 }
 
-bool Cmd_TakeInput(const char* input) {	
+// What A_isspace does in the C locale, without a call per byte.
+static bool Cmd_IsSpace(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+bool Cmd_TakeInput(const char* input) {
+	return Cmd_TakeInputN(input, A_cstrlen(input));
+}
+
+// Each token is copied into s_cmdLine with a terminator after it. A token
+// never takes more room there than it and the whitespace or end of input
+// after it took in `input`, so CMD_MAX_LINE + 1 bytes is always enough.
+bool Cmd_TakeInputN(const char* input, size_t n) {
+	assert(input);
 	for (size_t i = 0; i < cmd_args.idx; i++)
-		A_cstrfree(cmd_args.args[i]);
-
-	int last_arg_i = 0;
-	int i          = 0;
-	for (const char* p = input; *p != '\0'; p++) {
-		if (A_isspace(*p)) {
-			size_t len = i - last_arg_i;
-			cmd_args.args[i] = (char*)Z_Alloc(len + 1);
-			A_cstrncpyz(cmd_args.args[cmd_args.idx++], &input[last_arg_i], len + 1);
-			last_arg_i = i + 1;
-			while (A_isspace(*(p++)));
+		cmd_args.args[i] = NULL;
+	cmd_args.idx = 0;
+
+	if (n > CMD_MAX_LINE)
+		return false;
+
+	char*  out = s_cmdLine;
+	size_t i   = 0;
+	for (;;) {
+		while (i < n && Cmd_IsSpace(input[i]))
+			i++;
+		if (i >= n || input[i] == '\0')
+			break;
+		if (input[i] == '/' && i + 1 < n && input[i + 1] == '/')
+			break;
+
+		if (cmd_args.idx >= CMD_MAX_ARGS)
+			return false;
+		cmd_args.args[cmd_args.idx++] = out;
+
+		if (input[i] == '"') {
+			i++;
+			while (i < n && input[i] != '\0' && input[i] != '"')
+				*out++ = input[i++];
+			if (i < n && input[i] == '"')
+				i++;
+		} else {
+			while (i < n && input[i] != '\0' && !Cmd_IsSpace(input[i]))
+				*out++ = input[i++];
 		}
-		i++;
+		*out++ = '\0';
 	}
+
+	assert(out <= s_cmdLine + sizeof(s_cmdLine));
 	return true;
 }
 
@@ -4,8 +4,9 @@
 
 #include "com_defs.h"
 
-#define CMD_MAX_COMMANDS 16
-#define CMD_MAX_ARGS     4 
+#define CMD_MAX_COMMANDS 256
+#define CMD_MAX_ARGS     8
+#define CMD_MAX_LINE     4096
 
 typedef void(*CmdFn)(void);
 
@@ -17,5 +18,11 @@ A_EXTERN_C void        Cmd_RemoveCommand(const char* cmdName);
 A_EXTERN_C void        Cmd_ClearCommands(void);
 A_EXTERN_C int         Cmd_Argc         (void);
 A_EXTERN_C const char* Cmd_Argv         (int i);
+// Splits `input` into the args Cmd_Argc and Cmd_Argv return, which stay
+// valid until the next call. Whitespace separates args, unless it's inside
+// double quotes, which are stripped, and `//` starts a comment. False if
+// there are more than CMD_MAX_ARGS args or CMD_MAX_LINE bytes.
 A_EXTERN_C bool        Cmd_TakeInput    (const char* input);
+// The same, but only for the first `n` bytes, or up to a terminator.
+A_EXTERN_C bool        Cmd_TakeInputN   (const char* input, size_t n);
 A_EXTERN_C void        Cmd_Shutdown     (void);
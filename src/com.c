@@ -1,8 +1,17 @@
+#include "acommon/a_atom.h"
 #include "acommon/a_string.h"
 
 #include "cg_cgame.h"
 #include "cl_client.h"
+#include "cl_demo.h"
+#include "cm_trace.h"
 #include "cmd_commands.h"
+#include "com_kernels.h"
+#include "com_meminfo.h"
+#include "com_memtrace.h"
+#include "com_perf.h"
+#include "com_print.h"
+#include "com_prof.h"
 #include "con_console.h"
 #include "devcon.h"
 #include "devgui.h"
@@ -23,18 +32,31 @@ void Com_Quit_f(void) {
     Sys_NormalExit(3);
 }
 
-bool Com_Init(void) {
-    VM_Init();
+void Com_EarlyInit(void) {
     Cmd_Init();
+    VM_Init();
+}
+
+bool Com_Init(void) {
+    Com_LogInit();
+    Com_MemTraceInit();
+    Com_MemInfoInit();
+    Com_KernelsInit();
     Cmd_AddCommand("quit", Com_Quit_f);
+    Com_PerfInit();
+    Com_ProfInit();
     Dvar_Init();
     com_maxfps = Dvar_RegisterInt("com_maxfps", DVAR_FLAG_NONE, 165, 1, 1000);
     //Font_Init();
+    CM_Init();
     PM_Init();
     CG_Init();
     R_Init();
     CL_Init();
 #if !A_TARGET_PLATFORM_IS_XBOX
+    Con_Init();
+    DevCon_AddCommands();
+    IN_AddCommands();
     DevGui_Init();
 #endif // !A_TARGET_PLATFORM_IS_XBOX
     s_lastFrameTime = Sys_Milliseconds();
@@ -43,25 +65,43 @@ bool Com_Init(void) {
 }
 
 bool Com_Frame(void) {
+    Com_PerfBeginFrame();
+    VM_BeginFrame();
+    COM_PROF_BEGIN("Com_Frame");
+
+    Com_PerfBeginPhase(COM_PERF_PHASE_WAIT);
     uint64_t wait_msec = 1000 / (uint64_t)Dvar_GetInt(com_maxfps);
+    // Timedemos run as fast as they can, or at the rate they were asked to.
+    if (CL_DemoIsPlaying())
+        wait_msec = CL_DemoFrameMsec();
     while (Sys_Milliseconds() - s_lastFrameTime < wait_msec);
+    Com_PerfEndPhase(COM_PERF_PHASE_WAIT);
 
     s_deltaTime = Sys_Milliseconds() - s_lastFrameTime;
     s_lastFrameTime = Sys_Milliseconds();
 
+    Com_PerfBeginPhase(COM_PERF_PHASE_IN);
     IN_Frame();
 
 #if !A_TARGET_PLATFORM_IS_XBOX
     while (Sys_HandleEvent())
         ;
-
-    DevCon_Frame();
 #endif // !A_TARGET_PLATFORM_IS_XBOX
+    Com_PerfEndPhase(COM_PERF_PHASE_IN);
 
+    Com_PerfBeginPhase(COM_PERF_PHASE_CG);
     CG_Frame(s_deltaTime);
+    Com_PerfEndPhase(COM_PERF_PHASE_CG);
+
+    Com_PerfBeginPhase(COM_PERF_PHASE_CL);
     CL_Frame();
+    Com_PerfEndPhase(COM_PERF_PHASE_CL);
 #if !A_TARGET_PLATFORM_IS_XBOX
+    Com_PerfBeginPhase(COM_PERF_PHASE_DEVGUI);
     DevGui_Frame();
+    Com_PerfEndPhase(COM_PERF_PHASE_DEVGUI);
+
+    Com_PerfBeginPhase(COM_PERF_PHASE_CON);
     for (size_t i = 0; i < MAX_LOCAL_CLIENTS; i++) {
         if(!CG_LocalClientIsActive(i))
             continue;
@@ -69,18 +109,25 @@ bool Com_Frame(void) {
         if (DevGui_HasText(i)) {
             char* t = DevGui_TakeText(i);
             Con_ProcessLocalInput(t, i);
-            A_cstrfree(t);
         }
     }
-    if (DevCon_HasText()) {
+    while (DevCon_HasText()) {
         char* t = DevCon_TakeText();
-        Con_ProcessInput(t);
-        A_cstrfree(t);
+        Cbuf_AddText(t);
     }
+    // Everything queued for the command buffer, from the dev console,
+    // exec or wait, runs here and only here.
+    Cbuf_Execute();
+    Com_PerfEndPhase(COM_PERF_PHASE_CON);
 #endif // !A_TARGET_PLATFORM_IS_XBOX
     
+    Com_PerfBeginPhase(COM_PERF_PHASE_R);
     R_Frame();
+    Com_PerfEndPhase(COM_PERF_PHASE_R);
 
+    COM_PROF_END();
+    Com_PerfEndFrame();
+    Com_ProfFrame();
     return true;
 }
 
@@ -95,14 +142,27 @@ uint64_t Com_LastFrameTime(void) {
 void Com_Shutdown(void) {
 #if !A_TARGET_PLATFORM_IS_XBOX
     DevGui_Shutdown();
+    IN_RemoveCommands();
+    DevCon_RemoveCommands();
+    Con_Shutdown();
 #endif // !A_TARGET_PLATFORM_IS_XBOX
     CL_Shutdown();
+    CM_Shutdown();
     CG_Shutdown();
     R_Shutdown();
     //Font_Shutdown();
     Dvar_Unregister("com_maxfps");
     com_maxfps = NULL;
     Dvar_Shutdown();
+    Com_ProfShutdown();
+    Com_PerfShutdown();
+    Com_KernelsShutdown();
+    Com_MemInfoShutdown();
+    Com_MemTraceShutdown();
+    Com_LogShutdown();
     Cmd_Shutdown();
+    // Nothing's looked up by name from here on, and the atoms have to be
+    // freed while the VM still can.
+    A_AtomShutdown();
     VM_Shutdown();
 }
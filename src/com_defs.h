@@ -7,6 +7,33 @@
 // can't #include sys.hpp because sys.hpp #includes this file
 A_EXTERN_C A_NO_RETURN Sys_NormalExit(int ec);
 A_EXTERN_C uint64_t Sys_Milliseconds(void);
+A_EXTERN_C uint64_t Sys_Microseconds(void);
+A_EXTERN_C uint64_t Sys_Nanoseconds(void);
+A_EXTERN_C uint64_t Sys_ThreadId(void);
+// Gives up the rest of the calling thread's time slice for at least `ms`
+// milliseconds, or just the time slice if it's 0.
+A_EXTERN_C void     Sys_Sleep(uint32_t ms);
+// Logical CPUs the process can run on, at least 1.
+A_EXTERN_C uint32_t Sys_CpuCount(void);
+// Physical memory in use by the process, or 0 if it can't be determined.
+A_EXTERN_C uint64_t Sys_ResidentBytes(void);
+
+typedef struct SysPageFaults {
+    uint64_t minor; // resolved without I/O
+    uint64_t major; // needed I/O
+} SysPageFaults;
+// Page faults taken by the process so far. Windows doesn't split them, so
+// they're all counted as minor there. Returns false if they can't be
+// determined.
+A_EXTERN_C bool     Sys_PageFaults(A_OUT SysPageFaults* faults);
+
+typedef struct SysThread SysThread;
+// Runs `f(arg)` on a new thread. Returns NULL if the thread couldn't be
+// created. Every thread must be joined, which returns what `f` returned.
+A_EXTERN_C A_NO_DISCARD SysThread* Sys_SpawnThread(const char* name,
+                                                   int (*f)(void*),
+                                                   void* arg);
+A_EXTERN_C int                     Sys_JoinThread (SysThread* thread);
 
 #define MAX_LOCAL_CLIENTS 4
 
@@ -14,6 +41,10 @@ typedef struct RectDef {
 	float x, y, w, h;
 } RectDef;
 
+// Brings up the command table and the VM, which everything else registers
+// and allocates through. main calls it before Sys_Init, since that already
+// registers dvars, and their names are interned as atoms counted by the VM.
+A_EXTERN_C void     Com_EarlyInit(void);
 A_EXTERN_C bool     Com_Init(void);
 A_EXTERN_C bool     Com_Frame(void);
 A_EXTERN_C uint64_t Com_LastFrameTime(void);
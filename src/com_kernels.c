@@ -0,0 +1,1011 @@
+#include "com_kernels.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "acommon/a_atom.h"
+#include "acommon/a_math.h"
+#include "acommon/a_string.h"
+#include "acommon/z_mem.h"
+
+#include "cmd_commands.h"
+#include "com_print.h"
+
+// Every offset within two of the widest blocks, for both buffers, at every
+// length up to COM_STR_TEST_MAX_SMALL. Longer lengths only get a few
+// alignments, or the test would take minutes.
+#define COM_STR_TEST_ALIGNS    64
+#define COM_STR_TEST_MAX_SMALL 192
+#define COM_STR_TEST_MAX_LARGE 65549
+// Bytes either side of the range that mustn't be touched.
+#define COM_STR_TEST_GUARD     32
+#define COM_STR_TEST_FILL      0xA5
+#define COM_STR_TEST_BUF_SIZE  (COM_STR_TEST_GUARD + COM_STR_TEST_ALIGNS + \
+                                COM_STR_TEST_MAX_LARGE + COM_STR_TEST_GUARD + 1)
+
+static const size_t s_strTestLargeLens[] = {
+    255, 256, 257, 1000, 4096, 4111, COM_STR_TEST_MAX_LARGE
+};
+static const size_t s_strTestLargeAligns[] = { 0, 1, 15, 16, 31, 33, 63 };
+// Including the values that trip up sign extension.
+static const unsigned char s_strTestFillValues[] = { 0x00, 0x5A, 0x80, 0xFF };
+
+#define COM_STR_BENCH_BYTES (64 * 1024 * 1024)
+static const size_t s_strBenchSizes[] = {
+    16, 64, 256, 4096, 65536, 1024 * 1024
+};
+
+typedef struct ComStrTest {
+    const AStringKernels* k;
+    unsigned char*        a;
+    unsigned char*        b;
+} ComStrTest;
+
+// Each returns whether `t->k` got the case right.
+typedef bool (*ComStrTestCase)(const ComStrTest* t, size_t a0, size_t a1,
+                               size_t len);
+
+// Enough for every remainder after the four-at-a-time loops, both in
+// place and not.
+#define COM_MATH_TEST_MAX_BATCH 37
+#define COM_MATH_TEST_ITERS     2000
+// The SSE2 inverse isn't done the same way as the scalar one, so it only
+// has to match to within this, relative to the largest element.
+#define COM_MATH_TEST_INVERSE_EPSILON 1e-4f
+#define COM_MATH_TEST_EPSILON         1e-4f
+
+#define COM_MATH_BENCH_BATCH 4096
+#define COM_MATH_BENCH_OPS   (4 * 1024 * 1024)
+
+#define COM_ATOM_BENCH_DEFAULT  100000
+#define COM_ATOM_BENCH_NAME_MAX 48
+
+static void Com_StrTest_f(void);
+static void Com_StrBench_f(void);
+static void Com_MathTest_f(void);
+static void Com_MathBench_f(void);
+static void Com_AtomBench_f(void);
+
+void Com_KernelsInit(void) {
+    Cmd_AddCommand("str_test",   Com_StrTest_f);
+    Cmd_AddCommand("str_bench",  Com_StrBench_f);
+    Cmd_AddCommand("math_test",  Com_MathTest_f);
+    Cmd_AddCommand("math_bench", Com_MathBench_f);
+    Cmd_AddCommand("atom_bench", Com_AtomBench_f);
+}
+
+static bool Com_StrTestGuardsIntact(const unsigned char* p, size_t len) {
+    for (size_t i = 1; i <= COM_STR_TEST_GUARD; i++) {
+        if (p[-(ptrdiff_t)i] != COM_STR_TEST_FILL ||
+            p[len + i - 1] != COM_STR_TEST_FILL
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Where to put a difference or a match in a range of `len`: everywhere for
+// short ranges, and either side of each block boundary for longer ones.
+static size_t Com_StrTestPositions(size_t len, A_OUT size_t* positions) {
+    size_t count = 0;
+    if (len <= 48) {
+        for (size_t i = 0; i < len; i++)
+            positions[count++] = i;
+        return count;
+    }
+
+    positions[count++] = 0;
+    positions[count++] = 1;
+    positions[count++] = 15;
+    positions[count++] = 16;
+    positions[count++] = 31;
+    positions[count++] = 32;
+    positions[count++] = 33;
+    positions[count++] = len / 2;
+    positions[count++] = len - 33;
+    positions[count++] = len - 32;
+    positions[count++] = len - 17;
+    positions[count++] = len - 16;
+    positions[count++] = len - 2;
+    positions[count++] = len - 1;
+    return count;
+}
+
+static bool Com_StrTestCompare(const ComStrTest* t, size_t a0, size_t a1,
+                               size_t len
+) {
+    unsigned char* x = t->a + COM_STR_TEST_GUARD + a0;
+    unsigned char* y = t->b + COM_STR_TEST_GUARD + a1;
+    for (size_t i = 0; i < len; i++)
+        x[i] = y[i] = (unsigned char)(i * 131 + 7);
+    // Just outside the range, so they mustn't count.
+    x[-1]  = 1;
+    y[-1]  = 2;
+    x[len] = 3;
+    y[len] = 4;
+    if (!t->k->compare(x, y, len))
+        return false;
+
+    size_t positions[64];
+    size_t count = Com_StrTestPositions(len, positions);
+    for (size_t i = 0; i < count; i++) {
+        size_t at = positions[i];
+        y[at] ^= 0x80;
+        bool equal = t->k->compare(x, y, len);
+        y[at] ^= 0x80;
+        if (equal)
+            return false;
+    }
+    return true;
+}
+
+static bool Com_StrTestCopy(const ComStrTest* t, size_t a0, size_t a1,
+                            size_t len
+) {
+    unsigned char*       d = t->a + COM_STR_TEST_GUARD + a0;
+    const unsigned char* s = t->b + COM_STR_TEST_GUARD + a1;
+    memset(d - COM_STR_TEST_GUARD, COM_STR_TEST_FILL,
+           len + 2 * COM_STR_TEST_GUARD);
+    t->k->copy(d, s, len);
+    return memcmp(d, s, len) == 0 && Com_StrTestGuardsIntact(d, len);
+}
+
+static bool Com_StrTestFind(const ComStrTest* t, size_t a0, size_t a1,
+                            size_t len
+) {
+    A_UNUSED(a1);
+    unsigned char* p     = t->a + COM_STR_TEST_GUARD + a0;
+    unsigned char  c     = (len & 1) ? 0x80 : 0x2A;
+    unsigned char  other = 0x11;
+    // Matches either side of the range mustn't be found.
+    memset(p - COM_STR_TEST_GUARD, c, len + 2 * COM_STR_TEST_GUARD);
+    memset(p, other, len);
+    if (t->k->find(p, (char)c, len) != NULL)
+        return false;
+
+    size_t positions[64];
+    size_t count = Com_StrTestPositions(len, positions);
+    for (size_t i = 0; i < count; i++) {
+        size_t at = positions[i];
+        // A later match too, to check it's the first that's found.
+        p[at]      = c;
+        p[len - 1] = c;
+        void* found = t->k->find(p, (char)c, len);
+        p[at]      = other;
+        p[len - 1] = other;
+        if (found != p + at)
+            return false;
+    }
+    return true;
+}
+
+static bool Com_StrTestFill(const ComStrTest* t, size_t a0, size_t a1,
+                            size_t len
+) {
+    A_UNUSED(a1);
+    unsigned char* p = t->a + COM_STR_TEST_GUARD + a0;
+    unsigned char  c = s_strTestFillValues[(len + a0) %
+                                           A_countof(s_strTestFillValues)];
+    memset(p - COM_STR_TEST_GUARD, COM_STR_TEST_FILL,
+           len + 2 * COM_STR_TEST_GUARD);
+    t->k->fill(p, (char)c, len);
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != c)
+            return false;
+    }
+    return Com_StrTestGuardsIntact(p, len);
+}
+
+static bool Com_StrTestLength(const ComStrTest* t, size_t a0, size_t a1,
+                              size_t len
+) {
+    A_UNUSED(a1);
+    char* s = (char*)t->a + COM_STR_TEST_GUARD + a0;
+    // Terminators before the start mustn't count either.
+    memset(s - COM_STR_TEST_GUARD, 0, COM_STR_TEST_GUARD);
+    memset(s, 'x', len);
+    s[len] = '\0';
+    memset(s + len + 1, 'y', COM_STR_TEST_GUARD - 1);
+    return t->k->length(s) == len;
+}
+
+// Runs `f` over every case and returns how many failed, printing the
+// first.
+static size_t Com_StrTestRun(const ComStrTest* t, const char* fn,
+                             ComStrTestCase f, bool two_buffers
+) {
+    size_t failures = 0;
+    size_t a1_count = two_buffers ? COM_STR_TEST_ALIGNS : 1;
+    for (size_t a0 = 0; a0 < COM_STR_TEST_ALIGNS; a0++) {
+        for (size_t a1 = 0; a1 < a1_count; a1++) {
+            for (size_t len = 0; len <= COM_STR_TEST_MAX_SMALL; len++) {
+                if (f(t, a0, a1, len))
+                    continue;
+                if (failures++ == 0) {
+                    Com_Println(CON_DEST_CLIENT,
+                                "str_test: %s %s failed at alignment "
+                                "%zu/%zu, length %zu.",
+                                t->k->name, fn, a0, a1, len);
+                }
+            }
+        }
+    }
+
+    size_t large_a1_count = two_buffers ? A_countof(s_strTestLargeAligns) : 1;
+    for (size_t i = 0; i < A_countof(s_strTestLargeAligns); i++) {
+        for (size_t j = 0; j < large_a1_count; j++) {
+            for (size_t l = 0; l < A_countof(s_strTestLargeLens); l++) {
+                size_t a0  = s_strTestLargeAligns[i];
+                size_t a1  = s_strTestLargeAligns[j];
+                size_t len = s_strTestLargeLens[l];
+                if (f(t, a0, a1, len))
+                    continue;
+                if (failures++ == 0) {
+                    Com_Println(CON_DEST_CLIENT,
+                                "str_test: %s %s failed at alignment "
+                                "%zu/%zu, length %zu.",
+                                t->k->name, fn, a0, a1, len);
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+static void Com_StrTest_f(void) {
+    ComStrTest t;
+    t.a = (unsigned char*)Z_Alloc(COM_STR_TEST_BUF_SIZE);
+    t.b = (unsigned char*)Z_Alloc(COM_STR_TEST_BUF_SIZE);
+    if (!t.a || !t.b) {
+        Z_Free(t.a);
+        Z_Free(t.b);
+        Com_Println(CON_DEST_CLIENT, "str_test: out of memory.");
+        return;
+    }
+    for (size_t i = 0; i < COM_STR_TEST_BUF_SIZE; i++)
+        t.b[i] = (unsigned char)(i * 131 + 7);
+
+    size_t total = 0;
+    for (int impl = 0; impl < A_STRING_IMPL_COUNT; impl++) {
+        t.k = A_StringKernels((AStringImpl)impl);
+        if (!t.k)
+            continue;
+
+        size_t failures = 0;
+        failures += Com_StrTestRun(&t, "memcmp", Com_StrTestCompare, true);
+        failures += Com_StrTestRun(&t, "memcpy", Com_StrTestCopy,    true);
+        failures += Com_StrTestRun(&t, "memchr", Com_StrTestFind,    false);
+        failures += Com_StrTestRun(&t, "memset", Com_StrTestFill,    false);
+        failures += Com_StrTestRun(&t, "cstrlen", Com_StrTestLength, false);
+        Com_Println(CON_DEST_CLIENT, "str_test: %-5s %s", t.k->name,
+                    failures == 0 ? "PASS" : "FAIL");
+        total += failures;
+    }
+    Com_Println(CON_DEST_CLIENT, "str_test: %zu failures.", total);
+
+    Z_Free(t.a);
+    Z_Free(t.b);
+}
+
+static bool Com_LibcMemcmp(const void* A_RESTRICT a, const void* A_RESTRICT b,
+                           size_t n
+) {
+    return memcmp(a, b, n) == 0;
+}
+
+static void Com_LibcMemcpy(void* A_RESTRICT dest, const void* A_RESTRICT src,
+                           size_t n
+) {
+    memcpy(dest, src, n);
+}
+
+static void* Com_LibcMemchr(const void* A_RESTRICT p, char c, size_t n) {
+    return (void*)memchr(p, (unsigned char)c, n);
+}
+
+static void Com_LibcMemset(void* A_RESTRICT p, char c, size_t n) {
+    memset(p, (unsigned char)c, n);
+}
+
+static size_t Com_LibcStrlen(const char* A_RESTRICT s) {
+    return strlen(s);
+}
+
+static const AStringKernels s_libcKernels = {
+    /*.name    =*/ "libc",
+    /*.compare =*/ Com_LibcMemcmp,
+    /*.copy    =*/ Com_LibcMemcpy,
+    /*.find    =*/ Com_LibcMemchr,
+    /*.fill    =*/ Com_LibcMemset,
+    /*.length  =*/ Com_LibcStrlen,
+};
+
+typedef enum ComStrBenchFn {
+    COM_STR_BENCH_MEMCMP,
+    COM_STR_BENCH_MEMCPY,
+    COM_STR_BENCH_MEMCHR,
+    COM_STR_BENCH_MEMSET,
+    COM_STR_BENCH_CSTRLEN,
+
+    COM_STR_BENCH_COUNT
+} ComStrBenchFn;
+
+static const char* s_strBenchFnNames[COM_STR_BENCH_COUNT] = {
+    "memcmp", "memcpy", "memchr", "memset", "cstrlen"
+};
+
+// Returns GB/s. The buffers are set up so each call has to go through
+// all `n` bytes: equal for memcmp, no match for memchr, and the
+// terminator at the end for cstrlen.
+static double Com_StrBenchRun(const AStringKernels* k, ComStrBenchFn fn,
+                              unsigned char* a, unsigned char* b, size_t n
+) {
+    size_t iters = COM_STR_BENCH_BYTES / n;
+    if (iters < 16)
+        iters = 16;
+
+    memset(a, 'a', n);
+    memset(b, 'a', n);
+    a[n - 1] = '\0';
+    b[n - 1] = '\0';
+
+    volatile size_t sink = 0;
+    uint64_t start = Sys_Nanoseconds();
+    switch (fn) {
+    case COM_STR_BENCH_MEMCMP:
+        for (size_t i = 0; i < iters; i++)
+            sink += k->compare(a, b, n);
+        break;
+    case COM_STR_BENCH_MEMCPY:
+        for (size_t i = 0; i < iters; i++)
+            k->copy(a, b, n);
+        break;
+    case COM_STR_BENCH_MEMCHR:
+        for (size_t i = 0; i < iters; i++)
+            sink += k->find(a, 'b', n) != NULL;
+        break;
+    case COM_STR_BENCH_MEMSET:
+        for (size_t i = 0; i < iters; i++)
+            k->fill(a, 'a', n);
+        break;
+    case COM_STR_BENCH_CSTRLEN:
+        for (size_t i = 0; i < iters; i++)
+            sink += k->length((const char*)b);
+        break;
+    default:
+        assert(false && "unreachable");
+        break;
+    }
+    uint64_t ns = Sys_Nanoseconds() - start;
+    (void)sink;
+
+    // Bytes per nanosecond is GB/s.
+    return ns > 0 ? (double)n * (double)iters / (double)ns : 0.0;
+}
+
+static void Com_StrBench_f(void) {
+    int only = 0;
+    if (Cmd_Argc() > 2 ||
+        (Cmd_Argc() == 2 && (!A_atoi(Cmd_Argv(1), &only) || only < 1))
+    ) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: str_bench [bytes]");
+        return;
+    }
+
+    size_t max = only > 0 ? (size_t)only : s_strBenchSizes[
+        A_countof(s_strBenchSizes) - 1
+    ];
+    unsigned char* a = (unsigned char*)Z_Alloc(max);
+    unsigned char* b = (unsigned char*)Z_Alloc(max);
+    if (!a || !b) {
+        Z_Free(a);
+        Z_Free(b);
+        Com_Println(CON_DEST_CLIENT, "str_bench: out of memory.");
+        return;
+    }
+
+    const AStringKernels* kernels[A_STRING_IMPL_COUNT + 1];
+    int count = 0;
+    for (int impl = 0; impl < A_STRING_IMPL_COUNT; impl++) {
+        const AStringKernels* k = A_StringKernels((AStringImpl)impl);
+        if (k)
+            kernels[count++] = k;
+    }
+    kernels[count++] = &s_libcKernels;
+
+    Com_Println(CON_DEST_CLIENT, "str_bench: using %s, GB/s:",
+                A_StringKernels(A_StringImpl())->name);
+    char line[256];
+    for (int fn = 0; fn < COM_STR_BENCH_COUNT; fn++) {
+        int len = A_snprintf(line, sizeof(line), "%-8s %8s",
+                             s_strBenchFnNames[fn], "bytes");
+        for (int i = 0; i < count; i++) {
+            len += A_snprintf(line + len, sizeof(line) - len, " %7s",
+                              kernels[i]->name);
+        }
+        Com_Println(CON_DEST_CLIENT, "%s", line);
+
+        for (size_t s = 0; s < A_countof(s_strBenchSizes); s++) {
+            size_t n = only > 0 ? (size_t)only : s_strBenchSizes[s];
+            len = A_snprintf(line, sizeof(line), "%-8s %8zu", "", n);
+            for (int i = 0; i < count; i++) {
+                double gbps = Com_StrBenchRun(kernels[i], (ComStrBenchFn)fn,
+                                              a, b, n);
+                len += A_snprintf(line + len, sizeof(line) - len, " %7.2f",
+                                  gbps);
+            }
+            Com_Println(CON_DEST_CLIENT, "%s", line);
+            if (only > 0)
+                break;
+        }
+    }
+
+    Z_Free(a);
+    Z_Free(b);
+}
+
+// ============================================================================
+// Math
+static uint32_t s_mathTestSeed;
+
+// [-range, range), from a fixed sequence so failures can be reproduced.
+static float Com_MathTestRandom(float range) {
+    s_mathTestSeed = s_mathTestSeed * 1664525u + 1013904223u;
+    float unit = (float)(s_mathTestSeed >> 8) / (float)(1u << 24);
+    return (unit * 2.0f - 1.0f) * range;
+}
+
+// Well enough conditioned to invert: random, but with a heavy diagonal.
+static amat4f_t Com_MathTestMatrix(void) {
+    amat4f_t m;
+    for (int i = 0; i < 16; i++)
+        m.array[i] = Com_MathTestRandom(1.0f);
+    for (int i = 0; i < 4; i++)
+        m.m[i][i] += 4.0f;
+    return m;
+}
+
+static float Com_MathTestAbs(float x) {
+    return x < 0.0f ? -x : x;
+}
+
+static bool Com_MathTestNear(float a, float b, float epsilon) {
+    return Com_MathTestAbs(a - b) <= epsilon;
+}
+
+static bool Com_MathTestMatricesEqual(const amat4f_t* a, const amat4f_t* b) {
+    for (int i = 0; i < 16; i++) {
+        if (a->array[i] != b->array[i])
+            return false;
+    }
+    return true;
+}
+
+static bool Com_MathTestMatricesNear(const amat4f_t* a, const amat4f_t* b,
+                                     float epsilon
+) {
+    float scale = 1.0f;
+    for (int i = 0; i < 16; i++)
+        scale = A_MAX(scale, Com_MathTestAbs(b->array[i]));
+    for (int i = 0; i < 16; i++) {
+        if (!Com_MathTestNear(a->array[i], b->array[i], epsilon * scale))
+            return false;
+    }
+    return true;
+}
+
+static bool Com_MathTestFloatsEqual(const float* a, const float* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i])
+            return false;
+    }
+    return true;
+}
+
+// Checks `k` against the scalar kernels. Returns how many checks failed,
+// printing the first.
+static size_t Com_MathTestKernels(const AMathKernels* k) {
+    const AMathKernels* ref = A_MathKernels(A_MATH_IMPL_SCALAR);
+    size_t failures = 0;
+#define COM_MATH_TEST_CHECK(cond, what)                                   \
+    do {                                                                  \
+        if (!(cond) && failures++ == 0) {                                 \
+            Com_Println(CON_DEST_CLIENT, "math_test: %s %s failed.",      \
+                        k->name, what);                                   \
+        }                                                                 \
+    } while (0)
+
+    s_mathTestSeed = 1;
+    for (int iter = 0; iter < COM_MATH_TEST_ITERS; iter++) {
+        amat4f_t a = Com_MathTestMatrix();
+        amat4f_t b = Com_MathTestMatrix();
+        amat4f_t got, want;
+        k->mat4_mul(&a, &b, &got);
+        ref->mat4_mul(&a, &b, &want);
+        COM_MATH_TEST_CHECK(Com_MathTestMatricesEqual(&got, &want),
+                            "mat4_mul");
+        // In place.
+        got = a;
+        k->mat4_mul(&got, &b, &got);
+        COM_MATH_TEST_CHECK(Com_MathTestMatricesEqual(&got, &want),
+                            "mat4_mul in place");
+
+        bool got_ok  = k->mat4_inverse(&a, &got);
+        bool want_ok = ref->mat4_inverse(&a, &want);
+        COM_MATH_TEST_CHECK(got_ok && want_ok, "mat4_inverse");
+        COM_MATH_TEST_CHECK(
+            Com_MathTestMatricesNear(&got, &want,
+                                     COM_MATH_TEST_INVERSE_EPSILON),
+            "mat4_inverse"
+        );
+    }
+
+    // Singular: a row of zeroes, and all zeroes. (Only an exactly zero
+    // determinant counts, and these are the cases that give one whichever
+    // way it's worked out.)
+    amat4f_t singular = Com_MathTestMatrix();
+    for (int j = 0; j < 4; j++)
+        singular.m[2][j] = 0.0f;
+    amat4f_t out = A_MAT4F_IDENTITY;
+    COM_MATH_TEST_CHECK(!k->mat4_inverse(&singular, &out),
+                        "mat4_inverse of a singular matrix");
+    A_memzero(&singular, sizeof(singular));
+    COM_MATH_TEST_CHECK(!k->mat4_inverse(&singular, &out),
+                        "mat4_inverse of zero");
+
+    amat4f_t m = Com_MathTestMatrix();
+    avec3f_t in3[COM_MATH_TEST_MAX_BATCH];
+    avec3f_t got3[COM_MATH_TEST_MAX_BATCH];
+    avec3f_t want3[COM_MATH_TEST_MAX_BATCH];
+    avec4f_t in4[COM_MATH_TEST_MAX_BATCH];
+    avec4f_t got4[COM_MATH_TEST_MAX_BATCH];
+    avec4f_t want4[COM_MATH_TEST_MAX_BATCH];
+    for (size_t n = 0; n <= COM_MATH_TEST_MAX_BATCH; n++) {
+        for (size_t i = 0; i < n; i++) {
+            for (int j = 0; j < 3; j++)
+                in3[i].array[j] = Com_MathTestRandom(100.0f);
+            for (int j = 0; j < 4; j++)
+                in4[i].array[j] = Com_MathTestRandom(100.0f);
+        }
+        // Some zero vectors for normalize.
+        if (n > 5)
+            in3[5] = A_VEC3F_ZERO;
+        if (n > 0)
+            in3[n - 1] = A_VEC3F_ZERO;
+
+        k->transform_points3(&m, in3, got3, n);
+        ref->transform_points3(&m, in3, want3, n);
+        COM_MATH_TEST_CHECK(
+            Com_MathTestFloatsEqual(got3[0].array, want3[0].array, 3 * n),
+            "transform_points3"
+        );
+        A_memcpy(got3, in3, sizeof(got3[0]) * n);
+        k->transform_points3(&m, got3, got3, n);
+        COM_MATH_TEST_CHECK(
+            Com_MathTestFloatsEqual(got3[0].array, want3[0].array, 3 * n),
+            "transform_points3 in place"
+        );
+
+        k->transform_vec4(&m, in4, got4, n);
+        ref->transform_vec4(&m, in4, want4, n);
+        COM_MATH_TEST_CHECK(
+            Com_MathTestFloatsEqual(got4[0].array, want4[0].array, 4 * n),
+            "transform_vec4"
+        );
+
+        k->normalize3(in3, got3, n);
+        ref->normalize3(in3, want3, n);
+        COM_MATH_TEST_CHECK(
+            Com_MathTestFloatsEqual(got3[0].array, want3[0].array, 3 * n),
+            "normalize3"
+        );
+        A_memcpy(got3, in3, sizeof(got3[0]) * n);
+        k->normalize3(got3, got3, n);
+        COM_MATH_TEST_CHECK(
+            Com_MathTestFloatsEqual(got3[0].array, want3[0].array, 3 * n),
+            "normalize3 in place"
+        );
+    }
+
+#undef COM_MATH_TEST_CHECK
+    return failures;
+}
+
+// The scalar kernels and the functions built on top of them, against what
+// they're supposed to do rather than against another implementation.
+static size_t Com_MathTestReference(void) {
+    const AMathKernels* ref = A_MathKernels(A_MATH_IMPL_SCALAR);
+    size_t failures = 0;
+#define COM_MATH_TEST_CHECK(cond, what)                                   \
+    do {                                                                  \
+        if (!(cond) && failures++ == 0)                                   \
+            Com_Println(CON_DEST_CLIENT, "math_test: %s failed.", what);  \
+    } while (0)
+
+    s_mathTestSeed = 2;
+    for (int iter = 0; iter < COM_MATH_TEST_ITERS; iter++) {
+        amat4f_t m = Com_MathTestMatrix();
+        amat4f_t inv, id;
+        bool ok = ref->mat4_inverse(&m, &inv);
+        COM_MATH_TEST_CHECK(ok, "mat4_inverse");
+        ref->mat4_mul(&m, &inv, &id);
+        COM_MATH_TEST_CHECK(
+            Com_MathTestMatricesNear(&id, &A_MAT4F_IDENTITY,
+                                     COM_MATH_TEST_EPSILON),
+            "m * inverse(m) == identity"
+        );
+
+        // Translating a point by m then by its inverse.
+        avec3f_t p = A_vec3(Com_MathTestRandom(10.0f),
+                            Com_MathTestRandom(10.0f),
+                            Com_MathTestRandom(10.0f));
+        amat4f_t t = A_MAT4F_IDENTITY;
+        t.m[3][0] = 1.0f;
+        t.m[3][1] = 2.0f;
+        t.m[3][2] = 3.0f;
+        avec3f_t moved = A_mat4f_transform_point3(t, p);
+        COM_MATH_TEST_CHECK(moved.x == p.x + 1.0f && moved.y == p.y + 2.0f &&
+                            moved.z == p.z + 3.0f,
+                            "transform_point3 translation");
+
+        // A point on a plane is still on it after they both go through
+        // the same transform. transform_point3 doesn't divide by w, so
+        // that has to be affine.
+        amat4f_t affine = m;
+        for (int i = 0; i < 3; i++)
+            affine.m[i][3] = 0.0f;
+        affine.m[3][3] = 1.0f;
+        avec3f_t normal = A_vec3(Com_MathTestRandom(1.0f),
+                                 Com_MathTestRandom(1.0f),
+                                 Com_MathTestRandom(1.0f) + 2.0f);
+        avec3f_t axis   = A_vec3(1.0f, 0.0f, 0.0f);
+        aplane3f_t plane;
+        plane.p.v = A_vec3f_normalize(normal);
+        plane.p.w = Com_MathTestRandom(10.0f);
+        avec3f_t tangent = A_vec3f_cross(plane.p.v, axis);
+        avec3f_t on = A_vec3f_add(A_vec3f_mul(plane.p.v, plane.p.w),
+                                  A_vec3f_mul(tangent, 3.0f));
+        aplane3f_t moved_plane;
+        A_mat4f_transform_planes(&affine, &plane, &moved_plane, 1);
+        avec3f_t moved_on = A_mat4f_transform_point3(affine, on);
+        float length = A_vec3f_length(moved_plane.p.v);
+        float dist   = A_vec3f_dot(moved_plane.p.v, moved_on) -
+                       moved_plane.p.w;
+        COM_MATH_TEST_CHECK(
+            Com_MathTestNear(dist / length, 0.0f, 1e-3f), "transform_planes"
+        );
+    }
+
+    avec3f_t x = A_vec3(1.0f, 0.0f, 0.0f);
+    avec3f_t y = A_vec3(0.0f, 1.0f, 0.0f);
+    avec3f_t z = A_vec3(0.0f, 0.0f, 1.0f);
+    COM_MATH_TEST_CHECK(A_vec3f_eq(A_vec3f_cross(x, y), z), "vec3f_cross");
+    COM_MATH_TEST_CHECK(A_vec3f_eq(A_vec3f_normalize(A_VEC3F_ZERO),
+                                   A_VEC3F_ZERO),
+                        "vec3f_normalize of zero");
+
+    // The eye ends up at the origin, looking down -z for right-handed and
+    // +z for left-handed, with up still up.
+    avec3f_t eye    = A_vec3(3.0f, -2.0f, 5.0f);
+    avec3f_t center = A_vec3(-1.0f, 4.0f, 2.0f);
+    avec3f_t up     = A_vec3(0.0f, 0.0f, 1.0f);
+    float    dist   = A_vec3f_length(A_vec3f_sub(center, eye));
+    amat4f_t rh = A_mat4f_look_at(eye, center, up);
+    amat4f_t lh = A_mat4f_look_at_lh(eye, center, up);
+    avec3f_t e  = A_mat4f_transform_point3(rh, eye);
+    avec3f_t c  = A_mat4f_transform_point3(rh, center);
+    avec3f_t u  = A_mat4f_transform_point3(rh, A_vec3f_add(eye, up));
+    COM_MATH_TEST_CHECK(A_vec3f_length(e) < COM_MATH_TEST_EPSILON, "look_at");
+    COM_MATH_TEST_CHECK(Com_MathTestNear(c.x, 0.0f, COM_MATH_TEST_EPSILON) &&
+                        Com_MathTestNear(c.y, 0.0f, COM_MATH_TEST_EPSILON) &&
+                        Com_MathTestNear(c.z, -dist, COM_MATH_TEST_EPSILON),
+                        "look_at");
+    COM_MATH_TEST_CHECK(u.y > 0.0f, "look_at");
+    e = A_mat4f_transform_point3(lh, eye);
+    c = A_mat4f_transform_point3(lh, center);
+    u = A_mat4f_transform_point3(lh, A_vec3f_add(eye, up));
+    COM_MATH_TEST_CHECK(A_vec3f_length(e) < COM_MATH_TEST_EPSILON,
+                        "look_at_lh");
+    COM_MATH_TEST_CHECK(Com_MathTestNear(c.x, 0.0f, COM_MATH_TEST_EPSILON) &&
+                        Com_MathTestNear(c.y, 0.0f, COM_MATH_TEST_EPSILON) &&
+                        Com_MathTestNear(c.z, dist, COM_MATH_TEST_EPSILON),
+                        "look_at_lh");
+    COM_MATH_TEST_CHECK(u.y > 0.0f, "look_at_lh");
+
+    // The near and far planes go to the ends of the clip space depth
+    // range: [-1, 1] right-handed, [0, 1] left-handed.
+    float z_near = 0.5f, z_far = 300.0f;
+    amat4f_t proj[2];
+    proj[0] = A_mat4f_perspective   (A_radians(70.0f), 16.0f / 9.0f,
+                                     z_near, z_far);
+    proj[1] = A_mat4f_perspective_lh(A_radians(70.0f), 16.0f / 9.0f,
+                                     z_near, z_far);
+    for (int i = 0; i < 2; i++) {
+        float    sign = i == 0 ? -1.0f : 1.0f;
+        avec4f_t v[2] = {
+            A_vec4(0.0f, 0.0f, sign * z_near, 1.0f),
+            A_vec4(0.0f, 0.0f, sign * z_far,  1.0f)
+        };
+        avec4f_t clip[2];
+        ref->transform_vec4(&proj[i], v, clip, 2);
+        float want_near = i == 0 ? -1.0f : 0.0f;
+        COM_MATH_TEST_CHECK(
+            Com_MathTestNear(clip[0].z / clip[0].w, want_near,
+                             COM_MATH_TEST_EPSILON) &&
+            Com_MathTestNear(clip[1].z / clip[1].w, 1.0f,
+                             COM_MATH_TEST_EPSILON),
+            i == 0 ? "perspective" : "perspective_lh"
+        );
+    }
+
+#undef COM_MATH_TEST_CHECK
+    return failures;
+}
+
+static void Com_MathTest_f(void) {
+    size_t total = Com_MathTestReference();
+    Com_Println(CON_DEST_CLIENT, "math_test: %-6s %s", "scalar",
+                total == 0 ? "PASS" : "FAIL");
+
+    for (int impl = A_MATH_IMPL_SCALAR + 1; impl < A_MATH_IMPL_COUNT; impl++) {
+        const AMathKernels* k = A_MathKernels((AMathImpl)impl);
+        if (!k)
+            continue;
+
+        size_t failures = Com_MathTestKernels(k);
+        Com_Println(CON_DEST_CLIENT, "math_test: %-6s %s", k->name,
+                    failures == 0 ? "PASS" : "FAIL");
+        total += failures;
+    }
+    Com_Println(CON_DEST_CLIENT, "math_test: %zu failures.", total);
+}
+
+typedef enum ComMathBenchFn {
+    COM_MATH_BENCH_MAT4_MUL,
+    COM_MATH_BENCH_MAT4_INVERSE,
+    COM_MATH_BENCH_TRANSFORM_POINTS3,
+    COM_MATH_BENCH_TRANSFORM_VEC4,
+    COM_MATH_BENCH_NORMALIZE3,
+
+    COM_MATH_BENCH_COUNT
+} ComMathBenchFn;
+
+static const char* s_mathBenchFnNames[COM_MATH_BENCH_COUNT] = {
+    "mat4_mul", "mat4_inverse", "transform_points3", "transform_vec4",
+    "normalize3"
+};
+
+typedef struct ComMathBench {
+    amat4f_t* mats;
+    avec3f_t* in3;
+    avec3f_t* out3;
+    avec4f_t* in4;
+    avec4f_t* out4;
+} ComMathBench;
+
+// Returns millions of matrices or vectors a second.
+static double Com_MathBenchRun(const AMathKernels* k, ComMathBenchFn fn,
+                               const ComMathBench* b
+) {
+    size_t batches = COM_MATH_BENCH_OPS / COM_MATH_BENCH_BATCH;
+    volatile float sink = 0.0f;
+    amat4f_t out = A_MAT4F_IDENTITY;
+    uint64_t start = Sys_Nanoseconds();
+    switch (fn) {
+    case COM_MATH_BENCH_MAT4_MUL:
+        for (size_t i = 0; i < batches; i++) {
+            for (size_t j = 0; j < COM_MATH_BENCH_BATCH; j++) {
+                k->mat4_mul(&b->mats[j], &b->mats[COM_MATH_BENCH_BATCH - 1 - j],
+                            &out);
+            }
+        }
+        break;
+    case COM_MATH_BENCH_MAT4_INVERSE:
+        for (size_t i = 0; i < batches; i++) {
+            for (size_t j = 0; j < COM_MATH_BENCH_BATCH; j++) {
+                bool ok = k->mat4_inverse(&b->mats[j], &out);
+                (void)ok;
+            }
+        }
+        break;
+    case COM_MATH_BENCH_TRANSFORM_POINTS3:
+        for (size_t i = 0; i < batches; i++) {
+            k->transform_points3(&b->mats[i % COM_MATH_BENCH_BATCH], b->in3,
+                                 b->out3, COM_MATH_BENCH_BATCH);
+        }
+        break;
+    case COM_MATH_BENCH_TRANSFORM_VEC4:
+        for (size_t i = 0; i < batches; i++) {
+            k->transform_vec4(&b->mats[i % COM_MATH_BENCH_BATCH], b->in4,
+                              b->out4, COM_MATH_BENCH_BATCH);
+        }
+        break;
+    case COM_MATH_BENCH_NORMALIZE3:
+        for (size_t i = 0; i < batches; i++)
+            k->normalize3(b->in3, b->out3, COM_MATH_BENCH_BATCH);
+        break;
+    default:
+        assert(false && "unreachable");
+        break;
+    }
+    uint64_t ns = Sys_Nanoseconds() - start;
+    sink += out.array[0] + b->out3[0].x + b->out4[0].x;
+    (void)sink;
+
+    // Operations per microsecond is millions a second.
+    return ns > 0 ?
+        (double)batches * COM_MATH_BENCH_BATCH * 1000.0 / (double)ns : 0.0;
+}
+
+static void Com_MathBench_f(void) {
+    ComMathBench b;
+    b.mats = (amat4f_t*)Z_Alloc(sizeof(*b.mats) * COM_MATH_BENCH_BATCH);
+    b.in3  = (avec3f_t*)Z_Alloc(sizeof(*b.in3)  * COM_MATH_BENCH_BATCH);
+    b.out3 = (avec3f_t*)Z_Alloc(sizeof(*b.out3) * COM_MATH_BENCH_BATCH);
+    b.in4  = (avec4f_t*)Z_Alloc(sizeof(*b.in4)  * COM_MATH_BENCH_BATCH);
+    b.out4 = (avec4f_t*)Z_Alloc(sizeof(*b.out4) * COM_MATH_BENCH_BATCH);
+    if (!b.mats || !b.in3 || !b.out3 || !b.in4 || !b.out4) {
+        Com_Println(CON_DEST_CLIENT, "math_bench: out of memory.");
+    } else {
+        s_mathTestSeed = 3;
+        for (size_t j = 0; j < COM_MATH_BENCH_BATCH; j++) {
+            b.mats[j] = Com_MathTestMatrix();
+            for (int c = 0; c < 3; c++)
+                b.in3[j].array[c] = Com_MathTestRandom(100.0f);
+            for (int c = 0; c < 4; c++)
+                b.in4[j].array[c] = Com_MathTestRandom(100.0f);
+        }
+
+        const AMathKernels* kernels[A_MATH_IMPL_COUNT];
+        int count = 0;
+        for (int impl = 0; impl < A_MATH_IMPL_COUNT; impl++) {
+            const AMathKernels* k = A_MathKernels((AMathImpl)impl);
+            if (k)
+                kernels[count++] = k;
+        }
+
+        Com_Println(CON_DEST_CLIENT, "math_bench: using %s, millions/s:",
+                    A_MathKernels(A_MathImpl())->name);
+        char line[256];
+        int len = A_snprintf(line, sizeof(line), "%-18s", "");
+        for (int i = 0; i < count; i++) {
+            len += A_snprintf(line + len, sizeof(line) - len, " %8s",
+                              kernels[i]->name);
+        }
+        Com_Println(CON_DEST_CLIENT, "%s", line);
+
+        for (int fn = 0; fn < COM_MATH_BENCH_COUNT; fn++) {
+            len = A_snprintf(line, sizeof(line), "%-18s",
+                             s_mathBenchFnNames[fn]);
+            for (int i = 0; i < count; i++) {
+                double mops = Com_MathBenchRun(kernels[i], (ComMathBenchFn)fn,
+                                               &b);
+                len += A_snprintf(line + len, sizeof(line) - len, " %8.1f",
+                                  mops);
+            }
+            Com_Println(CON_DEST_CLIENT, "%s", line);
+        }
+    }
+
+    Z_Free(b.mats);
+    Z_Free(b.in3);
+    Z_Free(b.out3);
+    Z_Free(b.in4);
+    Z_Free(b.out4);
+}
+
+// ============================================================================
+// Atoms
+static void Com_AtomBenchReport(const char* what, uint64_t ns, int count) {
+    Com_Println(CON_DEST_CLIENT, "atom_bench: %-14s %8.2f ms, %7.1f ns each",
+                what, (double)ns / 1000000.0, (double)ns / (double)count);
+}
+
+// Interns into a table of its own that's freed when it's done, so every
+// run starts from an empty table and none of its names end up in the
+// global one.
+static void Com_AtomBench_f(void) {
+    int count = COM_ATOM_BENCH_DEFAULT;
+    if (Cmd_Argc() > 2 ||
+        (Cmd_Argc() == 2 && (!A_atoi(Cmd_Argv(1), &count) || count < 2))
+    ) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: atom_bench [count]");
+        return;
+    }
+
+    size_t      n      = (size_t)count * COM_ATOM_BENCH_NAME_MAX;
+    char*       names  = (char*)Z_Alloc(n);
+    char*       misses = (char*)Z_Alloc(n);
+    char**      dups   = (char**)Z_Alloc((size_t)count * sizeof(*dups));
+    aatom_t*    atoms  = (aatom_t*)Z_Alloc((size_t)count * sizeof(*atoms));
+    AAtomTable* table  = A_AtomCreateTable();
+    if (!names || !misses || !dups || !atoms || !table) {
+        Com_Println(CON_DEST_CLIENT, "atom_bench: out of memory.");
+        Z_Free(names);
+        Z_Free(misses);
+        Z_Free(dups);
+        Z_Free(atoms);
+        if (table)
+            A_AtomDestroyTable(table);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        A_snprintf(names + (size_t)i * COM_ATOM_BENCH_NAME_MAX,
+                   COM_ATOM_BENCH_NAME_MAX, "atom_bench_name_%d", i);
+        A_snprintf(misses + (size_t)i * COM_ATOM_BENCH_NAME_MAX,
+                   COM_ATOM_BENCH_NAME_MAX, "atom_bench_miss_%d", i);
+    }
+#define COM_ATOM_BENCH_NAME(a, i) ((a) + (size_t)(i) * COM_ATOM_BENCH_NAME_MAX)
+
+    // What the registries did before: a copy of every name.
+    uint64_t start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++)
+        dups[i] = A_cstrdup(COM_ATOM_BENCH_NAME(names, i));
+    Com_AtomBenchReport("A_cstrdup", Sys_Nanoseconds() - start, count);
+
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++)
+        atoms[i] = A_atom_in(table, COM_ATOM_BENCH_NAME(names, i));
+    Com_AtomBenchReport("intern (new)", Sys_Nanoseconds() - start, count);
+
+    size_t wrong = 0;
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++)
+        wrong += A_atom_in(table, COM_ATOM_BENCH_NAME(names, i)) != atoms[i];
+    Com_AtomBenchReport("intern (hit)", Sys_Nanoseconds() - start, count);
+
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++)
+        wrong += A_atom_find_in(table, COM_ATOM_BENCH_NAME(names, i)) !=
+                 atoms[i];
+    Com_AtomBenchReport("find (hit)", Sys_Nanoseconds() - start, count);
+
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++)
+        wrong += A_atom_find_in(table, COM_ATOM_BENCH_NAME(misses, i)) !=
+                 NULL;
+    Com_AtomBenchReport("find (miss)", Sys_Nanoseconds() - start, count);
+
+    // Comparing each name with the next, as strings and as atoms. None are
+    // equal, so any that are count as wrong.
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++)
+        wrong += A_cstrcmp(dups[i], dups[(i + 1) % count]);
+    Com_AtomBenchReport("A_cstrcmp", Sys_Nanoseconds() - start, count);
+
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++)
+        wrong += atoms[i] == atoms[(i + 1) % count];
+    Com_AtomBenchReport("atom ==", Sys_Nanoseconds() - start, count);
+#undef COM_ATOM_BENCH_NAME
+
+    AAtomStats stats;
+    A_AtomGetTableStats(table, &stats);
+    Com_Println(CON_DEST_CLIENT,
+                "atom_bench: %zu atoms, %zu bytes of text in %zu bytes of "
+                "blocks, %zu byte table",
+                stats.count, stats.atom_bytes, stats.pool_bytes,
+                stats.table_bytes);
+    if (wrong)
+        Com_Println(CON_DEST_CLIENT, "atom_bench: %zu lookups were wrong.",
+                    wrong);
+
+    for (int i = 0; i < count; i++)
+        Z_Free(dups[i]);
+    Z_Free(names);
+    Z_Free(misses);
+    Z_Free(dups);
+    Z_Free(atoms);
+    A_AtomDestroyTable(table);
+}
+// ============================================================================
+
+void Com_KernelsShutdown(void) {
+    Cmd_RemoveCommand("str_test");
+    Cmd_RemoveCommand("str_bench");
+    Cmd_RemoveCommand("math_test");
+    Cmd_RemoveCommand("math_bench");
+    Cmd_RemoveCommand("atom_bench");
+}
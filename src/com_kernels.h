@@ -0,0 +1,22 @@
+#pragma once
+
+#include "acommon/acommon.h"
+
+#include "com_defs.h"
+
+// Console commands that check and time the acommon kernels with more than
+// one implementation against each other:
+//
+// `str_test` runs every A_mem*/A_cstrlen implementation the CPU supports
+// over every alignment and a range of lengths, comparing with libc.
+// `str_bench [bytes]` times them, and libc, in GB/s.
+//
+// `math_test` checks every AMathKernels implementation against the scalar
+// one, and the scalar one, look-at and perspective against what they're
+// meant to do. `math_bench` times them in millions of operations a second.
+//
+// `atom_bench [count]` times interning and looking up `count` new names
+// against copying and comparing them as strings, and prints the atom pool's
+// size.
+A_EXTERN_C void Com_KernelsInit    (void);
+A_EXTERN_C void Com_KernelsShutdown(void);
@@ -0,0 +1,272 @@
+#include "com_meminfo.h"
+
+#include <assert.h>
+
+#include "acommon/a_string.h"
+
+#include "cl_map.h"
+#include "cmd_commands.h"
+#include "com_print.h"
+#include "fs_files.h"
+#include "gfx_stats.h"
+#include "vm_vmem.h"
+
+#define COM_MEMINFO_JSON_SIZE (16 * 1024)
+
+typedef struct ComMemInfo {
+    VmAllocStats types[VM_ALLOC_COUNT];
+    VmAllocStats total;
+    VmHeapInfo   heap;
+    MapMemStats  map;
+    uint64_t     texture_bytes;
+    uint64_t     buffer_bytes;
+    uint64_t     resident_bytes;
+} ComMemInfo;
+
+static void Com_MemInfo_f(void);
+
+void Com_MemInfoInit(void) {
+    Cmd_AddCommand("meminfo", Com_MemInfo_f);
+}
+
+static void Com_GatherMemInfo(A_OUT ComMemInfo* info) {
+    A_memset(info, 0, sizeof(*info));
+    for (int i = 0; i < VM_ALLOC_COUNT; i++)
+        info->types[i] = *VM_GetAllocStats((VmAllocType)i);
+    info->total = *VM_GetTotalAllocStats();
+    VM_GetHeapInfo(&info->heap);
+    CL_Map_MemStats(&info->map);
+    info->texture_bytes  = r_stats.texture_bytes_resident;
+    info->buffer_bytes   = r_stats.buffer_bytes_resident;
+    info->resident_bytes = Sys_ResidentBytes();
+}
+
+static double Com_Percent(size_t part, size_t whole) {
+    return whole > 0 ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+// Resident memory nobody accounts for: the C runtime's own overhead and
+// free lists, driver allocations, code, and so on.
+static uint64_t Com_UntrackedBytes(const ComMemInfo* info) {
+    uint64_t tracked = (uint64_t)info->total.bytes + info->heap.slab_free_bytes +
+                       info->heap.frame_bytes + info->heap.scratch_bytes +
+                       (info->map.arena_reserved - info->map.arena_used);
+    return info->resident_bytes > tracked ? info->resident_bytes - tracked : 0;
+}
+
+static void Com_PrintMemInfo(const ComMemInfo* info) {
+    Com_Println(CON_DEST_CLIENT,
+                "type        current KiB   peak KiB     allocs  total allocs");
+    for (int i = 0; i < VM_ALLOC_COUNT; i++) {
+        const VmAllocStats* s = &info->types[i];
+        Com_Println(CON_DEST_CLIENT, "%-10s %12zu %10zu %10zu %13zu",
+                    VM_AllocTypeName((VmAllocType)i), s->bytes / 1024,
+                    s->peak_bytes / 1024, s->count, s->total_allocs);
+    }
+    Com_Println(CON_DEST_CLIENT, "%-10s %12zu %10zu %10zu %13zu", "total",
+                info->total.bytes / 1024, info->total.peak_bytes / 1024,
+                info->total.count, info->total.total_allocs);
+
+    const MapMemStats* map = &info->map;
+    if (map->map_name) {
+        Com_Println(CON_DEST_CLIENT,
+                    "map '%s': tag data %zu KiB, bsp vertices %zu KiB, "
+                    "model vertices %zu KiB",
+                    map->map_name, map->tag_data_bytes / 1024,
+                    map->bsp_vertex_bytes / 1024,
+                    map->model_vertex_bytes / 1024);
+        for (int i = 0; i < BSP_BITMAP_DATA_FORMAT_COUNT; i++) {
+            if (map->bitmap_count[i] == 0)
+                continue;
+            Com_Println(CON_DEST_CLIENT, "  bitmaps %-8s %5u, %8zu KiB",
+                        CL_BitmapDataFormatName((BSPBitmapDataFormat)i),
+                        map->bitmap_count[i], map->bitmap_bytes[i] / 1024);
+        }
+    } else {
+        Com_Println(CON_DEST_CLIENT, "map: none loaded");
+    }
+
+    Com_Println(CON_DEST_CLIENT,
+                "gpu: textures %llu KiB, vertex buffers %llu KiB",
+                (unsigned long long)(info->texture_bytes / 1024),
+                (unsigned long long)(info->buffer_bytes / 1024));
+
+    const VmHeapInfo* heap = &info->heap;
+    Com_Println(CON_DEST_CLIENT,
+                "fragmentation: slabs %zu / %zu KiB free (%.1f%%), "
+                "map arena %zu / %zu KiB unused (%.1f%%)",
+                heap->slab_free_bytes / 1024, heap->slab_bytes / 1024,
+                Com_Percent(heap->slab_free_bytes, heap->slab_bytes),
+                (map->arena_reserved - map->arena_used) / 1024,
+                map->arena_reserved / 1024,
+                Com_Percent(map->arena_reserved - map->arena_used,
+                            map->arena_reserved));
+    Com_Println(CON_DEST_CLIENT,
+                "reserved: frame %zu KiB, scratch %zu KiB",
+                heap->frame_bytes / 1024, heap->scratch_bytes / 1024);
+    Com_Println(CON_DEST_CLIENT,
+                "process: %llu KiB resident, %llu KiB untracked",
+                (unsigned long long)(info->resident_bytes / 1024),
+                (unsigned long long)(Com_UntrackedBytes(info) / 1024));
+}
+
+typedef struct ComJsonBuf {
+    char*  p;
+    size_t len;
+    size_t cap;
+    bool   overflowed;
+} ComJsonBuf;
+
+static void Com_JsonAppend(ComJsonBuf* b, const char* fmt, ...) {
+    if (b->overflowed)
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = A_vsnprintf(b->p + b->len, b->cap - b->len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= b->cap - b->len) {
+        b->overflowed = true;
+        return;
+    }
+    b->len += (size_t)n;
+}
+
+static void Com_JsonAppendStats(ComJsonBuf* b, const char* name,
+                                const VmAllocStats* s, bool last
+) {
+    Com_JsonAppend(b,
+                   "    \"%s\": {\"bytes\": %zu, \"peak_bytes\": %zu, "
+                   "\"count\": %zu, \"total_allocs\": %zu}%s\n",
+                   name, s->bytes, s->peak_bytes, s->count, s->total_allocs,
+                   last ? "" : ",");
+}
+
+// Map names are file names, but escape them anyway.
+static void Com_JsonAppendString(ComJsonBuf* b, const char* s) {
+    Com_JsonAppend(b, "\"");
+    for (const char* p = s; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\')
+            Com_JsonAppend(b, "\\%c", *p);
+        else if ((unsigned char)*p >= 0x20)
+            Com_JsonAppend(b, "%c", *p);
+    }
+    Com_JsonAppend(b, "\"");
+}
+
+static void Com_BuildMemInfoJson(const ComMemInfo* info, ComJsonBuf* b) {
+    Com_JsonAppend(b, "{\n  \"vm\": {\n");
+    for (int i = 0; i < VM_ALLOC_COUNT; i++) {
+        Com_JsonAppendStats(b, VM_AllocTypeName((VmAllocType)i),
+                            &info->types[i], false);
+    }
+    Com_JsonAppendStats(b, "total", &info->total, true);
+    Com_JsonAppend(b, "  },\n");
+
+    const MapMemStats* map = &info->map;
+    Com_JsonAppend(b, "  \"map\": {\n    \"name\": ");
+    if (map->map_name)
+        Com_JsonAppendString(b, map->map_name);
+    else
+        Com_JsonAppend(b, "null");
+    Com_JsonAppend(b,
+                   ",\n    \"tag_data_bytes\": %zu,\n"
+                   "    \"bsp_vertex_bytes\": %zu,\n"
+                   "    \"model_vertex_bytes\": %zu,\n"
+                   "    \"bitmaps\": {",
+                   map->tag_data_bytes, map->bsp_vertex_bytes,
+                   map->model_vertex_bytes);
+    bool first = true;
+    for (int i = 0; i < BSP_BITMAP_DATA_FORMAT_COUNT; i++) {
+        if (map->bitmap_count[i] == 0)
+            continue;
+        Com_JsonAppend(b, "%s\n      \"%s\": {\"count\": %u, \"bytes\": %zu}",
+                       first ? "" : ",",
+                       CL_BitmapDataFormatName((BSPBitmapDataFormat)i),
+                       map->bitmap_count[i], map->bitmap_bytes[i]);
+        first = false;
+    }
+    Com_JsonAppend(b, "%s},\n", first ? "" : "\n    ");
+    Com_JsonAppend(b,
+                   "    \"arena_used\": %zu,\n"
+                   "    \"arena_reserved\": %zu\n  },\n",
+                   map->arena_used, map->arena_reserved);
+
+    Com_JsonAppend(b,
+                   "  \"gpu\": {\"texture_bytes\": %llu, "
+                   "\"buffer_bytes\": %llu},\n",
+                   (unsigned long long)info->texture_bytes,
+                   (unsigned long long)info->buffer_bytes);
+
+    const VmHeapInfo* heap = &info->heap;
+    Com_JsonAppend(b,
+                   "  \"fragmentation\": {\n"
+                   "    \"slab_bytes\": %zu,\n"
+                   "    \"slab_free_bytes\": %zu,\n"
+                   "    \"arena_unused_bytes\": %zu,\n"
+                   "    \"frame_bytes\": %zu,\n"
+                   "    \"scratch_bytes\": %zu\n  },\n",
+                   heap->slab_bytes, heap->slab_free_bytes,
+                   map->arena_reserved - map->arena_used,
+                   heap->frame_bytes, heap->scratch_bytes);
+    Com_JsonAppend(b,
+                   "  \"process\": {\"resident_bytes\": %llu, "
+                   "\"untracked_bytes\": %llu}\n}\n",
+                   (unsigned long long)info->resident_bytes,
+                   (unsigned long long)Com_UntrackedBytes(info));
+}
+
+bool Com_MemInfoDumpJson(const char* path) {
+    assert(path);
+    if (!path)
+        return false;
+
+    ComMemInfo info;
+    Com_GatherMemInfo(&info);
+
+    VmScratchMark mark = VM_ScratchMark();
+    ComJsonBuf b;
+    b.p          = (char*)VM_ScratchAlloc(COM_MEMINFO_JSON_SIZE);
+    b.len        = 0;
+    b.cap        = COM_MEMINFO_JSON_SIZE;
+    b.overflowed = false;
+    Com_BuildMemInfoJson(&info, &b);
+    assert(!b.overflowed);
+
+    bool ok = false;
+    if (!b.overflowed) {
+        StreamFile f = FS_StreamFile(path, FS_SEEK_BEGIN,
+                                     FS_STREAM_WRITE_NEW, 0);
+        if (f.f != NULL) {
+            ok = FS_WriteStream(&f, b.p, b.len);
+            FS_CloseStream(&f);
+        }
+    }
+    VM_ScratchRelease(mark);
+    return ok;
+}
+
+static void Com_MemInfo_f(void) {
+    if (Cmd_Argc() == 1) {
+        ComMemInfo info;
+        Com_GatherMemInfo(&info);
+        Com_PrintMemInfo(&info);
+        return;
+    }
+
+    if (!A_cstrcmp(Cmd_Argv(1), "json") || Cmd_Argc() > 3) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: meminfo [json [path]]");
+        return;
+    }
+
+    const char* path = Cmd_Argc() > 2 ? Cmd_Argv(2) : COM_MEMINFO_DEFAULT_PATH;
+    if (!Com_MemInfoDumpJson(path)) {
+        Com_Println(CON_DEST_CLIENT, "meminfo: failed to write '%s'.", path);
+        return;
+    }
+    Com_Println(CON_DEST_CLIENT, "meminfo: wrote '%s'.", path);
+}
+
+void Com_MemInfoShutdown(void) {
+    Cmd_RemoveCommand("meminfo");
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "acommon/acommon.h"
+
+#include "com_defs.h"
+
+// `meminfo` reports where memory is going: VM allocations by type, what
+// the loaded map is using, GPU resources, and how much is being held on
+// to without being used. `meminfo json [path]` writes the same to a file,
+// for tracking budgets across maps.
+#define COM_MEMINFO_DEFAULT_PATH "meminfo.json"
+
+A_EXTERN_C void Com_MemInfoInit    (void);
+A_EXTERN_C bool Com_MemInfoDumpJson(const char* path);
+A_EXTERN_C void Com_MemInfoShutdown(void);
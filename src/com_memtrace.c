@@ -0,0 +1,263 @@
+#include "com_memtrace.h"
+
+#include <assert.h>
+
+#include "acommon/a_atomic.h"
+#include "acommon/a_string.h"
+
+#include "cmd_commands.h"
+#include "com_perf.h"
+#include "com_print.h"
+#include "vm_vmem.h"
+
+#if Z_TRACE_ENABLED
+#define COM_MEMTRACE_DEFAULT_TOP 10
+
+A_STATIC_ASSERT((COM_MEMTRACE_MAX_EVENTS & (COM_MEMTRACE_MAX_EVENTS - 1)) == 0);
+A_STATIC_ASSERT((COM_MEMTRACE_MAX_SITES  & (COM_MEMTRACE_MAX_SITES  - 1)) == 0);
+
+typedef struct ComMemTraceEvent {
+    const char* file;
+    size_t      n;
+    uint32_t    frame;
+    int32_t     line;
+    int16_t     type;
+    bool        loading;
+} ComMemTraceEvent;
+
+// Any thread can record, so slots are claimed with an atomic increment.
+// The summary only runs on the main thread and doesn't lock anything out,
+// so it may see an event that's being overwritten; that's fine for what
+// it's for.
+typedef struct ComMemTraceGlob {
+    volatile int32_t head; // events recorded since the last clear
+    volatile int32_t loading;
+    ComMemTraceEvent events[COM_MEMTRACE_MAX_EVENTS];
+} ComMemTraceGlob;
+static ComMemTraceGlob s_memTrace;
+
+typedef struct ComMemTraceSite {
+    const char* file; // NULL if the slot is empty
+    int32_t     line;
+    int32_t     type;
+    size_t      count;
+    size_t      bytes;
+} ComMemTraceSite;
+
+static void Com_MemTrace_f(void);
+
+static void Com_MemTraceRecord(const char* file, int line, size_t n,
+                               int type
+) {
+    uint32_t i = (uint32_t)A_atomic_fetch_add32(&s_memTrace.head, 1);
+    ComMemTraceEvent* e = &s_memTrace.events[i & (COM_MEMTRACE_MAX_EVENTS - 1)];
+    e->file    = file;
+    e->n       = n;
+    e->frame   = (uint32_t)Com_PerfFrameCount();
+    e->line    = line;
+    e->type    = (int16_t)type;
+    e->loading = A_atomic_load32(&s_memTrace.loading) > 0;
+}
+
+void Com_MemTraceInit(void) {
+    A_memset(&s_memTrace, 0, sizeof(s_memTrace));
+    Cmd_AddCommand("memtrace", Com_MemTrace_f);
+    Z_SetTraceFn(Com_MemTraceRecord);
+}
+
+void Com_MemTraceBeginLoad(void) {
+    A_atomic_fetch_add32(&s_memTrace.loading, 1);
+}
+
+void Com_MemTraceEndLoad(void) {
+    int32_t loading = A_atomic_fetch_add32(&s_memTrace.loading, -1);
+    assert(loading > 0);
+    (void)loading;
+}
+
+static const char* Com_MemTraceBaseName(const char* file) {
+    const char* base = file;
+    for (const char* p = file; *p != '\0'; p++) {
+        if (*p == '/' || *p == '\\')
+            base = p + 1;
+    }
+    return base;
+}
+
+static const char* Com_MemTraceTypeName(int type) {
+    if (type == Z_TRACE_NO_TYPE)
+        return "heap";
+    return VM_AllocTypeName((VmAllocType)type);
+}
+
+static ComMemTraceSite* Com_MemTraceFindSite(ComMemTraceSite* sites,
+                                             const ComMemTraceEvent* e
+) {
+    uint32_t h = (uint32_t)(uintptr_t)e->file * 2654435769u;
+    h ^= (uint32_t)e->line * 0x85EBCA6Bu;
+    h ^= (uint32_t)(e->type + 1) * 0xC2B2AE35u;
+    uint32_t mask = COM_MEMTRACE_MAX_SITES - 1;
+    for (uint32_t i = 0; i <= mask; i++) {
+        ComMemTraceSite* s = &sites[(h + i) & mask];
+        if (s->file == NULL) {
+            s->file = e->file;
+            s->line = e->line;
+            s->type = e->type;
+            return s;
+        }
+        if (s->file == e->file && s->line == e->line && s->type == e->type)
+            return s;
+    }
+    return NULL;
+}
+
+// Moves the `top` biggest sites by count (or bytes) to the front of
+// `order`.
+static void Com_MemTraceSelectTop(ComMemTraceSite** order, int count,
+                                  int top, bool by_bytes
+) {
+    for (int i = 0; i < top && i < count; i++) {
+        int best = i;
+        for (int j = i + 1; j < count; j++) {
+            size_t a = by_bytes ? order[j]->bytes    : order[j]->count;
+            size_t b = by_bytes ? order[best]->bytes : order[best]->count;
+            if (a > b)
+                best = j;
+        }
+        ComMemTraceSite* tmp = order[i];
+        order[i]    = order[best];
+        order[best] = tmp;
+    }
+}
+
+static void Com_MemTracePrintTop(ComMemTraceSite** order, int count, int top,
+                                 bool by_bytes
+) {
+    Com_MemTraceSelectTop(order, count, top, by_bytes);
+    Com_Println(CON_DEST_CLIENT, "  top %d by %s:", top < count ? top : count,
+                by_bytes ? "bytes" : "count");
+    for (int i = 0; i < top && i < count; i++) {
+        const ComMemTraceSite* s = order[i];
+        Com_Println(CON_DEST_CLIENT, "  %8zu allocs %10zu bytes  %-8s %s:%d",
+                    s->count, s->bytes, Com_MemTraceTypeName(s->type),
+                    Com_MemTraceBaseName(s->file), (int)s->line);
+    }
+}
+
+typedef enum ComMemTraceFilter {
+    COM_MEMTRACE_ALL,
+    COM_MEMTRACE_LAST_FRAME,
+    COM_MEMTRACE_LOAD,
+} ComMemTraceFilter;
+
+static void Com_MemTraceSummarize(ComMemTraceFilter filter, int top) {
+    uint32_t recorded = (uint32_t)A_atomic_load32(&s_memTrace.head);
+    uint32_t valid    = recorded < COM_MEMTRACE_MAX_EVENTS ?
+                        recorded : COM_MEMTRACE_MAX_EVENTS;
+    uint32_t last_frame = (uint32_t)Com_PerfFrameCount() - 1;
+
+    VmScratchMark mark = VM_ScratchMark();
+    ComMemTraceSite* sites = (ComMemTraceSite*)VM_ScratchZalloc(
+        COM_MEMTRACE_MAX_SITES * sizeof(*sites)
+    );
+
+    size_t   events = 0, bytes = 0, dropped = 0;
+    uint32_t first = 0, last = 0;
+    for (uint32_t i = 0; i < valid; i++) {
+        const ComMemTraceEvent* e =
+            &s_memTrace.events[(recorded - valid + i) &
+                               (COM_MEMTRACE_MAX_EVENTS - 1)];
+        if (e->file == NULL ||
+            (filter == COM_MEMTRACE_LAST_FRAME && e->frame != last_frame) ||
+            (filter == COM_MEMTRACE_LOAD && !e->loading)
+        ) {
+            continue;
+        }
+
+        if (events == 0 || e->frame < first)
+            first = e->frame;
+        if (events == 0 || e->frame > last)
+            last = e->frame;
+        events++;
+        bytes += e->n;
+
+        ComMemTraceSite* s = Com_MemTraceFindSite(sites, e);
+        if (!s) {
+            dropped++;
+            continue;
+        }
+        s->count++;
+        s->bytes += e->n;
+    }
+
+    if (events == 0) {
+        Com_Println(CON_DEST_CLIENT, "memtrace: no matching allocations.");
+        VM_ScratchRelease(mark);
+        return;
+    }
+
+    int count = 0;
+    ComMemTraceSite** order = (ComMemTraceSite**)VM_ScratchAlloc(
+        COM_MEMTRACE_MAX_SITES * sizeof(*order)
+    );
+    for (int i = 0; i < COM_MEMTRACE_MAX_SITES; i++) {
+        if (sites[i].file)
+            order[count++] = &sites[i];
+    }
+
+    uint32_t frames = last - first + 1;
+    Com_Println(CON_DEST_CLIENT,
+                "memtrace: %zu allocs (%zu bytes) from %d sites over frames "
+                "%u-%u, %.1f allocs/frame%s",
+                events, bytes, count, first, last, (double)events / frames,
+                recorded > valid ? " (ring wrapped, oldest dropped)" : "");
+    if (dropped > 0) {
+        Com_Println(CON_DEST_CLIENT,
+                    "memtrace: %zu allocs from sites that didn't fit.",
+                    dropped);
+    }
+    Com_MemTracePrintTop(order, count, top, false);
+    Com_MemTracePrintTop(order, count, top, true);
+    VM_ScratchRelease(mark);
+}
+
+static void Com_MemTrace_f(void) {
+    ComMemTraceFilter filter = COM_MEMTRACE_ALL;
+    int top = COM_MEMTRACE_DEFAULT_TOP;
+    bool ok = true;
+    if (Cmd_Argc() > 1) {
+        const char* mode = Cmd_Argv(1);
+        if (A_cstrcmp(mode, "clear")) {
+            A_atomic_store32(&s_memTrace.head, 0);
+            A_memset(s_memTrace.events, 0, sizeof(s_memTrace.events));
+            Com_Println(CON_DEST_CLIENT, "memtrace: cleared.");
+            return;
+        } else if (A_cstrcmp(mode, "frame")) {
+            filter = COM_MEMTRACE_LAST_FRAME;
+        } else if (A_cstrcmp(mode, "load")) {
+            filter = COM_MEMTRACE_LOAD;
+        } else if (!A_cstrcmp(mode, "all")) {
+            ok = false;
+        }
+    }
+    if (Cmd_Argc() > 2 && (!A_atoi(Cmd_Argv(2), &top) || top < 1))
+        ok = false;
+
+    if (!ok) {
+        Com_Println(CON_DEST_CLIENT,
+                    "USAGE: memtrace [all|frame|load|clear] [top]");
+        return;
+    }
+    Com_MemTraceSummarize(filter, top);
+}
+
+void Com_MemTraceShutdown(void) {
+    Z_SetTraceFn(NULL);
+    Cmd_RemoveCommand("memtrace");
+}
+#else
+void Com_MemTraceInit(void) {}
+void Com_MemTraceBeginLoad(void) {}
+void Com_MemTraceEndLoad(void) {}
+void Com_MemTraceShutdown(void) {}
+#endif // Z_TRACE_ENABLED
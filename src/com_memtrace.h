@@ -0,0 +1,22 @@
+#pragma once
+
+#include "acommon/acommon.h"
+#include "acommon/z_mem.h"
+
+#include "com_defs.h"
+
+// Records every traced allocation (see Z_TRACE_ENABLED in z_mem.h) into a
+// ring buffer, with its call site, size, type and frame, for the
+// `memtrace` command to summarize. Compiled out along with the tracing.
+#if !A_TARGET_PLATFORM_IS_XBOX
+#define COM_MEMTRACE_MAX_EVENTS 65536
+#else
+#define COM_MEMTRACE_MAX_EVENTS 8192
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+#define COM_MEMTRACE_MAX_SITES  4096
+
+A_EXTERN_C void Com_MemTraceInit     (void);
+// Allocations between these are attributed to map loading. They nest.
+A_EXTERN_C void Com_MemTraceBeginLoad(void);
+A_EXTERN_C void Com_MemTraceEndLoad  (void);
+A_EXTERN_C void Com_MemTraceShutdown (void);
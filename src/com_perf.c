@@ -0,0 +1,308 @@
+#include "com_perf.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "acommon/a_math.h"
+#include "acommon/a_string.h"
+
+#include "cmd_commands.h"
+#include "com_print.h"
+#include "fs_files.h"
+
+#define COM_PERF_FRAME_MASK (COM_PERF_MAX_FRAMES - 1)
+A_STATIC_ASSERT((COM_PERF_MAX_FRAMES & COM_PERF_FRAME_MASK) == 0);
+A_STATIC_ASSERT(COM_PERF_PHASE_COUNT <= 32);
+// One GPU phase per local client.
+A_STATIC_ASSERT(COM_PERF_PHASE_GPU_CLIENT3 - COM_PERF_PHASE_GPU_CLIENT0 + 1 ==
+                MAX_LOCAL_CLIENTS);
+
+typedef struct ComPerfFrame {
+    uint64_t frame;
+    uint32_t valid; // bitmask of the phases that have a sample
+    uint32_t usec[COM_PERF_PHASE_COUNT];
+} ComPerfFrame;
+
+// The ring is only ever written by Com_Frame and read by the perf commands
+// and the graph, all of which run on the main thread, so there's nothing to
+// lock. A frame only becomes visible once s_perfFrameCount is bumped after
+// its slot has been filled in.
+static ComPerfFrame s_perfFrames[COM_PERF_MAX_FRAMES];
+static uint64_t     s_perfFrameCount;
+static ComPerfFrame s_perfCurrent;
+static uint64_t     s_perfFrameStart;
+static uint64_t     s_perfInputTime; // 0 if the frame hasn't consumed any
+static uint64_t     s_perfPhaseStart[COM_PERF_PHASE_COUNT];
+static uint32_t     s_perfSamples[COM_PERF_MAX_FRAMES];
+
+static const char* s_perfPhaseNames[COM_PERF_PHASE_COUNT] = {
+    /*[COM_PERF_PHASE_WAIT]   =*/ "wait",
+    /*[COM_PERF_PHASE_IN]     =*/ "in",
+    /*[COM_PERF_PHASE_CG]     =*/ "cg",
+    /*[COM_PERF_PHASE_CL]     =*/ "cl",
+    /*[COM_PERF_PHASE_DEVGUI] =*/ "devgui",
+    /*[COM_PERF_PHASE_CON]    =*/ "con",
+    /*[COM_PERF_PHASE_R]      =*/ "r",
+    /*[COM_PERF_PHASE_FRAME]  =*/ "frame",
+    /*[COM_PERF_PHASE_GPU_FRAME]     =*/ "gpu_frame",
+    /*[COM_PERF_PHASE_GPU_CLIENT0]   =*/ "gpu_cl0",
+    /*[COM_PERF_PHASE_GPU_CLIENT1]   =*/ "gpu_cl1",
+    /*[COM_PERF_PHASE_GPU_CLIENT2]   =*/ "gpu_cl2",
+    /*[COM_PERF_PHASE_GPU_CLIENT3]   =*/ "gpu_cl3",
+    /*[COM_PERF_PHASE_GPU_BSP]       =*/ "gpu_bsp",
+    /*[COM_PERF_PHASE_GPU_TEXT]      =*/ "gpu_text",
+    /*[COM_PERF_PHASE_GPU_WIREFRAME] =*/ "gpu_wireframe",
+    /*[COM_PERF_PHASE_LAT_SUBMIT]    =*/ "lat_submit",
+    /*[COM_PERF_PHASE_LAT_SWAP]      =*/ "lat_swap"
+};
+
+static void Com_PerfReport_f(void);
+static void Com_PerfDump_f  (void);
+
+void Com_PerfInit(void) {
+    A_memset(s_perfFrames,     0, sizeof(s_perfFrames));
+    A_memset(&s_perfCurrent,   0, sizeof(s_perfCurrent));
+    A_memset(s_perfPhaseStart, 0, sizeof(s_perfPhaseStart));
+    s_perfFrameCount = 0;
+    s_perfFrameStart = 0;
+    s_perfInputTime  = 0;
+
+    Cmd_AddCommand("perf_report", Com_PerfReport_f);
+    Cmd_AddCommand("perf_dump",   Com_PerfDump_f);
+}
+
+void Com_PerfBeginFrame(void) {
+    A_memset(&s_perfCurrent, 0, sizeof(s_perfCurrent));
+    s_perfCurrent.frame = s_perfFrameCount;
+    s_perfFrameStart    = Sys_Microseconds();
+    s_perfInputTime     = 0;
+}
+
+void Com_PerfBeginPhase(ComPerfPhase phase) {
+    assert(phase < COM_PERF_PHASE_FRAME);
+    s_perfPhaseStart[phase] = Sys_Microseconds();
+}
+
+void Com_PerfEndPhase(ComPerfPhase phase) {
+    assert(phase < COM_PERF_PHASE_FRAME);
+    // Accumulate rather than assign so a phase can be entered more than once
+    // per frame.
+    s_perfCurrent.usec[phase] +=
+        (uint32_t)(Sys_Microseconds() - s_perfPhaseStart[phase]);
+    s_perfCurrent.valid |= 1u << phase;
+}
+
+void Com_PerfEndFrame(void) {
+    s_perfCurrent.usec[COM_PERF_PHASE_FRAME] =
+        (uint32_t)(Sys_Microseconds() - s_perfFrameStart);
+    s_perfCurrent.valid |= 1u << COM_PERF_PHASE_FRAME;
+    s_perfFrames[s_perfFrameCount & COM_PERF_FRAME_MASK] = s_perfCurrent;
+    s_perfFrameCount++;
+}
+
+void Com_PerfRecordLate(uint64_t frame, ComPerfPhase phase, uint32_t usec) {
+    assert(phase < COM_PERF_PHASE_COUNT);
+    if (frame >= s_perfFrameCount ||
+        s_perfFrameCount - frame > COM_PERF_MAX_FRAMES)
+        return;
+
+    ComPerfFrame* f = &s_perfFrames[frame & COM_PERF_FRAME_MASK];
+    assert(f->frame == frame);
+    f->usec[phase] = usec;
+    f->valid |= 1u << phase;
+}
+
+void Com_PerfMarkInput(uint64_t usec) {
+    if (s_perfInputTime == 0 || usec < s_perfInputTime)
+        s_perfInputTime = usec;
+}
+
+static void Com_PerfMarkLatency(ComPerfPhase phase) {
+    if (s_perfInputTime == 0)
+        return;
+
+    uint64_t now = Sys_Microseconds();
+    s_perfCurrent.usec[phase] =
+        now > s_perfInputTime ? (uint32_t)(now - s_perfInputTime) : 0;
+    s_perfCurrent.valid |= 1u << phase;
+}
+
+void Com_PerfMarkSubmit(void) {
+    Com_PerfMarkLatency(COM_PERF_PHASE_LAT_SUBMIT);
+}
+
+void Com_PerfMarkSwap(void) {
+    Com_PerfMarkLatency(COM_PERF_PHASE_LAT_SWAP);
+}
+
+A_NO_DISCARD const char* Com_PerfPhaseName(ComPerfPhase phase) {
+    assert(phase < COM_PERF_PHASE_COUNT);
+    return s_perfPhaseNames[phase];
+}
+
+A_NO_DISCARD uint64_t Com_PerfFrameCount(void) {
+    return s_perfFrameCount;
+}
+
+size_t Com_PerfHistory(ComPerfPhase phase, A_OUT uint32_t* usec, size_t n) {
+    assert(phase < COM_PERF_PHASE_COUNT);
+    assert(usec);
+
+    uint64_t count = A_MIN(s_perfFrameCount, COM_PERF_MAX_FRAMES);
+    if (n > count)
+        n = (size_t)count;
+
+    uint64_t first = s_perfFrameCount - n;
+    for (size_t i = 0; i < n; i++) {
+        const ComPerfFrame* f =
+            &s_perfFrames[(first + i) & COM_PERF_FRAME_MASK];
+        usec[i] = (f->valid & (1u << phase)) ? f->usec[phase] : 0;
+    }
+    return n;
+}
+
+static int Com_PerfCompareSamples(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// Nearest-rank percentile of an already sorted sample set.
+static uint32_t Com_PerfPercentile(const uint32_t* sorted, size_t n, int p) {
+    assert(n > 0);
+    size_t rank = ((size_t)p * n + 99) / 100;
+    if (rank < 1)
+        rank = 1;
+    return sorted[rank - 1];
+}
+
+bool Com_PerfGetStats(ComPerfPhase phase, A_OUT ComPerfStats* stats) {
+    assert(stats);
+    A_memset(stats, 0, sizeof(*stats));
+
+    assert(phase < COM_PERF_PHASE_COUNT);
+    uint64_t count = A_MIN(s_perfFrameCount, COM_PERF_MAX_FRAMES);
+    size_t   n     = 0;
+    for (uint64_t i = s_perfFrameCount - count; i < s_perfFrameCount; i++) {
+        const ComPerfFrame* f = &s_perfFrames[i & COM_PERF_FRAME_MASK];
+        if (f->valid & (1u << phase))
+            s_perfSamples[n++] = f->usec[phase];
+    }
+    if (n == 0)
+        return false;
+
+    Com_PerfComputeStats(s_perfSamples, n, stats);
+    return true;
+}
+
+bool Com_PerfGetSample(uint64_t frame, ComPerfPhase phase,
+                       A_OUT uint32_t* usec
+) {
+    assert(phase < COM_PERF_PHASE_COUNT);
+    assert(usec);
+    *usec = 0;
+    if (frame >= s_perfFrameCount ||
+        s_perfFrameCount - frame > COM_PERF_MAX_FRAMES)
+        return false;
+
+    const ComPerfFrame* f = &s_perfFrames[frame & COM_PERF_FRAME_MASK];
+    assert(f->frame == frame);
+    if (!(f->valid & (1u << phase)))
+        return false;
+
+    *usec = f->usec[phase];
+    return true;
+}
+
+void Com_PerfComputeStats(A_INOUT uint32_t* usec, size_t n,
+                          A_OUT ComPerfStats* stats
+) {
+    assert(usec);
+    assert(n > 0);
+    assert(stats);
+
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += usec[i];
+
+    qsort(usec, n, sizeof(*usec), Com_PerfCompareSamples);
+
+    stats->samples = n;
+    stats->avg     = (uint32_t)(sum / n);
+    stats->p50     = Com_PerfPercentile(usec, n, 50);
+    stats->p95     = Com_PerfPercentile(usec, n, 95);
+    stats->p99     = Com_PerfPercentile(usec, n, 99);
+    stats->max     = usec[n - 1];
+}
+
+bool Com_PerfDumpCsv(const char* path) {
+    StreamFile f = FS_StreamFile(path, FS_SEEK_BEGIN,
+                                 FS_STREAM_WRITE_NEW, 0);
+    if (f.f == NULL)
+        return false;
+
+    char line[512];
+    int  len = A_snprintf(line, sizeof(line), "frame");
+    for (int i = 0; i < COM_PERF_PHASE_COUNT; i++) {
+        len += A_snprintf(line + len, sizeof(line) - len, ",%s_usec",
+                          Com_PerfPhaseName((ComPerfPhase)i));
+    }
+    len += A_snprintf(line + len, sizeof(line) - len, "\n");
+    bool b = FS_WriteStream(&f, line, len);
+
+    uint64_t count = A_MIN(s_perfFrameCount, COM_PERF_MAX_FRAMES);
+    uint64_t first = s_perfFrameCount - count;
+    for (uint64_t i = first; b && i < s_perfFrameCount; i++) {
+        const ComPerfFrame* fr = &s_perfFrames[i & COM_PERF_FRAME_MASK];
+        len = A_snprintf(line, sizeof(line), "%llu",
+                         (unsigned long long)fr->frame);
+        for (int j = 0; j < COM_PERF_PHASE_COUNT; j++) {
+            if (fr->valid & (1u << j)) {
+                len += A_snprintf(line + len, sizeof(line) - len, ",%u",
+                                  (unsigned int)fr->usec[j]);
+            } else {
+                len += A_snprintf(line + len, sizeof(line) - len, ",");
+            }
+        }
+        len += A_snprintf(line + len, sizeof(line) - len, "\n");
+        b = FS_WriteStream(&f, line, len);
+    }
+
+    FS_CloseStream(&f);
+    return b;
+}
+
+static void Com_PerfReport_f(void) {
+    Com_Println(CON_DEST_CLIENT, "%-13s %9s %9s %9s %9s %9s  (msec)",
+                "phase", "avg", "p50", "p95", "p99", "max");
+
+    ComPerfStats stats;
+    for (int i = 0; i < COM_PERF_PHASE_COUNT; i++) {
+        if (!Com_PerfGetStats((ComPerfPhase)i, &stats))
+            continue;
+
+        Com_Println(CON_DEST_CLIENT, "%-13s %9.3f %9.3f %9.3f %9.3f %9.3f",
+                    Com_PerfPhaseName((ComPerfPhase)i),
+                    stats.avg / 1000.0, stats.p50 / 1000.0,
+                    stats.p95 / 1000.0, stats.p99 / 1000.0,
+                    stats.max / 1000.0);
+    }
+    Com_Println(CON_DEST_CLIENT, "%zu frames sampled.",
+                (size_t)A_MIN(s_perfFrameCount, COM_PERF_MAX_FRAMES));
+}
+
+static void Com_PerfDump_f(void) {
+    const char* path = Cmd_Argc() > 1 ? Cmd_Argv(1) : "perf.csv";
+    if (!Com_PerfDumpCsv(path)) {
+        Com_Println(CON_DEST_CLIENT, "perf_dump: failed to write '%s'.",
+                    path);
+        return;
+    }
+    Com_Println(CON_DEST_CLIENT, "perf_dump: wrote '%s'.", path);
+}
+
+void Com_PerfShutdown(void) {
+    Cmd_RemoveCommand("perf_dump");
+    Cmd_RemoveCommand("perf_report");
+    s_perfFrameCount = 0;
+}
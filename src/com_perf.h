@@ -0,0 +1,80 @@
+#pragma once
+
+#include "acommon/acommon.h"
+
+#include "com_defs.h"
+
+// Must be a power of two so the ring index can be masked.
+#define COM_PERF_MAX_FRAMES 1024
+
+typedef enum ComPerfPhase {
+    COM_PERF_PHASE_WAIT,   // frame limiter busy-wait
+    COM_PERF_PHASE_IN,     // IN_Frame, SDL events and DevCon_Frame
+    COM_PERF_PHASE_CG,     // CG_Frame
+    COM_PERF_PHASE_CL,     // CL_Frame
+    COM_PERF_PHASE_DEVGUI, // DevGui_Frame
+    COM_PERF_PHASE_CON,    // console input processing
+    COM_PERF_PHASE_R,      // R_Frame, including the buffer swap
+    COM_PERF_PHASE_FRAME,  // the whole frame, start to end
+
+    // GPU times, filled in a few frames late by R_EndGpuTimerFrame.
+    COM_PERF_PHASE_GPU_FRAME,
+    COM_PERF_PHASE_GPU_CLIENT0,
+    COM_PERF_PHASE_GPU_CLIENT1,
+    COM_PERF_PHASE_GPU_CLIENT2,
+    COM_PERF_PHASE_GPU_CLIENT3,
+    COM_PERF_PHASE_GPU_BSP,
+    COM_PERF_PHASE_GPU_TEXT,
+    COM_PERF_PHASE_GPU_WIREFRAME,
+
+    // Input-to-photon latency, only sampled on frames that consumed input:
+    // from the earliest input event CG_Frame took to when the frame was
+    // submitted, and to when the swap returned.
+    COM_PERF_PHASE_LAT_SUBMIT,
+    COM_PERF_PHASE_LAT_SWAP,
+
+    COM_PERF_PHASE_COUNT
+} ComPerfPhase;
+
+typedef struct ComPerfStats {
+    size_t   samples;
+    uint32_t avg, p50, p95, p99, max; // usec
+} ComPerfStats;
+
+A_EXTERN_C void Com_PerfInit      (void);
+A_EXTERN_C void Com_PerfBeginFrame(void);
+A_EXTERN_C void Com_PerfBeginPhase(ComPerfPhase phase);
+A_EXTERN_C void Com_PerfEndPhase  (ComPerfPhase phase);
+A_EXTERN_C void Com_PerfEndFrame  (void);
+// Records a phase for an already finished frame, as long as it's still in
+// the ring. Used for results that are only available some frames later.
+A_EXTERN_C void Com_PerfRecordLate(uint64_t frame, ComPerfPhase phase,
+                                   uint32_t usec);
+// `usec` is when (by Sys_Microseconds) an input event the current frame
+// consumed happened; the earliest one counts. Submit and swap are marked
+// around the frame's buffer swap, and record the latency phases if any
+// input was marked.
+A_EXTERN_C void Com_PerfMarkInput (uint64_t usec);
+A_EXTERN_C void Com_PerfMarkSubmit(void);
+A_EXTERN_C void Com_PerfMarkSwap  (void);
+
+A_EXTERN_C A_NO_DISCARD const char* Com_PerfPhaseName (ComPerfPhase phase);
+A_EXTERN_C A_NO_DISCARD uint64_t    Com_PerfFrameCount(void);
+// Copies the last (at most) `n` samples for `phase` into `usec`, oldest
+// first, and returns how many were copied. Frames that have no sample for
+// `phase` (yet) read as 0.
+A_EXTERN_C size_t Com_PerfHistory (ComPerfPhase phase,
+                                   A_OUT uint32_t* usec, size_t n);
+A_EXTERN_C bool   Com_PerfGetStats(ComPerfPhase phase,
+                                   A_OUT ComPerfStats* stats);
+// The sample for `phase` in `frame`. Returns false if the frame isn't in
+// the ring anymore (or yet), or has no sample for `phase`.
+A_EXTERN_C bool   Com_PerfGetSample(uint64_t frame, ComPerfPhase phase,
+                                    A_OUT uint32_t* usec);
+// Stats over samples kept somewhere other than the ring, e.g. for longer
+// than it holds. Sorts `usec`. `n` must be at least 1.
+A_EXTERN_C void   Com_PerfComputeStats(A_INOUT uint32_t* usec, size_t n,
+                                       A_OUT ComPerfStats* stats);
+A_EXTERN_C bool   Com_PerfDumpCsv (const char* path);
+
+A_EXTERN_C void Com_PerfShutdown(void);
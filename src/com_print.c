@@ -4,15 +4,114 @@
 #include <stdarg.h>
 #include <stdio.h>
 
+#include "acommon/a_atomic.h"
 #include "acommon/a_string.h"
 
+#include "cmd_commands.h"
 #include "devcon.h"
 #include "sys.h"
 
-void Com_PrintMessage(print_msg_dest_t dest, const char* msg) {
-    if (msg == NULL)
-        return;
+#if !A_TARGET_PLATFORM_IS_XBOX
+#define COM_LOG_RING_SIZE (1024 * 1024)
+#else
+#define COM_LOG_RING_SIZE (64 * 1024)
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+#define COM_LOG_RING_MASK (COM_LOG_RING_SIZE - 1)
+#define COM_LOG_MAX_MSG   4096
+
+// How often a line that keeps repeating gets its count written.
+#define COM_LOG_REPEAT_MSEC 1000
+// How many times the logger thread yields, with nothing to do, before it
+// starts sleeping, so a burst doesn't fill the ring while it's asleep.
+#define COM_LOG_IDLE_YIELDS 64
+
+#define COM_LOG_BENCH_DEFAULT 1000000
+#define COM_LOG_BENCH_THREADS 4
+
+// The queue is a ring of variable-length records. A producer claims space
+// by advancing `head` with a CAS, writes its record, then commits it by
+// storing its size, so the logger thread stops at the first record that's
+// claimed but not yet committed. The logger zeroes every record it's
+// consumed before advancing `tail` past it, which is what lets a zero size
+// mean "not committed" the next time round.
+//
+// Records are padded to a multiple of the header's size, so there's always
+// room for a header before the end of the ring. A record that wouldn't fit
+// there claims the rest of the ring as well, as padding, and starts over at
+// the beginning.
+typedef struct ComLogRecord {
+    volatile int32_t size;    // the whole record, or 0 until it's committed
+    uint16_t         len;     // the text, which follows NUL-terminated
+    uint8_t          dest;    // print_msg_dest_t
+    uint8_t          level;   // ComLogLevel
+    uint8_t          channel; // ComLogChannel
+    uint8_t          flags;
+    uint8_t          reserved[6];
+} ComLogRecord;
+A_STATIC_ASSERT(sizeof(ComLogRecord) == 16);
+A_STATIC_ASSERT((COM_LOG_RING_SIZE & COM_LOG_RING_MASK) == 0);
 
+#define COM_LOG_RECORD_PAD     0x01
+#define COM_LOG_RECORD_DISCARD 0x02 // counted, not written, for log_bench
+
+static const char* s_logChannelNames[COM_LOG_CH_COUNT] = {
+    "com", "cmd", "r", "cl", "in", "fs", "vm", "sys"
+};
+static const char* s_logLevelNames[COM_LOG_LEVEL_COUNT] = {
+    "debug", "info", "warn", "error", "none"
+};
+
+static struct {
+    volatile size_t  head;
+    volatile size_t  tail;
+    volatile int32_t dropped;
+    volatile int32_t running;
+    volatile int32_t stop;
+    SysThread*       thread;
+
+    volatile int32_t file_lock;
+    FILE*            file;
+    bool             file_line_start;
+
+    // The logger thread's last line, for collapsing repeats of it.
+    char             last[COM_LOG_MAX_MSG];
+    size_t           last_len;
+    int              last_dest;
+    int              last_channel;
+    int              repeats;
+    uint64_t         repeat_start;
+    uint64_t         dropped_report;
+
+    volatile int32_t discarded;
+    // Only ever accessed through 4-byte fields, so it only needs the
+    // alignment of the ones before it.
+    unsigned char    ring[COM_LOG_RING_SIZE];
+} s_log;
+
+#if _DEBUG
+#define COM_LOG_DEFAULT_LEVEL COM_LOG_DEBUG
+#else
+#define COM_LOG_DEFAULT_LEVEL COM_LOG_INFO
+#endif // _DEBUG
+
+static volatile int32_t s_logLevels[COM_LOG_CH_COUNT] = {
+    COM_LOG_DEFAULT_LEVEL, COM_LOG_DEFAULT_LEVEL, COM_LOG_DEFAULT_LEVEL,
+    COM_LOG_DEFAULT_LEVEL, COM_LOG_DEFAULT_LEVEL, COM_LOG_DEFAULT_LEVEL,
+    COM_LOG_DEFAULT_LEVEL, COM_LOG_DEFAULT_LEVEL
+};
+A_STATIC_ASSERT(COM_LOG_CH_COUNT == 8);
+
+// Each thread formats into its own buffer, so formatting never contends.
+static A_THREAD_LOCAL char s_logFormatBuf[COM_LOG_MAX_MSG];
+
+static void Com_LogLevel_f(void);
+static void Com_LogFile_f (void);
+static void Com_LogBench_f(void);
+static int  Com_LogThreadMain(void* arg);
+
+// ============================================================================
+// Writing
+static void Com_LogWriteDest(int dest, const char* msg) {
     if (dest == CON_DEST_CLIENT)
         dest = CON_DEST_DEVCON;
 
@@ -26,34 +125,527 @@ void Com_PrintMessage(print_msg_dest_t dest, const char* msg) {
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 }
 
+// Each line in the log file starts with when it was written and where it
+// came from.
+static void Com_LogWriteFile(int channel, int level, const char* msg,
+                             size_t len
+) {
+    A_spin_lock(&s_log.file_lock);
+    if (s_log.file == NULL) {
+        A_spin_unlock(&s_log.file_lock);
+        return;
+    }
+
+    const char* p   = msg;
+    const char* end = msg + len;
+    while (p < end) {
+        if (s_log.file_line_start) {
+            fprintf(s_log.file, "[%10.3f] [%s] [%s] ",
+                    (double)Sys_Milliseconds() / 1000.0,
+                    s_logChannelNames[channel], s_logLevelNames[level]);
+        }
+        const char* nl = (const char*)A_memchr(p, '\n', (size_t)(end - p));
+        const char* line_end = nl ? nl + 1 : end;
+        fwrite(p, 1, (size_t)(line_end - p), s_log.file);
+        s_log.file_line_start = nl != NULL;
+        p = line_end;
+    }
+    A_spin_unlock(&s_log.file_lock);
+}
+
+static void Com_LogWrite(int dest, int channel, int level, const char* msg,
+                         size_t len
+) {
+    Com_LogWriteDest(dest, msg);
+    Com_LogWriteFile(channel, level, msg, len);
+}
+
+static void Com_LogWriteRepeats(void) {
+    if (s_log.repeats == 0)
+        return;
+
+    char msg[64];
+    int len = A_snprintf(msg, sizeof(msg),
+                         "(last message repeated %d more times)\n",
+                         s_log.repeats);
+    Com_LogWrite(s_log.last_dest, s_log.last_channel, COM_LOG_INFO, msg,
+                 (size_t)len);
+    s_log.repeats      = 0;
+    s_log.repeat_start = Sys_Milliseconds();
+}
+
+// Only whole lines are collapsed; Com_Print's pieces of one are written as
+// they are.
+static void Com_LogConsume(const ComLogRecord* r) {
+    const char* text = (const char*)(r + 1);
+    if (r->len > 0 && text[r->len - 1] == '\n' &&
+        r->len == s_log.last_len && r->dest == s_log.last_dest &&
+        r->channel == s_log.last_channel && A_memcmp(text, s_log.last, r->len)
+    ) {
+        if (s_log.repeats++ == 0)
+            s_log.repeat_start = Sys_Milliseconds();
+        else if (Sys_Milliseconds() - s_log.repeat_start >= COM_LOG_REPEAT_MSEC)
+            Com_LogWriteRepeats();
+        return;
+    }
+
+    Com_LogWriteRepeats();
+    Com_LogWrite(r->dest, r->channel, r->level, text, r->len);
+    A_memcpy(s_log.last, text, r->len);
+    s_log.last_len     = r->len;
+    s_log.last_dest    = r->dest;
+    s_log.last_channel = r->channel;
+}
+
+// Consumes every committed record. Returns how many there were.
+static size_t Com_LogDrain(void) {
+    size_t count = 0;
+    size_t tail  = s_log.tail;
+    while (tail != A_atomic_load_size(&s_log.head)) {
+        ComLogRecord* r = (ComLogRecord*)&s_log.ring[tail & COM_LOG_RING_MASK];
+        int32_t size = A_atomic_load32(&r->size);
+        // Claimed, but its producer hasn't finished writing it.
+        if (size == 0)
+            break;
+
+        if (r->flags & COM_LOG_RECORD_DISCARD)
+            A_atomic_fetch_add32(&s_log.discarded, 1);
+        else if (!(r->flags & COM_LOG_RECORD_PAD))
+            Com_LogConsume(r);
+
+        A_memset(r, 0, (size_t)size);
+        tail += (size_t)size;
+        A_atomic_fetch_add_size(&s_log.tail, (size_t)size);
+        count++;
+    }
+    return count;
+}
+
+// Like repeats, drops are only reported once a second, or the reports would
+// flood the console as well.
+static void Com_LogWriteDropped(bool force) {
+    if (A_atomic_load32(&s_log.dropped) == 0)
+        return;
+    if (!force &&
+        Sys_Milliseconds() - s_log.dropped_report < COM_LOG_REPEAT_MSEC)
+        return;
+
+    int32_t dropped = A_atomic_exchange32(&s_log.dropped, 0);
+    Com_LogWriteRepeats();
+    char msg[64];
+    int len = A_snprintf(msg, sizeof(msg),
+                         "(%d log messages dropped, queue full)\n", dropped);
+    Com_LogWrite(CON_DEST_ERR, COM_LOG_CH_COM, COM_LOG_WARN, msg,
+                 (size_t)len);
+    s_log.last_len       = 0;
+    s_log.dropped_report = Sys_Milliseconds();
+}
+
+static int Com_LogThreadMain(void* arg) {
+    A_UNUSED(arg);
+    int idle = 0;
+    for (;;) {
+        size_t drained = Com_LogDrain();
+        Com_LogWriteDropped(false);
+        if (drained > 0) {
+            idle = 0;
+            continue;
+        }
+
+        if (s_log.repeats > 0 &&
+            Sys_Milliseconds() - s_log.repeat_start >= COM_LOG_REPEAT_MSEC)
+            Com_LogWriteRepeats();
+
+        if (A_atomic_load32(&s_log.stop) &&
+            A_atomic_load_size(&s_log.head) == s_log.tail)
+            break;
+
+        Sys_Sleep(idle++ < COM_LOG_IDLE_YIELDS ? 0 : 1);
+    }
+    Com_LogWriteRepeats();
+    Com_LogWriteDropped(true);
+    A_spin_lock(&s_log.file_lock);
+    if (s_log.file)
+        fflush(s_log.file);
+    A_spin_unlock(&s_log.file_lock);
+    return 0;
+}
+// ============================================================================
+
+// ============================================================================
+// Queueing
+static size_t Com_LogRecordSize(size_t len) {
+    size_t n = sizeof(ComLogRecord) + len + 1;
+    return (n + sizeof(ComLogRecord) - 1) & ~(sizeof(ComLogRecord) - 1);
+}
+
+// Returns false if there wasn't room.
+static bool Com_LogPush(int dest, int channel, int level, int flags,
+                        const char* text, size_t len
+) {
+    size_t size = Com_LogRecordSize(len);
+    size_t head, off, pad;
+    for (;;) {
+        head = A_atomic_load_size(&s_log.head);
+        size_t tail = A_atomic_load_size(&s_log.tail);
+        off = head & COM_LOG_RING_MASK;
+        pad = COM_LOG_RING_SIZE - off < size ? COM_LOG_RING_SIZE - off : 0;
+        if (head + pad + size - tail > COM_LOG_RING_SIZE) {
+            A_atomic_fetch_add32(&s_log.dropped, 1);
+            return false;
+        }
+        if (A_atomic_cas_size(&s_log.head, head, head + pad + size))
+            break;
+    }
+
+    if (pad > 0) {
+        ComLogRecord* p = (ComLogRecord*)&s_log.ring[off];
+        p->flags = COM_LOG_RECORD_PAD;
+        A_atomic_store32(&p->size, (int32_t)pad);
+        off = 0;
+    }
+
+    ComLogRecord* r = (ComLogRecord*)&s_log.ring[off];
+    r->len     = (uint16_t)len;
+    r->dest    = (uint8_t)dest;
+    r->level   = (uint8_t)level;
+    r->channel = (uint8_t)channel;
+    r->flags   = (uint8_t)flags;
+    A_memcpy(r + 1, text, len);
+    ((char*)(r + 1))[len] = '\0';
+    A_atomic_store32(&r->size, (int32_t)size);
+    return true;
+}
+
+static void Com_LogMessage(int dest, int channel, int level, int flags,
+                           const char* text, size_t len
+) {
+    if (!A_atomic_load32(&s_log.running)) {
+        if (!(flags & COM_LOG_RECORD_DISCARD))
+            Com_LogWrite(dest, channel, level, text, len);
+        return;
+    }
+    Com_LogPush(dest, channel, level, flags, text, len);
+}
+
+static void Com_LogVFormat(int dest, int channel, int level, int flags,
+                           bool newline, const char* fmt, va_list ap
+) {
+    char* buf = s_logFormatBuf;
+    int len = A_vsnprintf(buf, COM_LOG_MAX_MSG - 1, fmt, ap);
+    if (len < 0)
+        return;
+
+    // Truncated.
+    if (len > COM_LOG_MAX_MSG - 2)
+        len = COM_LOG_MAX_MSG - 2;
+    if (newline)
+        buf[len++] = '\n';
+    buf[len] = '\0';
+    Com_LogMessage(dest, channel, level, flags, buf, (size_t)len);
+}
+
+static void Com_LogFormat(int dest, int channel, int level, int flags,
+                          bool newline, const char* fmt, ...
+) {
+    va_list ap;
+    va_start(ap, fmt);
+    Com_LogVFormat(dest, channel, level, flags, newline, fmt, ap);
+    va_end(ap);
+}
+
+static int Com_LogDest(ComLogLevel level) {
+    return level >= COM_LOG_ERROR ? CON_DEST_ERR : CON_DEST_CLIENT;
+}
+
+bool Com_LogEnabled(ComLogChannel channel, ComLogLevel level) {
+    assert(channel >= 0 && channel < COM_LOG_CH_COUNT);
+    return (int32_t)level >= s_logLevels[channel];
+}
+
+void Com_Log(ComLogChannel channel, ComLogLevel level, const char* fmt, ...) {
+    if (!Com_LogEnabled(channel, level))
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    Com_LogVFormat(Com_LogDest(level), channel, level, 0, false, fmt, ap);
+    va_end(ap);
+}
+
+void Com_Logln(ComLogChannel channel, ComLogLevel level, const char* fmt, ...) {
+    if (!Com_LogEnabled(channel, level))
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    Com_LogVFormat(Com_LogDest(level), channel, level, 0, true, fmt, ap);
+    va_end(ap);
+}
+
+void Com_LogFlush(void) {
+    if (!A_atomic_load32(&s_log.running))
+        return;
+
+    size_t head = A_atomic_load_size(&s_log.head);
+    while (A_atomic_load_size(&s_log.tail) < head)
+        Sys_Sleep(0);
+}
+// ============================================================================
+
+void Com_LogInit(void) {
+    assert(!s_log.running);
+    s_log.file_line_start = true;
+    s_log.last_len        = 0;
+    s_log.repeats         = 0;
+    A_atomic_store32(&s_log.stop, 0);
+    s_log.thread = Sys_SpawnThread("logger", Com_LogThreadMain, NULL);
+    // Printing just stays synchronous.
+    if (s_log.thread)
+        A_atomic_store32(&s_log.running, 1);
+
+    Cmd_AddCommand("log_level", Com_LogLevel_f);
+    Cmd_AddCommand("log_file",  Com_LogFile_f );
+    Cmd_AddCommand("log_bench", Com_LogBench_f);
+}
+
+void Com_LogShutdown(void) {
+    Cmd_RemoveCommand("log_level");
+    Cmd_RemoveCommand("log_file");
+    Cmd_RemoveCommand("log_bench");
+
+    if (s_log.thread) {
+        // Anything printed from here on is written straight away, so it
+        // can't race the logger thread's last writes.
+        A_atomic_store32(&s_log.running, 0);
+        A_atomic_store32(&s_log.stop, 1);
+        Sys_JoinThread(s_log.thread);
+        s_log.thread = NULL;
+    }
+
+    A_spin_lock(&s_log.file_lock);
+    if (s_log.file) {
+        fclose(s_log.file);
+        s_log.file = NULL;
+    }
+    A_spin_unlock(&s_log.file_lock);
+}
+
+// ============================================================================
+// Commands
+static int Com_LogFindName(const char** names, int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (A_cstricmp(names[i], name))
+            return i;
+    }
+    return -1;
+}
+
+static void Com_LogLevel_f(void) {
+    int argc = Cmd_Argc();
+    if (argc == 1) {
+        for (int i = 0; i < COM_LOG_CH_COUNT; i++) {
+            Com_Println(CON_DEST_CLIENT, "%-4s %s", s_logChannelNames[i],
+                        s_logLevelNames[s_logLevels[i]]);
+        }
+        return;
+    }
+
+    int level = Com_LogFindName(s_logLevelNames, COM_LOG_LEVEL_COUNT,
+                                Cmd_Argv(argc - 1));
+    int channel = argc == 3 ?
+        Com_LogFindName(s_logChannelNames, COM_LOG_CH_COUNT, Cmd_Argv(1)) : 0;
+    if (argc > 3 || level < 0 || channel < 0) {
+        Com_Println(CON_DEST_CLIENT,
+                    "USAGE: log_level [channel] <debug|info|warn|error|none>");
+        return;
+    }
+
+    for (int i = 0; i < COM_LOG_CH_COUNT; i++) {
+        if (argc == 2 || i == channel)
+            A_atomic_store32(&s_logLevels[i], level);
+    }
+}
+
+static void Com_LogFile_f(void) {
+    if (Cmd_Argc() > 2) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: log_file [path]");
+        return;
+    }
+
+    FILE* f = NULL;
+    if (Cmd_Argc() == 2) {
+        f = fopen(Cmd_Argv(1), "a");
+        if (f == NULL) {
+            Com_Println(CON_DEST_CLIENT, "log_file: couldn't open '%s'.",
+                        Cmd_Argv(1));
+            return;
+        }
+    }
+
+    // Everything already queued goes to the old file.
+    Com_LogFlush();
+    A_spin_lock(&s_log.file_lock);
+    FILE* old = s_log.file;
+    s_log.file            = f;
+    s_log.file_line_start = true;
+    A_spin_unlock(&s_log.file_lock);
+    if (old)
+        fclose(old);
+}
+
+typedef struct ComLogBenchThread {
+    SysThread* thread;
+    int        count;
+    int        id;
+} ComLogBenchThread;
+
+static void Com_LogBenchPush(int id, int i) {
+    Com_LogFormat(CON_DEST_CLIENT, COM_LOG_CH_COM, COM_LOG_INFO,
+                  COM_LOG_RECORD_DISCARD, true,
+                  "log_bench: thread %d, message %d, %.3f", id, i,
+                  (double)(i & 1023) / 7.0);
+}
+
+static int Com_LogBenchThreadMain(void* arg) {
+    ComLogBenchThread* t = (ComLogBenchThread*)arg;
+    for (int i = 0; i < t->count; i++)
+        Com_LogBenchPush(t->id, i);
+    return 0;
+}
+
+static void Com_LogBenchReport(const char* what, uint64_t ns, int count) {
+    Com_Println(CON_DEST_CLIENT, "log_bench: %-22s %8.1f ns a call", what,
+                (double)ns / (double)count);
+}
+
+// Times the calling thread's cost of each kind of message. The benchmark's
+// own messages are queued like any others but the logger thread throws them
+// away instead of writing them.
+static void Com_LogBench_f(void) {
+    int count = COM_LOG_BENCH_DEFAULT;
+    if (Cmd_Argc() > 2 ||
+        (Cmd_Argc() == 2 && (!A_atoi(Cmd_Argv(1), &count) || count < 1))
+    ) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: log_bench [count]");
+        return;
+    }
+    if (!A_atomic_load32(&s_log.running)) {
+        Com_Println(CON_DEST_CLIENT, "log_bench: the logger isn't running.");
+        return;
+    }
+
+    // A disabled message is one compare. The channel's silenced for the
+    // loop, so anything else on it in the meantime is lost.
+    int32_t level = s_logLevels[COM_LOG_CH_SYS];
+    A_atomic_store32(&s_logLevels[COM_LOG_CH_SYS], COM_LOG_NONE);
+    uint64_t start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++)
+        Com_Logln(COM_LOG_CH_SYS, COM_LOG_ERROR, "log_bench: %d", i);
+    Com_LogBenchReport("filtered", Sys_Nanoseconds() - start, count);
+    A_atomic_store32(&s_logLevels[COM_LOG_CH_SYS], level);
+
+    char buf[256];
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++) {
+        A_snprintf(buf, sizeof(buf), "log_bench: thread %d, message %d, %.3f",
+                   0, i, (double)(i & 1023) / 7.0);
+    }
+    Com_LogBenchReport("formatting only", Sys_Nanoseconds() - start, count);
+
+    Com_LogFlush();
+    A_atomic_store32(&s_log.discarded, 0);
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++)
+        Com_LogBenchPush(0, i);
+    uint64_t queued = Sys_Nanoseconds() - start;
+    Com_LogFlush();
+    uint64_t drained = Sys_Nanoseconds() - start;
+    Com_LogBenchReport("queued, 1 thread", queued, count);
+    Com_Println(CON_DEST_CLIENT,
+                "log_bench: all written after %.2f ms, %d of %d dropped",
+                (double)drained / 1000000.0,
+                count - A_atomic_load32(&s_log.discarded),
+                count);
+
+    ComLogBenchThread threads[COM_LOG_BENCH_THREADS];
+    A_atomic_store32(&s_log.discarded, 0);
+    int spawned = 0;
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < COM_LOG_BENCH_THREADS; i++) {
+        threads[i].count  = count / COM_LOG_BENCH_THREADS;
+        threads[i].id     = i + 1;
+        threads[i].thread = Sys_SpawnThread("log_bench",
+                                            Com_LogBenchThreadMain,
+                                            &threads[i]);
+        if (threads[i].thread)
+            spawned++;
+    }
+    for (int i = 0; i < COM_LOG_BENCH_THREADS; i++) {
+        if (threads[i].thread)
+            Sys_JoinThread(threads[i].thread);
+    }
+    queued = Sys_Nanoseconds() - start;
+    Com_LogFlush();
+    int total = spawned * (count / COM_LOG_BENCH_THREADS);
+    if (total > 0) {
+        char what[32];
+        A_snprintf(what, sizeof(what), "queued, %d threads", spawned);
+        Com_LogBenchReport(what, queued * spawned, total);
+        Com_Println(CON_DEST_CLIENT, "log_bench: %d of %d dropped",
+                    total - A_atomic_load32(&s_log.discarded), total);
+    }
+}
+// ============================================================================
+
+void Com_PrintMessage(print_msg_dest_t dest, const char* msg) {
+    if (msg == NULL)
+        return;
+
+    int level = dest == CON_DEST_ERR ? COM_LOG_ERROR : COM_LOG_INFO;
+    if (!Com_LogEnabled(COM_LOG_CH_COM, (ComLogLevel)level))
+        return;
+
+    Com_LogMessage(dest, COM_LOG_CH_COM, level, 0, msg, A_cstrlen(msg));
+}
+
 char* Com_VFormat(char* buf, size_t n, const char* fmt, va_list ap) {
     if (A_vsnprintf(buf, n, fmt, ap) < 0)
         return NULL;
     return buf;
 }
 
-static char s_printBuf[4096];
+static void Com_VPrint(print_msg_dest_t dest, int level, bool newline,
+                       const char* fmt, va_list ap
+) {
+    if (!Com_LogEnabled(COM_LOG_CH_COM, (ComLogLevel)level))
+        return;
+
+    Com_LogVFormat(dest, COM_LOG_CH_COM, level, 0, newline, fmt, ap);
+}
+
 void Com_Print(print_msg_dest_t dest, const char* fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
-    Com_PrintMessage(dest, 
-        Com_VFormat(s_printBuf, sizeof(s_printBuf), fmt, ap));
+    Com_VPrint(dest, dest == CON_DEST_ERR ? COM_LOG_ERROR : COM_LOG_INFO,
+               false, fmt, ap);
+    va_end(ap);
 }
 
 void Com_Println(print_msg_dest_t dest, const char* fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
-    Com_PrintMessage(dest, 
-        Com_VFormat(s_printBuf, sizeof(s_printBuf), fmt, ap));
-    Com_PrintMessage(dest, "\n");
+    Com_VPrint(dest, dest == CON_DEST_ERR ? COM_LOG_ERROR : COM_LOG_INFO,
+               true, fmt, ap);
+    va_end(ap);
 }
 
 void Com_DPrint(print_msg_dest_t dest, const char* fmt, ...) {
 #if _DEBUG
     va_list ap;
     va_start(ap, fmt);
-    Com_PrintMessage(dest, 
-        Com_VFormat(s_printBuf, sizeof(s_printBuf), fmt, ap));
+    Com_VPrint(dest, COM_LOG_DEBUG, false, fmt, ap);
+    va_end(ap);
 #else
     A_UNUSED(dest);
     A_UNUSED(fmt);
@@ -64,20 +656,33 @@ void Com_DPrintln(print_msg_dest_t dest, const char* fmt, ...) {
 #if _DEBUG
     va_list ap;
     va_start(ap, fmt);
-    Com_PrintMessage(dest, 
-        Com_VFormat(s_printBuf, sizeof(s_printBuf), fmt, ap));
-    Com_PrintMessage(dest, "\n");
+    Com_VPrint(dest, COM_LOG_DEBUG, true, fmt, ap);
+    va_end(ap);
 #else
     A_UNUSED(dest);
     A_UNUSED(fmt);
 #endif // _DEBUG
 }
 
+// Errors are written straight away, after everything queued before them,
+// since the process is about to exit.
+static void Com_VError(bool newline, const char* fmt, va_list ap) {
+    Com_LogFlush();
+    char* buf = s_logFormatBuf;
+    if (Com_VFormat(buf, COM_LOG_MAX_MSG, fmt, ap) == NULL)
+        return;
+
+    Com_LogWrite(CON_DEST_ERR, COM_LOG_CH_COM, COM_LOG_ERROR, buf,
+                 A_cstrlen(buf));
+    if (newline)
+        Com_LogWrite(CON_DEST_ERR, COM_LOG_CH_COM, COM_LOG_ERROR, "\n", 1);
+}
+
 A_NO_RETURN Com_Error(int ec, const char* fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
-    Com_PrintMessage(CON_DEST_ERR, 
-        Com_VFormat(s_printBuf, sizeof(s_printBuf), fmt, ap));
+    Com_VError(false, fmt, ap);
+    va_end(ap);
 #if _DEBUG
     assert(false);
 #endif // _DEBUG
@@ -87,9 +692,8 @@ A_NO_RETURN Com_Error(int ec, const char* fmt, ...) {
 void Com_Errorln(int ec, const char* fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
-    Com_PrintMessage(CON_DEST_ERR, 
-        Com_VFormat(s_printBuf, sizeof(s_printBuf), fmt, ap));
-    Com_PrintMessage(CON_DEST_ERR, "\n");
+    Com_VError(true, fmt, ap);
+    va_end(ap);
 #if _DEBUG
     assert(false);
 #endif // _DEBUG
@@ -10,6 +10,54 @@ typedef enum print_msg_dest_t {
     CON_DEST_ERR,
 } print_msg_dest_t;
 
+typedef enum ComLogLevel {
+    COM_LOG_DEBUG,
+    COM_LOG_INFO,
+    COM_LOG_WARN,
+    COM_LOG_ERROR,
+    COM_LOG_NONE, // only for filtering, to silence a channel
+    COM_LOG_LEVEL_COUNT
+} ComLogLevel;
+
+typedef enum ComLogChannel {
+    COM_LOG_CH_COM,
+    COM_LOG_CH_CMD,
+    COM_LOG_CH_R,
+    COM_LOG_CH_CL,
+    COM_LOG_CH_IN,
+    COM_LOG_CH_FS,
+    COM_LOG_CH_VM,
+    COM_LOG_CH_SYS,
+    COM_LOG_CH_COUNT
+} ComLogChannel;
+
+// Once Com_LogInit has run, printing only formats the message, on the
+// calling thread, and queues it for the logger thread to write to the
+// console, stderr and the log file, so it's safe from any thread and never
+// waits on I/O. If the queue's full, the message is dropped and counted.
+// Before Com_LogInit and after Com_LogShutdown, messages are written
+// straight away instead.
+//
+// Messages below their channel's level (`log_level`) aren't formatted at
+// all. A line repeated back to back is only written once, followed by how
+// many times it was repeated, at most once a second.
+A_EXTERN_C void        Com_LogInit     (void);
+// Waits until everything queued so far has been written.
+A_EXTERN_C void        Com_LogFlush    (void);
+A_EXTERN_C void        Com_LogShutdown (void);
+A_EXTERN_C bool        Com_LogEnabled  (ComLogChannel    channel,
+                                        ComLogLevel      level);
+A_EXTERN_C void        Com_Log         (ComLogChannel    channel,
+                                        ComLogLevel      level,
+                                        const char* fmt, ...);
+A_EXTERN_C void        Com_Logln       (ComLogChannel    channel,
+                                        ComLogLevel      level,
+                                        const char* fmt, ...);
+
+// Com_Print* log to COM_LOG_CH_COM, at COM_LOG_ERROR for CON_DEST_ERR and
+// COM_LOG_INFO otherwise. Com_DPrint* log at COM_LOG_DEBUG and are compiled
+// out of release builds.
+
 A_EXTERN_C void        Com_PrintMessage(print_msg_dest_t dest, 
                                         const char* msg);
 A_EXTERN_C void        Com_Print       (print_msg_dest_t dest, 
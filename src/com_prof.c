@@ -0,0 +1,340 @@
+#include "com_prof.h"
+
+#include <assert.h>
+
+#include "acommon/a_atomic.h"
+#include "acommon/a_string.h"
+#include "acommon/z_mem.h"
+
+#include "cmd_commands.h"
+#include "com_print.h"
+#include "fs_files.h"
+
+#if COM_PROF_ENABLED
+#define COM_PROF_DEFAULT_FRAMES 60
+#define COM_PROF_DEFAULT_PATH   "trace.json"
+
+typedef struct ComProfEvent {
+    uint64_t           ns;
+    const ComProfZone* zone; // NULL for the end of a zone
+} ComProfEvent;
+
+// Each thread only ever writes its own buffer, and only the main thread
+// reads them, once the capture has stopped. `count` is published after the
+// event it covers has been written, so the reader never sees a partial one.
+typedef struct ComProfThread {
+    uint64_t         tid;
+    const char*      name;
+    int32_t          capture; // which capture `events` belongs to
+    int32_t          depth;
+    int32_t          dropped;
+    volatile int32_t count;
+    ComProfEvent     events[COM_PROF_MAX_EVENTS];
+} ComProfThread;
+
+volatile bool com_profCapturing;
+
+static void* volatile   s_profThreads[COM_PROF_MAX_THREADS];
+static volatile int32_t s_profThreadCount;
+static volatile int32_t s_profCaptureId;
+static A_THREAD_LOCAL ComProfThread* s_profThread;
+static A_THREAD_LOCAL bool           s_profThreadRejected;
+
+static int      s_profPendingFrames;
+static int      s_profFramesLeft;
+static uint64_t s_profCaptureStart;
+static char     s_profPath[A_OS_MAX_PATH];
+
+static void Com_ProfCapture_f(void);
+
+void Com_ProfInit(void) {
+    com_profCapturing   = false;
+    s_profPendingFrames = 0;
+    s_profFramesLeft    = 0;
+    Com_ProfSetThreadName("main");
+    Cmd_AddCommand("prof_capture", Com_ProfCapture_f);
+}
+
+static ComProfThread* Com_ProfGetThread(void) {
+    if (s_profThread)
+        return s_profThread;
+
+    if (s_profThreadRejected)
+        return NULL;
+
+    int32_t slot = A_atomic_fetch_add32(&s_profThreadCount, 1);
+    if (slot >= COM_PROF_MAX_THREADS) {
+        s_profThreadRejected = true;
+        return NULL;
+    }
+
+    ComProfThread* t = (ComProfThread*)Z_Zalloc(sizeof(*t));
+    t->tid     = Sys_ThreadId();
+    t->capture = -1;
+    A_atomic_store_ptr(&s_profThreads[slot], t);
+    s_profThread = t;
+    return t;
+}
+
+void Com_ProfSetThreadName(const char* name) {
+    ComProfThread* t = Com_ProfGetThread();
+    if (t)
+        t->name = name;
+}
+
+// Lazily resets the calling thread's buffer the first time it records an
+// event in a new capture, so nobody else ever has to touch it.
+static void Com_ProfSyncCapture(ComProfThread* t) {
+    int32_t capture = A_atomic_load32(&s_profCaptureId);
+    if (t->capture == capture)
+        return;
+
+    t->capture = capture;
+    t->depth   = 0;
+    t->dropped = 0;
+    A_atomic_store32(&t->count, 0);
+}
+
+static void Com_ProfPush(ComProfThread* t, const ComProfZone* zone) {
+    int32_t count = t->count;
+    if (count >= COM_PROF_MAX_EVENTS) {
+        t->dropped++;
+        return;
+    }
+
+    t->events[count].ns   = Sys_Nanoseconds();
+    t->events[count].zone = zone;
+    A_atomic_store32(&t->count, count + 1);
+}
+
+void Com_ProfBeginZone(const ComProfZone* zone) {
+    ComProfThread* t = Com_ProfGetThread();
+    if (!t)
+        return;
+
+    Com_ProfSyncCapture(t);
+    t->depth++;
+    Com_ProfPush(t, zone);
+}
+
+void Com_ProfEndZone(void) {
+    ComProfThread* t = Com_ProfGetThread();
+    if (!t)
+        return;
+
+    Com_ProfSyncCapture(t);
+    // The zone was opened before the capture started.
+    if (t->depth == 0)
+        return;
+
+    t->depth--;
+    Com_ProfPush(t, NULL);
+}
+
+typedef struct ComProfWriter {
+    StreamFile f;
+    bool       ok;
+    size_t     len;
+    char       buf[16384];
+} ComProfWriter;
+static ComProfWriter s_profWriter;
+
+static void Com_ProfFlush(ComProfWriter* w) {
+    if (w->ok && w->len > 0)
+        w->ok = FS_WriteStream(&w->f, w->buf, w->len);
+    w->len = 0;
+}
+
+static void Com_ProfWrite(ComProfWriter* w, const char* s, size_t n) {
+    if (w->len + n > sizeof(w->buf))
+        Com_ProfFlush(w);
+    assert(n <= sizeof(w->buf));
+    A_memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+static void Com_ProfWriteCstr(ComProfWriter* w, const char* s) {
+    Com_ProfWrite(w, s, A_cstrlen(s));
+}
+
+// __FILE__ contains backslashes on Windows.
+static void Com_ProfWriteJsonString(ComProfWriter* w, const char* s) {
+    Com_ProfWrite(w, "\"", 1);
+    for (const char* p = s; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\')
+            Com_ProfWrite(w, "\\", 1);
+        Com_ProfWrite(w, p, 1);
+    }
+    Com_ProfWrite(w, "\"", 1);
+}
+
+static bool Com_ProfWriteTrace(const char* path,
+                               A_OUT size_t* events, A_OUT size_t* dropped
+) {
+    *events  = 0;
+    *dropped = 0;
+
+    ComProfWriter* w = &s_profWriter;
+    w->f   = FS_StreamFile(path, FS_SEEK_BEGIN, FS_STREAM_WRITE_NEW, 0);
+    w->ok  = w->f.f != NULL;
+    w->len = 0;
+    if (!w->ok)
+        return false;
+
+    int32_t capture = A_atomic_load32(&s_profCaptureId);
+    int32_t threads = A_atomic_load32(&s_profThreadCount);
+    if (threads > COM_PROF_MAX_THREADS)
+        threads = COM_PROF_MAX_THREADS;
+
+    char line[256];
+    bool first = true;
+    Com_ProfWriteCstr(w, "{\"traceEvents\":[\n");
+    for (int32_t i = 0; i < threads; i++) {
+        ComProfThread* t = (ComProfThread*)A_atomic_load_ptr(
+            &s_profThreads[i]
+        );
+        if (t == NULL)
+            continue;
+
+        unsigned long long tid = (unsigned long long)t->tid;
+        if (t->name) {
+            A_snprintf(line, sizeof(line),
+                       "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                       "\"tid\":%llu,\"args\":{\"name\":",
+                       first ? "" : ",\n", tid);
+            Com_ProfWriteCstr(w, line);
+            Com_ProfWriteJsonString(w, t->name);
+            Com_ProfWriteCstr(w, "}}");
+            first = false;
+        }
+
+        if (t->capture != capture)
+            continue;
+
+        int32_t count = A_atomic_load32(&t->count);
+        for (int32_t j = 0; j < count; j++) {
+            const ComProfEvent* e = &t->events[j];
+            double ts = (double)(e->ns - s_profCaptureStart) / 1000.0;
+            if (e->zone) {
+                A_snprintf(line, sizeof(line), "%s{\"ph\":\"B\",\"name\":",
+                           first ? "" : ",\n");
+                Com_ProfWriteCstr(w, line);
+                Com_ProfWriteJsonString(w, e->zone->name);
+                A_snprintf(line, sizeof(line),
+                           ",\"ts\":%.3f,\"pid\":1,\"tid\":%llu,"
+                           "\"args\":{\"file\":", ts, tid);
+                Com_ProfWriteCstr(w, line);
+                Com_ProfWriteJsonString(w, e->zone->file);
+                A_snprintf(line, sizeof(line), ",\"line\":%d}}",
+                           e->zone->line);
+                Com_ProfWriteCstr(w, line);
+            } else {
+                A_snprintf(line, sizeof(line),
+                           "%s{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,"
+                           "\"tid\":%llu}",
+                           first ? "" : ",\n", ts, tid);
+                Com_ProfWriteCstr(w, line);
+            }
+            first = false;
+        }
+        *events  += count;
+        *dropped += t->dropped;
+    }
+    Com_ProfWriteCstr(w, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    Com_ProfFlush(w);
+    FS_CloseStream(&w->f);
+    return w->ok;
+}
+
+void Com_ProfFrame(void) {
+    if (com_profCapturing) {
+        if (--s_profFramesLeft > 0)
+            return;
+
+        com_profCapturing = false;
+        size_t events = 0, dropped = 0;
+        if (!Com_ProfWriteTrace(s_profPath, &events, &dropped)) {
+            Com_Println(CON_DEST_CLIENT,
+                        "prof_capture: failed to write '%s'.", s_profPath);
+            return;
+        }
+        Com_Println(CON_DEST_CLIENT,
+                    "prof_capture: wrote %zu events to '%s' (%zu dropped).",
+                    events, s_profPath, dropped);
+    } else if (s_profPendingFrames > 0) {
+        s_profFramesLeft    = s_profPendingFrames;
+        s_profPendingFrames = 0;
+        s_profCaptureStart  = Sys_Nanoseconds();
+        A_atomic_fetch_add32(&s_profCaptureId, 1);
+        com_profCapturing   = true;
+    }
+}
+
+bool Com_ProfCapture(int frames, const char* path) {
+    assert(frames > 0);
+    assert(path);
+    if (com_profCapturing || s_profPendingFrames > 0 || frames < 1 || !path)
+        return false;
+
+    A_cstrncpyz(s_profPath, path, sizeof(s_profPath));
+    s_profPendingFrames = frames;
+    return true;
+}
+
+static void Com_ProfCapture_f(void) {
+    int frames = COM_PROF_DEFAULT_FRAMES;
+    if (Cmd_Argc() > 1 && (!A_atoi(Cmd_Argv(1), &frames) || frames < 1)) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: prof_capture [frames] [path]");
+        return;
+    }
+
+    const char* path = Cmd_Argc() > 2 ? Cmd_Argv(2) : COM_PROF_DEFAULT_PATH;
+    if (!Com_ProfCapture(frames, path)) {
+        Com_Println(CON_DEST_CLIENT,
+                    "prof_capture: a capture is already in progress.");
+        return;
+    }
+    Com_Println(CON_DEST_CLIENT, "prof_capture: capturing %d frames.", frames);
+}
+
+void Com_ProfShutdown(void) {
+    Cmd_RemoveCommand("prof_capture");
+    com_profCapturing   = false;
+    s_profPendingFrames = 0;
+
+    // Every other thread has been joined by now.
+    int32_t threads = A_atomic_load32(&s_profThreadCount);
+    if (threads > COM_PROF_MAX_THREADS)
+        threads = COM_PROF_MAX_THREADS;
+    for (int32_t i = 0; i < threads; i++) {
+        void* t = A_atomic_exchange_ptr(&s_profThreads[i], NULL);
+        if (t)
+            Z_Free(t);
+    }
+    A_atomic_store32(&s_profThreadCount, 0);
+    s_profThread         = NULL;
+    s_profThreadRejected = false;
+}
+#else
+void Com_ProfInit(void) {}
+
+void Com_ProfSetThreadName(const char* name) {
+    A_UNUSED(name);
+}
+
+void Com_ProfBeginZone(const ComProfZone* zone) {
+    A_UNUSED(zone);
+}
+
+void Com_ProfEndZone(void) {}
+
+void Com_ProfFrame(void) {}
+
+bool Com_ProfCapture(int frames, const char* path) {
+    A_UNUSED(frames);
+    A_UNUSED(path);
+    return false;
+}
+
+void Com_ProfShutdown(void) {}
+#endif // COM_PROF_ENABLED
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "acommon/acommon.h"
+
+#include "com_defs.h"
+
+// Zones are compiled out entirely unless COM_PROF_ENABLED is set, so they
+// can be left in hot paths. They're off by default on Xbox, where the
+// per-thread event buffers would eat into the 64 MB of RAM.
+#ifndef COM_PROF_ENABLED
+#if !A_TARGET_PLATFORM_IS_XBOX
+#define COM_PROF_ENABLED 1
+#else
+#define COM_PROF_ENABLED 0
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+#endif // COM_PROF_ENABLED
+
+#define COM_PROF_MAX_THREADS 16
+#define COM_PROF_MAX_EVENTS  65536 // per thread, per capture
+
+typedef struct ComProfZone {
+    const char* name;
+    const char* file;
+    int         line;
+} ComProfZone;
+
+#if COM_PROF_ENABLED
+extern volatile bool com_profCapturing;
+
+// Opens a zone named `zone_name` (a string literal) on the calling thread.
+// Every COM_PROF_BEGIN must be closed by a COM_PROF_END in the same scope,
+// including on early returns.
+#define COM_PROF_BEGIN(zone_name)                                              \
+    do {                                                                       \
+        static const ComProfZone s_profZone = {                                \
+            zone_name, __FILE__, __LINE__                                      \
+        };                                                                     \
+        if (com_profCapturing)                                                 \
+            Com_ProfBeginZone(&s_profZone);                                    \
+    } while (0)
+#define COM_PROF_END()                                                         \
+    do {                                                                       \
+        if (com_profCapturing)                                                 \
+            Com_ProfEndZone();                                                 \
+    } while (0)
+#else
+#define COM_PROF_BEGIN(zone_name) ((void)0)
+#define COM_PROF_END()            ((void)0)
+#endif // COM_PROF_ENABLED
+
+A_EXTERN_C void Com_ProfInit         (void);
+// Names the calling thread in captured traces.
+A_EXTERN_C void Com_ProfSetThreadName(const char* name);
+A_EXTERN_C void Com_ProfBeginZone    (const ComProfZone* zone);
+A_EXTERN_C void Com_ProfEndZone      (void);
+// Starts and stops captures. Must be called once per frame, on the main
+// thread, outside of any zone.
+A_EXTERN_C void Com_ProfFrame        (void);
+A_EXTERN_C bool Com_ProfCapture      (int frames, const char* path);
+A_EXTERN_C void Com_ProfShutdown     (void);
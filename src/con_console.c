@@ -1,53 +1,74 @@
 #include "con_console.h"
 
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+
+#include "acommon/a_string.h"
+#include "acommon/z_mem.h"
+
 #include "cmd_commands.h"
+#include "com_defs.h"
 #include "com_print.h"
 #include "dvar.h"
+#include "fs_files.h"
 
-bool Con_ProcessInput(const char* input) {
-    if (!Cmd_TakeInput(input))
-        return false;
+// Sets `d` from the args after its name, or prints it if there aren't any.
+static bool Con_SetDvarFromArgs(dvar_t* d) {
+    const char* argv[4];
+    int argc = 0;
+
+    if (Cmd_Argc() == 1) {
+        Com_Println(CON_DEST_CLIENT, "%s", Dvar_GetString(d));
+        return true;
+    }
+
+    argv[0] = Cmd_Argv(1);
+    argc++;
+
+    if (Dvar_IsVec2(d) || Dvar_IsVec3(d) || Dvar_IsVec4(d)) {
+        argv[1] = Cmd_Argv(2);
+        argc++;
+    }
 
-    void(*fn)(void) = Cmd_FindCommand(Cmd_Argv(0));
+    if (Dvar_IsVec3(d) || Dvar_IsVec4(d)) {
+        argv[2] = Cmd_Argv(3);
+        argc++;
+    }
+
+    if (Dvar_IsVec4(d)) {
+        argv[3] = Cmd_Argv(4);
+        argc++;
+    }
+
+    return Dvar_SetFromString(d, argc, argv);
+}
+
+// Runs the command or sets the dvar the args Cmd_TakeInput split out name.
+static bool Con_ExecuteArgs(void) {
+    if (Cmd_Argc() < 1)
+        return true;
+
+    CmdFn fn = Cmd_FindCommand(Cmd_Argv(0));
     if (fn) {
         fn();
         return true;
-    } else {
-        dvar_t* d = Dvar_Find(Cmd_Argv(0));
-        if (d != NULL) {
-            const char* argv[4];
-            int argc = 0;
-
-            if (Cmd_Argc() == 1) {
-                Com_Println(CON_DEST_CLIENT, "%s", Dvar_GetString(d));
-                return true;
-            }
-            else {
-                argv[0] = Cmd_Argv(1);
-                argc++;
-
-                if (Dvar_IsVec2(d) || Dvar_IsVec3(d) || Dvar_IsVec4(d)) {
-                    argv[1] = Cmd_Argv(2);
-                    argc++;
-                }
-
-                if (Dvar_IsVec3(d) || Dvar_IsVec4(d)) {
-                    argv[2] = Cmd_Argv(3);
-                    argc++;
-                }
-
-                if (Dvar_IsVec4(d)) {
-                    argv[3] = Cmd_Argv(4);
-                    argc++;
-                }
-
-                return Dvar_SetFromString(d, argc, argv);
-            }
-        }
     }
+
+    dvar_t* d = Dvar_Find(Cmd_Argv(0));
+    if (d != NULL)
+        return Con_SetDvarFromArgs(d);
+
     return false;
 }
 
+bool Con_ProcessInput(const char* input) {
+    if (!Cmd_TakeInput(input))
+        return false;
+
+    return Con_ExecuteArgs();
+}
+
 bool Con_ProcessLocalInput(const char* input, size_t localClientNum) {
     if (!Cmd_TakeInput(input))
         return false;
@@ -62,35 +83,296 @@ bool Con_ProcessLocalInput(const char* input, size_t localClientNum) {
     } else {
         dvar_t* d = Dvar_FindLocal(localClientNum, Cmd_Argv(0));
         if (d == NULL) d = Dvar_Find(Cmd_Argv(0));
-        if (d != NULL) {
-            const char* argv[4];
-            int argc = 0;
-
-            if (Cmd_Argc() == 1) {
-                Com_Println(CON_DEST_CLIENT, "%s", Dvar_GetString(d));
-                return true;
-            } else {
-                argv[0] = Cmd_Argv(1);
-                argc++;
-
-                if (Dvar_IsVec2(d) || Dvar_IsVec3(d) || Dvar_IsVec4(d)) {
-                    argv[1] = Cmd_Argv(2);
-                    argc++;
-                }
-
-                if (Dvar_IsVec3(d) || Dvar_IsVec4(d)) {
-                    argv[2] = Cmd_Argv(3);
-                    argc++;
-                }
-
-                if (Dvar_IsVec4(d)) {
-                    argv[3] = Cmd_Argv(4);
-                    argc++;
-                }
-
-                return Dvar_SetFromString(d, argc, argv);
+        if (d != NULL)
+            return Con_SetDvarFromArgs(d);
+    }
+    return false;
+}
+
+// The command buffer is one growable block of text. What's left to run is
+// [start, end); running a command just moves `start` past it, and text is
+// only moved down to the front when there's no room left at the back.
+// Inserted text goes in front of `start`, in place if the commands already
+// run left enough room there. Commands are separated by newlines, or by
+// semicolons outside double quotes and `//` comments.
+typedef struct CmdBuf {
+    char*  text;
+    size_t size;
+    size_t start;
+    size_t end;
+} CmdBuf;
+
+#define CBUF_MIN_SIZE           (16 * 1024)
+#define CBUF_MAX_SIZE           (64 * 1024 * 1024)
+// So a config that execs itself can't hang the frame. What's left over
+// runs next frame.
+#define CBUF_MAX_FRAME_COMMANDS (1024 * 1024)
+
+static CmdBuf s_cbuf;
+static bool   s_cbufWait;
+
+static void Con_Exec_f(void);
+static void Con_Wait_f(void);
+static void Con_CbufBench_f(void);
+
+void Con_Init(void) {
+    A_memset(&s_cbuf, 0, sizeof(s_cbuf));
+    s_cbufWait = false;
+    Cmd_AddCommand("exec",       Con_Exec_f);
+    Cmd_AddCommand("wait",       Con_Wait_f);
+    Cmd_AddCommand("cbuf_bench", Con_CbufBench_f);
+}
+
+// Makes room for `n` more bytes at the back of `b`.
+static bool Con_CbufReserve(CmdBuf* b, size_t n) {
+    if (b->end + n > b->size && b->start > 0) {
+        memmove(b->text, b->text + b->start, b->end - b->start);
+        b->end  -= b->start;
+        b->start = 0;
+    }
+    if (b->end + n <= b->size)
+        return true;
+
+    size_t size = b->size ? b->size : CBUF_MIN_SIZE;
+    while (size < b->end + n) {
+        if (size >= CBUF_MAX_SIZE) {
+            Com_Println(CON_DEST_ERR,
+                        "Command buffer overflow, %zu bytes dropped.", n);
+            return false;
+        }
+        size *= 2;
+    }
+
+    char* text = (char*)Z_Realloc(b->text, size);
+    assert(text);
+    if (!text)
+        return false;
+
+    b->text = text;
+    b->size = size;
+    return true;
+}
+
+static void Con_CbufAddText(CmdBuf* b, const char* text) {
+    assert(text);
+    size_t n = A_cstrlen(text);
+    if (!Con_CbufReserve(b, n + 1))
+        return;
+
+    A_memcpy(b->text + b->end, text, n);
+    b->text[b->end + n] = '\n';
+    b->end += n + 1;
+}
+
+static void Con_CbufInsertText(CmdBuf* b, const char* text) {
+    assert(text);
+    size_t n = A_cstrlen(text);
+    if (b->start < n + 1) {
+        if (!Con_CbufReserve(b, n + 1))
+            return;
+        memmove(b->text + b->start + n + 1, b->text + b->start,
+                b->end - b->start);
+        b->end   += n + 1;
+        b->start += n + 1;
+    }
+
+    b->start -= n + 1;
+    A_memcpy(b->text + b->start, text, n);
+    b->text[b->start + n] = '\n';
+}
+
+// Runs up to `max_commands` commands from the front of `b`, and returns
+// how many it ran. Each one is tokenized, and `start` moved past it,
+// before it runs, since running it can add to `b` and move its text.
+static int Con_CbufExecute(CmdBuf* b, int max_commands) {
+    int executed = 0;
+    while (b->start < b->end && executed < max_commands) {
+        const char* text   = b->text + b->start;
+        size_t      len    = b->end - b->start;
+        size_t      i      = 0;
+        bool        quoted = false;
+        for (; i < len; i++) {
+            char c = text[i];
+            if (c == '\n' || c == '\r')
+                break;
+            if (c == '"') {
+                quoted = !quoted;
+            } else if (!quoted && c == ';') {
+                break;
+            } else if (!quoted && c == '/' && i + 1 < len && 
+                       text[i + 1] == '/'
+            ) {
+                // The tokenizer stops at the comment, so just find the end
+                // of the line.
+                while (i + 1 < len && text[i + 1] != '\n' && 
+                       text[i + 1] != '\r')
+                    i++;
             }
         }
+
+        bool ok = Cmd_TakeInputN(text, i);
+        b->start += i < len ? i + 1 : i;
+        if (!ok) {
+            Com_Println(CON_DEST_CLIENT,
+                        "Skipped a command with more than %d args or %d "
+                        "bytes.", CMD_MAX_ARGS, CMD_MAX_LINE);
+            continue;
+        }
+        if (Cmd_Argc() < 1)
+            continue;
+
+        // Only the dvar and unknown paths fail, and neither retokenizes,
+        // so Cmd_Argv(0) is still this command's name.
+        if (!Con_ExecuteArgs())
+            Com_Println(CON_DEST_CLIENT, "Couldn't execute '%s'.",
+                        Cmd_Argv(0));
+        executed++;
+
+        if (b == &s_cbuf && s_cbufWait) {
+            s_cbufWait = false;
+            break;
+        }
     }
-    return false;
+
+    if (b->start == b->end)
+        b->start = b->end = 0;
+    return executed;
+}
+
+void Cbuf_AddText(const char* text) {
+    Con_CbufAddText(&s_cbuf, text);
+}
+
+void Cbuf_InsertText(const char* text) {
+    Con_CbufInsertText(&s_cbuf, text);
+}
+
+void Cbuf_Execute(void) {
+    Con_CbufExecute(&s_cbuf, CBUF_MAX_FRAME_COMMANDS);
+}
+
+static void Con_Exec_f(void) {
+    if (Cmd_Argc() != 2) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: exec <file>");
+        return;
+    }
+
+    // Like Quake, `exec autoexec` finds autoexec.cfg.
+    char path[1024];
+    A_cstrncpyz(path, Cmd_Argv(1), sizeof(path));
+    if (!FS_FileExists(path)) {
+        A_snprintf(path, sizeof(path), "%s.cfg", Cmd_Argv(1));
+        if (!FS_FileExists(path)) {
+            Com_Println(CON_DEST_CLIENT, "exec: couldn't find '%s'.",
+                        Cmd_Argv(1));
+            return;
+        }
+    }
+
+    size_t size = 0;
+    char*  text = FS_ReadFileText(path, &size);
+    if (text == NULL) {
+        Com_Println(CON_DEST_CLIENT, "exec: couldn't read '%s'.", path);
+        return;
+    }
+
+    // Inserted rather than added, so the file runs before anything queued
+    // after the exec, as if it were typed in its place.
+    Cbuf_InsertText(text);
+    FS_FreeFileText(text);
+    Com_Println(CON_DEST_CLIENT, "execing %s (%zu bytes)", path, size);
+}
+
+// Leaves the rest of the command buffer for next frame.
+static void Con_Wait_f(void) {
+    s_cbufWait = true;
+}
+
+#define CBUF_BENCH_DEFAULT_COMMANDS 100000
+#define CBUF_BENCH_LINE_LEN         64
+
+static int s_cbufBenchCalls;
+
+static void Con_CbufBenchNop_f(void) {
+    if (Cmd_Argc() == 3)
+        s_cbufBenchCalls++;
+}
+
+// Queues and runs `count` commands through a scratch buffer, alternating a
+// command with a quoted arg and a dvar set, two to a line, which is what a
+// big config file looks like.
+static void Con_CbufBench_f(void) {
+    int count = CBUF_BENCH_DEFAULT_COMMANDS;
+    if (Cmd_Argc() > 1 && (!A_atoi(Cmd_Argv(1), &count) || count < 1)) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: cbuf_bench [commands]");
+        return;
+    }
+
+    char* script = (char*)Z_Alloc((size_t)count * CBUF_BENCH_LINE_LEN + 1);
+    if (script == NULL) {
+        Com_Println(CON_DEST_CLIENT, "cbuf_bench: out of memory.");
+        return;
+    }
+
+    size_t len = 0;
+    for (int i = 0; i < count; i++) {
+        int n;
+        if (i % 2 == 0) {
+            n = A_snprintf(script + len, CBUF_BENCH_LINE_LEN,
+                           "cbuf_bench_nop %d \"two words\"; ", i);
+        } else {
+            n = A_snprintf(script + len, CBUF_BENCH_LINE_LEN,
+                           "cbuf_bench_value %d // comment\n", i);
+        }
+        len += (size_t)n;
+    }
+    script[len] = '\0';
+
+    Cmd_AddCommand("cbuf_bench_nop", Con_CbufBenchNop_f);
+    dvar_t* value = Dvar_RegisterInt("cbuf_bench_value", DVAR_FLAG_NONE,
+                                     -1, INT_MIN, INT_MAX);
+    s_cbufBenchCalls = 0;
+
+    CmdBuf b;
+    A_memset(&b, 0, sizeof(b));
+
+    uint64_t start = Sys_Nanoseconds();
+    Con_CbufAddText(&b, script);
+    uint64_t add = Sys_Nanoseconds() - start;
+
+    start = Sys_Nanoseconds();
+    int executed = 0;
+    while (b.start < b.end)
+        executed += Con_CbufExecute(&b, INT_MAX);
+    uint64_t run = Sys_Nanoseconds() - start;
+
+    // The dvar's set by the odd commands, so it ends on the last of them.
+    int  last_value = count % 2 == 0 ? count - 1 : count - 2;
+    bool ok = executed == count &&
+              s_cbufBenchCalls == (count + 1) / 2 &&
+              (count < 2 || Dvar_GetInt(value) == last_value);
+
+    Z_Free(b.text);
+    Z_Free(script);
+    Dvar_Unregister("cbuf_bench_value");
+    Cmd_RemoveCommand("cbuf_bench_nop");
+
+    Com_Println(CON_DEST_CLIENT,
+                "cbuf_bench: %d commands, %zu bytes: queue %.3f ms, "
+                "run %.3f ms (%.1f ns a command, %.1f MB/s).",
+                count, len, add / 1e6, run / 1e6, (double)run / count,
+                (double)len / ((double)run / 1e9) / (1024.0 * 1024.0));
+    if (!ok) {
+        Com_Println(CON_DEST_CLIENT,
+                    "cbuf_bench: FAILED, ran %d of %d commands.",
+                    executed, count);
+    }
+}
+
+void Con_Shutdown(void) {
+    Cmd_RemoveCommand("exec");
+    Cmd_RemoveCommand("wait");
+    Cmd_RemoveCommand("cbuf_bench");
+    Z_Free(s_cbuf.text);
+    A_memset(&s_cbuf, 0, sizeof(s_cbuf));
 }
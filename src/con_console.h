@@ -2,5 +2,16 @@
 
 #include "acommon/acommon.h"
 
+A_EXTERN_C void Con_Init    (void);
+A_EXTERN_C void Con_Shutdown(void);
+
 A_EXTERN_C bool Con_ProcessInput(const char* input);
 A_EXTERN_C bool Con_ProcessLocalInput(const char* input, size_t localClientNum);
+
+// The command buffer, as in Quake. Text is queued with Cbuf_AddText, and
+// run by Cbuf_Execute once a frame, each command going through the same
+// path as Con_ProcessInput. `exec <file>` inserts a file's text in front of
+// whatever's still queued, and `wait` leaves the rest for next frame.
+A_EXTERN_C void Cbuf_AddText   (const char* text);
+A_EXTERN_C void Cbuf_InsertText(const char* text);
+A_EXTERN_C void Cbuf_Execute   (void);
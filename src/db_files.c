@@ -48,6 +48,10 @@ A_NO_DISCARD const char* DB_MapPath(const char* map_name) {
 	return DB_AssetPath(AT_MAP, map_name, NULL);
 }
 
+A_NO_DISCARD const char* DB_ProgramCachePath(void) {
+	return DB_AssetPath(AT_MAP, "program_cache", "bin");
+}
+
 A_NO_DISCARD static char* DB_LoadAsset_Text(
 	AssetType assetType, const char* assetName, 
 	const char* ext, A_OPTIONAL_OUT size_t* sz
@@ -7,6 +7,8 @@
 
 A_EXTERN_C A_NO_DISCARD const char* DB_ImagePath(const char* image_name);
 A_EXTERN_C A_NO_DISCARD const char* DB_MapPath  (const char* map_name);
+// Kept with the maps, like their decompressed copies.
+A_EXTERN_C A_NO_DISCARD const char* DB_ProgramCachePath(void);
 
 A_EXTERN_C A_NO_DISCARD char*       DB_LoadShader(const char* shader_name);
 A_EXTERN_C              void        DB_UnloadShader    (char* shader);
@@ -1,14 +1,13 @@
 #include "devcon.h"
 
+#include <assert.h>
 #include <stdio.h>
 
-// for select() - select(stdin) doesn't work on Windows
-// so don't include the headers there
+// stdin can't be waited on alongside a pipe on Windows, so there's no
+// reader thread there, and no need for the headers
 #if !A_TARGET_OS_IS_WINDOWS
 #include <errno.h>
-
-#include <sys/time.h>
-#include <sys/types.h>
+#include <poll.h>
 #include <unistd.h>
 #endif // !A_TARGET_OS_IS_WINDOWS
 
@@ -18,76 +17,192 @@
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 
 #include "acommon/acommon.h"
+#include "acommon/a_atomic.h"
+#include "acommon/a_math.h"
 #include "acommon/a_string.h"
+#include "acommon/z_mem.h"
 
+#include "cmd_commands.h"
 #include "com_print.h"
+#include "con_console.h"
+#include "vm_vmem.h"
+
+#define DEVCON_MAX_IN      4096
+#define DEVCON_QUEUE_LINES 32 // must be a power of two
+// How many times the reader yields waiting for room before it sleeps.
+#define DEVCON_FULL_YIELDS 64
 
-#define DEVCON_MAX_IN 4096
+#define DEVCON_TEST_DEFAULT_LINES 10000
 
-bool       devcon_hasText;
 SDL_mutex* devcon_ioMutex;
 
 #if !A_TARGET_OS_IS_WINDOWS
-static char           devcon_in[DEVCON_MAX_IN];
-static SDL_mutex*     devcon_inMutex;
-static SDL_mutex*     devcon_selectMutex;
-static fd_set         devcon_fds;
-static struct timeval devcon_timeval;
-#endif
+// A thread blocks reading `fd` and queues each complete line for the main
+// thread, which only ever looks at `head` and `tail`, so a frame never makes
+// a syscall for console input. Only the reader writes `head` and only the
+// main thread writes `tail`. When the queue's full the reader waits for
+// room, since there's nowhere else for the input to go.
+//
+// Stopping writes to `wake`, which the reader waits on alongside `fd`, so it
+// stops even while stdin's idle.
+typedef struct DevConReader {
+    // First, and a power of two each, so the word-at-a-time string kernels'
+    // reads past a line's end never stray into another slot while the
+    // reader's writing it.
+    char             lines[DEVCON_QUEUE_LINES][DEVCON_MAX_IN];
+    int              fd;
+    int              wake[2];
+    SysThread*       thread;
+    volatile int32_t head;
+    volatile int32_t tail;
+    volatile int32_t stop;
+    volatile int32_t done; // the reader's hit the end of the input
+    // Only touched by the reader. Leaves room for the newline and NUL.
+    char             partial[DEVCON_MAX_IN - 2];
+    size_t           partial_len;
+    bool             truncated;
+} DevConReader;
 
-#if A_TARGET_OS_IS_WINDOWS
-/*
-static bool DevCon_StdinHasLine(void) {
-    return false;
-}
-*/
-#else 
-static bool DevCon_StdinHasLine(void) {
-    SDL_LockMutex(devcon_selectMutex);
-    FD_ZERO(&devcon_fds);
-    FD_CLR(STDIN_FILENO, &devcon_fds);
-    FD_SET(STDIN_FILENO, &devcon_fds);
-
-    if (select(1, &devcon_fds, NULL, NULL, &devcon_timeval) < 0) {
-        SDL_UnlockMutex(devcon_selectMutex);
-        Com_Errorln(-1, "DevCon: select() failed with errno=%d", errno);
-        return false;
+static DevConReader* s_devconStdin;
+
+static bool DevCon_ReaderPush(DevConReader* r) {
+    int32_t head = r->head;
+    int     waits = 0;
+    while (head - A_atomic_load32(&r->tail) >= DEVCON_QUEUE_LINES) {
+        if (A_atomic_load32(&r->stop))
+            return false;
+        Sys_Sleep(waits++ < DEVCON_FULL_YIELDS ? 0 : 1);
     }
 
-    bool hasLine = FD_ISSET(STDIN_FILENO, &devcon_fds);
-    SDL_UnlockMutex(devcon_selectMutex);
-    return hasLine;
+    // Lines keep their newline so they stay separate in the command buffer.
+    char* line = r->lines[head & (DEVCON_QUEUE_LINES - 1)];
+    A_memcpy(line, r->partial, r->partial_len);
+    line[r->partial_len]     = '\n';
+    line[r->partial_len + 1] = '\0';
+    A_atomic_store32(&r->head, head + 1);
+    return true;
 }
-#endif
 
-#if A_TARGET_OS_IS_WINDOWS
-A_EXTERN_C void DevCon_Frame(void) {
-    return;
+// Returns false if the reader's been stopped while waiting for room.
+static bool DevCon_ReaderAppend(DevConReader* r, const char* s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        char c = s[i];
+        if (c == '\n') {
+            // Blank lines don't do anything, so they aren't queued.
+            if (r->partial_len > 0 && !DevCon_ReaderPush(r))
+                return false;
+            r->partial_len = 0;
+            r->truncated   = false;
+        } else if (c == '\r') {
+            continue;
+        } else if (r->partial_len < sizeof(r->partial)) {
+            r->partial[r->partial_len++] = c;
+        } else if (!r->truncated) {
+            r->truncated = true;
+            Com_Println(CON_DEST_ERR,
+                        "DevCon: line longer than %d characters truncated.",
+                        (int)sizeof(r->partial));
+        }
+    }
+    return true;
 }
-#else
-void DevCon_Frame(void) {
-    // Don't even try to read a new line if the previous one hasn't 
-    // been taken
-    if (DevCon_HasText())
-        return;
 
-    // If stdin has a new line, read it.
-    if (DevCon_StdinHasLine()) {
-        // stdin and stdout aren't necessarily safe to concurrently 
-        // access, so make sure that doesn't happen
-        SDL_LockMutex(devcon_ioMutex);
-        SDL_LockMutex(devcon_inMutex);
-        fgets(devcon_in, sizeof(devcon_in), stdin);
-        SDL_UnlockMutex(devcon_inMutex);
-        SDL_UnlockMutex(devcon_ioMutex);
-        devcon_hasText = true;
+static int DevCon_ReaderMain(void* arg) {
+    DevConReader* r = (DevConReader*)arg;
+    char buf[DEVCON_MAX_IN];
+    for (;;) {
+        struct pollfd fds[2];
+        fds[0].fd      = r->fd;
+        fds[0].events  = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd      = r->wake[0];
+        fds[1].events  = POLLIN;
+        fds[1].revents = 0;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            Com_Println(CON_DEST_ERR, "DevCon: poll() failed with errno=%d",
+                        errno);
+            break;
+        }
+        if (fds[1].revents != 0)
+            break;
+        if (fds[0].revents == 0)
+            continue;
+
+        ssize_t n = read(r->fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            Com_Println(CON_DEST_ERR, "DevCon: read() failed with errno=%d",
+                        errno);
+            break;
+        }
+        // The input's closed. A last line without a newline still counts.
+        if (n == 0) {
+            if (r->partial_len > 0)
+                DevCon_ReaderPush(r);
+            break;
+        }
+        if (!DevCon_ReaderAppend(r, buf, (size_t)n))
+            break;
     }
+    A_atomic_store32(&r->done, 1);
+    return 0;
+}
+
+static DevConReader* DevCon_StartReader(int fd) {
+    DevConReader* r = (DevConReader*)Z_Zalloc(sizeof(*r));
+    if (r == NULL)
+        return NULL;
+
+    r->fd = fd;
+    if (pipe(r->wake) != 0) {
+        Z_Free(r);
+        return NULL;
+    }
+
+    r->thread = Sys_SpawnThread("devcon", DevCon_ReaderMain, r);
+    if (r->thread == NULL) {
+        close(r->wake[0]);
+        close(r->wake[1]);
+        Z_Free(r);
+        return NULL;
+    }
+    return r;
+}
+
+static void DevCon_StopReader(DevConReader* r) {
+    A_atomic_store32(&r->stop, 1);
+    char c = 0;
+    while (write(r->wake[1], &c, 1) < 0 && errno == EINTR)
+        ;
+    Sys_JoinThread(r->thread);
+    close(r->wake[0]);
+    close(r->wake[1]);
+    Z_Free(r);
 }
-#endif // A_TARGET_OS_IS_WINDOWS
+
+static bool DevCon_ReaderHasLine(const DevConReader* r) {
+    return A_atomic_load32(&r->head) != r->tail;
+}
+
+// The oldest line, which stays put until DevCon_ReaderPop hands its slot
+// back to the reader.
+static const char* DevCon_ReaderPeek(const DevConReader* r) {
+    if (!DevCon_ReaderHasLine(r))
+        return NULL;
+    return r->lines[r->tail & (DEVCON_QUEUE_LINES - 1)];
+}
+
+static void DevCon_ReaderPop(DevConReader* r) {
+    assert(DevCon_ReaderHasLine(r));
+    A_atomic_store32(&r->tail, r->tail + 1);
+}
+#endif // !A_TARGET_OS_IS_WINDOWS
 
 #if A_TARGET_OS_IS_WINDOWS
 A_EXTERN_C void DevCon_Init(void) {
-    devcon_hasText = false;
     devcon_ioMutex = SDL_CreateMutex();
     DevCon_PrintMessage("DevCon doesn't work correctly on Windows.\n");
     DevCon_PrintMessage("Output works just fine but input doesn't.\n");
@@ -95,34 +210,37 @@ A_EXTERN_C void DevCon_Init(void) {
 }
 #else
 A_EXTERN_C void DevCon_Init(void) {
-    devcon_hasText = false;
-    A_memset(devcon_in,       0, sizeof(devcon_in));
-    A_memset(&devcon_timeval, 0, sizeof(devcon_timeval));
-	devcon_inMutex     = SDL_CreateMutex();
-    devcon_ioMutex     = SDL_CreateMutex();
-    devcon_selectMutex = SDL_CreateMutex();
+    devcon_ioMutex = SDL_CreateMutex();
+    s_devconStdin  = DevCon_StartReader(STDIN_FILENO);
+    if (s_devconStdin == NULL)
+        DevCon_PrintMessage("DevCon: couldn't start the input thread.\n");
     DevCon_PrintMessage("Hello from DevCon!\n");
 }
 #endif // A_TARGET_OS_IS_WINDOWS
 
+#if A_TARGET_OS_IS_WINDOWS
 A_EXTERN_C A_NO_DISCARD bool DevCon_HasText(void) {
-	return devcon_hasText;
+    return false;
 }
 
-#if A_TARGET_OS_IS_WINDOWS
 A_EXTERN_C A_NO_DISCARD char* DevCon_TakeText(void) {
     return "";
 }
 #else
+A_EXTERN_C A_NO_DISCARD bool DevCon_HasText(void) {
+    return s_devconStdin && DevCon_ReaderHasLine(s_devconStdin);
+}
+
 A_EXTERN_C A_NO_DISCARD char* DevCon_TakeText(void) {
-    SDL_LockMutex(devcon_inMutex);
-    devcon_hasText = false;
-    char* s = A_cstrdup(devcon_in);
-    A_memset(devcon_in, 0, sizeof(devcon_in));
-    SDL_UnlockMutex(devcon_inMutex);
+    const char* line = s_devconStdin ? DevCon_ReaderPeek(s_devconStdin) : NULL;
+    if (line == NULL)
+        return VM_FrameStrdup("");
+
+    char* s = VM_FrameStrdup(line);
+    DevCon_ReaderPop(s_devconStdin);
     return s;
 }
-#endif
+#endif // A_TARGET_OS_IS_WINDOWS
 
 A_EXTERN_C void DevCon_PrintMessage(const char* s) {
     SDL_LockMutex(devcon_ioMutex);
@@ -130,20 +248,184 @@ A_EXTERN_C void DevCon_PrintMessage(const char* s) {
     SDL_UnlockMutex(devcon_ioMutex);
 }
 
+#if !A_TARGET_OS_IS_WINDOWS
+// ============================================================================
+// devcon_test
+typedef struct DevConTestWriter {
+    int        fd;
+    int        lines;
+    SysThread* thread;
+} DevConTestWriter;
+
+static int s_devconTestExpected;
+static int s_devconTestLines;
+static int s_devconTestErrors;
+
+// Writes the script in pieces of awkward sizes, so lines are split across
+// reads, and with CRLF endings and blank lines mixed in.
+static int DevCon_TestWriterMain(void* arg) {
+    static const size_t s_pieces[] = { 1, 7, 4096, 13, 2, 512, 3 };
+    DevConTestWriter* w = (DevConTestWriter*)arg;
+
+    size_t cap = (size_t)w->lines * 32 + 64;
+    char* script = (char*)Z_Alloc(cap);
+    size_t len = 0;
+    if (script) {
+        for (int i = 0; i < w->lines; i++) {
+            len += (size_t)A_snprintf(script + len, cap - len,
+                                      "devcon_test_seq %d%s", i,
+                                      i % 3 == 0 ? "\r\n\n" : "\n");
+        }
+        // No newline, so it's only seen once the pipe's closed.
+        len += (size_t)A_snprintf(script + len, cap - len,
+                                  "devcon_test_seq end");
+
+        size_t off = 0;
+        for (size_t p = 0; off < len; p++) {
+            size_t n = A_MIN(s_pieces[p % A_countof(s_pieces)], len - off);
+            ssize_t written = write(w->fd, script + off, n);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            off += (size_t)written;
+        }
+        Z_Free(script);
+    }
+    close(w->fd);
+    return 0;
+}
+
+static void DevCon_TestSeq_f(void) {
+    if (A_cstrcmp(Cmd_Argv(1), "end")) {
+        if (s_devconTestExpected != s_devconTestLines)
+            s_devconTestErrors++;
+        Com_Println(CON_DEST_CLIENT, "devcon_test: %d of %d commands ran in "
+                    "order, %d errors.", s_devconTestExpected,
+                    s_devconTestLines, s_devconTestErrors);
+        Cmd_RemoveCommand("devcon_test_seq");
+        return;
+    }
+
+    int i = -1;
+    if (!A_atoi(Cmd_Argv(1), &i) || i != s_devconTestExpected) {
+        if (s_devconTestErrors++ == 0) {
+            Com_Println(CON_DEST_CLIENT, "devcon_test: got %s, expected %d.",
+                        Cmd_Argv(1), s_devconTestExpected);
+        }
+    }
+    s_devconTestExpected = i + 1;
+}
+
+// Runs a second reader on a pipe, feeds it a script from another thread,
+// then queues what it read in the command buffer, where the script's
+// commands check they run in the order they were written. Also checks a
+// reader stops promptly while it's blocked on idle input.
+static void DevCon_Test_f(void) {
+    int lines = DEVCON_TEST_DEFAULT_LINES;
+    if (Cmd_Argc() > 2 ||
+        (Cmd_Argc() == 2 && (!A_atoi(Cmd_Argv(1), &lines) || lines < 1))
+    ) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: devcon_test [lines]");
+        return;
+    }
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        Com_Println(CON_DEST_CLIENT, "devcon_test: pipe() failed.");
+        return;
+    }
+
+    DevConReader* r = DevCon_StartReader(fds[0]);
+    if (r == NULL) {
+        close(fds[0]);
+        close(fds[1]);
+        Com_Println(CON_DEST_CLIENT, "devcon_test: couldn't start a reader.");
+        return;
+    }
+
+    // If the writer can't start, closing the pipe ends the reader.
+    DevConTestWriter w;
+    w.fd     = fds[1];
+    w.lines  = lines;
+    w.thread = Sys_SpawnThread("devcon_test", DevCon_TestWriterMain, &w);
+    if (w.thread == NULL)
+        close(fds[1]);
+
+    s_devconTestExpected = 0;
+    s_devconTestLines    = lines;
+    s_devconTestErrors   = 0;
+    Cmd_AddCommand("devcon_test_seq", DevCon_TestSeq_f);
+
+    // `done` is checked before the queue, so nothing queued before the
+    // reader finished can be missed.
+    uint64_t start = Sys_Nanoseconds();
+    int taken = 0;
+    for (;;) {
+        bool done = A_atomic_load32(&r->done) != 0;
+        const char* line = DevCon_ReaderPeek(r);
+        if (line) {
+            Cbuf_AddText(line);
+            DevCon_ReaderPop(r);
+            taken++;
+        } else if (done) {
+            break;
+        } else {
+            Sys_Sleep(0);
+        }
+    }
+    uint64_t ns = Sys_Nanoseconds() - start;
+    if (w.thread)
+        Sys_JoinThread(w.thread);
+    DevCon_StopReader(r);
+    close(fds[0]);
+    Com_Println(CON_DEST_CLIENT, "devcon_test: read %d lines in %.2f ms.",
+                taken, (double)ns / 1000000.0);
+
+    // Nothing's ever written to this one.
+    if (pipe(fds) != 0)
+        return;
+    r = DevCon_StartReader(fds[0]);
+    if (r) {
+        Sys_Sleep(10);
+        start = Sys_Nanoseconds();
+        DevCon_StopReader(r);
+        Com_Println(CON_DEST_CLIENT,
+                    "devcon_test: idle reader stopped in %.3f ms.",
+                    (double)(Sys_Nanoseconds() - start) / 1000000.0);
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+// ============================================================================
+#endif // !A_TARGET_OS_IS_WINDOWS
+
+A_EXTERN_C void DevCon_AddCommands(void) {
+#if !A_TARGET_OS_IS_WINDOWS
+    Cmd_AddCommand("devcon_test", DevCon_Test_f);
+#endif // !A_TARGET_OS_IS_WINDOWS
+}
+
+A_EXTERN_C void DevCon_RemoveCommands(void) {
+#if !A_TARGET_OS_IS_WINDOWS
+    Cmd_RemoveCommand("devcon_test");
+    Cmd_RemoveCommand("devcon_test_seq");
+#endif // !A_TARGET_OS_IS_WINDOWS
+}
+
 #if A_TARGET_OS_IS_WINDOWS
 A_EXTERN_C void DevCon_Shutdown(void) {
     SDL_DestroyMutex(devcon_ioMutex);
+    devcon_ioMutex = NULL;
 }
 #else
 A_EXTERN_C void DevCon_Shutdown(void) {
-    SDL_DestroyMutex(devcon_inMutex);
+    if (s_devconStdin) {
+        DevCon_StopReader(s_devconStdin);
+        s_devconStdin = NULL;
+    }
     SDL_DestroyMutex(devcon_ioMutex);
-    SDL_DestroyMutex(devcon_selectMutex);
-    devcon_inMutex     = NULL;
-    devcon_ioMutex     = NULL;
-    devcon_selectMutex = NULL;
-    devcon_hasText     = false;
-    A_memset(devcon_in,       0, sizeof(devcon_in));
-    A_memset(&devcon_timeval, 0, sizeof(devcon_timeval));
-}
-#endif
+    devcon_ioMutex = NULL;
+}
+#endif // A_TARGET_OS_IS_WINDOWS
@@ -2,9 +2,16 @@
 
 #include "com_defs.h"
 
+// Input is read by a thread of its own, which queues it a line at a time,
+// so checking for it never makes a syscall. Each line keeps its newline.
 A_EXTERN_C              void  DevCon_Init(void);
-A_EXTERN_C              void  DevCon_Frame(void);
 A_EXTERN_C A_NO_DISCARD bool  DevCon_HasText(void);
+// The text is frame-allocated, so it mustn't be freed.
 A_EXTERN_C A_NO_DISCARD char* DevCon_TakeText(void);
 A_EXTERN_C              void  DevCon_PrintMessage(const char* s);
+// DevCon_Init runs before there are commands, so its are added separately.
+// `devcon_test [lines]` feeds a reader a script through a pipe and checks
+// its commands run in order.
+A_EXTERN_C              void  DevCon_AddCommands(void);
+A_EXTERN_C              void  DevCon_RemoveCommands(void);
 A_EXTERN_C              void  DevCon_Shutdown(void);
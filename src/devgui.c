@@ -3,7 +3,6 @@
 #include <assert.h>
 
 #include "acommon/a_string.h"
-#include "acommon/z_mem.h"
 
 //#include "cl_client.hpp"
 typedef enum KeyFocus {
@@ -14,6 +13,7 @@ KeyFocus CL_KeyFocus(size_t localClientNum);
 
 #include "gfx_text.h"
 #include "in_kbm.h"
+#include "vm_vmem.h"
 
 typedef struct dgl_t {
 	size_t promptDrawId;
@@ -75,9 +75,7 @@ A_EXTERN_C char* DevGui_TakeText(size_t localClientNum) {
 	size_t n = A_cstrchr(dgl->buffer, '\n');
 	size_t pos = n == A_NPOS ? A_cstrlen(dgl->buffer) : n;
 	size_t len = pos - 2;
-	char* input = Z_Alloc(len + 1);
-	A_memcpy(input, dgl->buffer + 2, len);
-	input[len] = '\0';
+	char* input = VM_FrameStrndup(dgl->buffer + 2, len);
 	A_memset(dgl->buffer + 2, 0, len);
 	DevGui_SaveLine(localClientNum, input);
 	return input;
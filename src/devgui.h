@@ -7,6 +7,7 @@
 
 A_EXTERN_C void  DevGui_Init    (void);
 A_EXTERN_C bool  DevGui_HasText (size_t localClientNum);
+// The text is frame-allocated, so it mustn't be freed.
 A_EXTERN_C char* DevGui_TakeText(size_t localClientNum);
 A_EXTERN_C void  DevGui_Frame   (void);
 A_EXTERN_C void  DevGui_Shutdown(void);
@@ -4,10 +4,12 @@
 #include <float.h>
 #include <limits.h>
 
+#include "acommon/a_atom.h"
 #include "acommon/a_string.h"
 
 #include "cl_client.h"
 #include "cmd_commands.h"
+#include "com_defs.h"
 #include "com_print.h"
 #include "vm_vmem.h"
 
@@ -39,8 +41,8 @@ typedef union DvarValue {
 } DvarValue;
 
 typedef struct dvar_t {
-	char*      name;
-	uint32_t   name_hash;
+	aatom_t    name; // as it was registered
+	aatom_t    key;  // lowercased, for the table
 	DvarType   type;
 	DvarDomain domain;
 	DvarValue  value;
@@ -52,18 +54,30 @@ typedef struct dvar_t {
 	bool       hasLatched;
 } dvar_t;
 
-static dvar_t* s_dvars[DVAR_MAX_DVARS];
-static int     s_dvarCount;
-
-static uint32_t Dvar_HashName(const char* name) {
-	assert(name);
-	uint32_t hash = 0;
-	for (uint32_t i = 0; name[i] != '\0'; i++) {
-		char c = A_tolower(name[i]);
-		hash += (uint32_t)c * (i+119);
-	}
-	return hash;
-}
+// The global dvars, and each local client's, are kept in an open-addressing
+// hash table keyed by the atom of the lowercased name, with linear probing
+// and backward-shift deletion like the fixed-address table in vm_vmem.c.
+// It's twice DVAR_MAX_DVARS, so it's never more than half full and a lookup
+// hardly ever probes more than a slot or two. Keys compare by pointer, and
+// a name that was never interned can't be registered, so looking it up
+// doesn't touch the table at all.
+//
+// A dvar_t* is a handle that stays valid until the dvar is unregistered:
+// reregistering a dvar reuses its dvar_t in place. Anything that reads a
+// dvar every frame should keep the pointer it got from registering it
+// rather than calling Dvar_Find.
+#define DVAR_TABLE_SIZE (DVAR_MAX_DVARS * 2)
+#define DVAR_TABLE_MASK (DVAR_TABLE_SIZE - 1)
+A_STATIC_ASSERT((DVAR_TABLE_SIZE & DVAR_TABLE_MASK) == 0);
+
+typedef struct DvarTable {
+	dvar_t*     slots[DVAR_TABLE_SIZE];
+	int         count;
+	AAtomTable* atoms; // where names are interned, NULL for the global atoms
+} DvarTable;
+
+static DvarTable s_dvars;
+static DvarTable s_localDvars[MAX_LOCAL_CLIENTS];
 
 static void* Dvar_Alloc(size_t n) {
 	return VM_Alloc(n, VM_ALLOC_DVAR);
@@ -73,6 +87,116 @@ static bool Dvar_Free(void* p) {
 	return VM_Free(p, VM_ALLOC_DVAR);
 }
 
+static void Dvar_DestroyDvar(dvar_t* d);
+static void Dvar_Bench_f(void);
+
+// Returns the slot holding `key`, or the empty slot its probe sequence
+// ends at if it isn't in the table.
+static dvar_t** Dvar_TableSlot(DvarTable* t, aatom_t key) {
+	assert(key);
+	size_t i = A_atom_hash(key) & DVAR_TABLE_MASK;
+	while (t->slots[i] != NULL && t->slots[i]->key != key)
+		i = (i + 1) & DVAR_TABLE_MASK;
+
+	return &t->slots[i];
+}
+
+static dvar_t* Dvar_TableFind(DvarTable* t, const char* name) {
+	assert(name);
+	aatom_t key = A_atomi_find_in(t->atoms, name);
+	if (key == NULL)
+		return NULL;
+
+	return *Dvar_TableSlot(t, key);
+}
+
+static dvar_t* Dvar_TableInsert(DvarTable* t, const char* name, 
+	                            const dvar_t* d
+) {
+	assert(d);
+	if (d == NULL || t->count >= DVAR_MAX_DVARS)
+		return NULL;
+
+	aatom_t  key  = A_atomi_in(t->atoms, name);
+	dvar_t** slot = Dvar_TableSlot(t, key);
+	if (*slot != NULL)
+		return NULL;
+
+	*slot = (dvar_t*)Dvar_Alloc(sizeof(*d));
+	A_memcpy(*slot, d, sizeof(*d));
+	(*slot)->name = A_atom_in(t->atoms, name);
+	(*slot)->key  = key;
+	t->count++;
+	return *slot;
+}
+
+// Swaps the contents of the dvar registered as `name` for `d`, keeping the
+// same dvar_t so any pointers to it stay valid.
+static dvar_t* Dvar_TableReplace(DvarTable* t, const char* name, 
+	                             const dvar_t* d
+) {
+	assert(d);
+	dvar_t* dvar = Dvar_TableFind(t, name);
+	if (dvar == NULL || d == NULL)
+		return NULL;
+
+	aatom_t key = dvar->key;
+	Dvar_DestroyDvar(dvar);
+	A_memcpy(dvar, d, sizeof(*d));
+	dvar->name = A_atom_in(t->atoms, name);
+	dvar->key  = key;
+	return dvar;
+}
+
+// Empties the slot, then shifts back any later entries in its probe
+// sequence that would otherwise become unreachable.
+static bool Dvar_TableRemove(DvarTable* t, const char* name) {
+	aatom_t key = A_atomi_find_in(t->atoms, name);
+	if (key == NULL)
+		return false;
+
+	dvar_t** slot = Dvar_TableSlot(t, key);
+	if (*slot == NULL)
+		return false;
+
+	Dvar_DestroyDvar(*slot);
+	Dvar_Free(*slot);
+	t->count--;
+
+	size_t i = (size_t)(slot - t->slots);
+	size_t j = i;
+	for (;;) {
+		j = (j + 1) & DVAR_TABLE_MASK;
+		if (t->slots[j] == NULL)
+			break;
+
+		size_t k = A_atom_hash(t->slots[j]->key) & DVAR_TABLE_MASK;
+		if (A_HashSlotBetween(k, i, j))
+			continue;
+
+		t->slots[i] = t->slots[j];
+		i = j;
+	}
+	t->slots[i] = NULL;
+	return true;
+}
+
+static void Dvar_TableClear(DvarTable* t) {
+	for (size_t i = 0; i < DVAR_TABLE_SIZE; i++) {
+		if (t->slots[i] != NULL) {
+			Dvar_DestroyDvar(t->slots[i]);
+			Dvar_Free(t->slots[i]);
+			t->slots[i] = NULL;
+		}
+	}
+	t->count = 0;
+}
+
+static DvarTable* Dvar_LocalTable(int localClientNum) {
+	assert(localClientNum >= 0 && localClientNum < MAX_LOCAL_CLIENTS);
+	return &s_localDvars[localClientNum];
+}
+
 void Dvar_Init(void) {
 #if !A_TARGET_PLATFORM_IS_XBOX
 	Cmd_AddCommand("set",   Dvar_Set_f  );
@@ -80,9 +204,10 @@ void Dvar_Init(void) {
 	Cmd_AddCommand("setl",  Dvar_SetL_f );
 	Cmd_AddCommand("setla", Dvar_SetLA_f);
 #endif // !A_TARGET_PLATFORM_IS_XBOX
+	Cmd_AddCommand("dvar_bench", Dvar_Bench_f);
 
-	A_memset(s_dvars, 0, sizeof(s_dvars));
-	s_dvarCount = 0;
+	A_memset(&s_dvars, 0, sizeof(s_dvars));
+	A_memset(s_localDvars, 0, sizeof(s_localDvars));
 }
 
 A_NO_DISCARD bool Dvar_WasModified(const dvar_t* d) {
@@ -149,7 +274,6 @@ A_NO_DISCARD bool Dvar_HasLatchedValue(const dvar_t* d) {
 }
 
 static void Dvar_DestroyDvar(dvar_t* d) {
-	A_cstrfree(d->name);
 	if (d->type == DVAR_TYPE_ENUM) {
 		for (int i = 0; i < d->domain.e; i++)
 			A_cstrfree(d->e[i]);
@@ -177,8 +301,8 @@ dvar_t Dvar_CreateBool(const char* name, int flags, bool value) {
 		A_cstrncpyz(e[0], "false", 6);
 
 	dvar_t d;
-	d.name       = (char*)name;
-	d.name_hash  = Dvar_HashName(name);
+	d.name       = name;
+	d.key        = A_atomi(name);
 	d.type       = DVAR_TYPE_BOOL;
 	d.value.b    = value;
 	d.latched.b  = false;
@@ -198,8 +322,8 @@ dvar_t Dvar_CreateInt(const char* name, int flags,
 	A_itoa(value, e[0], 12);
 
 	dvar_t d;
-	d.name         = (char*)name;
-	d.name_hash    = Dvar_HashName(name);
+	d.name         = name;
+	d.key          = A_atomi(name);
 	d.type         = DVAR_TYPE_INT;
 	d.domain.i.min = min;
 	d.domain.i.max = max;
@@ -221,8 +345,8 @@ dvar_t Dvar_CreateFloat(const char* name, int flags,
 	A_itoa(value, e[0], 32);
 
 	dvar_t d;
-	d.name         = (char*)name;
-	d.name_hash    = Dvar_HashName(name);
+	d.name         = name;
+	d.key          = A_atomi(name);
 	d.type         = DVAR_TYPE_FLOAT;
 	d.domain.f.min = min;
 	d.domain.f.max = max;
@@ -241,8 +365,8 @@ dvar_t Dvar_CreateString(const char* name, int flags, const char* value) {
 	e[0] = (char*)A_cstrdup(value);
 
 	dvar_t d;
-	d.name       = (char*)name;
-	d.name_hash  = Dvar_HashName(name);
+	d.name       = name;
+	d.key        = A_atomi(name);
 	d.type       = DVAR_TYPE_STRING;
 	d.flags      = flags;
 	d.e          = e;
@@ -261,8 +385,8 @@ dvar_t Dvar_CreateEnum(
 		e[i] = (char*)A_cstrdup(domain[i]);
 
 	dvar_t d;
-	d.name       = (char*)name;
-	d.name_hash  = Dvar_HashName(name);
+	d.name       = name;
+	d.key        = A_atomi(name);
 	d.type       = DVAR_TYPE_ENUM;
 	d.domain.e   = domain_count;
 	d.flags      = flags;
@@ -283,8 +407,8 @@ dvar_t Dvar_CreateVec2(const char* name, int flags,
 	A_itoa(value.y, &e[0][pos + 1], 32);
 
 	dvar_t d;
-	d.name         = (char*)name;
-	d.name_hash    = Dvar_HashName(name);
+	d.name         = name;
+	d.key          = A_atomi(name);
 	d.type         = DVAR_TYPE_VEC2;
 	d.domain.f.min = min;
 	d.domain.f.max = max;
@@ -309,8 +433,8 @@ dvar_t Dvar_CreateVec3(const char* name, int flags,
 	A_itoa(value.y, &e[0][pos + 1], 32);
 
 	dvar_t d;
-	d.name         = (char*)name;
-	d.name_hash    = Dvar_HashName(name);
+	d.name         = name;
+	d.key          = A_atomi(name);
 	d.type         = DVAR_TYPE_VEC3;
 	d.domain.f.min = min;
 	d.domain.f.max = max;
@@ -337,8 +461,8 @@ dvar_t Dvar_CreateVec4(const char* name, int flags,
 	A_itoa(value.y, &e[0][pos + 1], 32);
 
 	dvar_t d;
-	d.name         = (char*)name;
-	d.name_hash    = Dvar_HashName(name);
+	d.name         = name;
+	d.key          = A_atomi(name);
 	d.type         = DVAR_TYPE_VEC4;
 	d.domain.f.min = min;
 	d.domain.f.max = max;
@@ -419,6 +543,7 @@ void Dvar_SetInt(A_INOUT dvar_t* d, int i) {
 		(i <= d->domain.i.max && i >= d->domain.i.min)
 	) {
 		d->value.i = i;
+		A_itoa(i, d->e[0], 12);
 		d->modified = true;
 	}
 	else if (d->type == DVAR_TYPE_ENUM && i < d->i) {
@@ -519,52 +644,15 @@ void Dvar_ClearFlags(A_INOUT dvar_t* d, int flags) {
 }
 
 A_NO_DISCARD bool Dvar_Exists(const char* name) {
-	for (int i = 0; i < s_dvarCount; i++) {
-		if (s_dvars[i] &&
-			s_dvars[i]->name_hash == Dvar_HashName(name)) {
-			return true;
-		}
-	}
-	
-	return false;
+	return Dvar_TableFind(&s_dvars, name) != NULL;
 }
 
 A_NO_DISCARD dvar_t* Dvar_Find(const char* name) {
-	for (int i = 0; i < s_dvarCount; i++) {
-		if (s_dvars[i] &&
-			s_dvars[i]->name_hash == Dvar_HashName(name)) 
-		{
-			return s_dvars[i];
-		}
-	}
-
-	return NULL;
-}
-
-static dvar_t** Dvar_TakeFreeDvar(void) {
-	if (s_dvarCount < DVAR_MAX_DVARS) {
-		dvar_t** d = &s_dvars[s_dvarCount++];
-		assert(*d == NULL);
-		return d;
-	}
-
-	for (int i = 0; i < DVAR_MAX_DVARS; i++) {
-		if (s_dvars[i] == NULL)
-			return &s_dvars[i];
-	}
-	
-	return NULL;
+	return Dvar_TableFind(&s_dvars, name);
 }
 
 static dvar_t* Dvar_RegisterDvar(const char* name, const dvar_t* d) {
-	dvar_t** dvar = Dvar_TakeFreeDvar();
-	if (d == NULL)
-		return NULL;
-
-	*dvar = (dvar_t*)Dvar_Alloc(sizeof(*d));
-	A_memcpy(*dvar, d, sizeof(*d));
-	(*dvar)->name = A_cstrdup(name);
-	return *dvar;
+	return Dvar_TableInsert(&s_dvars, name, d);
 }
 
 static dvar_t* Dvar_RegisterNewDvar(const char* name, const dvar_t* d) {
@@ -638,11 +726,7 @@ dvar_t* Dvar_RegisterNewVec4(
 }
 
 static dvar_t* Dvar_ReregisterDvar(const char* name, const dvar_t* d) {
-	if (!Dvar_Exists(name))
-		return NULL;
-
-	Dvar_Unregister(name);
-	return Dvar_RegisterDvar(name, d);
+	return Dvar_TableReplace(&s_dvars, name, d);
 }
 
 dvar_t* Dvar_ReregisterBool(
@@ -657,7 +741,7 @@ dvar_t* Dvar_ReregisterInt(
 	int value, int min, int max
 ) {
 	dvar_t d = Dvar_CreateInt(name, flags, value, min, max);
-	return Dvar_RegisterDvar(name, &d);
+	return Dvar_ReregisterDvar(name, &d);
 }
 
 dvar_t* Dvar_ReregisterFloat(
@@ -665,7 +749,7 @@ dvar_t* Dvar_ReregisterFloat(
 	float value, float min, float max
 ) {
 	dvar_t d = Dvar_CreateFloat(name, flags, value, min, max);
-	return Dvar_RegisterDvar(name, &d);
+	return Dvar_ReregisterDvar(name, &d);
 }
 
 dvar_t* Dvar_ReregisterString(
@@ -673,7 +757,7 @@ dvar_t* Dvar_ReregisterString(
 	const char* value
 ) {
 	dvar_t d = Dvar_CreateString(name, flags, value);
-	return Dvar_RegisterDvar(name, &d);
+	return Dvar_ReregisterDvar(name, &d);
 }
 
 dvar_t* Dvar_ReregisterEnum(
@@ -681,7 +765,7 @@ dvar_t* Dvar_ReregisterEnum(
 	int value, const char** domain, size_t domain_count
 ) {
 	dvar_t d = Dvar_CreateEnum(name, flags, value, domain, domain_count);
-	return Dvar_RegisterDvar(name, &d);
+	return Dvar_ReregisterDvar(name, &d);
 }
 
 dvar_t* Dvar_ReregisterVec2(
@@ -689,7 +773,7 @@ dvar_t* Dvar_ReregisterVec2(
 	avec2f_t value, float min, float max
 ) {
 	dvar_t d = Dvar_CreateVec2(name, flags, value, min, max);
-	return Dvar_RegisterDvar(name, &d);
+	return Dvar_ReregisterDvar(name, &d);
 }
 
 dvar_t* Dvar_ReregisterVec3(
@@ -697,7 +781,7 @@ dvar_t* Dvar_ReregisterVec3(
 	avec3f_t value, float min, float max
 ) {
 	dvar_t d = Dvar_CreateVec3(name, flags, value, min, max);
-	return Dvar_RegisterDvar(name, &d);
+	return Dvar_ReregisterDvar(name, &d);
 }
 
 dvar_t* Dvar_ReregisterVec4(
@@ -705,7 +789,7 @@ dvar_t* Dvar_ReregisterVec4(
 	avec4f_t value, float min, float max
 ) {
 	dvar_t d = Dvar_CreateVec4(name, flags, value, min, max);
-	return Dvar_RegisterDvar(name, &d);
+	return Dvar_ReregisterDvar(name, &d);
 }
 
 dvar_t* Dvar_RegisterBool(
@@ -786,84 +870,26 @@ dvar_t* Dvar_RegisterVec4(
 }
 
 bool Dvar_Unregister(const char* name) {
-	for (int i = 0; i < s_dvarCount; i++) {
-		if (s_dvars[i] && s_dvars[i]->name_hash == Dvar_HashName(name)) {
-			dvar_t** d = &s_dvars[i];
-			Dvar_DestroyDvar(*d);
-			Dvar_Free(*d);
-			*d = NULL;
-			return true;
-		}
-	}
-
-	return false;
+	return Dvar_TableRemove(&s_dvars, name);
 }
 
 void Dvar_ClearDvars(void) {
-	for (int i = 0; i < s_dvarCount; i++) {
-		dvar_t** d = &s_dvars[i];
-		if (*d != NULL) {
-			Dvar_DestroyDvar(*d);
-			Dvar_Free(*d);
-			*d = NULL;
-		}
-	}
+	Dvar_TableClear(&s_dvars);
 }
 
-static dvar_t* s_localDvars[MAX_LOCAL_CLIENTS][DVAR_MAX_DVARS];
-static int s_localDvarCount;
-
 A_NO_DISCARD bool Dvar_LocalExists(int localClientNum, const char* name) {
-	for (int i = 0; i < s_localDvarCount; i++) {
-		if (s_localDvars[localClientNum][i] &&
-			s_localDvars[localClientNum][i]->name_hash == Dvar_HashName(name)
-		) {
-			return true;
-		}
-	}
-
-	return false;
+	return Dvar_TableFind(Dvar_LocalTable(localClientNum), name) != NULL;
 }
 
 A_NO_DISCARD dvar_t* Dvar_FindLocal(int localClientNum, const char* name) {
-	for (int i = 0; i < s_localDvarCount; i++) {
-		if (s_localDvars[localClientNum][i] &&
-			s_localDvars[localClientNum][i]->name_hash == Dvar_HashName(name)
-		) {
-			return s_localDvars[localClientNum][i];
-		}
-	}
-
-	return NULL;
-}
-
-static dvar_t** Dvar_TakeFreeLocalDvar(int localClientNum) {
-	if (s_localDvarCount < DVAR_MAX_DVARS) {
-		dvar_t** d = &s_localDvars[localClientNum][s_localDvarCount++];
-		assert(*d == NULL);
-		return d;
-	}
-
-	for (int i = 0; i < DVAR_MAX_DVARS; i++) {
-		if (s_localDvars[localClientNum][i] == NULL)
-			return &s_localDvars[localClientNum][i];
-	}
-
-	return NULL;
+	return Dvar_TableFind(Dvar_LocalTable(localClientNum), name);
 }
 
 static dvar_t* Dvar_RegisterLocalDvar(int localClientNum, 
 	                                  const char* name, 
 									  const dvar_t* d
 ) {
-	dvar_t** dvar = Dvar_TakeFreeLocalDvar(localClientNum);
-	if (d == NULL)
-		return NULL;
-
-	*dvar = (dvar_t*)Dvar_Alloc(sizeof(*d));
-	A_memcpy(*dvar, d, sizeof(*d));
-	(*dvar)->name = A_cstrdup(name);
-	return *dvar;
+	return Dvar_TableInsert(Dvar_LocalTable(localClientNum), name, d);
 }
 
 static dvar_t* Dvar_RegisterNewLocalDvar(int localClientNum, 
@@ -943,11 +969,7 @@ static dvar_t* Dvar_ReregisterLocalDvar(int localClientNum,
 	                                    const char* name, 
 										const dvar_t* d
 ) {
-	if (!Dvar_LocalExists(localClientNum, name))
-		return NULL;
-
-	Dvar_UnregisterLocal(localClientNum, name);
-	return Dvar_RegisterLocalDvar(localClientNum, name, d);
+	return Dvar_TableReplace(Dvar_LocalTable(localClientNum), name, d);
 }
 
 dvar_t* Dvar_ReregisterLocalBool(int localClientNum,
@@ -962,7 +984,7 @@ dvar_t* Dvar_ReregisterLocalInt(int localClientNum,
 	int value, int min, int max
 ) {
 	dvar_t d = Dvar_CreateInt(name, flags, value, min, max);
-	return Dvar_RegisterLocalDvar(localClientNum, name, &d);
+	return Dvar_ReregisterLocalDvar(localClientNum, name, &d);
 }
 
 dvar_t* Dvar_ReregisterLocalFloat(int localClientNum,
@@ -970,7 +992,7 @@ dvar_t* Dvar_ReregisterLocalFloat(int localClientNum,
 	float value, float min, float max
 ) {
 	dvar_t d = Dvar_CreateFloat(name, flags, value, min, max);
-	return Dvar_RegisterLocalDvar(localClientNum, name, &d);
+	return Dvar_ReregisterLocalDvar(localClientNum, name, &d);
 }
 
 dvar_t* Dvar_ReregisterLocalString(int localClientNum,
@@ -978,7 +1000,7 @@ dvar_t* Dvar_ReregisterLocalString(int localClientNum,
 	const char* value
 ) {
 	dvar_t d = Dvar_CreateString(name, flags, value);
-	return Dvar_RegisterLocalDvar(localClientNum, name, &d);
+	return Dvar_ReregisterLocalDvar(localClientNum, name, &d);
 }
 
 dvar_t* Dvar_ReregisterLocalEnum(int localClientNum,
@@ -986,7 +1008,7 @@ dvar_t* Dvar_ReregisterLocalEnum(int localClientNum,
 	int value, const char** domain, size_t domain_count
 ) {
 	dvar_t d = Dvar_CreateEnum(name, flags, value, domain, domain_count);
-	return Dvar_RegisterLocalDvar(localClientNum, name, &d);
+	return Dvar_ReregisterLocalDvar(localClientNum, name, &d);
 }
 
 dvar_t* Dvar_ReregisterLocalVec2(int localClientNum,
@@ -994,7 +1016,7 @@ dvar_t* Dvar_ReregisterLocalVec2(int localClientNum,
 	avec2f_t value, float min, float max
 ) {
 	dvar_t d = Dvar_CreateVec2(name, flags, value, min, max);
-	return Dvar_RegisterLocalDvar(localClientNum, name, &d);
+	return Dvar_ReregisterLocalDvar(localClientNum, name, &d);
 }
 
 dvar_t* Dvar_ReregisterLocalVec3(int localClientNum,
@@ -1002,7 +1024,7 @@ dvar_t* Dvar_ReregisterLocalVec3(int localClientNum,
 	avec3f_t value, float min, float max
 ) {
 	dvar_t d = Dvar_CreateVec3(name, flags, value, min, max);
-	return Dvar_RegisterLocalDvar(localClientNum, name, &d);
+	return Dvar_ReregisterLocalDvar(localClientNum, name, &d);
 }
 
 dvar_t* Dvar_ReregisterLocalVec4(int localClientNum,
@@ -1010,7 +1032,7 @@ dvar_t* Dvar_ReregisterLocalVec4(int localClientNum,
 	avec4f_t value, float min, float max
 ) {
 	dvar_t d = Dvar_CreateVec4(name, flags, value, min, max);
-	return Dvar_RegisterLocalDvar(localClientNum, name, &d);
+	return Dvar_ReregisterLocalDvar(localClientNum, name, &d);
 }
 
 dvar_t* Dvar_RegisterLocalBool(int localClientNum,
@@ -1103,30 +1125,11 @@ dvar_t* Dvar_RegisterLocalVec4(int localClientNum,
 }
 
 bool Dvar_UnregisterLocal(int localClientNum, const char* name) {
-	for (int i = 0; i < s_localDvarCount; i++) {
-		if (s_localDvars[localClientNum][i] &&
-			s_localDvars[localClientNum][i]->name_hash == Dvar_HashName(name)
-		) {
-			dvar_t** d = &s_localDvars[localClientNum][i];
-			Dvar_DestroyDvar(*d);
-			Dvar_Free(*d);
-			*d = NULL;
-			return true;
-		}
-	}
-
-	return false;
+	return Dvar_TableRemove(Dvar_LocalTable(localClientNum), name);
 }
 
 void Dvar_ClearLocalDvars(int localClientNum) {
-	for (int i = 0; i < s_localDvarCount; i++) {
-		dvar_t** d = &s_localDvars[localClientNum][i];
-		if (*d != NULL) {
-			Dvar_DestroyDvar(*d);
-			Dvar_Free(*d);
-			*d = NULL;
-		}
-	}
+	Dvar_TableClear(Dvar_LocalTable(localClientNum));
 }
 
 #if !A_TARGET_PLATFORM_IS_XBOX
@@ -1392,13 +1395,13 @@ void Dvar_Set_f(void) {
 	const char* name = Cmd_Argv(1);
 
 	const char* argv[4];
-	if (argc <= 3)
+	if (argc > 2)
 		argv[0] = Cmd_Argv(2);
-	if (argc <= 4)
+	if (argc > 3)
 		argv[1] = Cmd_Argv(3);
-	if (argc <= 5)
+	if (argc > 4)
 		argv[2] = Cmd_Argv(4);
-	if (argc <= 6)
+	if (argc > 5)
 		argv[3] = Cmd_Argv(5);
 
 	dvar_t* d = Dvar_Find(name);
@@ -1435,13 +1438,13 @@ void Dvar_SetL_f(void) {
 	const char* name = Cmd_Argv(1);
 
 	const char* argv[4];
-	if (argc <= 3)
+	if (argc > 2)
 		argv[0] = Cmd_Argv(2);
-	if (argc <= 4)
+	if (argc > 3)
 		argv[1] = Cmd_Argv(3);
-	if (argc <= 5)
+	if (argc > 4)
 		argv[2] = Cmd_Argv(4);
-	if (argc <= 6)
+	if (argc > 5)
 		argv[3] = Cmd_Argv(5);
 
 	int activeLocalClient = CL_ClientWithKbmFocus();
@@ -1472,6 +1475,149 @@ void Dvar_SetLA_f(void) {
 }
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 
+#define DVAR_BENCH_DEFAULT_COUNT 2048
+#define DVAR_BENCH_ROUNDS        64
+#define DVAR_BENCH_NAME_LEN      32
+
+// Times registering, finding, reading and unregistering `count` dvars in a
+// scratch table with its own atoms, so neither the real dvars nor the
+// global atoms are touched. The linear scan of case-insensitive compares is what the
+// registry used to do, and the handle read is what code holding on to a
+// dvar_t* pays instead.
+static void Dvar_Bench_f(void) {
+	int count = DVAR_BENCH_DEFAULT_COUNT;
+	if (Cmd_Argc() > 1 && 
+		(!A_atoi(Cmd_Argv(1), &count) || count < 1 || count > DVAR_MAX_DVARS)
+	) {
+		Com_Println(CON_DEST_CLIENT, 
+			        "USAGE: dvar_bench [count (1-%d)]", DVAR_MAX_DVARS);
+		return;
+	}
+
+	DvarTable*  t       = (DvarTable*)Dvar_Alloc(sizeof(*t));
+	char*       names   = (char*)Dvar_Alloc(
+		(size_t)count * 2 * DVAR_BENCH_NAME_LEN);
+	dvar_t**    handles = (dvar_t**)Dvar_Alloc(
+		(size_t)count * sizeof(*handles));
+	AAtomTable* atoms   = A_AtomCreateTable();
+	if (!t || !names || !handles || !atoms) {
+		Com_Println(CON_DEST_CLIENT, "dvar_bench: out of memory.");
+		if (t)       Dvar_Free(t);
+		if (names)   Dvar_Free(names);
+		if (handles) Dvar_Free(handles);
+		if (atoms)   A_AtomDestroyTable(atoms);
+		return;
+	}
+
+	A_memset(t, 0, sizeof(*t));
+	t->atoms = atoms;
+	// The second half of `names` are ones that won't be found. The mixed
+	// case makes every lookup fold it.
+	for (int i = 0; i < count; i++) {
+		A_snprintf(&names[i * DVAR_BENCH_NAME_LEN], DVAR_BENCH_NAME_LEN,
+			       "Bench_Dvar_%d", i);
+		A_snprintf(&names[(count + i) * DVAR_BENCH_NAME_LEN], 
+			       DVAR_BENCH_NAME_LEN, "bench_missing_%d", i);
+	}
+
+	uint64_t start = Sys_Nanoseconds();
+	for (int i = 0; i < count; i++) {
+		// Created under this command's name, which is already interned, so
+		// nothing's added to the global atoms. Inserting it renames it.
+		const char* name = &names[i * DVAR_BENCH_NAME_LEN];
+		dvar_t d = Dvar_CreateInt("dvar_bench", DVAR_FLAG_NONE, i,
+		                          INT_MIN, INT_MAX);
+		handles[i] = Dvar_TableInsert(t, name, &d);
+	}
+	uint64_t insert = Sys_Nanoseconds() - start;
+
+	size_t probes = 0, longest = 0;
+	for (size_t i = 0; i < DVAR_TABLE_SIZE; i++) {
+		if (t->slots[i] == NULL)
+			continue;
+		size_t home = A_atom_hash(t->slots[i]->key) & DVAR_TABLE_MASK;
+		size_t n    = (i - home) & DVAR_TABLE_MASK;
+		probes += n + 1;
+		longest = A_MAX(longest, n + 1);
+	}
+
+	int wrong = 0;
+	int64_t sink = 0;
+	start = Sys_Nanoseconds();
+	for (int r = 0; r < DVAR_BENCH_ROUNDS; r++) {
+		for (int i = 0; i < count; i++) {
+			dvar_t* d = Dvar_TableFind(t, &names[i * DVAR_BENCH_NAME_LEN]);
+			if (d != handles[i] || d == NULL) {
+				wrong++;
+				continue;
+			}
+			sink += Dvar_GetInt(d);
+		}
+	}
+	uint64_t find = Sys_Nanoseconds() - start;
+
+	start = Sys_Nanoseconds();
+	for (int r = 0; r < DVAR_BENCH_ROUNDS; r++) {
+		for (int i = 0; i < count; i++) {
+			const char* name = &names[(count + i) * DVAR_BENCH_NAME_LEN];
+			if (Dvar_TableFind(t, name) != NULL)
+				wrong++;
+		}
+	}
+	uint64_t miss = Sys_Nanoseconds() - start;
+
+	start = Sys_Nanoseconds();
+	for (int i = 0; i < count; i++) {
+		const char* name = &names[i * DVAR_BENCH_NAME_LEN];
+		for (int j = 0; j < count; j++) {
+			if (A_cstricmp(handles[j]->name, name)) {
+				sink += Dvar_GetInt(handles[j]);
+				break;
+			}
+		}
+	}
+	uint64_t linear = Sys_Nanoseconds() - start;
+
+	start = Sys_Nanoseconds();
+	for (int r = 0; r < DVAR_BENCH_ROUNDS; r++) {
+		for (int i = 0; i < count; i++)
+			sink += Dvar_GetInt(handles[i]);
+	}
+	uint64_t handle = Sys_Nanoseconds() - start;
+
+	start = Sys_Nanoseconds();
+	for (int i = 0; i < count; i++) {
+		if (!Dvar_TableRemove(t, &names[i * DVAR_BENCH_NAME_LEN]))
+			wrong++;
+	}
+	uint64_t remove = Sys_Nanoseconds() - start;
+	if (t->count != 0)
+		wrong++;
+
+	Dvar_Free(handles);
+	Dvar_Free(names);
+	Dvar_Free(t);
+	A_AtomDestroyTable(atoms);
+
+	double lookups = (double)count * DVAR_BENCH_ROUNDS;
+	Com_Println(CON_DEST_CLIENT,
+		        "dvar_bench: %d dvars in %d slots, %.2f probes a find on "
+		        "average, %zu at most.",
+		        count, DVAR_TABLE_SIZE, (double)probes / count, longest);
+	Com_Println(CON_DEST_CLIENT,
+		        "dvar_bench: register %.1f ns, find %.1f ns, miss %.1f ns, "
+		        "unregister %.1f ns.",
+		        (double)insert / count, (double)find / lookups,
+		        (double)miss / lookups, (double)remove / count);
+	Com_Println(CON_DEST_CLIENT,
+		        "dvar_bench: linear scan %.1f ns a find, handle read %.2f ns "
+		        "(checksum %lld).",
+		        (double)linear / count, (double)handle / lookups, 
+		        (long long)sink);
+	if (wrong)
+		Com_Println(CON_DEST_CLIENT, "dvar_bench: FAILED, %d wrong.", wrong);
+}
+
 void Dvar_Shutdown(void) {
 #if !A_TARGET_PLATFORM_IS_XBOX
 	Cmd_RemoveCommand("set");
@@ -1479,6 +1625,7 @@ void Dvar_Shutdown(void) {
 	Cmd_RemoveCommand("setl");
 	Cmd_RemoveCommand("setla");
 #endif // !A_TARGET_PLATFORM_IS_XBOX
+	Cmd_RemoveCommand("dvar_bench");
 
 	Dvar_ClearDvars();
 	for(size_t i = 0; i < MAX_LOCAL_CLIENTS; i++)
@@ -407,7 +407,12 @@ bool FS_DeleteFile(const char* filename) {
 
 bool FS_FileExists(const char* filename) {
 #if !A_TARGET_PLATFORM_IS_XBOX
-	return SDL_RWFromFile(filename, "r") != NULL;
+	SDL_RWops* ops = SDL_RWFromFile(filename, "r");
+	if (ops == NULL)
+		return false;
+
+	SDL_RWclose(ops);
+	return true;
 #else
 	DWORD attrib = GetFileAttributesA(filename);
 
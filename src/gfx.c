@@ -19,14 +19,22 @@
 #include "cg_cgame.h"
 #include "cl_client.h"
 #include "cl_map.h"
+#include "com_perf.h"
 #include "com_print.h"
+#include "com_prof.h"
 #include "db_files.h"
 #include "dvar.h"
 #include "font.h"
 #include "gfx_backend.h"
+#include "gfx_bvh.h"
+#include "gfx_capture.h"
+#include "gfx_debug.h"
 #include "gfx_map.h"
+#include "gfx_progcache.h"
 #include "gfx_shader.h"
+#include "gfx_stats.h"
 #include "gfx_text.h"
+#include "gfx_timer.h"
 #include "gfx_uniform.h"
 #include "sys.h"
 
@@ -196,6 +204,8 @@ dvar_t* r_fullscreen;
 dvar_t* r_noBorder;
 dvar_t* r_renderDistance;
 dvar_t* r_wireframe;
+dvar_t* r_drawPerfGraph;
+dvar_t* r_drawStats;
 
 extern FontDef r_defaultFont;
 
@@ -453,6 +463,8 @@ void R_Init(void) {
     r_renderGlob.clear_color.a = 1.0f;
 
     R_RegisterDvars();
+    // Before anything creates a shader program.
+    R_InitProgramCache();
 
 #if A_RENDER_BACKEND_GL
     bool b = R_InitGL();
@@ -487,6 +499,12 @@ void R_Init(void) {
         color, true, false, &r_testDrawId
     );
     R_InitMap();
+    R_InitDebugDraw();
+    R_InitGpuTimers();
+    R_InitStats();
+    R_InitBvh();
+    R_InitCapture();
+    R_ReportProgramCache();
 
     //glEnable(GL_POINT_SMOOTH);
     //glPointSize(4);
@@ -524,13 +542,14 @@ void R_UpdateProjection(size_t localClientNum) {
     float h = cg->viewport.h * Dvar_GetInt(vid_height);
 
 #if A_RENDER_BACKEND_GL
-    mat4 perspective;
-    glm_perspective(A_radians(cg->fovy), w / h, cg->nearPlane, cg->farPlane, perspective);
+    cg->camera.perspectiveProjection = A_mat4f_perspective(
+        A_radians(cg->fovy), w / h, cg->nearPlane, cg->farPlane
+    );
 #elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
-    D3DXMATRIX perspective;
-    D3DXMatrixPerspectiveFovLH(&perspective, A_radians(cg->fovy), w / h, cg->nearPlane, cg->farPlane);
+    cg->camera.perspectiveProjection = A_mat4f_perspective_lh(
+        A_radians(cg->fovy), w / h, cg->nearPlane, cg->farPlane
+    );
 #endif // A_RENDER_BACKEND_GL
-    cg->camera.perspectiveProjection = *(amat4f_t*)&perspective;
 }
 
 static void R_UpdateLocalClientView(size_t localClientNum) {
@@ -546,13 +565,15 @@ static void R_RegisterDvars(void) {
                                           R_FAR_PLANE_DEFAULT, 
                                           10.0f, 1000000.0f);
     r_wireframe      = Dvar_RegisterBool("r_wireframe", DVAR_FLAG_NONE, false);
+    r_drawPerfGraph  = Dvar_RegisterBool("r_drawPerfGraph", DVAR_FLAG_NONE, 
+                                         false);
+    r_drawStats      = Dvar_RegisterBool("r_drawStats", DVAR_FLAG_NONE, false);
 }
 
 void R_DrawFrame(size_t localClientNum) {
-    GfxCamera* camera = &CG_GetLocalClientGlobals(localClientNum)->camera;
-    avec3f_t* front = &camera->front;
-    Com_DPrintln(CON_DEST_CLIENT, "R_DrawFrame: camera %i dir = (%f, %f, %f)", localClientNum, front->x, front->y, front->z);
+    R_BeginGpuTimer((GfxGpuPass)(R_GPU_PASS_CLIENT0 + localClientNum));
     R_DrawFrameInternal(localClientNum);
+    R_EndGpuTimer((GfxGpuPass)(R_GPU_PASS_CLIENT0 + localClientNum));
 }
 
 static bool R_EnableScissorTest(void) {
@@ -606,8 +627,11 @@ static void R_EndFrame(void) {
 }
 
 void R_Frame(void) {
+    R_BeginStatsFrame();
     RB_BeginFrame();
     R_BeginFrame();
+    R_BeginCaptureFrame();
+    R_BeginGpuTimerFrame();
     R_EnableScissorTest();
     for (size_t i = 0; i < MAX_LOCAL_CLIENTS; i++) {
         if (!CG_LocalClientIsActive(i))
@@ -616,8 +640,19 @@ void R_Frame(void) {
         R_DrawFrame(i);
     }
     R_DisableScissorTest();
+    if (Dvar_GetBool(r_drawPerfGraph) || Dvar_GetBool(r_drawStats)) {
+        R_SetViewport(0, 0, Dvar_GetInt(vid_width), Dvar_GetInt(vid_height));
+        if (Dvar_GetBool(r_drawPerfGraph))
+            R_DrawPerfGraph();
+        if (Dvar_GetBool(r_drawStats))
+            R_DrawStatsOverlay();
+    }
+    R_EndGpuTimerFrame();
+    R_EndCaptureFrame();
+    Com_PerfMarkSubmit();
     R_EndFrame();
     RB_EndFrame();
+    Com_PerfMarkSwap();
 }
 
 void R_WindowResized(void) {
@@ -650,6 +685,19 @@ static GLint R_ImageFormatToTypeGL(ImageFormat format) {
 }
 #endif // A_RENDER_BACKEND_GL
 
+// An estimate, since the driver is free to pad or convert the image.
+static size_t R_ImageResidentBytes(size_t pixels_size, int width, int height,
+                                   ImageFormat format, bool mipmapped
+) {
+    size_t bytes = pixels_size;
+    if (bytes == 0)
+        bytes = (size_t)width * (size_t)height * R_ImageFormatBPP(format) / 8;
+    // A full mip chain adds roughly another third.
+    if (mipmapped)
+        bytes += bytes / 3;
+    return bytes;
+}
+
 A_NO_DISCARD bool R_CreateImage2D(const void* pixels, size_t pixels_size, 
                                   int width, int height, int depth,
                                   ImageFormat format,
@@ -822,6 +870,10 @@ A_NO_DISCARD bool R_CreateImage2D(const void* pixels, size_t pixels_size,
     image->wrap_t          = true;
     image->minfilter       = minfilter;
     image->magfilter       = magfilter;
+    image->resident_bytes  = R_ImageResidentBytes(pixels_size, width, height,
+                                                  format, 
+                                                  auto_generate_mipmaps);
+    r_stats.texture_bytes_resident += image->resident_bytes;
 
     return true;
 }
@@ -936,6 +988,9 @@ A_NO_DISCARD bool R_ImageSubData(A_INOUT GfxImage* image,
 }
 
 void R_DeleteImage(A_INOUT GfxImage* image) {
+    assert(r_stats.texture_bytes_resident >= image->resident_bytes);
+    r_stats.texture_bytes_resident -= image->resident_bytes;
+    image->resident_bytes = 0;
 #if A_RENDER_BACKEND_GL
     GL_CALL(glDeleteTextures, 1, &image->tex);
 #elif A_RENDER_BACKEND_D3D9
@@ -1125,6 +1180,7 @@ void R_Clear(void) {
 }
 
 bool R_BindVertexBuffer(const GfxVertexBuffer* vb, int stream) {
+    r_stats.vao_binds++;
 #if A_RENDER_BACKEND_GL
     assert(stream == 0);
     if (vb) {
@@ -1157,6 +1213,7 @@ bool R_BindVertexBuffer(const GfxVertexBuffer* vb, int stream) {
 }
 
 bool R_BindImage(A_INOUT GfxImage* image, int index) {
+    r_stats.texture_binds++;
 #if A_RENDER_BACKEND_GL
     if (image) {
         GL_CALL(glActiveTexture, GL_TEXTURE0 + index);
@@ -1187,6 +1244,8 @@ bool R_BindImage(A_INOUT GfxImage* image, int index) {
 }
 
 bool R_BindShaderProgram(const GfxShaderProgram* prog) {
+    COM_PROF_BEGIN("R_BindShaderProgram");
+    r_stats.program_binds++;
 #if A_RENDER_BACKEND_GL
     if (prog) {
         GL_CALL(glUseProgram, prog->program);
@@ -1204,6 +1263,7 @@ bool R_BindShaderProgram(const GfxShaderProgram* prog) {
 #else
     assert(false && "unimplemented"); // FIXME
 #endif // A_RENDER_BACKEND_GL
+    COM_PROF_END();
     return true;
 }
 
@@ -1214,6 +1274,8 @@ static GLenum R_PrimitiveTypeToGL(GfxPrimitiveType type) {
         return GL_TRIANGLES;
     case PRIMITIVE_TYPE_TRI_STRIP:
         return GL_TRIANGLE_STRIP;
+    case PRIMITIVE_TYPE_LINE:
+        return GL_LINES;
     default:
         assert(false && "R_PrimitiveTypeToGL: invalid GfxPrimitiveType");
         Com_Errorln(
@@ -1230,6 +1292,8 @@ static D3DPRIMITIVETYPE R_PrimitiveTypeToD3D(GfxPrimitiveType type) {
         return D3DPT_TRIANGLELIST;
     case PRIMITIVE_TYPE_TRI_STRIP:
         return D3DPT_TRIANGLESTRIP;
+    case PRIMITIVE_TYPE_LINE:
+        return D3DPT_LINELIST;
     default:
         assert(false && "R_PrimitiveTypeToGL: invalid GfxPrimitiveType");
         Com_Errorln(
@@ -1242,11 +1306,15 @@ static D3DPRIMITIVETYPE R_PrimitiveTypeToD3D(GfxPrimitiveType type) {
 #endif // A_RENDER_BACKEND_GL
 
 bool R_DrawPrimitives(GfxPrimitiveType type, int primitive_count, int primitive_off) {
-    int off = type == PRIMITIVE_TYPE_TRI ? 3 * primitive_off : type == PRIMITIVE_TYPE_TRI_STRIP ? 1 * primitive_off : -1;
+    int off = type == PRIMITIVE_TYPE_TRI ? 3 * primitive_off : type == PRIMITIVE_TYPE_TRI_STRIP ? 1 * primitive_off : type == PRIMITIVE_TYPE_LINE ? 2 * primitive_off : -1;
+    int vertices = type == PRIMITIVE_TYPE_TRI ? primitive_count * 3 : type == PRIMITIVE_TYPE_TRI_STRIP ? primitive_count + 2 : type == PRIMITIVE_TYPE_LINE ? primitive_count * 2 : 0;
+    r_stats.draw_calls++;
+    r_stats.vertices  += vertices;
+    if (type != PRIMITIVE_TYPE_LINE)
+        r_stats.triangles += primitive_count;
 #if A_RENDER_BACKEND_GL
     GLenum mode = R_PrimitiveTypeToGL(type);
-    GLsizei count = type == PRIMITIVE_TYPE_TRI ? primitive_count * 3 : type == PRIMITIVE_TYPE_TRI_STRIP ? primitive_count + 2 : -1;
-    GL_CALL(glDrawArrays, mode, off, count);
+    GL_CALL(glDrawArrays, mode, off, vertices);
 #elif A_RENDER_BACKEND_D3D
     D3DPRIMITIVETYPE primitive_type = R_PrimitiveTypeToD3D(type);
 #if A_RENDER_BACKEND_D3D9
@@ -1289,27 +1357,20 @@ static void R_DrawFrameInternal(size_t localClientNum) {
     //    1.0f, 1.0f, color, false
     //);
 
-    avec4f_t pos   = A_vec4(cg->camera.pos.x,   
-                            cg->camera.pos.y,   
-                            cg->camera.pos.z,
-                            1.0f);
-    avec4f_t front = A_vec4(cg->camera.front.x, 
-                            cg->camera.front.y, 
-                            cg->camera.front.z,
-                            1.0f);
-    avec4f_t center = A_vec4f_add(pos, front);
+    avec3f_t pos    = A_vec3(cg->camera.pos.x,   
+                             cg->camera.pos.y,   
+                             cg->camera.pos.z);
+    avec3f_t center = A_vec3f_add(pos, cg->camera.front);
 #if A_RENDER_BACKEND_GL
-    mat4 view;
-    glm_lookat(pos.array, center.array, cg->camera.up.array, view);
+    amat4f_t view = A_mat4f_look_at(pos, center, cg->camera.up);
 #elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
-    D3DXMATRIX view;
-    D3DXMatrixLookAtLH(&view, (D3DXVECTOR3*)&pos, (D3DXVECTOR3*)&center, (D3DXVECTOR3*)&cg->camera.up);
+    amat4f_t view = A_mat4f_look_at_lh(pos, center, cg->camera.up);
 #endif // A_RENDER_BACKEND_GL
 #if !A_TARGET_PLATFORM_IS_XBOX
     R_ShaderSetUniformMat4fByName(&r_mapGlob.prog, "uView", 
-                                  SHADER_TYPE_VERTEX, *(amat4f_t*)&view);
+                                  SHADER_TYPE_VERTEX, view);
     R_ShaderSetUniformMat4fByName(&r_mapGlob.model_prog, "uView",
-                                  SHADER_TYPE_VERTEX, *(amat4f_t*)&view);
+                                  SHADER_TYPE_VERTEX, view);
     R_ShaderSetUniformMat4fByName(&r_mapGlob.prog, "uPerspectiveProjection",
                                   SHADER_TYPE_VERTEX,
                                   cg->camera.perspectiveProjection);
@@ -1325,11 +1386,15 @@ static void R_DrawFrameInternal(size_t localClientNum) {
 }
 
 static void R_UnregisterDvars(void) {
+    Dvar_Unregister("r_drawStats");
+    Dvar_Unregister("r_drawPerfGraph");
     Dvar_Unregister("r_wireframe");
     Dvar_Unregister("r_renderDistance");
     Dvar_Unregister("r_noBorder");
     Dvar_Unregister("r_fullscreen");
     Dvar_Unregister("r_vsync");
+    r_drawStats      = NULL;
+    r_drawPerfGraph  = NULL;
     r_wireframe      = NULL;
     r_renderDistance = NULL;
     r_noBorder       = NULL;
@@ -1382,10 +1447,16 @@ static void R_ShutdownD3D8(void) {
 #endif // A_RENDER_BACKEND_D3D9
 
 A_EXTERN_C void R_Shutdown(void) {
+    R_ShutdownCapture();
+    R_ShutdownBvh();
+    R_ShutdownStats();
     for(size_t i = 0; i < MAX_LOCAL_CLIENTS; i++)
         R_ClearTextDrawDefs(i);
 
+    R_ShutdownGpuTimers();
+    R_ShutdownDebugDraw();
     R_ShutdownMap();
+    R_ShutdownProgramCache();
 
     R_UnregisterDvars();
 #if A_RENDER_BACKEND_GL
@@ -12,6 +12,8 @@ extern dvar_t* r_fullscreen;
 extern dvar_t* r_noBorder;
 extern dvar_t* r_renderDistance;
 extern dvar_t* r_wireframe;
+extern dvar_t* r_drawPerfGraph;
+extern dvar_t* r_drawStats;
 
 A_EXTERN_C void R_Init(void);
 
@@ -1,11 +1,27 @@
 #include "gfx_backend.h"
 
 #include <stdio.h>
+#include <string.h>
+
+#ifndef A_HAVE_EGL
+#define A_HAVE_EGL 0
+#endif // A_HAVE_EGL
+
+// Headless runs need EGL for a context without a window.
+#define RB_HAS_OFFSCREEN (A_RENDER_BACKEND_GL && A_HAVE_EGL)
 
 #if A_RENDER_BACKEND_GL
 #include <GL/glew.h>
 #endif // A_RENDER_BACKEND_GL
 
+#if RB_HAS_OFFSCREEN
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif // RB_HAS_OFFSCREEN
+
+#include "acommon/a_string.h"
+
 #include "com_print.h"
 #include "dvar.h"
 #include "gfx.h"
@@ -13,6 +29,154 @@
 
 static bool s_windowResizeable;
 
+#if RB_HAS_OFFSCREEN
+// Headless, frames are drawn into a pbuffer the size of vid_width and
+// vid_height instead of a window, on Mesa's surfaceless platform if it's
+// there, which needs no display: it renders on the GPU's render node if
+// it can get one and on llvmpipe if not (or with LIBGL_ALWAYS_SOFTWARE=1).
+// Everything past the context is the same GL the window gets.
+typedef struct RBOffscreen {
+    EGLDisplay display;
+    EGLConfig  config;
+    EGLContext context;
+    EGLSurface surface;
+    int        width, height;
+    GLsync     frame_fence; // the end of the frame before this one
+} RBOffscreen;
+static RBOffscreen s_offscreen;
+
+static EGLDisplay RB_GetOffscreenDisplay(void) {
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    const char* exts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+            "eglGetPlatformDisplayEXT");
+    if (exts && strstr(exts, "EGL_MESA_platform_surfaceless") &&
+        getPlatformDisplay) {
+        EGLDisplay display = getPlatformDisplay(
+            EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display != EGL_NO_DISPLAY)
+            return display;
+    }
+#endif // EGL_PLATFORM_SURFACELESS_MESA
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static EGLSurface RB_CreateOffscreenSurface(int width, int height) {
+    const EGLint attribs[] = {
+        EGL_WIDTH,  width,
+        EGL_HEIGHT, height,
+        EGL_NONE
+    };
+    return eglCreatePbufferSurface(s_offscreen.display, s_offscreen.config,
+                                   attribs);
+}
+
+static void RB_InitOffscreen(void) {
+    RBOffscreen* o = &s_offscreen;
+    EGLint major = 0, minor = 0;
+    o->display = RB_GetOffscreenDisplay();
+    if (o->display == EGL_NO_DISPLAY ||
+        !eglInitialize(o->display, &major, &minor)) {
+        printf("Headless: couldn't initialize EGL (0x%x).\n", eglGetError());
+        Sys_NormalExit(-1);
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE,        8,
+        EGL_GREEN_SIZE,      8,
+        EGL_BLUE_SIZE,       8,
+        EGL_ALPHA_SIZE,      8,
+        EGL_DEPTH_SIZE,      24,
+        EGL_NONE
+    };
+    EGLint configs = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) ||
+        !eglChooseConfig(o->display, config_attribs, &o->config, 1,
+                         &configs) ||
+        configs < 1) {
+        printf("Headless: EGL %d.%d has no desktop GL pbuffer config.\n",
+               major, minor);
+        Sys_NormalExit(-1);
+    }
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION,       3,
+        EGL_CONTEXT_MINOR_VERSION,       3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    o->context = eglCreateContext(o->display, o->config, EGL_NO_CONTEXT,
+                                  context_attribs);
+    o->width   = Dvar_GetInt(vid_width);
+    o->height  = Dvar_GetInt(vid_height);
+    o->surface = RB_CreateOffscreenSurface(o->width, o->height);
+    if (o->context == EGL_NO_CONTEXT || o->surface == EGL_NO_SURFACE ||
+        !eglMakeCurrent(o->display, o->surface, o->surface, o->context)) {
+        printf("Headless: GL 3.3 context creation failed (0x%x).\n",
+               eglGetError());
+        Sys_NormalExit(-1);
+    }
+
+    printf("Headless: EGL %d.%d, %s\n", major, minor,
+           eglQueryString(o->display, EGL_VENDOR));
+}
+
+// vid_width and vid_height resize the pbuffer, as they would the window.
+static void RB_ResizeOffscreen(void) {
+    RBOffscreen* o = &s_offscreen;
+    if (!Dvar_WasModified(vid_width) && !Dvar_WasModified(vid_height))
+        return;
+
+    Dvar_ClearModified(vid_width);
+    Dvar_ClearModified(vid_height);
+    int width  = Dvar_GetInt(vid_width);
+    int height = Dvar_GetInt(vid_height);
+    if (width == o->width && height == o->height)
+        return;
+
+    EGLSurface surface = RB_CreateOffscreenSurface(width, height);
+    if (surface == EGL_NO_SURFACE ||
+        !eglMakeCurrent(o->display, surface, surface, o->context)) {
+        Com_Println(CON_DEST_ERR,
+                    "Failed to resize the offscreen surface to %dx%d (0x%x).",
+                    width, height, eglGetError());
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(o->display, surface);
+        Dvar_SetInt(vid_width,  o->width);
+        Dvar_SetInt(vid_height, o->height);
+        Dvar_ClearModified(vid_width);
+        Dvar_ClearModified(vid_height);
+        return;
+    }
+
+    eglDestroySurface(o->display, o->surface);
+    o->surface = surface;
+    o->width   = width;
+    o->height  = height;
+    R_WindowResized();
+}
+
+static void RB_ShutdownOffscreen(void) {
+    RBOffscreen* o = &s_offscreen;
+    if (o->display == EGL_NO_DISPLAY)
+        return;
+
+    if (o->frame_fence)
+        glDeleteSync(o->frame_fence);
+    eglMakeCurrent(o->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (o->surface != EGL_NO_SURFACE)
+        eglDestroySurface(o->display, o->surface);
+    if (o->context != EGL_NO_CONTEXT)
+        eglDestroyContext(o->display, o->context);
+    eglTerminate(o->display);
+    A_memset(o, 0, sizeof(*o));
+}
+#endif // RB_HAS_OFFSCREEN
+
 bool RB_WindowResizeable(void) {
     return s_windowResizeable;
 }
@@ -41,32 +205,58 @@ void RB_EnableWindowResize(bool resizeable) {
 }
 
 A_EXTERN_C void RB_Init(void) {
+#if !RB_HAS_OFFSCREEN && !A_TARGET_PLATFORM_IS_XBOX
+    if (Sys_Headless()) {
+        printf("Headless runs need the GL backend built with EGL.\n");
+        Sys_NormalExit(-3);
+    }
+#endif // !RB_HAS_OFFSCREEN && !A_TARGET_PLATFORM_IS_XBOX
+
 #if A_RENDER_BACKEND_GL
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, 
-                        SDL_GL_CONTEXT_PROFILE_CORE);
+#if RB_HAS_OFFSCREEN
+    if (Sys_Headless()) {
+        RB_InitOffscreen();
+    } else
+#endif // RB_HAS_OFFSCREEN
+    {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, 
+                            SDL_GL_CONTEXT_PROFILE_CORE);
 #if _DEBUG
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
 #endif // _DEBUG
-    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+        SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+        SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
-    SDL_SetHint(SDL_HINT_VIDEO_MINIMIZE_ON_FOCUS_LOSS, "0");
+        SDL_SetHint(SDL_HINT_VIDEO_MINIMIZE_ON_FOCUS_LOSS, "0");
 
-    sys_sdlGlob.glContext = SDL_GL_CreateContext(sys_sdlGlob.window);
-    if (sys_sdlGlob.glContext == NULL) {
-        printf("GL context creation failed: %s\n", SDL_GetError());
-        Sys_NormalExit(-1);
+        sys_sdlGlob.glContext = SDL_GL_CreateContext(sys_sdlGlob.window);
+        if (sys_sdlGlob.glContext == NULL) {
+            printf("GL context creation failed: %s\n", SDL_GetError());
+            Sys_NormalExit(-1);
+        }
     }
 
     GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW built for GLX loads every function through GLVND's dispatch,
+    // then complains that there's no X display behind an EGL context.
+    if (err == GLEW_ERROR_NO_GLX_DISPLAY && Sys_Headless())
+        err = GLEW_OK;
+#endif // GLEW_ERROR_NO_GLX_DISPLAY
     if (err != GLEW_OK) {
         printf("GLEW init failed: %s", glewGetErrorString(err));
         Sys_NormalExit(-2);
     }
-    
-    RB_EnableWindowResize(true);
+
+    if (Sys_Headless()) {
+        printf("Headless: %s, %s\n",
+               (const char*)glGetString(GL_RENDERER),
+               (const char*)glGetString(GL_VERSION));
+    } else {
+        RB_EnableWindowResize(true);
+    }
 #elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
     RB_EnableWindowResize(false);
 #endif // A_RENDER_BACKEND_GL
@@ -74,6 +264,10 @@ A_EXTERN_C void RB_Init(void) {
 
 A_EXTERN_C bool RB_EnableVsync(bool enable) {
 #if A_RENDER_BACKEND_GL
+    // A pbuffer's never presented, so there's nothing to sync to.
+    if (Sys_Headless())
+        return true;
+
     return SDL_GL_SetSwapInterval((int)enable) == 0;
 #else
     (void)enable;
@@ -94,6 +288,13 @@ A_EXTERN_C void RB_BeginFrame(void) {
         }
     }
 
+#if RB_HAS_OFFSCREEN
+    if (Sys_Headless()) {
+        RB_ResizeOffscreen();
+        return;
+    }
+#endif // RB_HAS_OFFSCREEN
+
 #if !A_TARGET_PLATFORM_IS_XBOX
     if (Dvar_WasModified(r_fullscreen) && RB_WindowResizeable()) {
         if (Dvar_GetBool(r_fullscreen)) {
@@ -162,12 +363,38 @@ A_EXTERN_C void RB_BeginFrame(void) {
 }
 
 A_EXTERN_C void RB_EndFrame(void) {
+#if RB_HAS_OFFSCREEN
+    // Nothing's presented, so nothing would stop frames queueing up on the
+    // GPU without bound. Like a swap with one frame queued, this waits for
+    // the frame before to finish, not this one, so the CPU can get on with
+    // the next frame while the GPU draws this one, and fences and queries
+    // from this frame can still be pending a frame later.
+    if (Sys_Headless()) {
+        RBOffscreen* o = &s_offscreen;
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        if (o->frame_fence) {
+            glClientWaitSync(o->frame_fence, 0, GL_TIMEOUT_IGNORED);
+            glDeleteSync(o->frame_fence);
+        }
+        o->frame_fence = fence;
+        return;
+    }
+#endif // RB_HAS_OFFSCREEN
+
 #if A_RENDER_BACKEND_GL
     SDL_GL_SwapWindow(sys_sdlGlob.window);
 #endif // A_RENDER_BACKEND_GL
 }
 
 A_EXTERN_C void RB_Shutdown(void) {
+#if RB_HAS_OFFSCREEN
+    if (Sys_Headless()) {
+        RB_ShutdownOffscreen();
+        return;
+    }
+#endif // RB_HAS_OFFSCREEN
+
 #if A_RENDER_BACKEND_GL
     SDL_GL_DeleteContext(sys_sdlGlob.glContext);
 #endif // A_RENDER_BACKEND_GL
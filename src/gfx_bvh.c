@@ -0,0 +1,1283 @@
+#include "gfx_bvh.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "acommon/a_atomic.h"
+#include "acommon/a_cpu.h"
+#include "acommon/a_string.h"
+
+#include "cg_cgame.h"
+#include "cl_client.h"
+#include "cl_map.h"
+#include "cmd_commands.h"
+#include "com_print.h"
+#include "vm_vmem.h"
+
+#if A_CPU_CAN_BUILD_SSE2
+#include <emmintrin.h>
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_NEON
+#include <arm_neon.h>
+#endif // A_CPU_CAN_BUILD_NEON
+
+#define R_BVH_BINS           16
+#define R_BVH_MAX_LEAF_TRIS  8
+// The intersection cost is per block of four triangles, since that's what
+// the kernels test at once, so SAH fills leaves out to whole blocks.
+#define R_BVH_TRAVERSAL_COST 1.0f
+#define R_BVH_INTERSECT_COST 1.0f
+#define R_BVH_BLOCKS(tris)   (((tris) + 3) / 4)
+// Past this depth, nodes are split in half instead of by SAH, so a run of
+// lopsided splits can't outgrow the traversal stack.
+#define R_BVH_SAH_MAX_DEPTH  40
+#define R_BVH_STACK_SIZE     64
+#define R_BVH_DET_EPSILON    1e-12f
+// How far short of `b` R_BvhOccluded stops, so a point on a triangle isn't
+// hidden by the triangle itself.
+#define R_BVH_OCCLUSION_EPSILON 0.001f
+
+#define R_BVH_MAX_THREADS    16
+#define R_BVH_MAX_TASKS      1024
+// Subtrees with fewer triangles than this aren't worth a task of their
+// own.
+#define R_BVH_TASK_MIN_TRIS  1024
+
+#define R_BVH_TRACE_DEFAULT_DISTANCE 1000.0f
+#define R_BVH_BENCH_DEFAULT_RAYS     1000000
+#define R_BVH_BENCH_GRID             256
+
+// Inner nodes' left child is the node after them, and `offset` is their
+// right child. A leaf's triangles are the `count` starting at lane 0 of
+// block `offset`.
+typedef struct GfxBvhNode {
+    avec3f_t mins;
+    uint32_t offset;
+    avec3f_t maxs;
+    uint32_t count; // 0 for inner nodes
+} GfxBvhNode;
+A_STATIC_ASSERT(sizeof(GfxBvhNode) == 32);
+
+// Four triangles as a vertex and two edges each, a lane apiece. A leaf's
+// last block is padded out with triangles with no area, which nothing
+// hits.
+typedef struct GfxBvhTriBlock {
+    float v0x[4], v0y[4], v0z[4];
+    float e1x[4], e1y[4], e1z[4];
+    float e2x[4], e2y[4], e2z[4];
+} GfxBvhTriBlock;
+
+typedef struct GfxBvhTriRef {
+    uint16_t lightmap;
+    uint16_t material;
+    uint32_t surf;
+} GfxBvhTriRef;
+
+typedef struct GfxBvh {
+    GfxBvhNode*     nodes;
+    uint32_t        node_count;
+    uint32_t        leaf_count;
+    uint32_t        depth;
+    GfxBvhTriBlock* blocks;
+    GfxBvhTriRef*   refs;       // one per lane of `blocks`
+    uint32_t        block_count;
+    uint32_t        tri_count;
+    float           sah_cost;
+    size_t          bytes;
+} GfxBvh;
+
+typedef struct GfxBvhRay {
+    avec3f_t origin;
+    avec3f_t dir;
+    avec3f_t inv_dir;
+} GfxBvhRay;
+
+// Returns the lane of `b` the ray hits nearest, if that's nearer than `*t`,
+// and moves `*t` up to it. Returns -1 if none is.
+typedef int (*GfxBvhIntersectFn)(const GfxBvhTriBlock* b,
+                                 const GfxBvhRay* ray, A_INOUT float* t);
+
+typedef struct GfxBvhGlob {
+    bool              loaded;
+    GfxBvh            bvh;
+    uint64_t          build_ns;
+    uint32_t          build_threads;
+    GfxBvhIntersectFn intersect;
+    const char*       intersect_name;
+} GfxBvhGlob;
+static GfxBvhGlob r_bvhGlob;
+
+static void R_Trace_f   (void);
+static void R_BvhBench_f(void);
+
+// ============================================================================
+// Small vector helpers
+static avec3f_t R_BvhVec3(float x, float y, float z) {
+    avec3f_t v;
+    v.x = x;
+    v.y = y;
+    v.z = z;
+    return v;
+}
+
+static avec3f_t R_BvhSub(avec3f_t a, avec3f_t b) {
+    return R_BvhVec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static float R_BvhDot(avec3f_t a, avec3f_t b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static avec3f_t R_BvhCross(avec3f_t a, avec3f_t b) {
+    return R_BvhVec3(a.y * b.z - a.z * b.y,
+                     a.z * b.x - a.x * b.z,
+                     a.x * b.y - a.y * b.x);
+}
+
+static avec3f_t R_BvhMin(avec3f_t a, avec3f_t b) {
+    return R_BvhVec3(A_MIN(a.x, b.x), A_MIN(a.y, b.y), A_MIN(a.z, b.z));
+}
+
+static avec3f_t R_BvhMax(avec3f_t a, avec3f_t b) {
+    return R_BvhVec3(A_MAX(a.x, b.x), A_MAX(a.y, b.y), A_MAX(a.z, b.z));
+}
+
+static avec3f_t R_BvhFromPoint(apoint3f_t p) {
+    return R_BvhVec3(p.x, p.y, p.z);
+}
+
+static float R_BvhArea(avec3f_t mins, avec3f_t maxs) {
+    avec3f_t e = R_BvhSub(maxs, mins);
+    return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+// ============================================================================
+
+// ============================================================================
+// Ray-triangle kernels, Möller-Trumbore four triangles at a time. The SIMD
+// ones do exactly the scalar one's arithmetic, so they find the same hits.
+static int R_BvhIntersectScalar(const GfxBvhTriBlock* b,
+                                const GfxBvhRay* ray, A_INOUT float* t
+) {
+    const avec3f_t* d = &ray->dir;
+    int hit = -1;
+    for (int i = 0; i < 4; i++) {
+        float px  = d->y * b->e2z[i] - d->z * b->e2y[i];
+        float py  = d->z * b->e2x[i] - d->x * b->e2z[i];
+        float pz  = d->x * b->e2y[i] - d->y * b->e2x[i];
+        float det = b->e1x[i] * px + b->e1y[i] * py + b->e1z[i] * pz;
+        if (fabsf(det) <= R_BVH_DET_EPSILON)
+            continue;
+
+        float inv = 1.0f / det;
+        float sx  = ray->origin.x - b->v0x[i];
+        float sy  = ray->origin.y - b->v0y[i];
+        float sz  = ray->origin.z - b->v0z[i];
+        float u   = (sx * px + sy * py + sz * pz) * inv;
+        if (u < 0.0f)
+            continue;
+
+        float qx = sy * b->e1z[i] - sz * b->e1y[i];
+        float qy = sz * b->e1x[i] - sx * b->e1z[i];
+        float qz = sx * b->e1y[i] - sy * b->e1x[i];
+        float v  = (d->x * qx + d->y * qy + d->z * qz) * inv;
+        if (v < 0.0f || u + v > 1.0f)
+            continue;
+
+        float dist = (b->e2x[i] * qx + b->e2y[i] * qy + b->e2z[i] * qz) * inv;
+        if (dist > 0.0f && dist < *t) {
+            *t  = dist;
+            hit = i;
+        }
+    }
+    return hit;
+}
+
+// Of the lanes set in `mask`, the one with the smallest `dist`, the first
+// if there's a tie.
+static int R_BvhNearestLane(int mask, const float* dist, A_INOUT float* t) {
+    int hit = -1;
+    for (int i = 0; i < 4; i++) {
+        if ((mask & (1 << i)) && dist[i] < *t) {
+            *t  = dist[i];
+            hit = i;
+        }
+    }
+    return hit;
+}
+
+#if A_CPU_CAN_BUILD_SSE2
+A_TARGET_FEATURE("sse2")
+static int R_BvhIntersectSse2(const GfxBvhTriBlock* b,
+                              const GfxBvhRay* ray, A_INOUT float* t
+) {
+    __m128 dx  = _mm_set1_ps(ray->dir.x);
+    __m128 dy  = _mm_set1_ps(ray->dir.y);
+    __m128 dz  = _mm_set1_ps(ray->dir.z);
+    __m128 e1x = _mm_loadu_ps(b->e1x);
+    __m128 e1y = _mm_loadu_ps(b->e1y);
+    __m128 e1z = _mm_loadu_ps(b->e1z);
+    __m128 e2x = _mm_loadu_ps(b->e2x);
+    __m128 e2y = _mm_loadu_ps(b->e2y);
+    __m128 e2z = _mm_loadu_ps(b->e2z);
+
+    __m128 px  = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py  = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz  = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px),
+                                       _mm_mul_ps(e1y, py)),
+                            _mm_mul_ps(e1z, pz));
+    __m128 ok  = _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), det),
+                              _mm_set1_ps(R_BVH_DET_EPSILON));
+    if (_mm_movemask_ps(ok) == 0)
+        return -1;
+
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    __m128 sx  = _mm_sub_ps(_mm_set1_ps(ray->origin.x), _mm_loadu_ps(b->v0x));
+    __m128 sy  = _mm_sub_ps(_mm_set1_ps(ray->origin.y), _mm_loadu_ps(b->v0y));
+    __m128 sz  = _mm_sub_ps(_mm_set1_ps(ray->origin.z), _mm_loadu_ps(b->v0z));
+    __m128 u   = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px),
+                                                  _mm_mul_ps(sy, py)),
+                                       _mm_mul_ps(sz, pz)), inv);
+    __m128 qx  = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy  = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz  = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v   = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx),
+                                                  _mm_mul_ps(dy, qy)),
+                                       _mm_mul_ps(dz, qz)), inv);
+    __m128 d   = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx),
+                                                  _mm_mul_ps(e2y, qy)),
+                                       _mm_mul_ps(e2z, qz)), inv);
+
+    __m128 zero = _mm_setzero_ps();
+    ok = _mm_and_ps(ok, _mm_cmpge_ps(u, zero));
+    ok = _mm_and_ps(ok, _mm_cmpge_ps(v, zero));
+    ok = _mm_and_ps(ok, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    ok = _mm_and_ps(ok, _mm_cmpgt_ps(d, zero));
+    int mask = _mm_movemask_ps(ok);
+    if (mask == 0)
+        return -1;
+
+    float dist[4];
+    _mm_storeu_ps(dist, d);
+    return R_BvhNearestLane(mask, dist, t);
+}
+#endif // A_CPU_CAN_BUILD_SSE2
+
+#if A_CPU_CAN_BUILD_NEON
+static int R_BvhIntersectNeon(const GfxBvhTriBlock* b,
+                              const GfxBvhRay* ray, A_INOUT float* t
+) {
+    float32x4_t dx  = vdupq_n_f32(ray->dir.x);
+    float32x4_t dy  = vdupq_n_f32(ray->dir.y);
+    float32x4_t dz  = vdupq_n_f32(ray->dir.z);
+    float32x4_t e1x = vld1q_f32(b->e1x);
+    float32x4_t e1y = vld1q_f32(b->e1y);
+    float32x4_t e1z = vld1q_f32(b->e1z);
+    float32x4_t e2x = vld1q_f32(b->e2x);
+    float32x4_t e2y = vld1q_f32(b->e2y);
+    float32x4_t e2z = vld1q_f32(b->e2z);
+
+    float32x4_t px  = vsubq_f32(vmulq_f32(dy, e2z), vmulq_f32(dz, e2y));
+    float32x4_t py  = vsubq_f32(vmulq_f32(dz, e2x), vmulq_f32(dx, e2z));
+    float32x4_t pz  = vsubq_f32(vmulq_f32(dx, e2y), vmulq_f32(dy, e2x));
+    float32x4_t det = vaddq_f32(vaddq_f32(vmulq_f32(e1x, px),
+                                          vmulq_f32(e1y, py)),
+                                vmulq_f32(e1z, pz));
+    uint32x4_t  ok  = vcgtq_f32(vabsq_f32(det),
+                                vdupq_n_f32(R_BVH_DET_EPSILON));
+    if (vmaxvq_u32(ok) == 0)
+        return -1;
+
+    float32x4_t inv = vdivq_f32(vdupq_n_f32(1.0f), det);
+    float32x4_t sx  = vsubq_f32(vdupq_n_f32(ray->origin.x), vld1q_f32(b->v0x));
+    float32x4_t sy  = vsubq_f32(vdupq_n_f32(ray->origin.y), vld1q_f32(b->v0y));
+    float32x4_t sz  = vsubq_f32(vdupq_n_f32(ray->origin.z), vld1q_f32(b->v0z));
+    float32x4_t u   = vmulq_f32(vaddq_f32(vaddq_f32(vmulq_f32(sx, px),
+                                                    vmulq_f32(sy, py)),
+                                          vmulq_f32(sz, pz)), inv);
+    float32x4_t qx  = vsubq_f32(vmulq_f32(sy, e1z), vmulq_f32(sz, e1y));
+    float32x4_t qy  = vsubq_f32(vmulq_f32(sz, e1x), vmulq_f32(sx, e1z));
+    float32x4_t qz  = vsubq_f32(vmulq_f32(sx, e1y), vmulq_f32(sy, e1x));
+    float32x4_t v   = vmulq_f32(vaddq_f32(vaddq_f32(vmulq_f32(dx, qx),
+                                                    vmulq_f32(dy, qy)),
+                                          vmulq_f32(dz, qz)), inv);
+    float32x4_t d   = vmulq_f32(vaddq_f32(vaddq_f32(vmulq_f32(e2x, qx),
+                                                    vmulq_f32(e2y, qy)),
+                                          vmulq_f32(e2z, qz)), inv);
+
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    ok = vandq_u32(ok, vcgeq_f32(u, zero));
+    ok = vandq_u32(ok, vcgeq_f32(v, zero));
+    ok = vandq_u32(ok, vcleq_f32(vaddq_f32(u, v), vdupq_n_f32(1.0f)));
+    ok = vandq_u32(ok, vcgtq_f32(d, zero));
+    if (vmaxvq_u32(ok) == 0)
+        return -1;
+
+    uint32_t lanes[4];
+    float    dist[4];
+    vst1q_u32(lanes, ok);
+    vst1q_f32(dist, d);
+    int mask = (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) |
+               (lanes[3] & 8);
+    return R_BvhNearestLane(mask, dist, t);
+}
+#endif // A_CPU_CAN_BUILD_NEON
+// ============================================================================
+
+// ============================================================================
+// Building
+//
+// Every triangle is gathered from the lightmaps' materials first. Nodes are
+// then split by binned SAH into slots where every subtree of n triangles
+// owns the 2n - 1 after its root, so a subtree knows where its children go
+// without waiting to see how big its siblings turn out, and threads can
+// build subtrees side by side. The slots a subtree doesn't use are squeezed
+// out when the tree is copied, depth first, into what traversal reads.
+typedef struct GfxBvhPrim {
+    avec3f_t     v[3];
+    avec3f_t     mins, maxs;
+    avec3f_t     centroid;
+    GfxBvhTriRef ref;
+} GfxBvhPrim;
+
+typedef struct GfxBvhBuildNode {
+    avec3f_t mins, maxs;
+    uint32_t first; // into the build's indices
+    uint32_t count; // 0 for inner nodes
+    uint32_t right; // slot; the left child's is the next one
+} GfxBvhBuildNode;
+
+typedef struct GfxBvhTask {
+    uint32_t slot;
+    uint32_t first;
+    uint32_t count;
+    uint32_t depth;
+} GfxBvhTask;
+
+typedef struct GfxBvhBuild {
+    const GfxBvhPrim* prims;
+    uint32_t*         indices;
+    GfxBvhBuildNode*  nodes;
+    // Subtrees smaller than this are left for the threads. 0 once they've
+    // started.
+    uint32_t          task_min;
+    GfxBvhTask        tasks[R_BVH_MAX_TASKS];
+    uint32_t          task_count;
+    volatile int32_t  next_task;
+} GfxBvhBuild;
+
+typedef struct GfxBvhBin {
+    avec3f_t mins, maxs;
+    uint32_t count;
+} GfxBvhBin;
+
+typedef void* (*GfxBvhAllocFn)(size_t n);
+
+static void* R_BvhMapAlloc(size_t n) {
+    return CL_Map_Alloc(n, VM_ALLOC_BVH);
+}
+
+// Gathers the map's triangles into `prims`, or only counts them if it's
+// NULL.
+static uint32_t R_BvhGather(A_OUT GfxBvhPrim* prims) {
+    const BSPSurf* surfs      = CL_Map_Surfs();
+    uint32_t       surf_count = CL_Map_SurfCount();
+    uint32_t       n          = 0;
+    for (uint32_t i = 0; i < CL_Map_LightmapCount(); i++) {
+        const BSPLightmap* lightmap  = CL_Map_Lightmap((uint16_t)i);
+        const BSPMaterial* materials =
+            (const BSPMaterial*)lightmap->materials.pointer;
+        for (uint32_t j = 0; j < lightmap->materials.count; j++) {
+            const BSPMaterial*       m     = &materials[j];
+            const BSPRenderedVertex* verts =
+                (const BSPRenderedVertex*)m->uncompressed_vertices.pointer;
+            if (!verts || m->surfaces > surf_count ||
+                m->surface_count > surf_count - m->surfaces)
+                continue;
+
+            for (uint32_t k = 0; k < m->surface_count; k++) {
+                const BSPSurf* s = &surfs[m->surfaces + k];
+                if (s->verts[0] >= m->rendered_vertices_count ||
+                    s->verts[1] >= m->rendered_vertices_count ||
+                    s->verts[2] >= m->rendered_vertices_count)
+                    continue;
+
+                avec3f_t v[3];
+                for (int l = 0; l < 3; l++) {
+                    v[l] = R_BvhFromPoint(
+                        A_point3f_swap_yz(verts[s->verts[l]].pos));
+                }
+                // Nothing can hit a triangle with no area.
+                avec3f_t c = R_BvhCross(R_BvhSub(v[1], v[0]),
+                                        R_BvhSub(v[2], v[0]));
+                if (R_BvhDot(c, c) == 0.0f)
+                    continue;
+
+                if (prims) {
+                    GfxBvhPrim* p = &prims[n];
+                    p->v[0] = v[0];
+                    p->v[1] = v[1];
+                    p->v[2] = v[2];
+                    p->mins = R_BvhMin(R_BvhMin(v[0], v[1]), v[2]);
+                    p->maxs = R_BvhMax(R_BvhMax(v[0], v[1]), v[2]);
+                    p->centroid = R_BvhVec3(
+                        (p->mins.x + p->maxs.x) * 0.5f,
+                        (p->mins.y + p->maxs.y) * 0.5f,
+                        (p->mins.z + p->maxs.z) * 0.5f);
+                    p->ref.lightmap = (uint16_t)i;
+                    p->ref.material = (uint16_t)j;
+                    p->ref.surf     = m->surfaces + k;
+                }
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+static int R_BvhBinOf(float c, float lo, float scale) {
+    int bin = (int)((c - lo) * scale);
+    return A_MAX(0, A_MIN(bin, R_BVH_BINS - 1));
+}
+
+// Partitions `idx` by the cheapest binned-SAH split and returns how many
+// went left, or returns 0 if it'd be cheaper to keep them all in a leaf, or
+// they can't be told apart.
+static uint32_t R_BvhSplitSah(const GfxBvhBuild* b, A_INOUT uint32_t* idx,
+                              uint32_t count, avec3f_t mins, avec3f_t maxs,
+                              avec3f_t cmins, avec3f_t cmaxs
+) {
+    float best_cost = FLT_MAX;
+    int   best_axis = -1;
+    int   best_bin  = 0;
+    float best_lo   = 0.0f;
+    float best_scale = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo     = cmins.array[axis];
+        float extent = cmaxs.array[axis] - lo;
+        if (extent <= 0.0f)
+            continue;
+
+        float scale = (float)R_BVH_BINS / extent;
+        GfxBvhBin bins[R_BVH_BINS];
+        for (int i = 0; i < R_BVH_BINS; i++) {
+            bins[i].mins  = R_BvhVec3( FLT_MAX,  FLT_MAX,  FLT_MAX);
+            bins[i].maxs  = R_BvhVec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            bins[i].count = 0;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            const GfxBvhPrim* p = &b->prims[idx[i]];
+            GfxBvhBin* bin = &bins[R_BvhBinOf(p->centroid.array[axis],
+                                              lo, scale)];
+            bin->mins = R_BvhMin(bin->mins, p->mins);
+            bin->maxs = R_BvhMax(bin->maxs, p->maxs);
+            bin->count++;
+        }
+
+        // right_*[i] covers bins i and up.
+        float    right_area [R_BVH_BINS];
+        uint32_t right_count[R_BVH_BINS];
+        avec3f_t rmins = R_BvhVec3( FLT_MAX,  FLT_MAX,  FLT_MAX);
+        avec3f_t rmaxs = R_BvhVec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        uint32_t rcount = 0;
+        for (int i = R_BVH_BINS - 1; i > 0; i--) {
+            rcount += bins[i].count;
+            if (bins[i].count) {
+                rmins = R_BvhMin(rmins, bins[i].mins);
+                rmaxs = R_BvhMax(rmaxs, bins[i].maxs);
+            }
+            right_area [i] = rcount ? R_BvhArea(rmins, rmaxs) : 0.0f;
+            right_count[i] = rcount;
+        }
+
+        avec3f_t lmins = R_BvhVec3( FLT_MAX,  FLT_MAX,  FLT_MAX);
+        avec3f_t lmaxs = R_BvhVec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        uint32_t lcount = 0;
+        for (int i = 1; i < R_BVH_BINS; i++) {
+            lcount += bins[i - 1].count;
+            if (bins[i - 1].count) {
+                lmins = R_BvhMin(lmins, bins[i - 1].mins);
+                lmaxs = R_BvhMax(lmaxs, bins[i - 1].maxs);
+            }
+            if (lcount == 0 || right_count[i] == 0)
+                continue;
+
+            float cost = R_BvhArea(lmins, lmaxs) * R_BVH_BLOCKS(lcount) +
+                         right_area[i] * R_BVH_BLOCKS(right_count[i]);
+            if (cost < best_cost) {
+                best_cost  = cost;
+                best_axis  = axis;
+                best_bin   = i;
+                best_lo    = lo;
+                best_scale = scale;
+            }
+        }
+    }
+    if (best_axis < 0)
+        return 0;
+
+    float area       = A_MAX(R_BvhArea(mins, maxs), FLT_MIN);
+    float leaf_cost  = R_BVH_BLOCKS(count) * R_BVH_INTERSECT_COST;
+    float split_cost = R_BVH_TRAVERSAL_COST +
+                       R_BVH_INTERSECT_COST * best_cost / area;
+    if (count <= R_BVH_MAX_LEAF_TRIS && leaf_cost <= split_cost)
+        return 0;
+
+    uint32_t i = 0;
+    uint32_t j = count;
+    while (i < j) {
+        const GfxBvhPrim* p = &b->prims[idx[i]];
+        if (R_BvhBinOf(p->centroid.array[best_axis], best_lo, best_scale) <
+            best_bin) {
+            i++;
+        } else {
+            uint32_t tmp = idx[i];
+            idx[i]   = idx[--j];
+            idx[j]   = tmp;
+        }
+    }
+    return i;
+}
+
+static void R_BvhBuildNode(A_INOUT GfxBvhBuild* b, uint32_t slot,
+                           uint32_t first, uint32_t count, uint32_t depth);
+
+static void R_BvhBuildChild(A_INOUT GfxBvhBuild* b, uint32_t slot,
+                            uint32_t first, uint32_t count, uint32_t depth
+) {
+    if (count < b->task_min && b->task_count < R_BVH_MAX_TASKS) {
+        GfxBvhTask* task = &b->tasks[b->task_count++];
+        task->slot  = slot;
+        task->first = first;
+        task->count = count;
+        task->depth = depth;
+        return;
+    }
+    R_BvhBuildNode(b, slot, first, count, depth);
+}
+
+static void R_BvhBuildNode(A_INOUT GfxBvhBuild* b, uint32_t slot,
+                           uint32_t first, uint32_t count, uint32_t depth
+) {
+    uint32_t* idx   = &b->indices[first];
+    avec3f_t  mins  = R_BvhVec3( FLT_MAX,  FLT_MAX,  FLT_MAX);
+    avec3f_t  maxs  = R_BvhVec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    avec3f_t  cmins = mins;
+    avec3f_t  cmaxs = maxs;
+    for (uint32_t i = 0; i < count; i++) {
+        const GfxBvhPrim* p = &b->prims[idx[i]];
+        mins  = R_BvhMin(mins,  p->mins);
+        maxs  = R_BvhMax(maxs,  p->maxs);
+        cmins = R_BvhMin(cmins, p->centroid);
+        cmaxs = R_BvhMax(cmaxs, p->centroid);
+    }
+
+    GfxBvhBuildNode* node = &b->nodes[slot];
+    node->mins  = mins;
+    node->maxs  = maxs;
+    node->first = first;
+    node->count = count;
+    node->right = 0;
+    if (count == 1)
+        return;
+
+    uint32_t left = 0;
+    if (depth < R_BVH_SAH_MAX_DEPTH)
+        left = R_BvhSplitSah(b, idx, count, mins, maxs, cmins, cmaxs);
+    if (left == 0) {
+        if (count <= R_BVH_MAX_LEAF_TRIS)
+            return;
+        // Too deep, or every centroid's in the same place: any halves will
+        // do.
+        left = count / 2;
+    }
+
+    node->count = 0;
+    node->right = slot + 2 * left;
+    R_BvhBuildChild(b, slot + 1, first, left, depth + 1);
+    R_BvhBuildChild(b, node->right, first + left, count - left, depth + 1);
+}
+
+static int R_BvhBuildThreadMain(void* arg) {
+    GfxBvhBuild* b = (GfxBvhBuild*)arg;
+    for (;;) {
+        int32_t i = A_atomic_fetch_add32(&b->next_task, 1);
+        if (i >= (int32_t)b->task_count)
+            break;
+
+        const GfxBvhTask* task = &b->tasks[i];
+        R_BvhBuildNode(b, task->slot, task->first, task->count, task->depth);
+    }
+    return 0;
+}
+
+static int R_BvhCompareTasks(const void* a, const void* b) {
+    uint32_t ca = ((const GfxBvhTask*)a)->count;
+    uint32_t cb = ((const GfxBvhTask*)b)->count;
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+static void R_BvhCount(const GfxBvhBuild* b, uint32_t slot, uint32_t depth,
+                       A_INOUT GfxBvh* bvh
+) {
+    const GfxBvhBuildNode* node = &b->nodes[slot];
+    bvh->node_count++;
+    bvh->depth = A_MAX(bvh->depth, depth + 1);
+    if (node->count) {
+        bvh->leaf_count++;
+        bvh->block_count += R_BVH_BLOCKS(node->count);
+        return;
+    }
+    R_BvhCount(b, slot + 1,     depth + 1, bvh);
+    R_BvhCount(b, node->right, depth + 1, bvh);
+}
+
+static uint32_t R_BvhEmit(const GfxBvhBuild* b, uint32_t slot,
+                          float inv_root_area, A_INOUT GfxBvh* bvh
+) {
+    const GfxBvhBuildNode* in  = &b->nodes[slot];
+    uint32_t               i   = bvh->node_count++;
+    GfxBvhNode*            out = &bvh->nodes[i];
+    float                  p   = R_BvhArea(in->mins, in->maxs) * inv_root_area;
+    out->mins  = in->mins;
+    out->maxs  = in->maxs;
+    out->count = in->count;
+    if (in->count == 0) {
+        bvh->sah_cost += p * R_BVH_TRAVERSAL_COST;
+        R_BvhEmit(b, slot + 1, inv_root_area, bvh);
+        out->offset = R_BvhEmit(b, in->right, inv_root_area, bvh);
+        return i;
+    }
+
+    bvh->sah_cost += p * R_BVH_BLOCKS(in->count) * R_BVH_INTERSECT_COST;
+    out->offset = bvh->block_count;
+    for (uint32_t k = 0; k < in->count; k++) {
+        const GfxBvhPrim* prim  = &b->prims[b->indices[in->first + k]];
+        GfxBvhTriBlock*   block = &bvh->blocks[bvh->block_count + k / 4];
+        uint32_t          lane  = k % 4;
+        avec3f_t e1 = R_BvhSub(prim->v[1], prim->v[0]);
+        avec3f_t e2 = R_BvhSub(prim->v[2], prim->v[0]);
+        block->v0x[lane] = prim->v[0].x;
+        block->v0y[lane] = prim->v[0].y;
+        block->v0z[lane] = prim->v[0].z;
+        block->e1x[lane] = e1.x;
+        block->e1y[lane] = e1.y;
+        block->e1z[lane] = e1.z;
+        block->e2x[lane] = e2.x;
+        block->e2y[lane] = e2.y;
+        block->e2z[lane] = e2.z;
+        bvh->refs[(bvh->block_count + k / 4) * 4 + lane] = prim->ref;
+    }
+    bvh->block_count += R_BVH_BLOCKS(in->count);
+    return i;
+}
+
+// Builds `bvh` over `prims` on up to `threads` threads, out of `alloc`.
+// Returns false if the tree's too deep to trace through (`bvh->depth` says
+// how deep it is) or if an allocation fails.
+static bool R_BvhBuildTree(A_OUT GfxBvh* bvh, const GfxBvhPrim* prims,
+                           uint32_t prim_count, uint32_t threads,
+                           GfxBvhAllocFn alloc
+) {
+    A_memset(bvh, 0, sizeof(*bvh));
+    if (prim_count == 0)
+        return true;
+
+    VmScratchMark mark = VM_ScratchMark();
+    GfxBvhBuild* b = (GfxBvhBuild*)VM_ScratchZalloc(sizeof(*b));
+    if (b == NULL) {
+        VM_ScratchRelease(mark);
+        return false;
+    }
+    b->prims   = prims;
+    b->indices = (uint32_t*)VM_ScratchAlloc(
+        prim_count * sizeof(*b->indices));
+    b->nodes   = (GfxBvhBuildNode*)VM_ScratchAlloc(
+        (2 * (size_t)prim_count - 1) * sizeof(*b->nodes));
+    if (b->indices == NULL || b->nodes == NULL) {
+        VM_ScratchRelease(mark);
+        return false;
+    }
+    for (uint32_t i = 0; i < prim_count; i++)
+        b->indices[i] = i;
+
+    threads = A_MAX(1, A_MIN(threads, R_BVH_MAX_THREADS));
+    if (threads > 1 && prim_count >= 2 * R_BVH_TASK_MIN_TRIS) {
+        // Enough tasks that the threads stay busy while the big ones
+        // finish.
+        b->task_min = A_MAX(R_BVH_TASK_MIN_TRIS, prim_count / (threads * 8));
+    }
+    R_BvhBuildNode(b, 0, 0, prim_count, 0);
+
+    if (b->task_count > 0) {
+        // Biggest first, so no thread's left with one at the end.
+        qsort(b->tasks, b->task_count, sizeof(*b->tasks), R_BvhCompareTasks);
+        b->task_min = 0;
+
+        SysThread* workers[R_BVH_MAX_THREADS];
+        uint32_t   worker_count = 0;
+        for (uint32_t i = 1; i < threads && i < b->task_count; i++) {
+            SysThread* t = Sys_SpawnThread("bvh_build", R_BvhBuildThreadMain,
+                                           b);
+            if (t)
+                workers[worker_count++] = t;
+        }
+        R_BvhBuildThreadMain(b);
+        for (uint32_t i = 0; i < worker_count; i++)
+            Sys_JoinThread(workers[i]);
+    }
+
+    R_BvhCount(b, 0, 0, bvh);
+    bool ok = bvh->depth <= R_BVH_STACK_SIZE;
+    if (ok) {
+        bvh->tri_count = prim_count;
+        bvh->bytes     = bvh->node_count  * sizeof(*bvh->nodes) +
+                         bvh->block_count * sizeof(*bvh->blocks) +
+                         bvh->block_count * 4 * sizeof(*bvh->refs);
+        bvh->nodes  = (GfxBvhNode*)alloc(
+            bvh->node_count * sizeof(*bvh->nodes));
+        bvh->blocks = (GfxBvhTriBlock*)alloc(
+            bvh->block_count * sizeof(*bvh->blocks));
+        bvh->refs   = (GfxBvhTriRef*)alloc(
+            bvh->block_count * 4 * sizeof(*bvh->refs));
+        ok = bvh->nodes && bvh->blocks && bvh->refs;
+    }
+    if (ok) {
+        A_memset(bvh->blocks, 0, bvh->block_count * sizeof(*bvh->blocks));
+        A_memset(bvh->refs, 0xFF,
+                 bvh->block_count * 4 * sizeof(*bvh->refs));
+
+        const GfxBvhBuildNode* root = &b->nodes[0];
+        float inv_root_area =
+            1.0f / A_MAX(R_BvhArea(root->mins, root->maxs), FLT_MIN);
+        bvh->node_count  = 0;
+        bvh->block_count = 0;
+        bvh->sah_cost    = 0.0f;
+        R_BvhEmit(b, 0, inv_root_area, bvh);
+    }
+    VM_ScratchRelease(mark);
+    return ok;
+}
+
+static uint32_t R_BvhThreadCount(void) {
+    return A_MIN(Sys_CpuCount(), R_BVH_MAX_THREADS);
+}
+// ============================================================================
+
+// ============================================================================
+// Tracing
+static void R_BvhMakeRay(A_OUT GfxBvhRay* ray, avec3f_t origin, avec3f_t dir) {
+    ray->origin    = origin;
+    ray->dir       = dir;
+    // Infinite for axes the ray's parallel to, which the slab test handles.
+    ray->inv_dir.x = 1.0f / dir.x;
+    ray->inv_dir.y = 1.0f / dir.y;
+    ray->inv_dir.z = 1.0f / dir.z;
+}
+
+static bool R_BvhBox(const GfxBvhNode* node, const GfxBvhRay* ray,
+                     float t_max, A_OUT float* t_enter
+) {
+    float tx0 = (node->mins.x - ray->origin.x) * ray->inv_dir.x;
+    float tx1 = (node->maxs.x - ray->origin.x) * ray->inv_dir.x;
+    float ty0 = (node->mins.y - ray->origin.y) * ray->inv_dir.y;
+    float ty1 = (node->maxs.y - ray->origin.y) * ray->inv_dir.y;
+    float tz0 = (node->mins.z - ray->origin.z) * ray->inv_dir.z;
+    float tz1 = (node->maxs.z - ray->origin.z) * ray->inv_dir.z;
+    float t0  = A_MAX(A_MAX(A_MIN(tx0, tx1), A_MIN(ty0, ty1)),
+                      A_MAX(A_MIN(tz0, tz1), 0.0f));
+    float t1  = A_MIN(A_MIN(A_MAX(tx0, tx1), A_MAX(ty0, ty1)),
+                      A_MIN(A_MAX(tz0, tz1), t_max));
+    *t_enter = t0;
+    return t0 <= t1;
+}
+
+// Returns the triangle (block * 4 + lane) nearest along `ray` within `*t`,
+// and moves `*t` up to it, or -1. With `any`, returns the first one found
+// instead of the nearest.
+static int32_t R_BvhTraverse(const GfxBvh* bvh, const GfxBvhRay* ray,
+                             GfxBvhIntersectFn intersect, bool any,
+                             A_INOUT float* t
+) {
+    typedef struct GfxBvhStackEntry {
+        uint32_t node;
+        float    t_enter;
+    } GfxBvhStackEntry;
+
+    float t_enter;
+    if (bvh->node_count == 0 ||
+        !R_BvhBox(&bvh->nodes[0], ray, *t, &t_enter))
+        return -1;
+
+    GfxBvhStackEntry stack[R_BVH_STACK_SIZE];
+    uint32_t         sp  = 0;
+    uint32_t         i   = 0;
+    int32_t          hit = -1;
+    for (;;) {
+        const GfxBvhNode* node = &bvh->nodes[i];
+        if (node->count) {
+            uint32_t blocks = R_BVH_BLOCKS(node->count);
+            for (uint32_t k = 0; k < blocks; k++) {
+                int lane = intersect(&bvh->blocks[node->offset + k], ray, t);
+                if (lane >= 0) {
+                    hit = (int32_t)((node->offset + k) * 4 + lane);
+                    if (any)
+                        return hit;
+                }
+            }
+        } else {
+            uint32_t near_node = i + 1;
+            uint32_t far_node  = node->offset;
+            float    t_near, t_far;
+            bool     hit_near  = R_BvhBox(&bvh->nodes[near_node], ray, *t,
+                                          &t_near);
+            bool     hit_far   = R_BvhBox(&bvh->nodes[far_node], ray, *t,
+                                          &t_far);
+            if (hit_near && hit_far) {
+                if (t_far < t_near) {
+                    uint32_t n = near_node;
+                    near_node  = far_node;
+                    far_node   = n;
+                    t_far      = t_near;
+                }
+                assert(sp < R_BVH_STACK_SIZE);
+                stack[sp].node    = far_node;
+                stack[sp].t_enter = t_far;
+                sp++;
+                i = near_node;
+                continue;
+            }
+            if (hit_near || hit_far) {
+                i = hit_near ? near_node : far_node;
+                continue;
+            }
+        }
+
+        // Anything entered past the nearest hit so far can't be nearer.
+        do {
+            if (sp == 0)
+                return hit;
+            sp--;
+        } while (stack[sp].t_enter > *t);
+        i = stack[sp].node;
+    }
+}
+
+static void R_BvhFillHit(const GfxBvh* bvh, const GfxBvhRay* ray,
+                         int32_t tri, float t, A_OUT GfxBvhHit* hit
+) {
+    const GfxBvhTriBlock* b    = &bvh->blocks[tri / 4];
+    const GfxBvhTriRef*   ref  = &bvh->refs[tri];
+    int                   lane = tri % 4;
+    avec3f_t n = R_BvhCross(R_BvhVec3(b->e1x[lane], b->e1y[lane], b->e1z[lane]),
+                            R_BvhVec3(b->e2x[lane], b->e2y[lane], b->e2z[lane]));
+    float len = sqrtf(R_BvhDot(n, n));
+    if (R_BvhDot(n, ray->dir) > 0.0f)
+        len = -len;
+
+    hit->t        = t;
+    hit->pos.x    = ray->origin.x + ray->dir.x * t;
+    hit->pos.y    = ray->origin.y + ray->dir.y * t;
+    hit->pos.z    = ray->origin.z + ray->dir.z * t;
+    hit->normal   = R_BvhVec3(n.x / len, n.y / len, n.z / len);
+    hit->tri      = tri;
+    hit->lightmap = ref->lightmap;
+    hit->material = ref->material;
+    hit->surf     = ref->surf;
+}
+
+static bool R_BvhTraceWith(A_OUT GfxBvhHit* hit, apoint3f_t origin,
+                           avec3f_t dir, float max_dist,
+                           GfxBvhIntersectFn intersect
+) {
+    A_memset(hit, 0, sizeof(*hit));
+    hit->tri = -1;
+    hit->t   = max_dist;
+
+    float len = sqrtf(R_BvhDot(dir, dir));
+    if (!r_bvhGlob.loaded || len == 0.0f)
+        return false;
+
+    GfxBvhRay ray;
+    R_BvhMakeRay(&ray, R_BvhFromPoint(origin),
+                 R_BvhVec3(dir.x / len, dir.y / len, dir.z / len));
+    float   t   = max_dist;
+    int32_t tri = R_BvhTraverse(&r_bvhGlob.bvh, &ray, intersect, false, &t);
+    if (tri < 0)
+        return false;
+
+    R_BvhFillHit(&r_bvhGlob.bvh, &ray, tri, t, hit);
+    return true;
+}
+
+bool R_BvhTrace(A_OUT GfxBvhHit* hit, apoint3f_t origin, avec3f_t dir,
+                float max_dist
+) {
+    return R_BvhTraceWith(hit, origin, dir, max_dist, r_bvhGlob.intersect);
+}
+
+A_NO_DISCARD bool R_BvhOccluded(apoint3f_t a, apoint3f_t b) {
+    avec3f_t d   = R_BvhSub(R_BvhFromPoint(b), R_BvhFromPoint(a));
+    float    len = sqrtf(R_BvhDot(d, d));
+    if (!r_bvhGlob.loaded || len <= R_BVH_OCCLUSION_EPSILON)
+        return false;
+
+    GfxBvhRay ray;
+    R_BvhMakeRay(&ray, R_BvhFromPoint(a),
+                 R_BvhVec3(d.x / len, d.y / len, d.z / len));
+    float t = len - R_BVH_OCCLUSION_EPSILON;
+    return R_BvhTraverse(&r_bvhGlob.bvh, &ray, r_bvhGlob.intersect, true,
+                         &t) >= 0;
+}
+// ============================================================================
+
+void R_InitBvh(void) {
+    A_memset(&r_bvhGlob, 0, sizeof(r_bvhGlob));
+    r_bvhGlob.intersect      = R_BvhIntersectScalar;
+    r_bvhGlob.intersect_name = "scalar";
+
+    const ACpuFeatures* cpu = A_CpuFeatures();
+#if A_CPU_CAN_BUILD_SSE2
+    if (cpu->sse2) {
+        r_bvhGlob.intersect      = R_BvhIntersectSse2;
+        r_bvhGlob.intersect_name = "sse2";
+    }
+#endif // A_CPU_CAN_BUILD_SSE2
+#if A_CPU_CAN_BUILD_NEON
+    if (cpu->neon) {
+        r_bvhGlob.intersect      = R_BvhIntersectNeon;
+        r_bvhGlob.intersect_name = "neon";
+    }
+#endif // A_CPU_CAN_BUILD_NEON
+    A_UNUSED(cpu);
+
+    Cmd_AddCommand("trace",       R_Trace_f);
+    Cmd_AddCommand("r_bvh_bench", R_BvhBench_f);
+}
+
+void R_ShutdownBvh(void) {
+    R_UnloadBvh();
+    Cmd_RemoveCommand("trace");
+    Cmd_RemoveCommand("r_bvh_bench");
+}
+
+bool R_LoadBvh(void) {
+    R_UnloadBvh();
+
+    uint64_t      start = Sys_Nanoseconds();
+    VmScratchMark mark  = VM_ScratchMark();
+    uint32_t      count = R_BvhGather(NULL);
+    GfxBvhPrim*   prims = (GfxBvhPrim*)VM_ScratchAlloc(
+        A_MAX(count, 1) * sizeof(*prims));
+    if (prims == NULL) {
+        VM_ScratchRelease(mark);
+        Com_Println(CON_DEST_CLIENT,
+                    "R_LoadBvh: not enough memory for %u triangles.", count);
+        return false;
+    }
+    R_BvhGather(prims);
+
+    uint32_t threads = R_BvhThreadCount();
+    bool b = R_BvhBuildTree(&r_bvhGlob.bvh, prims, count, threads,
+                            R_BvhMapAlloc);
+    VM_ScratchRelease(mark);
+    if (!b) {
+        if (r_bvhGlob.bvh.depth > R_BVH_STACK_SIZE) {
+            Com_Println(CON_DEST_CLIENT,
+                        "R_LoadBvh: tree is deeper than %d levels.",
+                        R_BVH_STACK_SIZE);
+        } else {
+            Com_Println(CON_DEST_CLIENT,
+                        "R_LoadBvh: not enough memory for %u triangles.",
+                        count);
+        }
+        A_memset(&r_bvhGlob.bvh, 0, sizeof(r_bvhGlob.bvh));
+        return false;
+    }
+
+    r_bvhGlob.loaded        = true;
+    r_bvhGlob.build_ns      = Sys_Nanoseconds() - start;
+    r_bvhGlob.build_threads = threads;
+    Com_DPrintln(CON_DEST_CLIENT,
+                 "R_LoadBvh: %u triangles, %u nodes, %u KiB, "
+                 "%.1f ms on %u threads.",
+                 r_bvhGlob.bvh.tri_count, r_bvhGlob.bvh.node_count,
+                 (unsigned int)(r_bvhGlob.bvh.bytes / 1024),
+                 (double)r_bvhGlob.build_ns / 1e6, threads);
+    return true;
+}
+
+void R_UnloadBvh(void) {
+    // It's all in the map's arena.
+    r_bvhGlob.loaded = false;
+    A_memset(&r_bvhGlob.bvh, 0, sizeof(r_bvhGlob.bvh));
+}
+
+// ============================================================================
+// Commands
+static const char* R_BvhShaderClassName(uint32_t klass) {
+    switch (klass) {
+    case TAG_FOURCC_SHADER_ENVIRONMENT:
+        return "environment";
+    case TAG_FOURCC_SHADER_MODEL:
+        return "model";
+    default:
+        return "other";
+    }
+}
+
+// From the camera of the client with the keyboard and mouse, along where
+// it's looking.
+static void R_Trace_f(void) {
+    float dist = R_BVH_TRACE_DEFAULT_DISTANCE;
+    if (Cmd_Argc() > 2 ||
+        (Cmd_Argc() == 2 && (!A_atof(Cmd_Argv(1), &dist) || dist <= 0.0f))
+    ) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: trace [distance]");
+        return;
+    }
+
+    if (!r_bvhGlob.loaded) {
+        Com_Println(CON_DEST_CLIENT, "trace: no map loaded.");
+        return;
+    }
+
+    const cg_t* cg = CG_GetLocalClientGlobals(CL_ClientWithKbmFocus());
+    GfxBvhHit hit;
+    if (!R_BvhTrace(&hit, cg->camera.pos, cg->camera.front, dist)) {
+        Com_Println(CON_DEST_CLIENT, "trace: nothing within %.2f units.",
+                    dist);
+        return;
+    }
+
+    Com_Println(CON_DEST_CLIENT,
+                "trace: hit triangle %d (surface %u) after %.3f units, "
+                "at (%.3f, %.3f, %.3f), normal (%.3f, %.3f, %.3f)",
+                hit.tri, hit.surf, hit.t, hit.pos.x, hit.pos.y, hit.pos.z,
+                hit.normal.x, hit.normal.y, hit.normal.z);
+
+    const BSPLightmap* lightmap = CL_Map_Lightmap((uint16_t)hit.lightmap);
+    const BSPMaterial* material =
+        &((const BSPMaterial*)lightmap->materials.pointer)[hit.material];
+    if (material->shader.id.index == 0xFFFF) {
+        Com_Println(CON_DEST_CLIENT,
+                    "trace: lightmap %u, material %u, no shader.",
+                    hit.lightmap, hit.material);
+        return;
+    }
+
+    const Tag*       shader_tag = CL_Map_Tag(material->shader.id);
+    const BSPShader* shader     =
+        (const BSPShader*)(uintptr_t)shader_tag->tag_data;
+    Com_Println(CON_DEST_CLIENT,
+                "trace: lightmap %u, material %u, %s shader %s, "
+                "material type %u.",
+                hit.lightmap, hit.material,
+                R_BvhShaderClassName(shader_tag->primary_class),
+                (const char*)(uintptr_t)shader_tag->tag_path,
+                (unsigned int)shader->material_type);
+}
+
+static uint32_t s_bvhBenchSeed;
+
+static float R_BvhBenchRandom(float lo, float hi) {
+    s_bvhBenchSeed = s_bvhBenchSeed * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (float)(s_bvhBenchSeed >> 8) / (float)(1u << 24);
+}
+
+typedef enum GfxBvhBenchRays {
+    R_BVH_BENCH_RANDOM,    // anywhere in the map, any direction
+    R_BVH_BENCH_CAMERA,    // through a grid over the focused client's view
+    R_BVH_BENCH_OCCLUSION, // between two points anywhere in the map
+} GfxBvhBenchRays;
+
+typedef struct GfxBvhBenchResult {
+    uint64_t ns;
+    uint32_t hits;
+    double   dists; // summed, to compare kernels
+} GfxBvhBenchResult;
+
+// The same `count` rays each time for each kind.
+static void R_BvhBenchTraces(GfxBvhBenchRays kind, int count,
+                             GfxBvhIntersectFn intersect,
+                             A_OUT GfxBvhBenchResult* res
+) {
+    const GfxBvh*  bvh   = &r_bvhGlob.bvh;
+    avec3f_t       mins  = bvh->nodes[0].mins;
+    avec3f_t       maxs  = bvh->nodes[0].maxs;
+    avec3f_t       size  = R_BvhSub(maxs, mins);
+    float          diag  = sqrtf(R_BvhDot(size, size));
+    const cg_t*    cg    = CG_GetLocalClientGlobals(CL_ClientWithKbmFocus());
+
+    A_memset(res, 0, sizeof(*res));
+    s_bvhBenchSeed = 0x12345678u;
+    uint64_t start_ns = Sys_Nanoseconds();
+    for (int i = 0; i < count; i++) {
+        avec3f_t origin, dir;
+        float    t = diag;
+        if (kind == R_BVH_BENCH_CAMERA) {
+            float x = ((float)(i % R_BVH_BENCH_GRID) + 0.5f) /
+                      R_BVH_BENCH_GRID * 2.0f - 1.0f;
+            float y = ((float)(i / R_BVH_BENCH_GRID % R_BVH_BENCH_GRID) +
+                       0.5f) / R_BVH_BENCH_GRID * 2.0f - 1.0f;
+            origin = R_BvhFromPoint(cg->camera.pos);
+            dir    = R_BvhVec3(
+                cg->camera.front.x + cg->camera.right.x * x +
+                    cg->camera.up.x * y,
+                cg->camera.front.y + cg->camera.right.y * x +
+                    cg->camera.up.y * y,
+                cg->camera.front.z + cg->camera.right.z * x +
+                    cg->camera.up.z * y);
+        } else {
+            origin = R_BvhVec3(R_BvhBenchRandom(mins.x, maxs.x),
+                               R_BvhBenchRandom(mins.y, maxs.y),
+                               R_BvhBenchRandom(mins.z, maxs.z));
+            if (kind == R_BVH_BENCH_OCCLUSION) {
+                avec3f_t to = R_BvhVec3(R_BvhBenchRandom(mins.x, maxs.x),
+                                        R_BvhBenchRandom(mins.y, maxs.y),
+                                        R_BvhBenchRandom(mins.z, maxs.z));
+                dir = R_BvhSub(to, origin);
+                t   = sqrtf(R_BvhDot(dir, dir));
+            } else {
+                dir = R_BvhVec3(R_BvhBenchRandom(-1.0f, 1.0f),
+                                R_BvhBenchRandom(-1.0f, 1.0f),
+                                R_BvhBenchRandom(-1.0f, 1.0f));
+            }
+        }
+
+        float len = sqrtf(R_BvhDot(dir, dir));
+        if (len == 0.0f)
+            continue;
+
+        GfxBvhRay ray;
+        R_BvhMakeRay(&ray, origin,
+                     R_BvhVec3(dir.x / len, dir.y / len, dir.z / len));
+        if (R_BvhTraverse(bvh, &ray, intersect,
+                          kind == R_BVH_BENCH_OCCLUSION, &t) >= 0) {
+            res->hits++;
+            res->dists += t;
+        }
+    }
+    res->ns = Sys_Nanoseconds() - start_ns;
+}
+
+static void R_BvhPrintBench(const char* name, int count,
+                            const GfxBvhBenchResult* res
+) {
+    double sec = (double)res->ns / 1e9;
+    Com_Println(CON_DEST_CLIENT,
+                "r_bvh_bench: %-18s %8.3f Mrays/s (%.1f%% hit, %.3f s)",
+                name, sec > 0.0 ? count / sec / 1e6 : 0.0,
+                100.0 * res->hits / count, sec);
+}
+
+// Builds a throwaway copy of the tree on `threads` threads and returns how
+// long it took.
+static uint64_t R_BvhBenchBuild(const GfxBvhPrim* prims, uint32_t count,
+                                uint32_t threads, A_OUT GfxBvh* bvh
+) {
+    VmScratchMark mark  = VM_ScratchMark();
+    uint64_t      start = Sys_Nanoseconds();
+    R_BvhBuildTree(bvh, prims, count, threads, VM_ScratchAlloc);
+    uint64_t      ns    = Sys_Nanoseconds() - start;
+    VM_ScratchRelease(mark);
+
+    double sec = (double)ns / 1e9;
+    char name[32];
+    A_snprintf(name, sizeof(name), "build (%u thread%s)", threads,
+               threads == 1 ? "" : "s");
+    Com_Println(CON_DEST_CLIENT,
+                "r_bvh_bench: %-18s %8.3f ms (%.3f Mtris/s)",
+                name, sec * 1e3, sec > 0.0 ? count / sec / 1e6 : 0.0);
+    return ns;
+}
+
+static void R_BvhBench_f(void) {
+    int count = R_BVH_BENCH_DEFAULT_RAYS;
+    if (Cmd_Argc() > 2 ||
+        (Cmd_Argc() == 2 && (!A_atoi(Cmd_Argv(1), &count) || count < 1))
+    ) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: r_bvh_bench [rays]");
+        return;
+    }
+
+    if (!r_bvhGlob.loaded || r_bvhGlob.bvh.node_count == 0) {
+        Com_Println(CON_DEST_CLIENT, "r_bvh_bench: no map loaded.");
+        return;
+    }
+
+    const GfxBvh* bvh = &r_bvhGlob.bvh;
+    Com_Println(CON_DEST_CLIENT,
+                "r_bvh_bench: %u triangles, %u nodes, %u leaves, depth %u, "
+                "SAH cost %.2f, %u KiB.",
+                bvh->tri_count, bvh->node_count, bvh->leaf_count,
+                bvh->depth, bvh->sah_cost,
+                (unsigned int)(bvh->bytes / 1024));
+
+    // The tree's laid out the same however many threads build it.
+    VmScratchMark mark  = VM_ScratchMark();
+    uint32_t      tris  = R_BvhGather(NULL);
+    GfxBvhPrim*   prims = (GfxBvhPrim*)VM_ScratchAlloc(
+        A_MAX(tris, 1) * sizeof(*prims));
+    if (prims == NULL) {
+        VM_ScratchRelease(mark);
+        Com_Println(CON_DEST_CLIENT, "r_bvh_bench: out of memory.");
+        return;
+    }
+    R_BvhGather(prims);
+    GfxBvh   serial, parallel;
+    uint32_t threads = R_BvhThreadCount();
+    uint64_t serial_ns = R_BvhBenchBuild(prims, tris, 1, &serial);
+    if (threads > 1) {
+        uint64_t parallel_ns = R_BvhBenchBuild(prims, tris, threads,
+                                               &parallel);
+        Com_Println(CON_DEST_CLIENT, "r_bvh_bench: %.2fx on %u threads.",
+                    parallel_ns ? (double)serial_ns / parallel_ns : 0.0,
+                    threads);
+        if (parallel.node_count != serial.node_count ||
+            parallel.sah_cost   != serial.sah_cost) {
+            Com_Println(CON_DEST_CLIENT,
+                        "r_bvh_bench: FAIL: threaded build differs "
+                        "(%u vs %u nodes).",
+                        parallel.node_count, serial.node_count);
+        }
+    }
+    VM_ScratchRelease(mark);
+
+    static const struct {
+        GfxBvhBenchRays kind;
+        const char*     name;
+    } kinds[] = {
+        { R_BVH_BENCH_RANDOM,    "random"    },
+        { R_BVH_BENCH_CAMERA,    "camera"    },
+        { R_BVH_BENCH_OCCLUSION, "occlusion" },
+    };
+    for (size_t i = 0; i < A_countof(kinds); i++) {
+        char name[32];
+        GfxBvhBenchResult scalar, simd;
+        A_snprintf(name, sizeof(name), "%s (scalar)", kinds[i].name);
+        R_BvhBenchTraces(kinds[i].kind, count, R_BvhIntersectScalar,
+                         &scalar);
+        R_BvhPrintBench(name, count, &scalar);
+        if (r_bvhGlob.intersect == R_BvhIntersectScalar)
+            continue;
+
+        A_snprintf(name, sizeof(name), "%s (%s)", kinds[i].name,
+                   r_bvhGlob.intersect_name);
+        R_BvhBenchTraces(kinds[i].kind, count, r_bvhGlob.intersect, &simd);
+        R_BvhPrintBench(name, count, &simd);
+        // Occlusion stops at whichever hit it finds first, so only the
+        // hits have to agree there.
+        if (simd.hits != scalar.hits ||
+            (kinds[i].kind != R_BVH_BENCH_OCCLUSION &&
+             simd.dists != scalar.dists)) {
+            Com_Println(CON_DEST_CLIENT,
+                        "r_bvh_bench: FAIL: %s and scalar disagree "
+                        "(%u vs %u hits).",
+                        r_bvhGlob.intersect_name, simd.hits, scalar.hits);
+        }
+    }
+}
+// ============================================================================
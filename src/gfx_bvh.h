@@ -0,0 +1,39 @@
+#pragma once
+
+#include "acommon/a_math.h"
+
+#include "com_defs.h"
+
+// A BVH over the loaded map's render triangles, for picking and line of
+// sight against what's actually drawn instead of the collision BSP.
+//
+// It's built by R_LoadMap, in the space the client and renderer use (the
+// map's with y and z swapped), and only read after that, so any thread can
+// query it while the map stays loaded. Triangles are hit from either side.
+typedef struct GfxBvhHit {
+    float      t;        // distance along the ray
+    apoint3f_t pos;
+    avec3f_t   normal;   // the triangle's, facing back along the ray
+    int32_t    tri;      // -1 if nothing was hit
+    uint32_t   lightmap;
+    uint32_t   material; // within the lightmap
+    uint32_t   surf;     // index into CL_Map_Surfs
+} GfxBvhHit;
+
+// `trace [distance]` picks what the focused client's camera is looking at
+// and prints its material and shader. `r_bvh_bench [rays]` times building
+// the BVH on one thread and on all of them, and tracing rays through it
+// with each triangle kernel.
+A_EXTERN_C void R_InitBvh    (void);
+A_EXTERN_C void R_ShutdownBvh(void);
+
+A_EXTERN_C bool R_LoadBvh    (void);
+A_EXTERN_C void R_UnloadBvh  (void);
+
+// The nearest triangle the ray from `origin` along `dir` hits within
+// `max_dist`. `dir` needn't be normalized. Returns false, with `hit->tri`
+// -1, if there isn't one.
+A_EXTERN_C bool R_BvhTrace(A_OUT GfxBvhHit* hit,
+                           apoint3f_t origin, avec3f_t dir, float max_dist);
+// Whether any triangle is between `a` and `b`.
+A_EXTERN_C A_NO_DISCARD bool R_BvhOccluded(apoint3f_t a, apoint3f_t b);
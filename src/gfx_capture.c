@@ -0,0 +1,988 @@
+#include "gfx_capture.h"
+
+#if A_RENDER_BACKEND_GL
+#include <zlib.h>
+#endif // A_RENDER_BACKEND_GL
+
+#include "acommon/a_atomic.h"
+#include "acommon/a_string.h"
+
+#include "cmd_commands.h"
+#include "com_perf.h"
+#include "com_print.h"
+#include "dvar.h"
+#include "fs_files.h"
+#include "gfx_defs.h"
+#include "sys.h"
+#include "vm_vmem.h"
+
+#define R_CAPTURE_MAX_NAME     256
+#define R_CAPTURE_DEFAULT_FPS  60
+#define R_CAPTURE_MAX_FPS      1000
+// PBOs in flight. Readback usually lands a frame or two after it's issued,
+// so this leaves the GPU a couple of frames of slack before frames drop.
+#define R_CAPTURE_READBACKS    4
+// Frames copied out of the PBOs and waiting on the writer.
+#define R_CAPTURE_QUEUE        4
+#define R_CAPTURE_IDLE_YIELDS  64
+#define R_CAPTURE_SCREENSHOTS  10000
+
+#define R_CAPTURE_BENCH_NAME           "capture_bench"
+#define R_CAPTURE_BENCH_DEFAULT_FRAMES 300
+#define R_CAPTURE_BENCH_MAX_FRAMES     100000
+
+static void R_Screenshot_f   (void);
+static void R_Capture_f      (void);
+static void R_CaptureStop_f  (void);
+static void R_CaptureBench_f (void);
+static void R_CaptureBenchFrame(void);
+
+static const char* R_CaptureFormatExt(GfxCaptureFormat format) {
+    return format == R_CAPTURE_FORMAT_PNG ? ".png" : ".y4m";
+}
+
+// `name` without `format`'s extension, if it has it.
+static void R_CaptureBaseName(const char* name, GfxCaptureFormat format,
+                              A_OUT char* base, size_t n
+) {
+    const char* ext_str = R_CaptureFormatExt(format);
+    size_t      len     = A_cstrlen(name);
+    size_t      ext     = A_cstrlen(ext_str);
+    A_cstrncpyz(base, name, n);
+    if (len > ext && len < n && A_cstricmp(name + len - ext, ext_str))
+        base[len - ext] = '\0';
+}
+
+#if A_RENDER_BACKEND_GL
+// ============================================================================
+// Capture
+typedef enum GfxCaptureState {
+    R_CAPTURE_OFF,
+    R_CAPTURE_RUNNING,
+    // Not reading back anymore, but what was is still being written.
+    R_CAPTURE_DRAINING,
+} GfxCaptureState;
+
+typedef struct GfxCaptureReadback {
+    GLuint   pbo;
+    size_t   size;
+    GLsync   fence;
+    uint32_t frame;
+    uint32_t repeat;
+    int      width, height;
+} GfxCaptureReadback;
+
+// Filled in by the render thread. The writer owns a slot from when
+// `queue_head` moves past it until it moves `queue_tail` past it.
+typedef struct GfxCaptureFrame {
+    uint8_t* pixels; // RGBA, bottom row first
+    size_t   capacity;
+    uint32_t frame;  // the first output frame it's written as
+    uint32_t repeat; // how many output frames it's written as
+    int      width, height;
+} GfxCaptureFrame;
+
+// Only the writer thread touches this while it's running.
+typedef struct GfxCaptureWriter {
+    StreamFile y4m;
+    int        y4m_width, y4m_height;
+    uint8_t*   out;      // encoded
+    size_t     out_size;
+    uint8_t*   rows;     // PNG's filtered rows
+    size_t     rows_size;
+    uint64_t   bytes;
+    uint32_t   written;
+    uint32_t   skipped;  // Y4M frames that weren't the stream's size
+    uint32_t   failed;
+} GfxCaptureWriter;
+
+typedef struct GfxCaptureGlob {
+    GfxCaptureState    state;
+    GfxCaptureFormat   format;
+    char               name[R_CAPTURE_MAX_NAME];
+    uint32_t           fps;           // 0 for every rendered frame
+    uint32_t           max_frames;
+    bool               discard;  // delete the file when done (the bench)
+    bool               in_frame; // the FBO's bound for this frame
+
+    GLuint             fbo;
+    GLuint             color_rb;
+    GLuint             depth_rb;
+    int                fbo_width, fbo_height;
+
+    GfxCaptureReadback readbacks[R_CAPTURE_READBACKS];
+    uint32_t           readback_head; // next to issue
+    uint32_t           readback_tail; // oldest in flight
+
+    GfxCaptureFrame    queue[R_CAPTURE_QUEUE];
+    volatile int32_t   queue_head;    // written by the render thread
+    volatile int32_t   queue_tail;    // written by the writer
+    volatile int32_t   stop;
+    SysThread*         thread;
+    GfxCaptureWriter   writer;
+
+    // With an fps, rendered frames are read back as output frames come
+    // due, on the wall clock from the first frame. One that covers more
+    // than one output frame (because rendering's slower than the fps, or
+    // frames before it were dropped) is written that many times, and
+    // one that covers none isn't read back.
+    uint64_t           start_usec;
+    uint32_t           output_frames; // accounted for by readbacks
+    uint32_t           frames;        // read back
+    uint32_t           repeated;      // extra output frames from repeats
+    uint32_t           dropped;       // no PBO free, or it couldn't be mapped
+    uint64_t           render_usec;   // capturing, on the render thread
+    uint32_t           render_frames;
+} GfxCaptureGlob;
+static GfxCaptureGlob r_captureGlob;
+
+static int  R_CaptureThreadMain(void* arg);
+static void R_CaptureFinish    (void);
+
+static bool R_CaptureReserve(A_INOUT uint8_t** p, A_INOUT size_t* size,
+                             size_t n
+) {
+    if (*size >= n)
+        return true;
+
+    if (*p)
+        VM_Free(*p, VM_ALLOC_CAPTURE);
+    *p    = (uint8_t*)VM_Alloc(n, VM_ALLOC_CAPTURE);
+    *size = *p ? n : 0;
+    return *p != NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Writer
+static bool R_CaptureWrite(A_INOUT StreamFile* f, const void* p, size_t n) {
+    if (n == 0)
+        return true;
+
+    if (!FS_WriteStream(f, p, n))
+        return false;
+
+    r_captureGlob.writer.bytes += n;
+    return true;
+}
+
+static void R_CapturePutBE32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >>  8);
+    p[3] = (uint8_t)(v      );
+}
+
+static bool R_CaptureWritePngChunk(A_INOUT StreamFile* f, const char* type,
+                                   const uint8_t* data, uint32_t len
+) {
+    uint8_t head[8];
+    R_CapturePutBE32(head, len);
+    A_memcpy(head + 4, type, 4);
+    uLong crc = crc32(0L, head + 4, 4);
+    if (len > 0)
+        crc = crc32(crc, data, len);
+
+    uint8_t tail[4];
+    R_CapturePutBE32(tail, (uint32_t)crc);
+    return R_CaptureWrite(f, head, sizeof(head)) &&
+           R_CaptureWrite(f, data, len)           &&
+           R_CaptureWrite(f, tail, sizeof(tail));
+}
+
+// RGB, since the alpha that's read back is meaningless, with every row
+// Sub filtered, which costs next to nothing and gives deflate runs to work
+// with on flat surfaces. Compression's at the fastest level, so a sequence
+// doesn't fall behind. The compressed rows are left in the writer's `out`.
+static bool R_CaptureEncodePng(const GfxCaptureFrame* frame,
+                               A_OUT uLongf* len
+) {
+    GfxCaptureWriter* w      = &r_captureGlob.writer;
+    int               width  = frame->width;
+    int               height = frame->height;
+    size_t            stride = (size_t)width * 3 + 1;
+    size_t            raw    = stride * height;
+    uLong             bound  = compressBound((uLong)raw);
+    if (!R_CaptureReserve(&w->rows, &w->rows_size, raw) ||
+        !R_CaptureReserve(&w->out,  &w->out_size,  bound))
+        return false;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = frame->pixels +
+                             (size_t)(height - 1 - y) * width * 4;
+        uint8_t* dst = w->rows + (size_t)y * stride;
+        *dst++ = 1; // Sub
+        uint8_t pr = 0, pg = 0, pb = 0;
+        for (int x = 0; x < width; x++) {
+            uint8_t r = src[x * 4 + 0];
+            uint8_t g = src[x * 4 + 1];
+            uint8_t b = src[x * 4 + 2];
+            dst[x * 3 + 0] = (uint8_t)(r - pr);
+            dst[x * 3 + 1] = (uint8_t)(g - pg);
+            dst[x * 3 + 2] = (uint8_t)(b - pb);
+            pr = r;
+            pg = g;
+            pb = b;
+        }
+    }
+
+    *len = bound;
+    return compress2(w->out, len, w->rows, (uLong)raw, Z_BEST_SPEED) == Z_OK;
+}
+
+static bool R_CaptureWritePng(const GfxCaptureFrame* frame, const char* path,
+                              uLongf len
+) {
+    GfxCaptureWriter* w      = &r_captureGlob.writer;
+    int               width  = frame->width;
+    int               height = frame->height;
+    StreamFile f = FS_StreamFile(path, FS_SEEK_BEGIN, FS_STREAM_WRITE_NEW, 0);
+    if (f.f == NULL)
+        return false;
+
+    static const uint8_t sig[8] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+    };
+    uint8_t ihdr[13];
+    R_CapturePutBE32(ihdr + 0, (uint32_t)width);
+    R_CapturePutBE32(ihdr + 4, (uint32_t)height);
+    ihdr[8]  = 8; // bit depth
+    ihdr[9]  = 2; // truecolor
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering
+    ihdr[12] = 0; // not interlaced
+    bool ok = R_CaptureWrite(&f, sig, sizeof(sig))                     &&
+              R_CaptureWritePngChunk(&f, "IHDR", ihdr, sizeof(ihdr))   &&
+              R_CaptureWritePngChunk(&f, "IDAT", w->out, (uint32_t)len) &&
+              R_CaptureWritePngChunk(&f, "IEND", NULL, 0);
+    FS_CloseStream(&f);
+    return ok;
+}
+
+static void R_CaptureY4mPath(A_OUT char* path, size_t n) {
+    A_snprintf(path, n, "%s.y4m", r_captureGlob.name);
+}
+
+// 4:2:0, with BT.601's limited range coefficients, in integers. Chroma's
+// the average of each 2x2 block. The stream's size is the first frame's;
+// frames of any other size (after a resize) are skipped, since Y4M can't
+// change size mid-stream.
+static bool R_CaptureWriteY4m(const GfxCaptureFrame* frame) {
+    GfxCaptureWriter* w      = &r_captureGlob.writer;
+    int               width  = frame->width;
+    int               height = frame->height;
+    if (w->y4m.f == NULL) {
+        char path[R_CAPTURE_MAX_NAME + 8];
+        R_CaptureY4mPath(path, sizeof(path));
+        w->y4m = FS_StreamFile(path, FS_SEEK_BEGIN, FS_STREAM_WRITE_NEW, 0);
+        if (w->y4m.f == NULL)
+            return false;
+
+        char header[128];
+        int  len = A_snprintf(header, sizeof(header),
+                              "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n",
+                              width, height,
+                              r_captureGlob.fps ? r_captureGlob.fps
+                                                : R_CAPTURE_DEFAULT_FPS);
+        if (!R_CaptureWrite(&w->y4m, header, (size_t)len))
+            return false;
+
+        w->y4m_width  = width;
+        w->y4m_height = height;
+    }
+
+    if (width != w->y4m_width || height != w->y4m_height) {
+        w->skipped++;
+        return true;
+    }
+
+    int    cw   = (width  + 1) / 2;
+    int    ch   = (height + 1) / 2;
+    size_t luma = (size_t)width * height;
+    size_t size = 6 + luma + 2 * (size_t)cw * ch;
+    if (!R_CaptureReserve(&w->out, &w->out_size, size))
+        return false;
+
+    A_memcpy(w->out, "FRAME\n", 6);
+    uint8_t* py = w->out + 6;
+    uint8_t* pu = py + luma;
+    uint8_t* pv = pu + (size_t)cw * ch;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = frame->pixels +
+                             (size_t)(height - 1 - y) * width * 4;
+        uint8_t* dst = py + (size_t)y * width;
+        for (int x = 0; x < width; x++) {
+            int r = src[x * 4 + 0];
+            int g = src[x * 4 + 1];
+            int b = src[x * 4 + 2];
+            dst[x] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+
+    for (int cy = 0; cy < ch; cy++) {
+        // Rows in the Y4M's order, so flipped from what was read back.
+        int y0 = height - 1 - 2 * cy;
+        int y1 = A_MAX(y0 - 1, 0);
+        const uint8_t* row0 = frame->pixels + (size_t)y0 * width * 4;
+        const uint8_t* row1 = frame->pixels + (size_t)y1 * width * 4;
+        for (int cx = 0; cx < cw; cx++) {
+            int x0 = 2 * cx * 4;
+            int x1 = A_MIN(2 * cx + 1, width - 1) * 4;
+            int r  = (row0[x0 + 0] + row0[x1 + 0] +
+                      row1[x0 + 0] + row1[x1 + 0] + 2) >> 2;
+            int g  = (row0[x0 + 1] + row0[x1 + 1] +
+                      row1[x0 + 1] + row1[x1 + 1] + 2) >> 2;
+            int b  = (row0[x0 + 2] + row0[x1 + 2] +
+                      row1[x0 + 2] + row1[x1 + 2] + 2) >> 2;
+            // Offset by 128 << 8 before shifting, so what's shifted is
+            // never negative.
+            size_t i = (size_t)cy * cw + cx;
+            pu[i] = (uint8_t)((-38 * r -  74 * g + 112 * b + 128 + (128 << 8))
+                              >> 8);
+            pv[i] = (uint8_t)((112 * r -  94 * g -  18 * b + 128 + (128 << 8))
+                              >> 8);
+        }
+    }
+
+    for (uint32_t i = 0; i < frame->repeat; i++) {
+        if (!R_CaptureWrite(&w->y4m, w->out, size))
+            return false;
+    }
+    return true;
+}
+
+static void R_CaptureWriteFrame(const GfxCaptureFrame* frame) {
+    GfxCaptureGlob* c       = &r_captureGlob;
+    uint32_t        skipped = c->writer.skipped;
+    bool            ok      = false;
+    if (c->format == R_CAPTURE_FORMAT_PNG) {
+        // A repeated frame's only compressed once.
+        uLongf len = 0;
+        ok = R_CaptureEncodePng(frame, &len);
+        for (uint32_t i = 0; ok && i < frame->repeat; i++) {
+            char path[R_CAPTURE_MAX_NAME + 16];
+            if (c->max_frames == 1)
+                A_snprintf(path, sizeof(path), "%s.png", c->name);
+            else
+                A_snprintf(path, sizeof(path), "%s_%06u.png",
+                           c->name, frame->frame + i);
+            ok = R_CaptureWritePng(frame, path, len);
+        }
+    } else {
+        ok = R_CaptureWriteY4m(frame);
+    }
+
+    if (!ok)
+        c->writer.failed++;
+    else if (c->writer.skipped == skipped)
+        c->writer.written += frame->repeat;
+}
+
+static int R_CaptureThreadMain(void* arg) {
+    A_UNUSED(arg);
+    GfxCaptureGlob* c    = &r_captureGlob;
+    int             idle = 0;
+    for (;;) {
+        int32_t tail = c->queue_tail;
+        if (A_atomic_load32(&c->queue_head) != tail) {
+            R_CaptureWriteFrame(
+                &c->queue[(uint32_t)tail % R_CAPTURE_QUEUE]);
+            A_atomic_store32(&c->queue_tail, tail + 1);
+            idle = 0;
+            continue;
+        }
+
+        if (A_atomic_load32(&c->stop))
+            break;
+
+        Sys_Sleep(idle++ < R_CAPTURE_IDLE_YIELDS ? 0 : 1);
+    }
+
+    if (c->writer.y4m.f)
+        FS_CloseStream(&c->writer.y4m);
+    VM_FlushThreadCache();
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Readback
+static void R_CaptureDeleteFbo(void) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    if (c->fbo) {
+        GL_CALL(glDeleteFramebuffers, 1, &c->fbo);
+        c->fbo = 0;
+    }
+    if (c->color_rb) {
+        GL_CALL(glDeleteRenderbuffers, 1, &c->color_rb);
+        c->color_rb = 0;
+    }
+    if (c->depth_rb) {
+        GL_CALL(glDeleteRenderbuffers, 1, &c->depth_rb);
+        c->depth_rb = 0;
+    }
+    c->fbo_width  = 0;
+    c->fbo_height = 0;
+}
+
+static bool R_CaptureCreateFbo(int width, int height) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    R_CaptureDeleteFbo();
+
+    GL_CALL(glGenRenderbuffers, 1, &c->color_rb);
+    GL_CALL(glBindRenderbuffer, GL_RENDERBUFFER, c->color_rb);
+    GL_CALL(glRenderbufferStorage, GL_RENDERBUFFER, GL_RGBA8, width, height);
+    GL_CALL(glGenRenderbuffers, 1, &c->depth_rb);
+    GL_CALL(glBindRenderbuffer, GL_RENDERBUFFER, c->depth_rb);
+    GL_CALL(glRenderbufferStorage, GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+            width, height);
+    GL_CALL(glBindRenderbuffer, GL_RENDERBUFFER, 0);
+
+    GL_CALL(glGenFramebuffers, 1, &c->fbo);
+    GL_CALL(glBindFramebuffer, GL_FRAMEBUFFER, c->fbo);
+    GL_CALL(glFramebufferRenderbuffer, GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_RENDERBUFFER, c->color_rb);
+    GL_CALL(glFramebufferRenderbuffer, GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+            GL_RENDERBUFFER, c->depth_rb);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    GL_CALL(glBindFramebuffer, GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        R_CaptureDeleteFbo();
+        return false;
+    }
+
+    c->fbo_width  = width;
+    c->fbo_height = height;
+    return true;
+}
+
+// Reads the FBO (bound for reading) back into the next PBO, behind a
+// fence. Nothing waits on it here.
+static void R_CaptureReadBack(A_INOUT GfxCaptureReadback* rb) {
+    GfxCaptureGlob* c    = &r_captureGlob;
+    size_t          size = (size_t)c->fbo_width * c->fbo_height * 4;
+    if (rb->pbo == 0) {
+        GL_CALL(glGenBuffers, 1, &rb->pbo);
+    }
+    GL_CALL(glBindBuffer, GL_PIXEL_PACK_BUFFER, rb->pbo);
+    if (rb->size != size) {
+        GL_CALL(glBufferData, GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size, NULL,
+                GL_STREAM_READ);
+        rb->size = size;
+    }
+    GL_CALL(glPixelStorei, GL_PACK_ALIGNMENT, 4);
+    GL_CALL(glReadPixels, 0, 0, c->fbo_width, c->fbo_height,
+            GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    GL_CALL(glBindBuffer, GL_PIXEL_PACK_BUFFER, 0);
+    rb->fence  = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    rb->frame  = c->output_frames;
+    rb->width  = c->fbo_width;
+    rb->height = c->fbo_height;
+}
+
+// Hands the oldest readbacks whose fences have signaled to the writer, as
+// long as it has room. With `wait`, blocks on the fences instead, for
+// shutdown.
+static void R_CaptureCollect(bool wait) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    while (c->readback_tail != c->readback_head) {
+        GfxCaptureReadback* rb =
+            &c->readbacks[c->readback_tail % R_CAPTURE_READBACKS];
+        GLenum res = glClientWaitSync(
+            rb->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+            wait ? GL_TIMEOUT_IGNORED : 0);
+        if (res == GL_TIMEOUT_EXPIRED)
+            break;
+
+        int32_t head = c->queue_head;
+        if (head - A_atomic_load32(&c->queue_tail) >= R_CAPTURE_QUEUE) {
+            if (!wait)
+                break;
+
+            Sys_Sleep(1);
+            continue;
+        }
+
+        GfxCaptureFrame* frame = &c->queue[(uint32_t)head % R_CAPTURE_QUEUE];
+        const void*      src   = NULL;
+        if (res != GL_WAIT_FAILED &&
+            R_CaptureReserve(&frame->pixels, &frame->capacity, rb->size)) {
+            GL_CALL(glBindBuffer, GL_PIXEL_PACK_BUFFER, rb->pbo);
+            src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                   (GLsizeiptr)rb->size, GL_MAP_READ_BIT);
+        }
+        if (src) {
+            A_memcpy(frame->pixels, src, rb->size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            frame->frame  = rb->frame;
+            frame->repeat = rb->repeat;
+            frame->width  = rb->width;
+            frame->height = rb->height;
+            A_atomic_store32(&c->queue_head, head + 1);
+        } else {
+            c->dropped++;
+        }
+        GL_CALL(glBindBuffer, GL_PIXEL_PACK_BUFFER, 0);
+        glDeleteSync(rb->fence);
+        rb->fence = NULL;
+        c->readback_tail++;
+    }
+}
+
+static bool R_CaptureIdle(void) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    return c->readback_tail == c->readback_head &&
+           A_atomic_load32(&c->queue_tail) == c->queue_head;
+}
+
+static void R_CaptureFinish(void) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    A_atomic_store32(&c->stop, 1);
+    Sys_JoinThread(c->thread);
+    c->thread = NULL;
+    c->state  = R_CAPTURE_OFF;
+
+    GfxCaptureWriter* w = &c->writer;
+    if (c->discard) {
+        if (c->format == R_CAPTURE_FORMAT_Y4M) {
+            char path[R_CAPTURE_MAX_NAME + 8];
+            R_CaptureY4mPath(path, sizeof(path));
+            FS_DeleteFile(path);
+        }
+    } else if (c->format == R_CAPTURE_FORMAT_PNG && c->max_frames == 1) {
+        if (w->written == 1)
+            Com_Println(CON_DEST_CLIENT, "Wrote %s.png.", c->name);
+        else
+            Com_Println(CON_DEST_ERR, "screenshot: couldn't write %s.png.",
+                        c->name);
+    } else {
+        Com_Println(CON_DEST_CLIENT,
+                    "capture: wrote %u frame%s (%u KiB) to %s%s%s.",
+                    w->written, w->written == 1 ? "" : "s",
+                    (unsigned int)(w->bytes / 1024), c->name,
+                    c->format == R_CAPTURE_FORMAT_PNG ? "_*" : "",
+                    R_CaptureFormatExt(c->format));
+    }
+
+    if (c->repeated > 0 || c->dropped > 0 || w->skipped > 0 ||
+        w->failed > 0) {
+        Com_Println(CON_DEST_CLIENT,
+                    "capture: %u repeated (to keep %u fps), %u dropped "
+                    "(capture fell behind), %u skipped (resized), %u failed "
+                    "to write.",
+                    c->repeated, c->fps, c->dropped, w->skipped, w->failed);
+    }
+    if (!(c->format == R_CAPTURE_FORMAT_PNG && c->max_frames == 1) &&
+        c->render_frames > 0) {
+        Com_Println(CON_DEST_CLIENT,
+                    "capture: %.1f usec per frame on the render thread.",
+                    (double)c->render_usec / c->render_frames);
+    }
+}
+
+bool R_StartCapture(const char* name, GfxCaptureFormat format,
+                    uint32_t fps, uint32_t max_frames
+) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    if (c->state != R_CAPTURE_OFF) {
+        Com_Println(CON_DEST_ERR, "capture: already capturing to %s.",
+                    c->name);
+        return false;
+    }
+
+    R_CaptureBaseName(name, format, c->name, sizeof(c->name));
+    c->format        = format;
+    c->fps           = fps;
+    c->max_frames    = max_frames;
+    c->discard       = false;
+    c->in_frame      = false;
+    c->readback_head = 0;
+    c->readback_tail = 0;
+    c->queue_head    = 0;
+    c->queue_tail    = 0;
+    c->stop          = 0;
+    c->start_usec    = 0;
+    c->output_frames = 0;
+    c->frames        = 0;
+    c->repeated      = 0;
+    c->dropped       = 0;
+    c->render_usec   = 0;
+    c->render_frames = 0;
+    A_memset(&c->writer.y4m, 0, sizeof(c->writer.y4m));
+    c->writer.bytes   = 0;
+    c->writer.written = 0;
+    c->writer.skipped = 0;
+    c->writer.failed  = 0;
+    c->thread = Sys_SpawnThread("capture", R_CaptureThreadMain, NULL);
+    if (c->thread == NULL) {
+        Com_Println(CON_DEST_ERR, "capture: couldn't start the writer.");
+        return false;
+    }
+
+    c->state = R_CAPTURE_RUNNING;
+    return true;
+}
+
+void R_StopCapture(void) {
+    if (r_captureGlob.state == R_CAPTURE_RUNNING)
+        r_captureGlob.state = R_CAPTURE_DRAINING;
+}
+
+bool R_IsCapturing(void) {
+    return r_captureGlob.state != R_CAPTURE_OFF;
+}
+
+void R_BeginCaptureFrame(void) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    R_CaptureBenchFrame();
+    c->in_frame = false;
+    if (c->state != R_CAPTURE_RUNNING)
+        return;
+
+    int width  = Dvar_GetInt(vid_width);
+    int height = Dvar_GetInt(vid_height);
+    if (width <= 0 || height <= 0)
+        return;
+
+    if ((width != c->fbo_width || height != c->fbo_height) &&
+        !R_CaptureCreateFbo(width, height)) {
+        Com_Println(CON_DEST_ERR,
+                    "capture: couldn't create a %dx%d framebuffer.",
+                    width, height);
+        R_StopCapture();
+        return;
+    }
+
+    GL_CALL(glBindFramebuffer, GL_FRAMEBUFFER, c->fbo);
+    GL_CALL(glClear, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    c->in_frame = true;
+}
+
+// How many output frames the frame rendered at `now` should be written as.
+static uint32_t R_CaptureFramesDue(uint64_t now) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    if (c->fps == 0)
+        return 1;
+
+    if (c->output_frames == 0 && c->start_usec == 0)
+        c->start_usec = now;
+    uint64_t due = (now - c->start_usec) * c->fps / 1000000 + 1;
+    if (c->max_frames > 0)
+        due = A_MIN(due, (uint64_t)c->max_frames);
+    return due > c->output_frames ? (uint32_t)(due - c->output_frames) : 0;
+}
+
+void R_EndCaptureFrame(void) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    if (c->state == R_CAPTURE_OFF)
+        return;
+
+    uint64_t start = Sys_Microseconds();
+    if (c->in_frame) {
+        c->in_frame = false;
+        GL_CALL(glBindFramebuffer, GL_READ_FRAMEBUFFER, c->fbo);
+        uint32_t due = R_CaptureFramesDue(start);
+        if (due == 0) {
+            // Rendering's ahead of the fps.
+        } else if (c->readback_head - c->readback_tail < R_CAPTURE_READBACKS) {
+            GfxCaptureReadback* rb =
+                &c->readbacks[c->readback_head % R_CAPTURE_READBACKS];
+            R_CaptureReadBack(rb);
+            rb->repeat        = due;
+            c->output_frames += due;
+            c->repeated      += due - 1;
+            c->readback_head++;
+            c->frames++;
+        } else {
+            // What's due carries over to the next frame that's read back.
+            c->dropped++;
+        }
+
+        // The frame still has to be shown.
+        GL_CALL(glBindFramebuffer, GL_DRAW_FRAMEBUFFER, 0);
+        GL_CALL(glBlitFramebuffer, 0, 0, c->fbo_width, c->fbo_height,
+                0, 0, c->fbo_width, c->fbo_height,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        GL_CALL(glBindFramebuffer, GL_FRAMEBUFFER, 0);
+        if (c->max_frames > 0 && c->output_frames >= c->max_frames)
+            R_StopCapture();
+    }
+
+    R_CaptureCollect(false);
+    c->render_usec += Sys_Microseconds() - start;
+    c->render_frames++;
+    if (c->state == R_CAPTURE_DRAINING && R_CaptureIdle())
+        R_CaptureFinish();
+}
+
+static void R_CaptureShutdownGL(void) {
+    GfxCaptureGlob* c = &r_captureGlob;
+    if (c->state != R_CAPTURE_OFF) {
+        c->state = R_CAPTURE_DRAINING;
+        R_CaptureCollect(true);
+        while (!R_CaptureIdle())
+            Sys_Sleep(1);
+        R_CaptureFinish();
+    }
+
+    for (size_t i = 0; i < A_countof(c->readbacks); i++) {
+        if (c->readbacks[i].pbo) {
+            GL_CALL(glDeleteBuffers, 1, &c->readbacks[i].pbo);
+        }
+    }
+    for (size_t i = 0; i < A_countof(c->queue); i++) {
+        if (c->queue[i].pixels)
+            VM_Free(c->queue[i].pixels, VM_ALLOC_CAPTURE);
+    }
+    if (c->writer.out)
+        VM_Free(c->writer.out, VM_ALLOC_CAPTURE);
+    if (c->writer.rows)
+        VM_Free(c->writer.rows, VM_ALLOC_CAPTURE);
+    R_CaptureDeleteFbo();
+    A_memset(c, 0, sizeof(*c));
+}
+// ============================================================================
+#else
+bool R_StartCapture(const char* name, GfxCaptureFormat format,
+                    uint32_t fps, uint32_t max_frames
+) {
+    A_UNUSED(name);
+    A_UNUSED(format);
+    A_UNUSED(fps);
+    A_UNUSED(max_frames);
+    Com_Println(CON_DEST_ERR,
+                "capture: not supported by this render backend.");
+    return false;
+}
+
+void R_StopCapture(void) {}
+
+bool R_IsCapturing(void) {
+    return false;
+}
+
+void R_BeginCaptureFrame(void) {
+    R_CaptureBenchFrame();
+}
+
+void R_EndCaptureFrame(void) {}
+#endif // A_RENDER_BACKEND_GL
+
+// ============================================================================
+// Commands
+static void R_Screenshot_f(void) {
+    if (Cmd_Argc() > 2) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: screenshot [name]");
+        return;
+    }
+
+    char name[R_CAPTURE_MAX_NAME];
+    if (Cmd_Argc() == 2) {
+        A_cstrncpyz(name, Cmd_Argv(1), sizeof(name));
+    } else {
+        int i = 0;
+        for (; i < R_CAPTURE_SCREENSHOTS; i++) {
+            char path[R_CAPTURE_MAX_NAME];
+            A_snprintf(name, sizeof(name), "shot%04d", i);
+            A_snprintf(path, sizeof(path), "%s.png", name);
+            if (!FS_FileExists(path))
+                break;
+        }
+        if (i == R_CAPTURE_SCREENSHOTS) {
+            Com_Println(CON_DEST_ERR,
+                        "screenshot: every name up to shot%04d is taken.",
+                        R_CAPTURE_SCREENSHOTS - 1);
+            return;
+        }
+    }
+
+    R_StartCapture(name, R_CAPTURE_FORMAT_PNG, 0, 1);
+}
+
+static void R_Capture_f(void) {
+    GfxCaptureFormat format = R_CAPTURE_FORMAT_PNG;
+    int              fps    = R_CAPTURE_DEFAULT_FPS;
+    bool             ok     = Cmd_Argc() >= 2 && Cmd_Argc() <= 4;
+    if (ok && Cmd_Argc() >= 3) {
+        if (A_cstricmp(Cmd_Argv(2), "png"))
+            format = R_CAPTURE_FORMAT_PNG;
+        else if (A_cstricmp(Cmd_Argv(2), "y4m"))
+            format = R_CAPTURE_FORMAT_Y4M;
+        else
+            ok = false;
+    }
+    if (ok && Cmd_Argc() == 4)
+        ok = A_atoi(Cmd_Argv(3), &fps) && fps > 0 && fps <= R_CAPTURE_MAX_FPS;
+    if (!ok) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: capture <name> [png|y4m] [fps]");
+        return;
+    }
+
+    if (R_StartCapture(Cmd_Argv(1), format, (uint32_t)fps, 0))
+        Com_Println(CON_DEST_CLIENT, "capture: capturing to %s.",
+                    Cmd_Argv(1));
+}
+
+static void R_CaptureStop_f(void) {
+    if (!R_IsCapturing()) {
+        Com_Println(CON_DEST_CLIENT, "capture: not capturing.");
+        return;
+    }
+
+    R_StopCapture();
+}
+
+// ============================================================================
+// Benchmark
+typedef enum GfxCaptureBenchPhase {
+    R_CAPTURE_BENCH_OFF,
+    R_CAPTURE_BENCH_BASELINE,
+    R_CAPTURE_BENCH_CAPTURE,
+} GfxCaptureBenchPhase;
+
+typedef struct GfxCaptureBench {
+    GfxCaptureBenchPhase phase;
+    uint32_t             frames;
+    uint32_t             taken;
+    uint64_t             first;  // the first perf frame to sample
+    // Frame and R_Frame time, without then with capturing.
+    uint32_t*            usec[2][2];
+} GfxCaptureBench;
+static GfxCaptureBench r_captureBenchGlob;
+
+static void R_CaptureBenchFree(void) {
+    GfxCaptureBench* b = &r_captureBenchGlob;
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 2; j++) {
+            if (b->usec[i][j])
+                VM_Free(b->usec[i][j], VM_ALLOC_CAPTURE);
+            b->usec[i][j] = NULL;
+        }
+    }
+    b->phase = R_CAPTURE_BENCH_OFF;
+}
+
+static void R_CaptureBenchReport(void) {
+    GfxCaptureBench* b = &r_captureBenchGlob;
+    static const struct {
+        ComPerfPhase phase;
+        const char*  name;
+    } rows[] = {
+        { COM_PERF_PHASE_FRAME, "frame"   },
+        { COM_PERF_PHASE_R,     "R_Frame" },
+    };
+    Com_Println(CON_DEST_CLIENT,
+                "capture_bench: %u frames each, usec avg/p95:", b->frames);
+    for (size_t i = 0; i < A_countof(rows); i++) {
+        ComPerfStats off, on;
+        Com_PerfComputeStats(b->usec[0][i], b->frames, &off);
+        Com_PerfComputeStats(b->usec[1][i], b->frames, &on);
+        Com_Println(CON_DEST_CLIENT,
+                    "capture_bench: %-8s %7u/%-7u off, %7u/%-7u on, "
+                    "%+8.1f avg (%+.1f%%)",
+                    rows[i].name, off.avg, off.p95, on.avg, on.p95,
+                    (double)on.avg - off.avg,
+                    off.avg ? 100.0 * ((double)on.avg - off.avg) / off.avg
+                            : 0.0);
+    }
+}
+
+// Takes the last frame's times each frame, then moves on from the
+// baseline to capturing, and from capturing to the report.
+static void R_CaptureBenchFrame(void) {
+    GfxCaptureBench* b = &r_captureBenchGlob;
+    if (b->phase == R_CAPTURE_BENCH_OFF)
+        return;
+
+    uint64_t frame = Com_PerfFrameCount();
+    size_t   set   = b->phase == R_CAPTURE_BENCH_CAPTURE ? 1 : 0;
+    uint32_t frame_usec, r_usec;
+    if (frame > b->first &&
+        Com_PerfGetSample(frame - 1, COM_PERF_PHASE_FRAME, &frame_usec) &&
+        Com_PerfGetSample(frame - 1, COM_PERF_PHASE_R,     &r_usec)) {
+        b->usec[set][0][b->taken] = frame_usec;
+        b->usec[set][1][b->taken] = r_usec;
+        b->taken++;
+    }
+    if (b->taken < b->frames)
+        return;
+
+    if (b->phase == R_CAPTURE_BENCH_BASELINE) {
+        // Unpaced, so every frame it times pays for a readback.
+        if (!R_StartCapture(R_CAPTURE_BENCH_NAME, R_CAPTURE_FORMAT_Y4M,
+                            0, b->frames)) {
+            R_CaptureBenchFree();
+            return;
+        }
+#if A_RENDER_BACKEND_GL
+        r_captureGlob.discard = true;
+#endif // A_RENDER_BACKEND_GL
+        b->phase = R_CAPTURE_BENCH_CAPTURE;
+        b->taken = 0;
+        b->first = frame;
+        return;
+    }
+
+    R_CaptureBenchReport();
+    R_CaptureBenchFree();
+}
+
+static void R_CaptureBench_f(void) {
+    int frames = R_CAPTURE_BENCH_DEFAULT_FRAMES;
+    if (Cmd_Argc() > 2 ||
+        (Cmd_Argc() == 2 &&
+         (!A_atoi(Cmd_Argv(1), &frames) || frames < 1 ||
+          frames > R_CAPTURE_BENCH_MAX_FRAMES))
+    ) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: capture_bench [frames]");
+        return;
+    }
+
+    GfxCaptureBench* b = &r_captureBenchGlob;
+    if (b->phase != R_CAPTURE_BENCH_OFF || R_IsCapturing()) {
+        Com_Println(CON_DEST_CLIENT,
+                    "capture_bench: already capturing or benchmarking.");
+        return;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 2; j++) {
+            b->usec[i][j] = (uint32_t*)VM_Alloc(
+                (size_t)frames * sizeof(uint32_t), VM_ALLOC_CAPTURE);
+            ok = ok && b->usec[i][j] != NULL;
+        }
+    }
+    if (!ok) {
+        R_CaptureBenchFree();
+        Com_Println(CON_DEST_ERR,
+                    "capture_bench: not enough memory for %d frames' "
+                    "samples.", frames);
+        return;
+    }
+    b->phase  = R_CAPTURE_BENCH_BASELINE;
+    b->frames = (uint32_t)frames;
+    b->taken  = 0;
+    // Not the frame the command ran in.
+    b->first  = Com_PerfFrameCount() + 1;
+    Com_Println(CON_DEST_CLIENT,
+                "capture_bench: timing %d frames without capturing, then "
+                "%d with.", frames, frames);
+}
+// ============================================================================
+
+void R_InitCapture(void) {
+    Cmd_AddCommand("screenshot",    R_Screenshot_f);
+    Cmd_AddCommand("capture",       R_Capture_f);
+    Cmd_AddCommand("capture_stop",  R_CaptureStop_f);
+    Cmd_AddCommand("capture_bench", R_CaptureBench_f);
+}
+
+void R_ShutdownCapture(void) {
+    Cmd_RemoveCommand("capture_bench");
+    Cmd_RemoveCommand("capture_stop");
+    Cmd_RemoveCommand("capture");
+    Cmd_RemoveCommand("screenshot");
+    R_CaptureBenchFree();
+#if A_RENDER_BACKEND_GL
+    R_CaptureShutdownGL();
+#endif // A_RENDER_BACKEND_GL
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "acommon/acommon.h"
+
+#include "com_defs.h"
+
+// Frame capture, without stalling the renderer. While capturing, frames
+// are drawn into an offscreen framebuffer, which is then copied to the
+// window and read back into one of a ring of pixel buffers, with a fence
+// behind it. A buffer's only mapped once its fence has signaled, so the
+// CPU never waits on the GPU, and what's mapped is handed to a writer
+// thread to encode. If the ring or the writer falls behind, frames are
+// dropped (and counted) instead.
+//
+// `screenshot [name]` writes the next frame as a PNG. `capture <name>
+// [png|y4m] [fps]` writes `fps` frames for every second of wall-clock time
+// until `capture_stop`, as numbered PNGs or a Y4M stream, so it plays back
+// at the speed it was captured: rendered frames are skipped when rendering's
+// faster than that and repeated when it's slower. `capture_bench [frames]`
+// times that many frames without capturing, then as many captured to a
+// Y4M stream, and reports what capturing costs; turn off r_vsync and raise
+// com_maxfps first, or it only measures those.
+//
+// Only the GL backend can capture.
+typedef enum GfxCaptureFormat {
+    R_CAPTURE_FORMAT_PNG,
+    R_CAPTURE_FORMAT_Y4M,
+} GfxCaptureFormat;
+
+A_EXTERN_C void R_InitCapture    (void);
+// Captures from the next frame, until R_StopCapture or until `max_frames`
+// have been written, if that's not 0. With an `fps`, frames are paced to
+// it as above; with 0, every rendered frame is read back once.
+A_EXTERN_C bool R_StartCapture   (const char* name, GfxCaptureFormat format,
+                                  uint32_t fps, uint32_t max_frames);
+// Stops reading frames back. The capture finishes, and reports, once the
+// frames already read back have been written.
+A_EXTERN_C void R_StopCapture    (void);
+A_EXTERN_C A_NO_DISCARD bool R_IsCapturing(void);
+// R_Frame brackets drawing with these.
+A_EXTERN_C void R_BeginCaptureFrame(void);
+A_EXTERN_C void R_EndCaptureFrame  (void);
+A_EXTERN_C void R_ShutdownCapture(void);
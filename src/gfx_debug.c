@@ -0,0 +1,361 @@
+#include "gfx_debug.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "acommon/a_string.h"
+
+#include "com_perf.h"
+#include "com_print.h"
+#include "db_files.h"
+#include "dvar.h"
+#include "gfx.h"
+#include "gfx_shader.h"
+#include "sys.h"
+
+typedef struct GfxDebugVertex {
+    float x, y;
+    float r, g, b, a;
+} GfxDebugVertex;
+
+typedef struct DebugDrawGlob {
+    GfxShaderProgram     prog;
+    GfxVertexDeclaration vertex_declaration;
+    GfxDebugVertex       vertices[R_DEBUG_MAX_LINES * 2];
+    size_t               line_count;
+    bool                 initialized;
+} DebugDrawGlob;
+static DebugDrawGlob r_debugGlob;
+
+// How many frames of history the perf graph shows, and the frame time that
+// maps to the top of the graph.
+#define R_PERF_GRAPH_FRAMES   256
+#define R_PERF_GRAPH_MAX_USEC 50000
+#define R_PERF_GRAPH_X        0.01f
+#define R_PERF_GRAPH_Y        0.01f
+#define R_PERF_GRAPH_W        0.4f
+#define R_PERF_GRAPH_H        0.25f
+
+static uint32_t s_perfGraphSamples[R_PERF_GRAPH_FRAMES];
+
+// Segments of a glyph cell 1 wide and 2 tall, origin at the bottom-left.
+// The diagonals all meet at the center, except VL and VR, which meet at
+// the bottom so V doesn't have to be drawn as a Y.
+typedef enum GfxDebugSegment {
+    R_SEG_A,  // top
+    R_SEG_B,  // upper right
+    R_SEG_C,  // lower right
+    R_SEG_D,  // bottom
+    R_SEG_E,  // lower left
+    R_SEG_F,  // upper left
+    R_SEG_G1, // middle, left half
+    R_SEG_G2, // middle, right half
+    R_SEG_H,  // top-left to center
+    R_SEG_I,  // top to center
+    R_SEG_J,  // top-right to center
+    R_SEG_K,  // bottom-left to center
+    R_SEG_L,  // bottom to center
+    R_SEG_M,  // bottom-right to center
+    R_SEG_VL, // middle-left to bottom
+    R_SEG_VR, // middle-right to bottom
+
+    R_SEG_COUNT
+} GfxDebugSegment;
+
+static const float s_segments[R_SEG_COUNT][4] = {
+    /*[R_SEG_A]  =*/ { 0.0f, 2.0f, 1.0f, 2.0f },
+    /*[R_SEG_B]  =*/ { 1.0f, 2.0f, 1.0f, 1.0f },
+    /*[R_SEG_C]  =*/ { 1.0f, 1.0f, 1.0f, 0.0f },
+    /*[R_SEG_D]  =*/ { 0.0f, 0.0f, 1.0f, 0.0f },
+    /*[R_SEG_E]  =*/ { 0.0f, 0.0f, 0.0f, 1.0f },
+    /*[R_SEG_F]  =*/ { 0.0f, 1.0f, 0.0f, 2.0f },
+    /*[R_SEG_G1] =*/ { 0.0f, 1.0f, 0.5f, 1.0f },
+    /*[R_SEG_G2] =*/ { 0.5f, 1.0f, 1.0f, 1.0f },
+    /*[R_SEG_H]  =*/ { 0.0f, 2.0f, 0.5f, 1.0f },
+    /*[R_SEG_I]  =*/ { 0.5f, 2.0f, 0.5f, 1.0f },
+    /*[R_SEG_J]  =*/ { 1.0f, 2.0f, 0.5f, 1.0f },
+    /*[R_SEG_K]  =*/ { 0.0f, 0.0f, 0.5f, 1.0f },
+    /*[R_SEG_L]  =*/ { 0.5f, 0.0f, 0.5f, 1.0f },
+    /*[R_SEG_M]  =*/ { 1.0f, 0.0f, 0.5f, 1.0f },
+    /*[R_SEG_VL] =*/ { 0.0f, 1.0f, 0.5f, 0.0f },
+    /*[R_SEG_VR] =*/ { 1.0f, 1.0f, 0.5f, 0.0f },
+};
+
+#define S(seg) (1u << R_SEG_##seg)
+static const uint16_t s_digitSegments[10] = {
+    S(A) | S(B) | S(C) | S(D) | S(E) | S(F) | S(J) | S(K),  // 0
+    S(B) | S(C),                                            // 1
+    S(A) | S(B) | S(G1) | S(G2) | S(E) | S(D),              // 2
+    S(A) | S(B) | S(G2) | S(C) | S(D),                      // 3
+    S(F) | S(G1) | S(G2) | S(B) | S(C),                     // 4
+    S(A) | S(F) | S(G1) | S(G2) | S(C) | S(D),              // 5
+    S(A) | S(F) | S(E) | S(D) | S(C) | S(G1) | S(G2),       // 6
+    S(A) | S(B) | S(C),                                     // 7
+    S(A) | S(B) | S(C) | S(D) | S(E) | S(F) | S(G1) | S(G2),// 8
+    S(A) | S(B) | S(C) | S(D) | S(F) | S(G1) | S(G2),       // 9
+};
+
+static const uint16_t s_letterSegments[26] = {
+    S(A) | S(B) | S(C) | S(E) | S(F) | S(G1) | S(G2),       // A
+    S(A) | S(B) | S(C) | S(D) | S(I) | S(L) | S(G2),        // B
+    S(A) | S(D) | S(E) | S(F),                              // C
+    S(A) | S(B) | S(C) | S(D) | S(I) | S(L),                // D
+    S(A) | S(D) | S(E) | S(F) | S(G1),                      // E
+    S(A) | S(E) | S(F) | S(G1),                             // F
+    S(A) | S(C) | S(D) | S(E) | S(F) | S(G2),               // G
+    S(B) | S(C) | S(E) | S(F) | S(G1) | S(G2),              // H
+    S(A) | S(D) | S(I) | S(L),                              // I
+    S(B) | S(C) | S(D) | S(E),                              // J
+    S(E) | S(F) | S(G1) | S(J) | S(M),                      // K
+    S(D) | S(E) | S(F),                                     // L
+    S(B) | S(C) | S(E) | S(F) | S(H) | S(J),                // M
+    S(B) | S(C) | S(E) | S(F) | S(H) | S(M),                // N
+    S(A) | S(B) | S(C) | S(D) | S(E) | S(F),                // O
+    S(A) | S(B) | S(E) | S(F) | S(G1) | S(G2),              // P
+    S(A) | S(B) | S(C) | S(D) | S(E) | S(F) | S(M),         // Q
+    S(A) | S(B) | S(E) | S(F) | S(G1) | S(G2) | S(M),       // R
+    S(A) | S(F) | S(G1) | S(G2) | S(C) | S(D),              // S
+    S(A) | S(I) | S(L),                                     // T
+    S(B) | S(C) | S(D) | S(E) | S(F),                       // U
+    S(B) | S(F) | S(VL) | S(VR),                            // V
+    S(B) | S(C) | S(E) | S(F) | S(K) | S(M),                // W
+    S(H) | S(J) | S(K) | S(M),                              // X
+    S(H) | S(J) | S(L),                                     // Y
+    S(A) | S(J) | S(K) | S(D),                              // Z
+};
+#undef S
+
+static uint16_t R_DebugGlyphSegments(char c) {
+    if (c >= '0' && c <= '9')
+        return s_digitSegments[c - '0'];
+    if (c >= 'a' && c <= 'z')
+        c = (char)(c - 'a' + 'A');
+    if (c >= 'A' && c <= 'Z')
+        return s_letterSegments[c - 'A'];
+    if (c == '-')
+        return (uint16_t)((1u << R_SEG_G1) | (1u << R_SEG_G2));
+    if (c == '/')
+        return (uint16_t)((1u << R_SEG_J) | (1u << R_SEG_K));
+    return 0;
+}
+
+void R_InitDebugDraw(void) {
+    A_memset(&r_debugGlob, 0, sizeof(r_debugGlob));
+
+    char* vertSource  = DB_LoadShader("debug.vs");
+    char* pixelSource = DB_LoadShader("debug.ps");
+    bool b = R_CreateShaderProgram(vertSource, pixelSource, &r_debugGlob.prog);
+    assert(b);
+    DB_UnloadShader(vertSource);
+    DB_UnloadShader(pixelSource);
+    if (!b)
+        return;
+
+    b = R_CreateVertexBuffer(NULL, 0, sizeof(r_debugGlob.vertices), 0,
+                             sizeof(GfxDebugVertex),
+                             &r_debugGlob.vertex_declaration.vbs[0]);
+    assert(b);
+    if (!b)
+        return;
+    r_debugGlob.vertex_declaration.vb_count = 1;
+
+#if A_RENDER_BACKEND_GL
+    GL_CALL(glBindVertexArray, r_debugGlob.vertex_declaration.vbs[0].vao);
+    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER,
+                          r_debugGlob.vertex_declaration.vbs[0].vbo);
+    GL_CALL(glBufferData, GL_ARRAY_BUFFER, sizeof(r_debugGlob.vertices),
+                          NULL, GL_DYNAMIC_DRAW);
+    GL_CALL(glVertexAttribPointer,
+        0, 2, GL_FLOAT, (GLboolean)GL_FALSE,
+        (GLsizei)sizeof(GfxDebugVertex), (void*)offsetof(GfxDebugVertex, x)
+    );
+    GL_CALL(glVertexAttribPointer,
+        1, 4, GL_FLOAT, (GLboolean)GL_FALSE,
+        (GLsizei)sizeof(GfxDebugVertex), (void*)offsetof(GfxDebugVertex, r)
+    );
+    GL_CALL(glEnableVertexAttribArray, 0);
+    GL_CALL(glEnableVertexAttribArray, 1);
+    GL_CALL(glBindVertexArray, 0);
+#elif A_RENDER_BACKEND_D3D9
+    D3DVERTEXELEMENT9 vertex_elements[] = {
+        {
+            .Stream     = 0,
+            .Offset     = offsetof(GfxDebugVertex, x),
+            .Type       = D3DDECLTYPE_FLOAT2,
+            .Method     = D3DDECLMETHOD_DEFAULT,
+            .Usage      = D3DDECLUSAGE_POSITION,
+            .UsageIndex = 0
+        },
+        {
+            .Stream     = 0,
+            .Offset     = offsetof(GfxDebugVertex, r),
+            .Type       = D3DDECLTYPE_FLOAT4,
+            .Method     = D3DDECLMETHOD_DEFAULT,
+            .Usage      = D3DDECLUSAGE_COLOR,
+            .UsageIndex = 0
+        },
+        D3DDECL_END()
+    };
+    D3D_CALL(r_d3d9Glob.d3ddev, CreateVertexDeclaration, vertex_elements,
+                                &r_debugGlob.vertex_declaration.decl);
+    assert(r_debugGlob.vertex_declaration.decl);
+    if (!r_debugGlob.vertex_declaration.decl)
+        return;
+#elif A_RENDER_BACKEND_D3D8
+    assert(false && "unimplemented"); // FIXME
+    return;
+#endif // A_RENDER_BACKEND_GL
+
+    r_debugGlob.initialized = true;
+}
+
+bool R_AddDebugLine2D(float x0, float y0, float x1, float y1,
+                      acolor_rgba_t color
+) {
+    if (r_debugGlob.line_count >= R_DEBUG_MAX_LINES)
+        return false;
+
+    // Convert from window-normalized to clip space here so the shader
+    // doesn't need any uniforms.
+    GfxDebugVertex* v = &r_debugGlob.vertices[r_debugGlob.line_count * 2];
+    v[0].x = x0 * 2.0f - 1.0f;
+    v[0].y = y0 * 2.0f - 1.0f;
+    v[1].x = x1 * 2.0f - 1.0f;
+    v[1].y = y1 * 2.0f - 1.0f;
+    v[0].r = v[1].r = color.r;
+    v[0].g = v[1].g = color.g;
+    v[0].b = v[1].b = color.b;
+    v[0].a = v[1].a = color.a;
+    r_debugGlob.line_count++;
+    return true;
+}
+
+bool R_AddDebugText2D(float x, float y, float size,
+                      const char* text, acolor_rgba_t color
+) {
+    // Glyphs are half as wide as they're tall, with a gap of half that
+    // again between them and between lines.
+    const float w       = size * 0.5f / (float)Dvar_GetInt(vid_width);
+    const float h       = size        / (float)Dvar_GetInt(vid_height);
+    const float advance = w * 1.5f;
+    const float line    = h * 1.5f;
+
+    float pen_x = x;
+    float pen_y = y - h;
+    for (const char* p = text; *p; p++) {
+        if (*p == '\n') {
+            pen_x  = x;
+            pen_y -= line;
+            continue;
+        }
+
+        uint16_t segments = R_DebugGlyphSegments(*p);
+        for (int i = 0; i < R_SEG_COUNT; i++) {
+            if (!(segments & (1u << i)))
+                continue;
+
+            const float* s = s_segments[i];
+            if (!R_AddDebugLine2D(pen_x + s[0] * w, pen_y + s[1] * h * 0.5f,
+                                  pen_x + s[2] * w, pen_y + s[3] * h * 0.5f,
+                                  color)
+            ) {
+                return false;
+            }
+        }
+        pen_x += advance;
+    }
+    return true;
+}
+
+void R_DrawDebugLines(void) {
+    size_t line_count = r_debugGlob.line_count;
+    r_debugGlob.line_count = 0;
+    if (!r_debugGlob.initialized || line_count == 0)
+        return;
+
+    GfxVertexBuffer* vb = &r_debugGlob.vertex_declaration.vbs[0];
+    bool b = R_UploadVertexData(vb, 0, r_debugGlob.vertices,
+                                line_count * 2 * sizeof(GfxDebugVertex));
+    assert(b);
+    if (!b)
+        return;
+
+#if A_RENDER_BACKEND_D3D9
+    D3D_CALL(r_d3d9Glob.d3ddev, SetVertexDeclaration,
+                                r_debugGlob.vertex_declaration.decl);
+#endif // A_RENDER_BACKEND_D3D9
+
+    R_EnableTransparencyBlending();
+    R_BindShaderProgram(&r_debugGlob.prog);
+    R_BindVertexBuffer(vb, 0);
+    b = R_DrawPrimitives(PRIMITIVE_TYPE_LINE, (int)line_count, 0);
+    assert(b);
+    R_BindVertexBuffer(NULL, 0);
+    R_BindShaderProgram(NULL);
+    R_DisableTransparencyBlending();
+}
+
+static void R_AddPerfGraphSeries(ComPerfPhase phase, acolor_rgba_t color) {
+    size_t n = Com_PerfHistory(phase, s_perfGraphSamples,
+                               A_countof(s_perfGraphSamples));
+    if (n < 2)
+        return;
+
+    const float dx = R_PERF_GRAPH_W / (R_PERF_GRAPH_FRAMES - 1);
+    // Right-align the series so the newest frame is always at the right edge.
+    float x = R_PERF_GRAPH_X + R_PERF_GRAPH_W - dx * (n - 1);
+    float last_y = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t usec = A_MIN(s_perfGraphSamples[i], R_PERF_GRAPH_MAX_USEC);
+        float y = R_PERF_GRAPH_Y +
+                  R_PERF_GRAPH_H * ((float)usec / R_PERF_GRAPH_MAX_USEC);
+        // A zero is a frame without a sample (e.g. GPU results that
+        // haven't come back yet), so leave a gap instead of a spike.
+        if (i > 0 && usec > 0 && s_perfGraphSamples[i - 1] > 0)
+            R_AddDebugLine2D(x - dx, last_y, x, y, color);
+        last_y = y;
+        x += dx;
+    }
+}
+
+static void R_AddPerfGraphMarker(uint32_t usec, acolor_rgba_t color) {
+    float y = R_PERF_GRAPH_Y +
+              R_PERF_GRAPH_H * ((float)usec / R_PERF_GRAPH_MAX_USEC);
+    R_AddDebugLine2D(R_PERF_GRAPH_X, y, R_PERF_GRAPH_X + R_PERF_GRAPH_W, y,
+                     color);
+}
+
+void R_DrawPerfGraph(void) {
+    acolor_rgba_t border = A_color_rgba(0.5f, 0.5f, 0.5f, 0.8f);
+    acolor_rgba_t ms16   = A_color_rgba(0.2f, 0.8f, 0.2f, 0.5f);
+    acolor_rgba_t ms33   = A_color_rgba(0.8f, 0.6f, 0.2f, 0.5f);
+    acolor_rgba_t frame  = A_color_rgba(1.0f, 1.0f, 1.0f, 1.0f);
+    acolor_rgba_t render = A_color_rgba(0.3f, 0.6f, 1.0f, 1.0f);
+    acolor_rgba_t wait   = A_color_rgba(0.6f, 0.6f, 0.6f, 0.7f);
+    acolor_rgba_t gpu    = A_color_rgba(1.0f, 0.5f, 0.1f, 1.0f);
+
+    const float x0 = R_PERF_GRAPH_X, x1 = R_PERF_GRAPH_X + R_PERF_GRAPH_W;
+    const float y0 = R_PERF_GRAPH_Y, y1 = R_PERF_GRAPH_Y + R_PERF_GRAPH_H;
+    R_AddDebugLine2D(x0, y0, x1, y0, border);
+    R_AddDebugLine2D(x1, y0, x1, y1, border);
+    R_AddDebugLine2D(x1, y1, x0, y1, border);
+    R_AddDebugLine2D(x0, y1, x0, y0, border);
+    R_AddPerfGraphMarker(16667, ms16);
+    R_AddPerfGraphMarker(33333, ms33);
+
+    R_AddPerfGraphSeries(COM_PERF_PHASE_WAIT,  wait);
+    R_AddPerfGraphSeries(COM_PERF_PHASE_R,     render);
+    R_AddPerfGraphSeries(COM_PERF_PHASE_GPU_FRAME, gpu);
+    R_AddPerfGraphSeries(COM_PERF_PHASE_FRAME, frame);
+
+    R_DrawDebugLines();
+}
+
+void R_ShutdownDebugDraw(void) {
+    if (!r_debugGlob.initialized)
+        return;
+
+    R_DeleteVertexDeclaration(&r_debugGlob.vertex_declaration);
+    R_DeleteShaderProgram(&r_debugGlob.prog);
+    A_memset(&r_debugGlob, 0, sizeof(r_debugGlob));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "acommon/acommon.h"
+#include "acommon/a_math.h"
+
+#include "gfx_defs.h"
+
+#define R_DEBUG_MAX_LINES 4096
+
+A_EXTERN_C void R_InitDebugDraw(void);
+
+// Queues a line for R_DrawDebugLines. Coordinates are normalized to the
+// window, with (0, 0) at the bottom-left and (1, 1) at the top-right.
+A_EXTERN_C bool R_AddDebugLine2D(float x0, float y0, float x1, float y1,
+                                 acolor_rgba_t color);
+// Queues `text` as line segments, like a 16-segment display, with the top
+// of its first line at window-normalized (x, y) and each glyph `size`
+// pixels tall. Lowercase is drawn as uppercase, and anything other than
+// letters, digits, spaces, '-' and '/' as a space. Returns false if the
+// line queue filled up partway through.
+A_EXTERN_C bool R_AddDebugText2D(float x, float y, float size,
+                                 const char* text, acolor_rgba_t color);
+// Uploads every queued line and draws them with a single draw call.
+A_EXTERN_C void R_DrawDebugLines(void);
+
+A_EXTERN_C void R_DrawPerfGraph(void);
+
+A_EXTERN_C void R_ShutdownDebugDraw(void);
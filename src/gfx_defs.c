@@ -8,6 +8,7 @@
 #include "com_print.h"
 #include "dvar.h"
 #include "gfx.h"
+#include "gfx_stats.h"
 
 extern dvar_t* vid_width;
 extern dvar_t* vid_height;
@@ -101,6 +102,9 @@ bool R_CreateVertexBuffer(const void* data, size_t n, size_t capacity,
 #endif
     vb->bytes    = n;
     vb->capacity = capacity;
+    if (data)
+        r_stats.buffer_bytes_uploaded += n;
+    r_stats.buffer_bytes_resident += capacity;
 
     return true;
 }
@@ -114,7 +118,8 @@ bool R_UploadVertexData(A_INOUT GfxVertexBuffer* vb,
 
     assert(data);
     assert(n);
-    assert(off + n < vb->capacity);
+    assert(off + n <= vb->capacity);
+    r_stats.buffer_bytes_uploaded += n;
 
 #if A_RENDER_BACKEND_GL
     GL_CALL(glBindVertexArray, vb->vao);
@@ -163,6 +168,8 @@ bool R_AppendVertexData(A_INOUT GfxVertexBuffer* vb,
     if (vb->bytes + n > vb->capacity)
         return false;
 
+    r_stats.buffer_bytes_uploaded += n;
+
 #if A_RENDER_BACKEND_GL
     GL_CALL(glBindVertexArray, vb->vao);
     GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, vb->vbo);
@@ -229,6 +236,8 @@ bool R_DeleteVertexBuffer(A_INOUT GfxVertexBuffer* vb) {
     assert(hr == D3D_OK);
     vb->buffer = NULL;
 #endif // A_RENDER_BACKEND_GL
+    assert(r_stats.buffer_bytes_resident >= vb->capacity);
+    r_stats.buffer_bytes_resident -= vb->capacity;
     vb->bytes    = 0;
     vb->capacity = 0;
     return true;
@@ -114,6 +114,7 @@ typedef struct GfxImage {
     const void*        pixels;
     size_t             pixels_size;
     int                width, height, depth;
+    size_t             resident_bytes; // for r_stats
 } GfxImage;
 
 typedef struct GfxVertexBuffer {
@@ -145,7 +146,8 @@ typedef struct GfxVertexDeclaration {
 
 typedef enum GfxPrimitiveType {
     PRIMITIVE_TYPE_TRI,
-    PRIMITIVE_TYPE_TRI_STRIP
+    PRIMITIVE_TYPE_TRI_STRIP,
+    PRIMITIVE_TYPE_LINE
 } GfxPrimitiveType;
 
 typedef enum GfxPolygonMode {
@@ -11,11 +11,14 @@
 #include "cl_client.h"
 #include "cl_map.h"
 #include "com_print.h"
+#include "com_prof.h"
 #include "db_files.h"
 #include "dvar.h"
 #include "gfx.h"
+#include "gfx_bvh.h"
 #include "gfx_defs.h"
 #include "gfx_shader.h"
+#include "gfx_timer.h"
 #include "gfx_uniform.h"
 #include "vm_vmem.h"
 
@@ -529,10 +532,12 @@ static void R_LoadMaterial(const BSPMaterial* bsp_material,
         assert(bsp_material->lightmap_vertices_count == 
                bsp_material->rendered_vertices_count);
     }
+    // Only needed until they're uploaded below.
+    VmScratchMark mark = VM_ScratchMark();
     BSPRenderedVertex* rendered_vertices = 
-        (BSPRenderedVertex*)VM_Zalloc(3 * surf_count * sizeof(BSPRenderedVertex), VM_ALLOC_BSP);
+        (BSPRenderedVertex*)VM_ScratchZalloc(3 * surf_count * sizeof(BSPRenderedVertex));
     BSPLightmapVertex* lightmap_vertices = bsp_material->lightmap_vertices_count > 0 ?
-        (BSPLightmapVertex*)VM_Zalloc(3 * surf_count * sizeof(BSPLightmapVertex), VM_ALLOC_BSP) : NULL;
+        (BSPLightmapVertex*)VM_ScratchZalloc(3 * surf_count * sizeof(BSPLightmapVertex)) : NULL;
     const BSPRenderedVertex* bsp_rendered_vertices =
         (const BSPRenderedVertex*)bsp_material->uncompressed_vertices.pointer;
     const BSPLightmapVertex* bsp_lightmap_vertices =
@@ -693,13 +698,11 @@ static void R_LoadMaterial(const BSPMaterial* bsp_material,
     material->vertex_declaration.format.Input[15].Format     = D3DVSDT_NONE;
     material->vertex_declaration.format_count = 7;
 #endif // A_RENDER_BACKEND_GL
-    VM_Free(rendered_vertices, VM_ALLOC_BSP);
-    if (bsp_material->lightmap_vertices_count > 0)
-        VM_Free(lightmap_vertices, VM_ALLOC_BSP);
+    VM_ScratchRelease(mark);
 }
 
 static void R_LoadLightmap(const BSPLightmap* bsp_lightmap, GfxLightmap* lightmap) {
-    lightmap->materials = (GfxMaterial*)VM_Zalloc(
+    lightmap->materials = (GfxMaterial*)CL_Map_Zalloc(
         bsp_lightmap->materials.count *
         sizeof(*lightmap->materials),
         VM_ALLOC_BSP
@@ -807,7 +810,7 @@ static void R_LoadModelPart(const BSPModelGeometryPart* bsp_part, GfxModelPart*
 
 static void R_LoadModelGeometry(const BSPModelGeometry* bsp_geometry, GfxModelGeometry* geometry) {
     geometry->part_count = bsp_geometry->parts.count;
-    geometry->parts = (GfxModelPart*)VM_Zalloc(geometry->part_count * sizeof(*geometry->parts), VM_ALLOC_MODEL);
+    geometry->parts = (GfxModelPart*)CL_Map_Zalloc(geometry->part_count * sizeof(*geometry->parts), VM_ALLOC_MODEL);
     assert(geometry->parts);
     BSPModelGeometryPart* bsp_parts = (BSPModelGeometryPart*)bsp_geometry->parts.pointer;
     for (int i = 0; i < bsp_geometry->parts.count; i++) {
@@ -817,7 +820,7 @@ static void R_LoadModelGeometry(const BSPModelGeometry* bsp_geometry, GfxModelGe
 
 static void R_LoadModel(const BSPModel* bsp_model, GfxModel* model) {
     model->geometry_count = bsp_model->geometries.count;
-    model->geometries = (GfxModelGeometry*)VM_Zalloc(model->geometry_count * sizeof(*model->geometries), VM_ALLOC_MODEL);
+    model->geometries = (GfxModelGeometry*)CL_Map_Zalloc(model->geometry_count * sizeof(*model->geometries), VM_ALLOC_MODEL);
     assert(model->geometries);
     BSPModelGeometry* bsp_geometries = (BSPModelGeometry*)bsp_model->geometries.pointer;
     for (int i = 0; i < bsp_model->geometries.count; i++) {
@@ -854,7 +857,7 @@ static void R_LoadSceneryPalette(const BSPScenarioSceneryPalette* bsp_scenery_pa
 
 void R_LoadMap(void) {
     r_mapGlob.lightmap_count = CL_Map_LightmapCount();
-    r_mapGlob.lightmaps = (GfxLightmap*)VM_Zalloc(
+    r_mapGlob.lightmaps = (GfxLightmap*)CL_Map_Zalloc(
         r_mapGlob.lightmap_count * sizeof(*r_mapGlob.lightmaps),
         VM_ALLOC_BSP
     );
@@ -865,18 +868,22 @@ void R_LoadMap(void) {
     }
 
     r_mapGlob.scenery_palette_count = CL_Map_ScenarioSceneryPaletteCount();
-    r_mapGlob.scenery_palette = (GfxSceneryPalette*)VM_Zalloc(r_mapGlob.scenery_palette_count * sizeof(*r_mapGlob.scenery_palette), VM_ALLOC_MODEL);
+    r_mapGlob.scenery_palette = (GfxSceneryPalette*)CL_Map_Zalloc(r_mapGlob.scenery_palette_count * sizeof(*r_mapGlob.scenery_palette), VM_ALLOC_MODEL);
     for (uint32_t i = 0; i < r_mapGlob.scenery_palette_count; i++) {
         BSPScenarioSceneryPalette* bsp_scenery_palette = CL_Map_ScenarioSceneryPalette(i);
         R_LoadSceneryPalette(bsp_scenery_palette, &r_mapGlob.scenery_palette[i]);
     }
 
     r_mapGlob.scenery_count = CL_Map_ScenarioSceneryCount();
-    r_mapGlob.scenery = (GfxScenery*)VM_Zalloc(r_mapGlob.scenery_count * sizeof(*r_mapGlob.scenery), VM_ALLOC_MODEL);
+    r_mapGlob.scenery = (GfxScenery*)CL_Map_Zalloc(r_mapGlob.scenery_count * sizeof(*r_mapGlob.scenery), VM_ALLOC_MODEL);
     for (uint32_t i = 0; i < r_mapGlob.scenery_count; i++) {
         BSPScenarioScenery* bsp_scenery = CL_Map_ScenarioScenery(i);
         R_LoadScenarioScenery(bsp_scenery, &r_mapGlob.scenery[i]);
     }
+
+    COM_PROF_BEGIN("R_LoadBvh");
+    R_LoadBvh();
+    COM_PROF_END();
 }
 
 static bool R_RenderShaderEnvironment(GfxShaderEnvironment* shader_environment, 
@@ -1028,7 +1035,8 @@ static void R_RenderShader(GfxShader* shader,
     }
 }
 
-static void R_RenderMaterial(GfxMaterial* material) {
+static void R_RenderMaterial(GfxMaterial* material, GfxPolygonMode mode) {
+    COM_PROF_BEGIN("R_RenderMaterial");
 #if !A_TARGET_PLATFORM_IS_XBOX
     //R_ShaderSetUniformBoolByName(&r_mapGlob.prog, "uAlphaTested",
     //                             material->alpha_tested);
@@ -1072,17 +1080,11 @@ static void R_RenderMaterial(GfxMaterial* material) {
     //R_ShaderSetUniformVec3fByName(&r_mapGlob.prog,
     //    "uDistantLight1Color", color);
 
-    //bool wireframe = Dvar_GetBool(r_wireframe);
-
-    R_RenderShader(&material->shader, &material->vertex_declaration, PRIMITIVE_TYPE_TRI, 0, R_POLYGON_MODE_FILL);
-    if (Dvar_GetBool(r_wireframe)) {
-        R_ShaderSetUniformBoolByName(&r_mapGlob.prog, "uWireframe", SHADER_TYPE_PIXEL, true);
-        R_RenderShader(&material->shader, &material->vertex_declaration, PRIMITIVE_TYPE_TRI, 0, R_POLYGON_MODE_LINE);
-        R_ShaderSetUniformBoolByName(&r_mapGlob.prog, "uWireframe", SHADER_TYPE_PIXEL, false);
-    }
+    R_RenderShader(&material->shader, &material->vertex_declaration, PRIMITIVE_TYPE_TRI, 0, mode);
 #else
 	assert(false && "unimplemented"); // FIXME
 #endif // !A_TARGET_PLATFORM_IS_XBOX
+    COM_PROF_END();
 }
 
 static void R_RenderModelPart(GfxModel* model, GfxModelPart* part, apoint3f_t position, avec3f_t rotation) {
@@ -1157,12 +1159,32 @@ static void R_RenderMapInternal(void) {
 #else
 	assert(false); // FIXME
 #endif // !A_TARGET_PLATFORM_IS_XBOX
+    R_BeginGpuTimer(R_GPU_PASS_BSP);
     for (uint32_t i = 0; i < r_mapGlob.lightmap_count; i++) {
         GfxLightmap* lightmap = &r_mapGlob.lightmaps[i];
         for (uint32_t j = 0; j < lightmap->material_count; j++) {
             GfxMaterial* material = &lightmap->materials[j];
-            R_RenderMaterial(material);
+            R_RenderMaterial(material, R_POLYGON_MODE_FILL);
+        }
+    }
+    R_EndGpuTimer(R_GPU_PASS_BSP);
+
+    // Drawing the wireframe as a second pass over the whole BSP (rather 
+    // than right after each material) gives the same result, since it's
+    // depth tested against the fill either way, but only toggles
+    // uWireframe once per frame and lets the pass be timed on its own.
+    if (Dvar_GetBool(r_wireframe)) {
+        R_BeginGpuTimer(R_GPU_PASS_WIREFRAME);
+        R_ShaderSetUniformBoolByName(&r_mapGlob.prog, "uWireframe", SHADER_TYPE_PIXEL, true);
+        for (uint32_t i = 0; i < r_mapGlob.lightmap_count; i++) {
+            GfxLightmap* lightmap = &r_mapGlob.lightmaps[i];
+            for (uint32_t j = 0; j < lightmap->material_count; j++) {
+                GfxMaterial* material = &lightmap->materials[j];
+                R_RenderMaterial(material, R_POLYGON_MODE_LINE);
+            }
         }
+        R_ShaderSetUniformBoolByName(&r_mapGlob.prog, "uWireframe", SHADER_TYPE_PIXEL, false);
+        R_EndGpuTimer(R_GPU_PASS_WIREFRAME);
     }
 
     for (uint32_t i = 0; i < r_mapGlob.scenery_count; i++) {
@@ -1178,7 +1200,9 @@ void R_RenderMap(void) {
     if (!CL_IsMapLoaded())
         return;
 
+    COM_PROF_BEGIN("R_RenderMapInternal");
     R_RenderMapInternal();
+    COM_PROF_END();
 }
 
 static void R_UnloadShaderEnvironment(A_IN GfxShaderEnvironment* shader) {
@@ -1224,7 +1248,6 @@ void R_UnloadLightmap(A_IN GfxLightmap* lightmap) {
         GfxMaterial* material = &lightmap->materials[i];
         R_UnloadMaterial(material);
     }
-    VM_Free(lightmap->materials, VM_ALLOC_BSP);
 }
 
 void R_UnloadModelPart(A_IN GfxModelPart* part) {
@@ -1239,9 +1262,7 @@ void R_UnloadModel(A_IN GfxModel* model) {
             GfxModelPart* part = &geometry->parts[j];
             R_UnloadModelPart(part);
         }
-        VM_Free(geometry->parts, VM_ALLOC_MODEL);
     }
-    VM_Free(geometries, VM_ALLOC_MODEL);
 
     for (int i = 0; i < A_countof(model->shaders); i++) {
         R_UnloadShader(&model->shaders[i]);
@@ -1257,13 +1278,22 @@ void R_UnloadSceneryPalette(A_IN GfxSceneryPalette* scenery_palette) {
 }
 
 void R_UnloadMap(void) {
+    R_UnloadBvh();
+
     for (uint32_t i = 0; i < r_mapGlob.lightmap_count; i++)
         R_UnloadLightmap(&r_mapGlob.lightmaps[i]);
 
     for (uint32_t i = 0; i < r_mapGlob.scenery_palette_count; i++)
         R_UnloadSceneryPalette(&r_mapGlob.scenery_palette[i]);
-    
-    VM_Free(r_mapGlob.lightmaps, VM_ALLOC_BSP);
+
+    // The arrays themselves are in the map arena, which CL_UnloadMap
+    // releases right after this.
+    r_mapGlob.lightmaps             = NULL;
+    r_mapGlob.lightmap_count        = 0;
+    r_mapGlob.scenery_palette       = NULL;
+    r_mapGlob.scenery_palette_count = 0;
+    r_mapGlob.scenery               = NULL;
+    r_mapGlob.scenery_count         = 0;
 }
 
 void R_ShutdownMap(void) {
@@ -0,0 +1,464 @@
+#include "gfx_progcache.h"
+
+#if A_RENDER_BACKEND_GL
+#include <zlib.h>
+#endif // A_RENDER_BACKEND_GL
+
+#include "acommon/a_math.h"
+#include "acommon/a_string.h"
+
+#include "com_print.h"
+#include "db_files.h"
+#include "fs_files.h"
+#include "vm_vmem.h"
+
+#if A_RENDER_BACKEND_GL
+#define R_PROGRAM_CACHE_MAGIC       0x43505241 // "ARPC"
+// Bump whenever the layout below changes.
+#define R_PROGRAM_CACHE_VERSION     1
+#define R_PROGRAM_CACHE_MAX_ENTRIES 64
+#define R_PROGRAM_CACHE_MAX_FORMATS 16
+#define R_PROGRAM_CACHE_MAX_DRIVER  512
+#define R_PROGRAM_CACHE_MAX_PATH    1024
+// Anything bigger than this is a corrupt file, not a program.
+#define R_PROGRAM_CACHE_MAX_BINARY  (64 * 1024 * 1024)
+
+// The file is a GfxProgramCacheHeader, the driver string (not
+// terminated), then `entry_count` entries, each a GfxProgramCacheEntryHeader
+// followed by `size` bytes of binary. It never leaves the machine that
+// wrote it, so everything's in native byte order.
+typedef struct GfxProgramCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t driver_len;
+    uint32_t entry_count;
+} GfxProgramCacheHeader;
+
+typedef struct GfxProgramCacheEntryHeader {
+    uint64_t key;
+    // Checked along with the key, so a hash collision between two
+    // programs also has to match both their lengths.
+    uint32_t vertex_len;
+    uint32_t pixel_len;
+    uint32_t format;
+    uint32_t size;
+    uint32_t crc;
+    // How long compiling and linking took, for what a hit saves.
+    uint32_t build_usec;
+} GfxProgramCacheEntryHeader;
+
+A_STATIC_ASSERT(sizeof(GfxProgramCacheHeader)      == 16);
+A_STATIC_ASSERT(sizeof(GfxProgramCacheEntryHeader) == 32);
+
+typedef struct GfxProgramCacheEntry {
+    GfxProgramCacheEntryHeader h;
+    uint8_t*                   binary;
+} GfxProgramCacheEntry;
+
+typedef struct GfxProgramCacheGlob {
+    bool                 enabled;
+    bool                 dirty;
+    char                 path  [R_PROGRAM_CACHE_MAX_PATH];
+    char                 driver[R_PROGRAM_CACHE_MAX_DRIVER];
+    uint32_t             driver_len;
+    GLint                formats[R_PROGRAM_CACHE_MAX_FORMATS];
+    int                  format_count;
+    GfxProgramCacheEntry entries[R_PROGRAM_CACHE_MAX_ENTRIES];
+    int                  entry_count;
+
+    int                  hits;
+    int                  misses;
+    // Hits whose binary the driver wouldn't link.
+    int                  rejected;
+    uint64_t             load_usec;
+    // What the hits took to build when they were cached.
+    uint64_t             hit_build_usec;
+    uint64_t             miss_build_usec;
+} GfxProgramCacheGlob;
+static GfxProgramCacheGlob r_programCacheGlob;
+
+static uint64_t R_ProgramCacheHash(uint64_t h, const char* s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+// FNV-1a over both sources, with the terminator between them so moving
+// text from one to the other changes the key.
+static uint64_t R_ProgramCacheKey(const char* vertexSource, size_t vertex_len,
+                                  const char* pixelSource,  size_t pixel_len
+) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    h = R_ProgramCacheHash(h, vertexSource, vertex_len + 1);
+    h = R_ProgramCacheHash(h, pixelSource,  pixel_len);
+    return h;
+}
+
+static bool R_ProgramCacheFormatSupported(uint32_t format) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    for (int i = 0; i < c->format_count; i++) {
+        if ((uint32_t)c->formats[i] == format)
+            return true;
+    }
+    return false;
+}
+
+static GfxProgramCacheEntry* R_FindCachedProgram(
+    uint64_t key, uint32_t vertex_len, uint32_t pixel_len
+) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    for (int i = 0; i < c->entry_count; i++) {
+        GfxProgramCacheEntry* e = &c->entries[i];
+        if (e->h.key        == key        &&
+            e->h.vertex_len == vertex_len &&
+            e->h.pixel_len  == pixel_len
+        ) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void R_RemoveCachedProgram(GfxProgramCacheEntry* e) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    VM_Free(e->binary, VM_ALLOC_SHADER);
+    *e = c->entries[--c->entry_count];
+    c->dirty = true;
+}
+
+static void R_ClearProgramCache(void) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    for (int i = 0; i < c->entry_count; i++)
+        VM_Free(c->entries[i].binary, VM_ALLOC_SHADER);
+    c->entry_count = 0;
+}
+
+// ----------------------------------------------------------------------------
+// File
+static bool R_ProgramCacheRead(const uint8_t* buf, size_t size,
+                               A_INOUT size_t* off, A_OUT void* p, size_t n
+) {
+    if (size - *off < n)
+        return false;
+
+    A_memcpy(p, buf + *off, n);
+    *off += n;
+    return true;
+}
+
+// Anything wrong with the file just leaves the cache empty, and it's
+// written over once something's stored.
+static void R_LoadProgramCacheFile(void) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    if (!FS_FileExists(c->path))
+        return;
+
+    size_t size = 0;
+    uint8_t* buf = (uint8_t*)FS_ReadFile(c->path, &size);
+    if (buf == NULL)
+        return;
+
+    const char* reason = NULL;
+    size_t off = 0;
+    GfxProgramCacheHeader h;
+    if (!R_ProgramCacheRead(buf, size, &off, &h, sizeof(h)) ||
+        h.magic != R_PROGRAM_CACHE_MAGIC
+    ) {
+        reason = "isn't a program cache";
+    } else if (h.version != R_PROGRAM_CACHE_VERSION) {
+        reason = "is from another version";
+    } else if (h.driver_len != c->driver_len            ||
+               size - off < h.driver_len                ||
+               !A_memcmp(buf + off, c->driver, c->driver_len)
+    ) {
+        reason = "is from another driver";
+    }
+    off += reason ? 0 : h.driver_len;
+
+    for (uint32_t i = 0; reason == NULL && i < h.entry_count; i++) {
+        GfxProgramCacheEntryHeader eh;
+        if (!R_ProgramCacheRead(buf, size, &off, &eh, sizeof(eh)) ||
+            eh.size == 0 || eh.size > R_PROGRAM_CACHE_MAX_BINARY  ||
+            size - off < eh.size
+        ) {
+            reason = "is truncated";
+            break;
+        }
+
+        const uint8_t* binary = buf + off;
+        off += eh.size;
+        if (crc32(0L, binary, eh.size) != eh.crc) {
+            reason = "is corrupt";
+            break;
+        }
+
+        if (c->entry_count == R_PROGRAM_CACHE_MAX_ENTRIES ||
+            !R_ProgramCacheFormatSupported(eh.format)     ||
+            R_FindCachedProgram(eh.key, eh.vertex_len, eh.pixel_len)
+        ) {
+            continue;
+        }
+
+        uint8_t* p = (uint8_t*)VM_Alloc(eh.size, VM_ALLOC_SHADER);
+        if (p == NULL)
+            continue;
+
+        A_memcpy(p, binary, eh.size);
+        c->entries[c->entry_count].h      = eh;
+        c->entries[c->entry_count].binary = p;
+        c->entry_count++;
+    }
+
+    if (reason) {
+        Com_Println(CON_DEST_CLIENT,
+                    "R_InitProgramCache: %s %s, starting over.",
+                    c->path, reason);
+        R_ClearProgramCache();
+        c->dirty = true;
+    }
+
+    FS_FreeFile(buf);
+}
+
+static void R_SaveProgramCacheFile(void) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+
+    StreamFile f = FS_StreamFile(c->path, FS_SEEK_BEGIN,
+                                 FS_STREAM_WRITE_NEW, 0);
+    if (f.f == NULL) {
+        Com_Println(CON_DEST_ERR,
+                    "R_ProgramCache: couldn't open %s for writing.",
+                    c->path);
+        return;
+    }
+
+    GfxProgramCacheHeader h;
+    h.magic       = R_PROGRAM_CACHE_MAGIC;
+    h.version     = R_PROGRAM_CACHE_VERSION;
+    h.driver_len  = c->driver_len;
+    h.entry_count = (uint32_t)c->entry_count;
+
+    bool ok = FS_WriteStream(&f, &h, sizeof(h)) &&
+              FS_WriteStream(&f, c->driver, c->driver_len);
+    for (int i = 0; ok && i < c->entry_count; i++) {
+        const GfxProgramCacheEntry* e = &c->entries[i];
+        ok = FS_WriteStream(&f, &e->h, sizeof(e->h)) &&
+             FS_WriteStream(&f, e->binary, e->h.size);
+    }
+    FS_CloseStream(&f);
+
+    // A partial file would only be thrown out next time, but it'd also
+    // be read for nothing until it is.
+    if (!ok) {
+        Com_Println(CON_DEST_ERR,
+                    "R_ProgramCache: failed to write %s.", c->path);
+        FS_DeleteFile(c->path);
+        return;
+    }
+    c->dirty = false;
+}
+
+// ----------------------------------------------------------------------------
+void R_InitProgramCache(void) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    A_memset(c, 0, sizeof(*c));
+
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) {
+        Com_Println(CON_DEST_CLIENT,
+                    "R_InitProgramCache: program binaries not supported, "
+                    "program cache disabled.");
+        return;
+    }
+
+    GLint format_count = 0;
+    GL_CALL(glGetIntegerv, GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    if (format_count <= 0) {
+        Com_Println(CON_DEST_CLIENT,
+                    "R_InitProgramCache: driver has no program binary "
+                    "formats, program cache disabled.");
+        return;
+    }
+
+    GLint* formats = (GLint*)VM_Alloc(format_count * sizeof(*formats),
+                                      VM_ALLOC_SHADER);
+    if (formats == NULL)
+        return;
+    GL_CALL(glGetIntegerv, GL_PROGRAM_BINARY_FORMATS, formats);
+    c->format_count = A_MIN(format_count, R_PROGRAM_CACHE_MAX_FORMATS);
+    A_memcpy(c->formats, formats, c->format_count * sizeof(*formats));
+    VM_Free(formats, VM_ALLOC_SHADER);
+
+    // A driver update can change what a binary means without changing its
+    // format, so any of these changing throws the whole cache out.
+    const char* vendor   = (const char*)glGetString(GL_VENDOR);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version  = (const char*)glGetString(GL_VERSION);
+    int n = A_snprintf(c->driver, sizeof(c->driver), "%s\n%s\n%s",
+                       vendor   ? vendor   : "",
+                       renderer ? renderer : "",
+                       version  ? version  : "");
+    if (n < 0 || (size_t)n >= sizeof(c->driver)) {
+        Com_Println(CON_DEST_CLIENT,
+                    "R_InitProgramCache: driver strings too long, "
+                    "program cache disabled.");
+        return;
+    }
+    c->driver_len = (uint32_t)n;
+
+    const char* path = DB_ProgramCachePath();
+    if (path == NULL) {
+        Com_Println(CON_DEST_ERR,
+                    "R_InitProgramCache: couldn't build the cache path, "
+                    "program cache disabled.");
+        return;
+    }
+    A_cstrncpyz(c->path, path, sizeof(c->path));
+
+    c->enabled = true;
+    R_LoadProgramCacheFile();
+}
+
+void R_PrepareCachedProgram(shader_program_t program) {
+    if (!r_programCacheGlob.enabled)
+        return;
+
+    GL_CALL(glProgramParameteri, program,
+                                 GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+A_NO_DISCARD bool R_LoadCachedProgram(
+    const char* vertexSource, const char* pixelSource,
+    A_OUT shader_program_t* program
+) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    *program = 0;
+    if (!c->enabled)
+        return false;
+
+    uint64_t start = Sys_Microseconds();
+    size_t vertex_len = A_cstrlen(vertexSource);
+    size_t pixel_len  = A_cstrlen(pixelSource);
+    uint64_t key = R_ProgramCacheKey(vertexSource, vertex_len,
+                                     pixelSource,  pixel_len);
+    GfxProgramCacheEntry* e = R_FindCachedProgram(
+        key, (uint32_t)vertex_len, (uint32_t)pixel_len
+    );
+    if (e == NULL) {
+        c->misses++;
+        return false;
+    }
+
+    shader_program_t p = GL_CALL(glCreateProgram);
+    GL_CALL(glProgramBinary, p, (GLenum)e->h.format,
+                             e->binary, (GLsizei)e->h.size);
+
+    GLint success = GL_FALSE;
+    GL_CALL(glGetProgramiv, p, GL_LINK_STATUS, &success);
+    if (success != GL_TRUE) {
+        // Usually the driver changed without its strings changing. The
+        // caller builds the program and it's stored again.
+        GL_CALL(glDeleteProgram, p);
+        R_RemoveCachedProgram(e);
+        c->misses++;
+        c->rejected++;
+        return false;
+    }
+
+    c->hits++;
+    c->load_usec      += Sys_Microseconds() - start;
+    c->hit_build_usec += e->h.build_usec;
+    *program = p;
+    return true;
+}
+
+void R_StoreCachedProgram(const char* vertexSource,
+                          const char* pixelSource,
+                          shader_program_t program,
+                          uint64_t build_usec
+) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    if (!c->enabled)
+        return;
+
+    c->miss_build_usec += build_usec;
+
+    size_t vertex_len = A_cstrlen(vertexSource);
+    size_t pixel_len  = A_cstrlen(pixelSource);
+    uint64_t key = R_ProgramCacheKey(vertexSource, vertex_len,
+                                     pixelSource,  pixel_len);
+    GfxProgramCacheEntry* e = R_FindCachedProgram(
+        key, (uint32_t)vertex_len, (uint32_t)pixel_len
+    );
+    if (e)
+        R_RemoveCachedProgram(e);
+
+    if (c->entry_count == R_PROGRAM_CACHE_MAX_ENTRIES)
+        return;
+
+    GLint size = 0;
+    GL_CALL(glGetProgramiv, program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0 || size > R_PROGRAM_CACHE_MAX_BINARY)
+        return;
+
+    uint8_t* binary = (uint8_t*)VM_Alloc((size_t)size, VM_ALLOC_SHADER);
+    if (binary == NULL)
+        return;
+
+    GLsizei len    = 0;
+    GLenum  format = 0;
+    GL_CALL(glGetProgramBinary, program, size, &len, &format, binary);
+    if (len <= 0 || !R_ProgramCacheFormatSupported(format)) {
+        VM_Free(binary, VM_ALLOC_SHADER);
+        return;
+    }
+
+    e = &c->entries[c->entry_count++];
+    e->h.key        = key;
+    e->h.vertex_len = (uint32_t)vertex_len;
+    e->h.pixel_len  = (uint32_t)pixel_len;
+    e->h.format     = format;
+    e->h.size       = (uint32_t)len;
+    e->h.crc        = (uint32_t)crc32(0L, binary, (uInt)len);
+    e->h.build_usec = (uint32_t)A_MIN(build_usec, (uint64_t)UINT32_MAX);
+    e->binary       = binary;
+    c->dirty        = true;
+}
+
+void R_ReportProgramCache(void) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    if (!c->enabled)
+        return;
+
+    if (c->dirty)
+        R_SaveProgramCacheFile();
+
+    // Misses have no cached build time to compare against, so only hits
+    // count toward what was saved.
+    double saved_msec = c->hit_build_usec > c->load_usec ?
+        (double)(c->hit_build_usec - c->load_usec) / 1000.0 : 0.0;
+    Com_Println(CON_DEST_CLIENT,
+                "R_ProgramCache: %d hits, %d misses (%d rejected), "
+                "saved %.1f ms. Hits loaded in %.1f ms, "
+                "misses built in %.1f ms.",
+                c->hits, c->misses, c->rejected, saved_msec,
+                (double)c->load_usec / 1000.0,
+                (double)c->miss_build_usec / 1000.0);
+}
+
+void R_ShutdownProgramCache(void) {
+    GfxProgramCacheGlob* c = &r_programCacheGlob;
+    if (c->enabled && c->dirty)
+        R_SaveProgramCacheFile();
+
+    R_ClearProgramCache();
+    A_memset(c, 0, sizeof(*c));
+}
+#else
+// FIXME: D3D9 could keep the bytecode D3DXCompileShader returns the same
+// way. Until then its shaders are compiled every run.
+void R_InitProgramCache    (void) {}
+void R_ReportProgramCache  (void) {}
+void R_ShutdownProgramCache(void) {}
+#endif // A_RENDER_BACKEND_GL
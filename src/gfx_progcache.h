@@ -0,0 +1,42 @@
+#pragma once
+
+#include "acommon/acommon.h"
+
+#include "com_defs.h"
+#include "gfx_defs.h"
+
+// Linked GL programs, kept across runs so startup doesn't have to compile
+// and link every shader again. Each program's keyed by a hash of its
+// vertex and pixel sources, which covers any #defines written into them,
+// and the whole cache by the driver's vendor, renderer and version
+// strings: a different driver starts the cache over, and a binary the
+// driver won't take back is dropped and the program compiled as usual.
+//
+// The cache is one file next to the decompressed maps. It's written once
+// the renderer has initialized, if anything new was linked, and again at
+// shutdown for anything linked since.
+//
+// Only the GL backend caches, and only with GL 4.1 or
+// ARB_get_program_binary and at least one binary format.
+A_EXTERN_C void R_InitProgramCache    (void);
+#if A_RENDER_BACKEND_GL
+// Called on a new program before it's linked, so the driver keeps what
+// R_StoreCachedProgram needs.
+A_EXTERN_C void R_PrepareCachedProgram(shader_program_t program);
+// Creates `*program` from the cache, if these sources are in it and the
+// driver accepts the binary.
+A_EXTERN_C A_NO_DISCARD bool R_LoadCachedProgram(
+    const char* vertexSource, const char* pixelSource,
+    A_OUT shader_program_t* program
+);
+// Caches a program that was just compiled and linked from these sources,
+// which took `build_usec`.
+A_EXTERN_C void R_StoreCachedProgram  (const char* vertexSource,
+                                       const char* pixelSource,
+                                       shader_program_t program,
+                                       uint64_t build_usec);
+#endif // A_RENDER_BACKEND_GL
+// Writes the cache, if anything's been stored, and prints how many
+// programs came from it and how long that saved.
+A_EXTERN_C void R_ReportProgramCache  (void);
+A_EXTERN_C void R_ShutdownProgramCache(void);
@@ -7,6 +7,9 @@
 #include "acommon/z_mem.h"
 
 #include "com_print.h"
+#include "com_prof.h"
+#include "gfx_progcache.h"
+#include "gfx_stats.h"
 #include "gfx_uniform.h"
 
 #define R_MAX_SHADER_ERROR_LEN 1024
@@ -113,6 +116,7 @@ A_NO_DISCARD bool R_LinkShadersGL(
     A_INOUT GfxShaderProgram*  prog
 ) {
     prog->program = GL_CALL(glCreateProgram);
+    R_PrepareCachedProgram(prog->program);
     GL_CALL(glAttachShader, prog->program, *vertShader);
     GL_CALL(glAttachShader, prog->program, *fragShader);
     GL_CALL(glLinkProgram,  prog->program);
@@ -166,13 +170,19 @@ static bool R_CreatePixelShaderD3D9(A_INOUT GfxShaderProgram*  prog,
 }
 #endif // A_RENDER_BACKEND_D3D9
 
-A_NO_DISCARD bool R_CreateShaderProgram(
+static bool R_CreateShaderProgramInternal(
     const char* vertexSource, 
     const char* pixelSource,
     A_OUT GfxShaderProgram* prog
 ) {
     A_memset(prog, 0, sizeof(*prog));
 
+#if A_RENDER_BACKEND_GL
+    if (R_LoadCachedProgram(vertexSource, pixelSource, &prog->program))
+        return true;
+    uint64_t start = Sys_Microseconds();
+#endif // A_RENDER_BACKEND_GL
+
 #if !A_TARGET_PLATFORM_IS_XBOX
     if (!R_CompileVertexShader(prog, vertexSource, &prog->vertex_shader))
         return false;
@@ -188,6 +198,8 @@ A_NO_DISCARD bool R_CreateShaderProgram(
                          &prog->pixel_shader.compiled_shader, prog
     ))
         return false;
+    R_StoreCachedProgram(vertexSource, pixelSource, prog->program,
+                         Sys_Microseconds() - start);
 #elif A_RENDER_BACKEND_D3D9
     if (!R_CreateVertexShaderD3D9(prog, &prog->vertex_shader.compiled_shader))
         return false;
@@ -197,6 +209,17 @@ A_NO_DISCARD bool R_CreateShaderProgram(
     return true;
 }
 
+A_NO_DISCARD bool R_CreateShaderProgram(
+    const char* vertexSource, 
+    const char* pixelSource,
+    A_OUT GfxShaderProgram* prog
+) {
+    COM_PROF_BEGIN("R_CreateShaderProgram");
+    bool b = R_CreateShaderProgramInternal(vertexSource, pixelSource, prog);
+    COM_PROF_END();
+    return b;
+}
+
 #if !A_TARGET_PLATFORM_IS_XBOX
 #if A_RENDER_BACKEND_GL
 static void R_ShaderSetUniformIntGL(shader_program_t program,
@@ -782,8 +805,9 @@ static bool R_ShaderSetUniformByNameD3D9(ID3DXConstantTable* constant_table,
 }
 #endif // A_RENDER_BACKEND_GL
 
-static bool R_ShaderSetUniform(const GfxShaderProgram* prog, int location, 
-                               int shader_type, GfxShaderUniformDef* uniform
+static bool R_ShaderSetUniformInternal(const GfxShaderProgram* prog, 
+                                       int location, int shader_type, 
+                                       GfxShaderUniformDef* uniform
 ) {
 #if A_RENDER_BACKEND_GL
     R_ShaderSetUniformGL(prog->program, location, uniform);
@@ -809,9 +833,10 @@ static bool R_ShaderSetUniform(const GfxShaderProgram* prog, int location,
 #endif // A_RENDER_BACKEND_GL
 }
 
-static bool R_ShaderSetUniformByName(const GfxShaderProgram* prog, 
-                                     const char* name, int shader_type,
-                                     GfxShaderUniformDef* uniform
+static bool R_ShaderSetUniformByNameInternal(const GfxShaderProgram* prog, 
+                                             const char* name, 
+                                             int shader_type,
+                                             GfxShaderUniformDef* uniform
 ) {
 #if A_RENDER_BACKEND_GL
     (void)shader_type;
@@ -838,6 +863,28 @@ static bool R_ShaderSetUniformByName(const GfxShaderProgram* prog,
 #endif // A_RENDER_BACKEND_GL
 }
 
+static bool R_ShaderSetUniform(const GfxShaderProgram* prog, int location, 
+                               int shader_type, GfxShaderUniformDef* uniform
+) {
+    COM_PROF_BEGIN("R_ShaderSetUniform");
+    r_stats.uniform_uploads++;
+    bool b = R_ShaderSetUniformInternal(prog, location, shader_type, uniform);
+    COM_PROF_END();
+    return b;
+}
+
+static bool R_ShaderSetUniformByName(const GfxShaderProgram* prog, 
+                                     const char* name, int shader_type,
+                                     GfxShaderUniformDef* uniform
+) {
+    COM_PROF_BEGIN("R_ShaderSetUniformByName");
+    r_stats.uniform_uploads++;
+    bool b = R_ShaderSetUniformByNameInternal(prog, name, shader_type, 
+                                              uniform);
+    COM_PROF_END();
+    return b;
+}
+
 GfxShaderUniformDef* R_ShaderAddUniform(A_INOUT GfxShaderProgram* prog, int shader_type,
                                         A_IN GfxShaderUniformDef* uniform
 ) {
@@ -934,9 +981,13 @@ GfxShaderUniformDef* R_ShaderGetUniformByName(A_INOUT GfxShaderProgram* prog,
     assert(prog);
     assert(name);
 
-    int hash = R_HashUniformName(name);
+    // Uniform names are interned, so a name that never was can't match.
+    aatom_t atom = A_atom_find(name);
+    if (atom == NULL)
+        return NULL;
+
     for (int i = 0; i < prog->current_uniform; i++) {
-        if (prog->uniforms[i].name_hash == hash)
+        if (prog->uniforms[i].name == atom)
             return &prog->uniforms[i];
     }
     return NULL;
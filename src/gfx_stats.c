@@ -0,0 +1,98 @@
+#include "gfx_stats.h"
+
+#include "acommon/a_string.h"
+
+#include "cmd_commands.h"
+#include "com_print.h"
+#include "gfx.h"
+#include "gfx_debug.h"
+
+GfxStats r_stats;
+
+#define R_STATS_OVERLAY_X    0.01f
+#define R_STATS_OVERLAY_Y    0.99f
+#define R_STATS_OVERLAY_SIZE 12.0f
+
+typedef struct GfxStatsGlob {
+    GfxStats last_frame;
+} GfxStatsGlob;
+static GfxStatsGlob r_statsGlob;
+
+static void R_Stats_f(void);
+
+void R_InitStats(void) {
+    // The resident counters outlive R_Shutdown/R_Init, since images and
+    // buffers can be created before the renderer is (re)initialized.
+    uint64_t texture_bytes = r_stats.texture_bytes_resident;
+    uint64_t buffer_bytes  = r_stats.buffer_bytes_resident;
+    A_memset(&r_stats,     0, sizeof(r_stats));
+    A_memset(&r_statsGlob, 0, sizeof(r_statsGlob));
+    r_stats.texture_bytes_resident = texture_bytes;
+    r_stats.buffer_bytes_resident  = buffer_bytes;
+
+    Cmd_AddCommand("r_stats", R_Stats_f);
+}
+
+static void R_FormatStats(const GfxStats* s, char* buf, size_t n) {
+    A_snprintf(buf, n,
+               "draws %u  tris %u  verts %u\n"
+               "program binds %u  texture binds %u  vao binds %u\n"
+               "uniforms %u  buffer uploads %llu KiB\n"
+               "textures resident %llu KiB  buffers resident %llu KiB",
+               s->draw_calls, s->triangles, s->vertices,
+               s->program_binds, s->texture_binds, s->vao_binds,
+               s->uniform_uploads,
+               (unsigned long long)(s->buffer_bytes_uploaded / 1024),
+               (unsigned long long)(s->texture_bytes_resident / 1024),
+               (unsigned long long)(s->buffer_bytes_resident / 1024));
+}
+
+void R_BeginStatsFrame(void) {
+    r_statsGlob.last_frame = r_stats;
+
+    uint64_t texture_bytes = r_stats.texture_bytes_resident;
+    uint64_t buffer_bytes  = r_stats.buffer_bytes_resident;
+    A_memset(&r_stats, 0, sizeof(r_stats));
+    r_stats.texture_bytes_resident = texture_bytes;
+    r_stats.buffer_bytes_resident  = buffer_bytes;
+}
+
+const GfxStats* R_LastFrameStats(void) {
+    return &r_statsGlob.last_frame;
+}
+
+// No font is loaded for text draw defs, so this goes through the debug
+// lines like the perf graph does.
+void R_DrawStatsOverlay(void) {
+    char text[256];
+    R_FormatStats(&r_statsGlob.last_frame, text, sizeof(text));
+
+    acolor_rgba_t color = A_color_rgba(0.9f, 0.9f, 0.9f, 1.0f);
+    R_AddDebugText2D(R_STATS_OVERLAY_X, R_STATS_OVERLAY_Y,
+                     R_STATS_OVERLAY_SIZE, text, color);
+    R_DrawDebugLines();
+}
+
+static void R_Stats_f(void) {
+    const GfxStats* s = &r_statsGlob.last_frame;
+    Com_Println(CON_DEST_CLIENT, "draw calls:             %u", s->draw_calls);
+    Com_Println(CON_DEST_CLIENT, "triangles:              %u", s->triangles);
+    Com_Println(CON_DEST_CLIENT, "vertices:               %u", s->vertices);
+    Com_Println(CON_DEST_CLIENT, "program binds:          %u", 
+                s->program_binds);
+    Com_Println(CON_DEST_CLIENT, "texture binds:          %u", 
+                s->texture_binds);
+    Com_Println(CON_DEST_CLIENT, "vao binds:              %u", s->vao_binds);
+    Com_Println(CON_DEST_CLIENT, "uniform uploads:        %u", 
+                s->uniform_uploads);
+    Com_Println(CON_DEST_CLIENT, "buffer bytes uploaded:  %llu",
+                (unsigned long long)s->buffer_bytes_uploaded);
+    Com_Println(CON_DEST_CLIENT, "texture bytes resident: %llu",
+                (unsigned long long)s->texture_bytes_resident);
+    Com_Println(CON_DEST_CLIENT, "buffer bytes resident:  %llu",
+                (unsigned long long)s->buffer_bytes_resident);
+}
+
+void R_ShutdownStats(void) {
+    Cmd_RemoveCommand("r_stats");
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "acommon/acommon.h"
+
+#include "com_defs.h"
+
+// Counters are bumped directly by the backend wrappers in gfx.c, gfx_defs.c
+// and gfx_shader.c. They're plain (non-atomic) increments on the render
+// thread, so they're cheap enough to leave in release builds.
+typedef struct GfxStats {
+    uint32_t draw_calls;
+    uint32_t triangles;
+    uint32_t vertices;
+    uint32_t program_binds;
+    uint32_t texture_binds;
+    uint32_t vao_binds;
+    uint32_t uniform_uploads;
+    uint64_t buffer_bytes_uploaded;
+    // Not reset per frame: these track what's currently allocated.
+    uint64_t texture_bytes_resident;
+    uint64_t buffer_bytes_resident;
+} GfxStats;
+
+extern GfxStats r_stats;
+
+A_EXTERN_C void R_InitStats      (void);
+// Snapshots the previous frame's counters and resets them. Must be called
+// once per frame, before anything is drawn.
+A_EXTERN_C void R_BeginStatsFrame(void);
+// The counters for the last completed frame.
+A_EXTERN_C const GfxStats* R_LastFrameStats(void);
+// Draws the last frame's counters in the top-left corner, for r_drawStats.
+A_EXTERN_C void R_DrawStatsOverlay(void);
+A_EXTERN_C void R_ShutdownStats  (void);
@@ -11,6 +11,7 @@
 #include "gfx.h"
 #include "gfx_defs.h"
 #include "gfx_shader.h"
+#include "gfx_timer.h"
 #include "gfx_uniform.h"
 #include "sys.h" 
 
@@ -461,6 +462,7 @@ A_EXTERN_C void R_ClearTextDrawDefs(size_t localClientNum) {
 }
 
 A_EXTERN_C void R_DrawTextDrawDefs(size_t localClientNum) {
+    R_BeginGpuTimer(R_GPU_PASS_TEXT);
 #if !A_TARGET_PLATFORM_IS_XBOX
     for (int i = 0; i < A_countof(r_textDraws); i++) {
         for (int j = 0; j < A_countof(r_textDraws[i]); j++) {
@@ -474,4 +476,5 @@ A_EXTERN_C void R_DrawTextDrawDefs(size_t localClientNum) {
         }
     }
 #endif // !A_TARGET_PLATFORM_IS_XBOX
+    R_EndGpuTimer(R_GPU_PASS_TEXT);
 }
@@ -0,0 +1,222 @@
+#include "gfx_timer.h"
+
+#include <assert.h>
+
+#include "acommon/a_string.h"
+
+#include "com_perf.h"
+#include "com_print.h"
+#include "gfx_defs.h"
+
+A_STATIC_ASSERT(R_GPU_PASS_COUNT ==
+                COM_PERF_PHASE_GPU_WIREFRAME - COM_PERF_PHASE_GPU_FRAME + 1);
+A_STATIC_ASSERT(R_GPU_PASS_CLIENT3 - R_GPU_PASS_CLIENT0 + 1 ==
+                MAX_LOCAL_CLIENTS);
+
+#if A_RENDER_BACKEND_GL
+// Each pass is timed with a pair of GL_TIMESTAMP queries rather than a
+// GL_TIME_ELAPSED query, because only one GL_TIME_ELAPSED query can be
+// active at once and the client passes contain the others.
+typedef struct GfxGpuTimerFrame {
+    GLuint     queries[R_GPU_TIMER_MAX_SPANS * 2];
+    GfxGpuPass passes [R_GPU_TIMER_MAX_SPANS];
+    int        open   [R_GPU_PASS_COUNT];
+    int        span_count;
+    uint64_t   frame;
+    bool       pending;
+} GfxGpuTimerFrame;
+
+typedef struct GfxGpuTimerGlob {
+    bool             available;
+    bool             in_frame;
+    int              current;
+    uint64_t         dropped_frames;
+    uint64_t         dropped_spans;
+    GfxGpuTimerFrame frames[R_GPU_TIMER_FRAMES];
+} GfxGpuTimerGlob;
+static GfxGpuTimerGlob r_gpuTimerGlob;
+
+void R_InitGpuTimers(void) {
+    A_memset(&r_gpuTimerGlob, 0, sizeof(r_gpuTimerGlob));
+
+    // Timer queries are core in 3.3, but check anyway since some drivers
+    // (and software rasterizers) report a 0-bit counter for "unsupported".
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query) {
+        Com_Println(CON_DEST_CLIENT,
+                    "R_InitGpuTimers: timer queries not supported, "
+                    "GPU timings disabled.");
+        return;
+    }
+
+    GLint bits = 0;
+    GL_CALL(glGetQueryiv, GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    if (bits == 0) {
+        Com_Println(CON_DEST_CLIENT,
+                    "R_InitGpuTimers: GL_TIMESTAMP has no counter bits, "
+                    "GPU timings disabled.");
+        return;
+    }
+
+    for (int i = 0; i < R_GPU_TIMER_FRAMES; i++) {
+        GfxGpuTimerFrame* f = &r_gpuTimerGlob.frames[i];
+        GL_CALL(glGenQueries, A_countof(f->queries), f->queries);
+        for (int j = 0; j < R_GPU_PASS_COUNT; j++)
+            f->open[j] = -1;
+    }
+    r_gpuTimerGlob.available = true;
+}
+
+A_NO_DISCARD bool R_GpuTimersAvailable(void) {
+    return r_gpuTimerGlob.available;
+}
+
+// Reads back a frame's results if (and only if) the GPU is already done
+// with them. GL doesn't promise queries become available in the order
+// they were issued, and the spans don't end in the order they began, so
+// every query is checked before any result is read: asking for one that
+// isn't ready would wait for it.
+static void R_CollectGpuTimerFrame(GfxGpuTimerFrame* f) {
+    if (!f->pending)
+        return;
+    f->pending = false;
+
+    for (int i = 0; i < f->span_count * 2; i++) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(f->queries[i], GL_QUERY_RESULT_AVAILABLE,
+                            &available);
+        if (available == GL_FALSE) {
+            r_gpuTimerGlob.dropped_frames++;
+            return;
+        }
+    }
+
+    uint64_t ns[R_GPU_PASS_COUNT];
+    bool     seen[R_GPU_PASS_COUNT];
+    A_memset(ns,   0, sizeof(ns));
+    A_memset(seen, 0, sizeof(seen));
+    for (int i = 0; i < f->span_count; i++) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(f->queries[i * 2],     GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(f->queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+        if (end > begin)
+            ns[f->passes[i]] += end - begin;
+        seen[f->passes[i]] = true;
+    }
+
+    for (int i = 0; i < R_GPU_PASS_COUNT; i++) {
+        if (!seen[i])
+            continue;
+        Com_PerfRecordLate(f->frame,
+                           (ComPerfPhase)(COM_PERF_PHASE_GPU_FRAME + i),
+                           (uint32_t)(ns[i] / 1000));
+    }
+}
+
+void R_BeginGpuTimerFrame(void) {
+    if (!r_gpuTimerGlob.available)
+        return;
+
+    // The oldest pool is about to be reused, so this is the last chance to
+    // read it back.
+    GfxGpuTimerFrame* f = &r_gpuTimerGlob.frames[r_gpuTimerGlob.current];
+    R_CollectGpuTimerFrame(f);
+
+    f->span_count = 0;
+    f->frame      = Com_PerfFrameCount();
+    for (int i = 0; i < R_GPU_PASS_COUNT; i++)
+        f->open[i] = -1;
+
+    r_gpuTimerGlob.in_frame = true;
+    R_BeginGpuTimer(R_GPU_PASS_FRAME);
+}
+
+void R_EndGpuTimerFrame(void) {
+    if (!r_gpuTimerGlob.available || !r_gpuTimerGlob.in_frame)
+        return;
+
+    GfxGpuTimerFrame* f = &r_gpuTimerGlob.frames[r_gpuTimerGlob.current];
+    // Close anything left open so every span has both of its queries.
+    for (int i = 0; i < R_GPU_PASS_COUNT; i++)
+        R_EndGpuTimer((GfxGpuPass)i);
+
+    r_gpuTimerGlob.in_frame = false;
+    f->pending = f->span_count > 0;
+    r_gpuTimerGlob.current = (r_gpuTimerGlob.current + 1) % R_GPU_TIMER_FRAMES;
+}
+
+// glQueryCounter is called directly rather than through GL_CALL, since
+// the glGetError in GL_CALL can force a round trip on threaded drivers.
+void R_BeginGpuTimer(GfxGpuPass pass) {
+    assert(pass < R_GPU_PASS_COUNT);
+    if (!r_gpuTimerGlob.in_frame)
+        return;
+
+    GfxGpuTimerFrame* f = &r_gpuTimerGlob.frames[r_gpuTimerGlob.current];
+    assert(f->open[pass] < 0);
+    if (f->open[pass] >= 0)
+        return;
+
+    if (f->span_count >= R_GPU_TIMER_MAX_SPANS) {
+        r_gpuTimerGlob.dropped_spans++;
+        return;
+    }
+
+    int i = f->span_count++;
+    f->passes[i]  = pass;
+    f->open[pass] = i;
+    glQueryCounter(f->queries[i * 2], GL_TIMESTAMP);
+}
+
+void R_EndGpuTimer(GfxGpuPass pass) {
+    assert(pass < R_GPU_PASS_COUNT);
+    if (!r_gpuTimerGlob.in_frame)
+        return;
+
+    GfxGpuTimerFrame* f = &r_gpuTimerGlob.frames[r_gpuTimerGlob.current];
+    int i = f->open[pass];
+    if (i < 0)
+        return;
+
+    f->open[pass] = -1;
+    glQueryCounter(f->queries[i * 2 + 1], GL_TIMESTAMP);
+}
+
+void R_ShutdownGpuTimers(void) {
+    if (!r_gpuTimerGlob.available)
+        return;
+
+    for (int i = 0; i < R_GPU_TIMER_FRAMES; i++) {
+        GfxGpuTimerFrame* f = &r_gpuTimerGlob.frames[i];
+        GL_CALL(glDeleteQueries, A_countof(f->queries), f->queries);
+    }
+    if (r_gpuTimerGlob.dropped_frames || r_gpuTimerGlob.dropped_spans) {
+        Com_DPrintln(CON_DEST_CLIENT,
+                     "R_ShutdownGpuTimers: %llu frames weren't ready in time, "
+                     "%llu spans didn't fit.",
+                     (unsigned long long)r_gpuTimerGlob.dropped_frames,
+                     (unsigned long long)r_gpuTimerGlob.dropped_spans);
+    }
+    A_memset(&r_gpuTimerGlob, 0, sizeof(r_gpuTimerGlob));
+}
+#else
+// FIXME: D3D9 has D3DQUERYTYPE_TIMESTAMP, D3D8 has nothing equivalent.
+// Until then the GPU phases are simply never recorded.
+void R_InitGpuTimers(void) {}
+
+A_NO_DISCARD bool R_GpuTimersAvailable(void) {
+    return false;
+}
+
+void R_BeginGpuTimerFrame(void) {}
+void R_EndGpuTimerFrame  (void) {}
+
+void R_BeginGpuTimer(GfxGpuPass pass) {
+    A_UNUSED(pass);
+}
+
+void R_EndGpuTimer(GfxGpuPass pass) {
+    A_UNUSED(pass);
+}
+
+void R_ShutdownGpuTimers(void) {}
+#endif // A_RENDER_BACKEND_GL
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "acommon/acommon.h"
+
+#include "com_defs.h"
+
+typedef enum GfxGpuPass {
+    R_GPU_PASS_FRAME,
+    R_GPU_PASS_CLIENT0, // R_GPU_PASS_CLIENT0 + localClientNum
+    R_GPU_PASS_CLIENT1,
+    R_GPU_PASS_CLIENT2,
+    R_GPU_PASS_CLIENT3,
+    R_GPU_PASS_BSP,
+    R_GPU_PASS_TEXT,
+    R_GPU_PASS_WIREFRAME,
+
+    R_GPU_PASS_COUNT
+} GfxGpuPass;
+
+// How many frames of queries are in flight before a pool is reused.
+#define R_GPU_TIMER_FRAMES    3
+// How many begin/end pairs can be recorded per frame.
+#define R_GPU_TIMER_MAX_SPANS 64
+
+A_EXTERN_C void R_InitGpuTimers     (void);
+A_EXTERN_C A_NO_DISCARD bool R_GpuTimersAvailable(void);
+A_EXTERN_C void R_BeginGpuTimerFrame(void);
+A_EXTERN_C void R_EndGpuTimerFrame  (void);
+// Passes can be entered more than once per frame, but a pass can't be
+// nested inside itself.
+A_EXTERN_C void R_BeginGpuTimer     (GfxGpuPass pass);
+A_EXTERN_C void R_EndGpuTimer       (GfxGpuPass pass);
+A_EXTERN_C void R_ShutdownGpuTimers (void);
@@ -2,26 +2,16 @@
 
 #include <assert.h>
 
+#include "acommon/a_atom.h"
 #include "acommon/a_string.h"
 
 #include "com_print.h"
 
-uint32_t R_HashUniformName(const char* name) {
-    assert(name);
-    uint32_t hash = 0;
-    for (uint32_t i = 0; name[i] != '\0'; i++) {
-        char c = A_tolower(name[i]);
-        hash += (uint32_t)c * (i + 119);
-    }
-    return hash;
-}
-
 void R_CreateUniformBool(const char* name, bool value, 
                          A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_BOOL;
@@ -32,8 +22,7 @@ void R_CreateUniformFloat(const char* name, float value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_FLOAT;
@@ -44,8 +33,7 @@ void R_CreateUniformFloatArray(const char* name, const float* value, int count,
                                A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name         = A_cstrdup(name);
-    pUniform->name_hash    = R_HashUniformName(name);
+    pUniform->name         = A_atom(name);
     pUniform->vs_location  = -1;
     pUniform->ps_location  = -1;
     pUniform->type         = UNIFORM_TYPE_FLOAT_ARRAY;
@@ -57,8 +45,7 @@ void R_CreateUniformVec2f(const char* name, avec2f_t value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_VEC2F;
@@ -69,8 +56,7 @@ void R_CreateUniformVec3f(const char* name, avec3f_t value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_VEC3F;
@@ -81,8 +67,7 @@ void R_CreateUniformVec4f(const char* name, avec4f_t value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_VEC4F;
@@ -93,8 +78,7 @@ void R_CreateUniformInt(const char* name, int value,
                         A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_INT;
@@ -105,8 +89,7 @@ void R_CreateUniformIntArray(const char* name, const int* value, int count,
                              A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name         = A_cstrdup(name);
-    pUniform->name_hash    = R_HashUniformName(name);
+    pUniform->name         = A_atom(name);
     pUniform->vs_location  = -1;
     pUniform->ps_location  = -1;
     pUniform->type         = UNIFORM_TYPE_INT_ARRAY;
@@ -118,8 +101,7 @@ void R_CreateUniformVec2i(const char* name, avec2i_t value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_VEC2I;
@@ -130,8 +112,7 @@ void R_CreateUniformVec3i(const char* name, avec3i_t value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_VEC3I;
@@ -142,8 +123,7 @@ void R_CreateUniformVec4i(const char* name, avec4i_t value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_VEC4I;
@@ -154,8 +134,7 @@ void R_CreateUniformUint(const char* name, unsigned int value,
                          A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name        = A_cstrdup(name);
-    pUniform->name_hash   = R_HashUniformName(name);
+    pUniform->name        = A_atom(name);
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        = UNIFORM_TYPE_UINT;
@@ -166,8 +145,7 @@ void R_CreateUniformUintArray(const char* name, const unsigned int* value,
                               int count, A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name         = A_cstrdup(name);
-    pUniform->name_hash    = R_HashUniformName(name);
+    pUniform->name         = A_atom(name);
     pUniform->vs_location  = -1;
     pUniform->ps_location  = -1;
     pUniform->type         = UNIFORM_TYPE_UINT;
@@ -179,8 +157,7 @@ void R_CreateUniformMat2f(const char* name, amat2f_t value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name         = A_cstrdup(name);
-    pUniform->name_hash    = R_HashUniformName(name);
+    pUniform->name         = A_atom(name);
     pUniform->vs_location  = -1;
     pUniform->ps_location  = -1;
     pUniform->type         = UNIFORM_TYPE_MAT2F;
@@ -191,8 +168,7 @@ void R_CreateUniformMat3f(const char* name, amat3f_t value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name         = A_cstrdup(name);
-    pUniform->name_hash    = R_HashUniformName(name);
+    pUniform->name         = A_atom(name);
     pUniform->vs_location  = -1;
     pUniform->ps_location  = -1;
     pUniform->type         = UNIFORM_TYPE_MAT3F;
@@ -203,8 +179,7 @@ void R_CreateUniformMat4f(const char* name, amat4f_t value,
                           A_OUT GfxShaderUniformDef* pUniform
 ) {
 	assert(pUniform);
-    pUniform->name         = A_cstrdup(name);
-    pUniform->name_hash    = R_HashUniformName(name);
+    pUniform->name         = A_atom(name);
     pUniform->vs_location  = -1;
     pUniform->ps_location  = -1;
     pUniform->type         = UNIFORM_TYPE_MAT4F;
@@ -430,11 +405,9 @@ void R_SetUniformMat4f(A_INOUT GfxShaderUniformDef* pUniform, amat4f_t value) {
 
 A_EXTERN_C void R_DeleteUniform(A_IN GfxShaderUniformDef* pUniform) {
     assert(pUniform);
-    A_cstrfree(pUniform->name);
     pUniform->name        =  NULL;
     pUniform->vs_location = -1;
     pUniform->ps_location = -1;
     pUniform->type        =  UNIFORM_TYPE_INVALID;
     pUniform->value.i     =  0;
-    pUniform->name_hash   = -1;
 }
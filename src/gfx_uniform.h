@@ -1,5 +1,7 @@
 #pragma once
 
+#include "acommon/a_atom.h"
+
 #include "gfx_defs.h"
 
 typedef enum GfxUniformType {
@@ -42,15 +44,12 @@ typedef union GfxUniformValue {
 } GfxUniformValue;
 
 typedef struct GfxUniformDef {
-    const char*     name;
-    int             name_hash;
+    aatom_t         name;
     int             vs_location, ps_location;
     GfxUniformType  type;
     GfxUniformValue value;
 } GfxShaderUniformDef;
 
-A_EXTERN_C uint32_t R_HashUniformName(const char* name);
-
 A_EXTERN_C void R_CreateUniformBool(const char* name, bool value, 
                                     A_OUT GfxShaderUniformDef* pUniform);
 A_EXTERN_C void R_CreateUniformFloat(const char* name, float value,
@@ -2,7 +2,12 @@
 
 #include <assert.h>
 
+#include "acommon/a_atomic.h"
+#include "acommon/a_string.h"
+
+#include "cmd_commands.h"
 #include "com_defs.h"
+#include "com_print.h"
 
 #if !A_TARGET_PLATFORM_IS_XBOX
 #include "in_kbm.h"
@@ -11,6 +16,26 @@
 
 static inl_t s_in[MAX_LOCAL_CLIENTS];
 
+#if !A_TARGET_PLATFORM_IS_XBOX
+// Pushes mouse motion onto SDL's queue at a steady rate from a thread of its
+// own, as a stand-in for a real device when measuring input latency. The
+// motion alternates a pixel left and right so the view doesn't drift, and
+// each interval's jittered by up to a quarter so the events don't line up
+// with frames.
+typedef struct INInjector {
+	SysThread*       thread;
+	volatile int32_t stop;
+	volatile int32_t done;
+	int              hz;
+	uint64_t         end;    // by Sys_Microseconds, 0 to run until stopped
+	uint64_t         pushed;
+} INInjector;
+
+static INInjector s_inInject;
+
+static void IN_StopInject(void);
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+
 inl_t* IN_GetLocalClientLocals(size_t localClientNum) {
 	assert(localClientNum < MAX_LOCAL_CLIENTS);
 	return &s_in[localClientNum];
@@ -28,14 +53,120 @@ bool IN_LocalClientHasGPad(size_t localClientNum) {
 	return IN_GetLocalClientLocals(localClientNum)->hasGPad;
 }
 
+void IN_MarkEventTime(size_t localClientNum, uint64_t usec) {
+	inl_t* in = IN_GetLocalClientLocals(localClientNum);
+	if (in->inputTime == 0 || usec < in->inputTime)
+		in->inputTime = usec;
+}
+
+uint64_t IN_TakeEventTime(size_t localClientNum) {
+	inl_t* in = IN_GetLocalClientLocals(localClientNum);
+	uint64_t usec = in->inputTime;
+	in->inputTime = 0;
+	return usec;
+}
+
 void IN_Frame(void) {
 #if !A_TARGET_PLATFORM_IS_XBOX
+	// Report on a timed injection once it's run out.
+	if (s_inInject.thread && A_atomic_load32(&s_inInject.done))
+		IN_StopInject();
+
 	IN_Key_Frame();
 	IN_Mouse_Frame();
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 	IN_GPad_Frame();
 }
 
+#if !A_TARGET_PLATFORM_IS_XBOX
+static int IN_InjectMain(void* arg) {
+	INInjector* inj = (INInjector*)arg;
+	int64_t  period = 1000000 / inj->hz;
+	uint64_t next   = Sys_Microseconds();
+	uint32_t seed   = (uint32_t)next | 1;
+	int      x      = 1;
+	while (!A_atomic_load32(&inj->stop)) {
+		uint64_t now = Sys_Microseconds();
+		if (inj->end != 0 && now >= inj->end)
+			break;
+
+		if (now < next) {
+			// Sleeping overshoots by up to a millisecond, so the last one
+			// is spent yielding.
+			uint64_t wait = next - now;
+			Sys_Sleep(wait > 2000 ? (uint32_t)(wait / 1000) - 1 : 0);
+			continue;
+		}
+
+		SDL_Event ev;
+		A_memset(&ev, 0, sizeof(ev));
+		ev.type        = SDL_MOUSEMOTION;
+		ev.motion.xrel = x;
+		x = -x;
+		if (SDL_PushEvent(&ev) == 1)
+			inj->pushed++;
+
+		seed = seed * 1664525u + 1013904223u;
+		int64_t jitter = (int64_t)(seed >> 8) % (period / 2 + 1) - period / 4;
+		next += (uint64_t)(period + jitter);
+	}
+	A_atomic_store32(&inj->done, 1);
+	return 0;
+}
+
+static void IN_StopInject(void) {
+	if (s_inInject.thread == NULL)
+		return;
+
+	A_atomic_store32(&s_inInject.stop, 1);
+	Sys_JoinThread(s_inInject.thread);
+	s_inInject.thread = NULL;
+	Com_Println(CON_DEST_CLIENT, "in_inject: pushed %llu events at %d Hz.",
+				(unsigned long long)s_inInject.pushed, s_inInject.hz);
+}
+
+static void IN_Inject_f(void) {
+	int hz      = 0;
+	int seconds = 0;
+	if (Cmd_Argc() == 2 && A_cstricmp(Cmd_Argv(1), "stop")) {
+		IN_StopInject();
+		return;
+	}
+	if (Cmd_Argc() < 2 || Cmd_Argc() > 3 ||
+		!A_atoi(Cmd_Argv(1), &hz) || hz < 1 || hz > 10000 ||
+		(Cmd_Argc() == 3 && (!A_atoi(Cmd_Argv(2), &seconds) || seconds < 1))
+	) {
+		Com_Println(CON_DEST_CLIENT, "USAGE: in_inject <hz> [seconds] | stop");
+		return;
+	}
+
+	IN_StopInject();
+	s_inInject.stop   = 0;
+	s_inInject.done   = 0;
+	s_inInject.hz     = hz;
+	s_inInject.pushed = 0;
+	s_inInject.end    = seconds > 0
+		? Sys_Microseconds() + (uint64_t)seconds * 1000000 : 0;
+	s_inInject.thread = Sys_SpawnThread("in_inject", IN_InjectMain,
+										&s_inInject);
+	if (s_inInject.thread == NULL)
+		Com_Println(CON_DEST_CLIENT, "in_inject: couldn't start a thread.");
+}
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+
+void IN_AddCommands(void) {
+#if !A_TARGET_PLATFORM_IS_XBOX
+	Cmd_AddCommand("in_inject", IN_Inject_f);
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+}
+
+void IN_RemoveCommands(void) {
+#if !A_TARGET_PLATFORM_IS_XBOX
+	IN_StopInject();
+	Cmd_RemoveCommand("in_inject");
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+}
+
 void IN_Shutdown(void) {
 #if !A_TARGET_PLATFORM_IS_XBOX
 	IN_Key_Shutdown();
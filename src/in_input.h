@@ -28,6 +28,7 @@ typedef struct inl_t {
 	int          gpad_id;
 	GPadInternal gpad_internal;
 	bool         hasGPad;
+	uint64_t     inputTime; // earliest event not yet taken, 0 if none
 } inl_t;
 
 A_EXTERN_C void   IN_Init                (void);
@@ -35,3 +36,12 @@ A_EXTERN_C inl_t* IN_GetLocalClientLocals(size_t localClientNum);
 A_EXTERN_C bool   IN_LocalClientHasGPad(size_t localClientNum);
 A_EXTERN_C void   IN_Frame               (void);
 A_EXTERN_C void   IN_Shutdown            (void);
+
+// Notes that an input event for the client happened at `usec` (by
+// Sys_Microseconds). IN_TakeEventTime returns the earliest one since it was
+// last called, or 0 if there wasn't one, for measuring input latency.
+A_EXTERN_C void     IN_MarkEventTime(size_t localClientNum, uint64_t usec);
+A_EXTERN_C uint64_t IN_TakeEventTime(size_t localClientNum);
+
+A_EXTERN_C void   IN_AddCommands   (void);
+A_EXTERN_C void   IN_RemoveCommands(void);
@@ -1,14 +1,33 @@
+#include "acommon/a_atom.h"
+#include "acommon/a_math.h"
+#include "acommon/a_string.h"
 #include "acommon/z_mem.h"
 
+#include "cl_map.h"
 #include "com_print.h"
 #include "sys.h"
+#include "vm_vmem.h"
+
+// Atoms are counted with the rest of the VM's memory.
+static void* Com_AtomAlloc(size_t n) {
+    return VM_Alloc(n, VM_ALLOC_ATOM);
+}
+
+static void Com_AtomFree(void* p) {
+    VM_Free(p, VM_ALLOC_ATOM);
+}
 
 #ifdef main
 #undef main
 #endif // main
 int main(int argc, const char** argv) {
     A_UNUSED(argc);
+    A_StringInit();
+    A_MathInit();
+    A_AtomInit(Com_AtomAlloc, Com_AtomFree);
+    Com_EarlyInit();
     Com_Println(CON_DEST_CLIENT, "Running.");  
+    CL_ReserveTagSpace();
     Sys_Init(argv);
     Com_Init();
     Com_DPrintln(CON_DEST_CLIENT, "Running in debug mode.");
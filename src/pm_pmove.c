@@ -5,7 +5,7 @@
 #include "acommon/a_string.h"
 #include "acommon/a_math.h"
 
-#include "gfx_defs.h"
+#include "com_prof.h"
 #include "m_math.h"
 
 pm_t s_pm[MAX_LOCAL_CLIENTS];
@@ -18,7 +18,9 @@ pm_t* PM_GetLocalClientGlobals(size_t localClientNum) {
 void PM_Init(void) {
 	for (size_t i = 0; i < MAX_LOCAL_CLIENTS; i++) {
 		pm_t* pm = PM_GetLocalClientGlobals(i);
-		pm->pm.ps = &pm->ps;
+		pm->pm.ps            = &pm->ps;
+		pm->pm.trace         = CM_TraceSphere;
+		pm->pm.pointcontents = CM_PointContents;
 	}
 }
 
@@ -26,11 +28,7 @@ static void PM_Accelerate(
 	A_INOUT pmove_t* pm, A_INOUT pml_t* pml,
 	avec3f_t wishdir, float wishspeed, float accel
 ) {
-#if A_RENDER_BACKEND_GL
-	float currentspeed = glm_vec3_dot(pm->ps->velocity.array, wishdir.array);
-#elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
-	float currentspeed = D3DXVec3Dot((D3DXVECTOR3*)pm->ps->velocity.array, (D3DXVECTOR3*)wishdir.array);
-#endif // A_RENDER_BACKEND_GL
+	float currentspeed = A_vec3f_dot(pm->ps->velocity, wishdir);
 
 	float addspeed = wishspeed - currentspeed;
 
@@ -41,23 +39,12 @@ static void PM_Accelerate(
 	if (accelspeed > addspeed)
 		accelspeed = addspeed;
 
-#if A_RENDER_BACKEND_GL
-	vec3 velocity;
-	glm_vec3_scale(wishdir.array, accelspeed, velocity);
-	glm_vec3_add(pm->ps->velocity.array, velocity, pm->ps->velocity.array);
-#elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
-	D3DXVECTOR3 velocity;
-	D3DXVec3Scale(&velocity, (D3DXVECTOR3*)wishdir.array, accelspeed);
-	D3DXVec3Add((D3DXVECTOR3*)pm->ps->velocity.array, &velocity, (D3DXVECTOR3*)pm->ps->velocity.array);
-#endif // A_RENDER_BACKEND_GL
+	pm->ps->velocity = A_vec3f_add(pm->ps->velocity,
+	                               A_vec3f_mul(wishdir, accelspeed));
 }
 
-static void PM_NoclipMove(A_INOUT pmove_t* pm, A_INOUT pml_t* pml) {
-#if A_RENDER_BACKEND_GL
-	float speed = glm_vec3_norm(pm->ps->velocity.array);
-#elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
-	float speed = D3DXVec3Length((D3DXVECTOR3*)pm->ps->velocity.array);
-#endif // A_RENDER_BACKEND_GL
+static void PM_FlyAccelerate(A_INOUT pmove_t* pm, A_INOUT pml_t* pml) {
+	float speed = A_vec3f_length(pm->ps->velocity);
 	if (speed < 1.0f) {
 		pm->ps->velocity = A_VEC3F_ZERO;
 	}
@@ -71,65 +58,128 @@ static void PM_NoclipMove(A_INOUT pmove_t* pm, A_INOUT pml_t* pml) {
 			newspeed = 0;
 		newspeed /= speed;
 
-#if A_RENDER_BACKEND_GL
-		vec3 velocity;
-		glm_vec3_scale(pm->ps->velocity.array, newspeed, velocity);
-#elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
-		D3DXVECTOR3 velocity;
-		D3DXVec3Scale(&velocity, (D3DXVECTOR3*)pm->ps->velocity.array, newspeed);
-#endif // A_RENDER_BACKEND_GL
-		pm->ps->velocity = *(avec3f_t*)&velocity;
+		pm->ps->velocity = A_vec3f_mul(pm->ps->velocity, newspeed);
 	}
 
-#if A_RENDER_BACKEND_GL
-	vec3 forward, right;
-	glm_vec3_scale(pml->forward.array, pm->cmd.vel.z, forward);
-	glm_vec3_scale(pml->right.array, pm->cmd.vel.x, right);
-	avec3f_t wishvel;
-	glm_vec3_sub(forward, right, wishvel.array);
-#elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
-	D3DXVECTOR3 forward, right;
-	D3DXVec3Scale(&forward, (D3DXVECTOR3*)pml->forward.array, pm->cmd.vel.z);
-	D3DXVec3Scale(&right, (D3DXVECTOR3*)pml->right.array, pm->cmd.vel.x);
-	avec3f_t wishvel;
-	D3DXVec3Subtract((D3DXVECTOR3*)wishvel.array, &forward, &right);
-#endif // A_RENDER_BACKEND_GL
+	avec3f_t forward = A_vec3f_mul(pml->forward, pm->cmd.vel.z);
+	avec3f_t right   = A_vec3f_mul(pml->right,   pm->cmd.vel.x);
+	avec3f_t wishvel = A_vec3f_sub(forward, right);
 
 	wishvel.y += pm->cmd.vel.y;
 
-	avec3f_t wishdir = wishvel;
-#if A_RENDER_BACKEND_GL
-	glm_vec3_normalize(wishdir.array);
-	float wishspeed = glm_vec3_norm(wishvel.array);
-#elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
-	D3DXVec3Normalize((D3DXVECTOR3*)wishdir.array, (D3DXVECTOR3*)wishdir.array);
-	float wishspeed = D3DXVec3Length((D3DXVECTOR3*)wishvel.array);
-#endif // A_RENDER_BACKEND_GL
+	avec3f_t wishdir   = A_vec3f_normalize(wishvel);
+	float    wishspeed = A_vec3f_length(wishvel);
 	if (A_memcmp(&wishvel, &A_VEC3F_ZERO, sizeof(wishvel))) {
 		wishdir = A_VEC3F_ZERO;
 		wishspeed = 0;
 	}
 
 	PM_Accelerate(pm, pml, wishdir, wishspeed, PM_ACCELERATE);
+}
+
+static void PM_NoclipMove(A_INOUT pmove_t* pm, A_INOUT pml_t* pml) {
+	PM_FlyAccelerate(pm, pml);
 
 	avec3f_t pos = A_vec3(pm->ps->origin.x, pm->ps->origin.y, pm->ps->origin.z);
-#if A_RENDER_BACKEND_GL
-	vec3 velocity;
-	glm_vec3_scale(pm->ps->velocity.array, pml->frametime, velocity);
-	glm_vec3_add(pos.array, velocity, pos.array);
-#elif A_RENDER_BACKEND_D3D9 || A_RENDER_BACKEND_D3D8
-	D3DXVECTOR3 velocity;
-	D3DXVec3Scale(&velocity, (D3DXVECTOR3*)pm->ps->velocity.array, pml->frametime);
-	D3DXVec3Add((D3DXVECTOR3*)pos.array, &velocity, (D3DXVECTOR3*)pos.array);
-#endif // A_RENDER_BACKEND_GL
+	pos = A_vec3f_add(pos, A_vec3f_mul(pm->ps->velocity, pml->frametime));
 	pm->ps->origin.x = pos.x;
 	pm->ps->origin.y = pos.y;
 	pm->ps->origin.z = pos.z;
 
 }
 
+static avec3f_t PM_ClipVelocity(avec3f_t in, avec3f_t normal,
+                                float overbounce
+) {
+	float backoff = A_vec3f_dot(in, normal);
+	if (backoff < 0)
+		backoff *= overbounce;
+	else
+		backoff /= overbounce;
+	return A_vec3f_sub(in, A_vec3f_mul(normal, backoff));
+}
+
+#define PM_MAX_CLIP_PLANES 5
+#define PM_NUM_BUMPS       4
+
+// Moves along the velocity until something's in the way, then along
+// whatever it hit, a few times over.
+static void PM_SlideMove(A_INOUT pmove_t* pm, A_INOUT pml_t* pml) {
+	avec3f_t planes[PM_MAX_CLIP_PLANES];
+	int      numplanes = 0;
+	float    time_left = pml->frametime;
+	for (int bump = 0; bump < PM_NUM_BUMPS && time_left > 0; bump++) {
+		apoint3f_t end;
+		end.x = pm->ps->origin.x + pm->ps->velocity.x * time_left;
+		end.y = pm->ps->origin.y + pm->ps->velocity.y * time_left;
+		end.z = pm->ps->origin.z + pm->ps->velocity.z * time_left;
+
+		CMTrace tr;
+		pm->trace(&tr, pm->ps->origin, end, PM_RADIUS);
+		pm->ps->origin = tr.endpos;
+		if (tr.fraction == 1.0f)
+			break;
+
+		time_left -= time_left * tr.fraction;
+		if (numplanes == PM_MAX_CLIP_PLANES) {
+			pm->ps->velocity = A_VEC3F_ZERO;
+			break;
+		}
+		planes[numplanes++] = tr.normal;
+		pm->ps->velocity =
+			PM_ClipVelocity(pm->ps->velocity, tr.normal, PM_OVERCLIP);
+
+		// Still heading into something it already hit means it's in a
+		// corner: slide along the crease, or stop if that goes into a third.
+		for (int i = 0; i < numplanes - 1; i++) {
+			if (A_vec3f_dot(pm->ps->velocity, planes[i]) >= 0)
+				continue;
+
+			avec3f_t dir = A_vec3f_normalize(
+				A_vec3f_cross(planes[i], tr.normal));
+			pm->ps->velocity =
+				A_vec3f_mul(dir, A_vec3f_dot(dir, pm->ps->velocity));
+			for (int j = 0; j < numplanes - 1; j++) {
+				if (j != i && A_vec3f_dot(pm->ps->velocity, planes[j]) < 0) {
+					pm->ps->velocity = A_VEC3F_ZERO;
+					return;
+				}
+			}
+			break;
+		}
+	}
+}
+
+static void PM_SpectatorMove(A_INOUT pmove_t* pm, A_INOUT pml_t* pml) {
+	PM_FlyAccelerate(pm, pml);
+	PM_SlideMove(pm, pml);
+}
+
+// Nudges the player out if they've ended up inside the world, e.g. by
+// leaving noclip in a wall.
+static void PM_CheckStuck(A_INOUT pmove_t* pm) {
+	if (pm->ps->pm_type == PM_NOCLIP ||
+		pm->pointcontents(pm->ps->origin) != CM_CONTENTS_SOLID)
+		return;
+
+	for (int i = -1; i <= 1; i++) {
+		for (int j = -1; j <= 1; j++) {
+			for (int k = -1; k <= 1; k++) {
+				apoint3f_t p = pm->ps->origin;
+				p.x += i * PM_STUCK_NUDGE;
+				p.y += j * PM_STUCK_NUDGE;
+				p.z += k * PM_STUCK_NUDGE;
+				if (pm->pointcontents(p) == CM_CONTENTS_EMPTY) {
+					pm->ps->origin = p;
+					return;
+				}
+			}
+		}
+	}
+}
+
 void PM_UpdateViewAngles(A_INOUT playerState_t* ps, const usercmd_t* cmd) {
-	if (ps->pm_type != PM_NOCLIP)
+	if (ps->pm_type != PM_NOCLIP && ps->pm_type != PM_SPECTATOR)
 		return;
 
 	ps->viewyaw += ps->deltayaw + cmd->yaw;
@@ -160,6 +210,8 @@ void PmoveSingle(A_INOUT pmove_t* pm, A_INOUT pml_t* pml) {
 
 	if (pm->ps->pm_type == PM_NOCLIP) {
 		PM_NoclipMove(pm, pml);
+	} else if (pm->ps->pm_type == PM_SPECTATOR) {
+		PM_SpectatorMove(pm, pml);
 	}
 
 	A_memset(&pm->cmd, 0, sizeof(pm->cmd));
@@ -172,6 +224,8 @@ void Pmove(A_INOUT pmove_t* pm, A_INOUT pml_t* pml) {
 		return;
 	}
 
+	COM_PROF_BEGIN("Pmove");
+
 	if (finalTime > pm->ps->commandTime + 1000) {
 		pm->ps->commandTime = finalTime - 1000;
 	}
@@ -192,5 +246,6 @@ void Pmove(A_INOUT pmove_t* pm, A_INOUT pml_t* pml) {
 		}
 	}
 
-	//PM_CheckStuck();
+	PM_CheckStuck(pm);
+	COM_PROF_END();
 }
\ No newline at end of file
@@ -1,9 +1,11 @@
 #include "acommon/a_math.h"
 
+#include "cm_trace.h"
 #include "com_defs.h"
 
 typedef enum pmType_t {
 	PM_NOCLIP,
+	PM_SPECTATOR, // flies like noclip, but slides along the world
 } pmType_t;
 
 typedef enum pmFlags_t {
@@ -32,6 +34,11 @@ typedef struct usercmd_t {
 typedef struct pmove_t {
 	playerState_t* ps;
 	usercmd_t      cmd;
+
+	// Collision, so pmove doesn't care where it comes from.
+	void       (*trace)(A_OUT CMTrace* tr, apoint3f_t start, apoint3f_t end,
+	                    float radius);
+	CMContents (*pointcontents)(apoint3f_t p);
 } pmove_t;
 
 typedef struct pml_t {
@@ -49,6 +56,9 @@ typedef struct pm_t {
 #define PM_FRICTION     6.0f
 #define PM_STOPSPEED  100.0f
 #define PM_ACCELERATE  10.0f
+#define PM_RADIUS       0.2f
+#define PM_OVERCLIP     1.001f
+#define PM_STUCK_NUDGE  0.25f
 
 A_EXTERN_C pm_t* PM_GetLocalClientGlobals(size_t localClientNum);
 A_EXTERN_C void  PM_Init    (void);
@@ -2,16 +2,32 @@
 
 #include <stdio.h>
 
+#if A_TARGET_PLATFORM_IS_XBOX
+#include <Xtl.h>
+#elif A_TARGET_OS_IS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#include <sys/resource.h>
+#endif // A_TARGET_PLATFORM_IS_XBOX
+
 #include "acommon/a_string.h"
+#include "acommon/z_mem.h"
 
 #include "cl_client.h"
 #include "devcon.h"
 #include "dvar.h"
 #include "gfx.h"
 #include "in_input.h"
+#include "vm_vmem.h"
 
 #if !A_TARGET_PLATFORM_IS_XBOX
 SDLGlob sys_sdlGlob;
+
+static bool s_headless;
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 
 dvar_t* vid_xpos;
@@ -32,11 +48,25 @@ static bool   Sys_CreateThread(
 );
 */
 
-void Sys_Init(const char** argv) {
-    A_UNUSED(argv);
+#if !A_TARGET_PLATFORM_IS_XBOX
+static bool Sys_WantHeadless(const char** argv) {
+    for (size_t i = 1; argv && argv[0] && argv[i]; i++) {
+        if (A_cstrcmp(argv[i], "-headless"))
+            return true;
+    }
+
+    const char* env = SDL_getenv("AERA_HEADLESS");
+    return env && *env && !A_cstrcmp(env, "0");
+}
+#endif // !A_TARGET_PLATFORM_IS_XBOX
 
+void Sys_Init(const char** argv) {
 #if !A_TARGET_PLATFORM_IS_XBOX
-    int i = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER);
+    // Without a window there's no need for video, which would want a
+    // display, or for gamepads.
+    s_headless = Sys_WantHeadless(argv);
+    int i = SDL_Init(s_headless ? SDL_INIT_EVENTS
+                                : SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER);
     assert(i == 0);
     if (i < 0) {
         fprintf(stderr, "Sys_Init: Failed to initialize SDL: %s", SDL_GetError());
@@ -64,26 +94,31 @@ void Sys_Init(const char** argv) {
         "vid_height", DVAR_FLAG_NONE, VID_HEIGHT_DEFAULT, 1, INT_MAX);
 
 #if !A_TARGET_PLATFORM_IS_XBOX
-    sys_sdlGlob.window = SDL_CreateWindow(
-        "Aera",
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        Dvar_GetInt(vid_width),
-        Dvar_GetInt(vid_height),
-        SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE
-    );
+    int x = 0, y = 0;
+    if (!s_headless) {
+        sys_sdlGlob.window = SDL_CreateWindow(
+            "Aera",
+            SDL_WINDOWPOS_UNDEFINED,
+            SDL_WINDOWPOS_UNDEFINED,
+            Dvar_GetInt(vid_width),
+            Dvar_GetInt(vid_height),
+            SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE
+        );
+        SDL_GetWindowPosition(sys_sdlGlob.window, &x, &y);
+    }
 
-    int x, y;
-    SDL_GetWindowPosition(sys_sdlGlob.window, &x, &y);
     vid_xpos = Dvar_RegisterInt("vid_xpos", DVAR_FLAG_NONE, x, 0, INT_MAX);
     vid_ypos = Dvar_RegisterInt("vid_ypos", DVAR_FLAG_NONE, y, 0, INT_MAX);
-    SDL_SetRelativeMouseMode(SDL_TRUE);
+    if (!s_headless) {
+        SDL_SetRelativeMouseMode(SDL_TRUE);
 
-    if (sys_sdlGlob.window == NULL) {
-        printf("Could not create window: %s\n", SDL_GetError());
-        Sys_NormalExit(-2);
+        if (sys_sdlGlob.window == NULL) {
+            printf("Could not create window: %s\n", SDL_GetError());
+            Sys_NormalExit(-2);
+        }
     }
 #else
+    A_UNUSED(argv);
     vid_xpos = Dvar_RegisterInt("vid_xpos", DVAR_FLAG_NONE, 0, 0, INT_MAX);
     vid_ypos = Dvar_RegisterInt("vid_ypos", DVAR_FLAG_NONE, 0, 0, INT_MAX);
 #endif // !A_TARGET_PLATFORM_IS_XBOX
@@ -101,9 +136,32 @@ void Sys_Init(const char** argv) {
 // Returns true if an event was handled, false if not 
 // (most likely, if event queue was empty).
 #if !A_TARGET_PLATFORM_IS_XBOX
+// SDL stamps events in msec by SDL_GetTicks, so this rebases one onto
+// Sys_Microseconds by how long ago it was. It's only good to the msec.
+static uint64_t Sys_EventTime(const SDL_Event* ev) {
+    uint64_t age = (uint64_t)(SDL_GetTicks() - ev->common.timestamp) * 1000;
+    uint64_t now = Sys_Microseconds();
+    return now > age ? now - age : 1;
+}
+
 bool Sys_HandleEvent(void) {
     SDL_Event ev;
     if (SDL_PollEvent(&ev)) {
+        switch (ev.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_MOUSEMOTION:
+            IN_MarkEventTime(CL_ClientWithKbmFocus(), Sys_EventTime(&ev));
+            break;
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP:
+        case SDL_CONTROLLERAXISMOTION:
+            IN_MarkEventTime(0, Sys_EventTime(&ev));
+            break;
+        }
+
         switch (ev.type) {
         case SDL_KEYDOWN:
             if (ev.key.keysym.sym == SDLK_ESCAPE) {
@@ -234,6 +292,167 @@ uint64_t Sys_Milliseconds(void) {
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 }
 
+// Reads the high-resolution counter and converts it to `units` per second.
+// The conversion is split so count * units can't overflow.
+static uint64_t Sys_PerformanceCounterIn(uint64_t units) {
+#if !A_TARGET_PLATFORM_IS_XBOX
+    uint64_t count = SDL_GetPerformanceCounter();
+    uint64_t freq  = SDL_GetPerformanceFrequency();
+#else
+    LARGE_INTEGER li;
+    BOOL b = QueryPerformanceCounter(&li);
+    assert(b != FALSE);
+    uint64_t count = li.QuadPart - s_timeBase;
+    uint64_t freq  = s_counterFreq;
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+    return (count / freq) * units + (count % freq) * units / freq;
+}
+
+uint64_t Sys_Microseconds(void) {
+    return Sys_PerformanceCounterIn(1000000);
+}
+
+uint64_t Sys_Nanoseconds(void) {
+    return Sys_PerformanceCounterIn(1000000000);
+}
+
+uint64_t Sys_ThreadId(void) {
+#if !A_TARGET_PLATFORM_IS_XBOX
+    return (uint64_t)SDL_ThreadID();
+#else
+    return (uint64_t)GetCurrentThreadId();
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+}
+
+void Sys_Sleep(uint32_t ms) {
+#if !A_TARGET_PLATFORM_IS_XBOX
+    SDL_Delay(ms);
+#else
+    Sleep(ms);
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+}
+
+uint32_t Sys_CpuCount(void) {
+#if !A_TARGET_PLATFORM_IS_XBOX
+    int n = SDL_GetCPUCount();
+    return n > 0 ? (uint32_t)n : 1;
+#else
+    return 1;
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+}
+
+uint64_t Sys_ResidentBytes(void) {
+#if A_TARGET_PLATFORM_IS_XBOX
+    // Nothing else runs on the console, so everything in use is ours.
+    MEMORYSTATUS ms;
+    GlobalMemoryStatus(&ms);
+    return (uint64_t)(ms.dwTotalPhys - ms.dwAvailPhys);
+#elif A_TARGET_OS_IS_WINDOWS
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return (uint64_t)pmc.WorkingSetSize;
+#else
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f)
+        return 0;
+
+    unsigned long long size = 0, resident = 0;
+    int n = fscanf(f, "%llu %llu", &size, &resident);
+    fclose(f);
+    if (n != 2)
+        return 0;
+    return (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE);
+#endif // A_TARGET_PLATFORM_IS_XBOX
+}
+
+bool Sys_PageFaults(A_OUT SysPageFaults* faults) {
+    faults->minor = 0;
+    faults->major = 0;
+#if A_TARGET_PLATFORM_IS_XBOX
+    // There's no paging on the console.
+    return false;
+#elif A_TARGET_OS_IS_WINDOWS
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return false;
+    faults->minor = (uint64_t)pmc.PageFaultCount;
+    return true;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return false;
+    faults->minor = (uint64_t)usage.ru_minflt;
+    faults->major = (uint64_t)usage.ru_majflt;
+    return true;
+#endif // A_TARGET_PLATFORM_IS_XBOX
+}
+
+typedef struct SysThreadStart {
+    int (*f)(void*);
+    void* arg;
+} SysThreadStart;
+
+// Every spawned thread runs through here, so whatever it took from the
+// scratch pool goes back once `f` returns.
+static int Sys_RunThread(void* data) {
+    SysThreadStart start = *(SysThreadStart*)data;
+    Z_Free(data);
+    int ret = start.f(start.arg);
+    VM_ScratchThreadExit();
+    return ret;
+}
+
+#if A_TARGET_PLATFORM_IS_XBOX
+static DWORD WINAPI Sys_ThreadStart(LPVOID data) {
+    return (DWORD)Sys_RunThread(data);
+}
+#endif // A_TARGET_PLATFORM_IS_XBOX
+
+A_NO_DISCARD SysThread* Sys_SpawnThread(const char* name,
+                                        int (*f)(void*), void* arg
+) {
+    assert(f);
+    SysThreadStart* start = (SysThreadStart*)Z_Alloc(sizeof(*start));
+    if (!start)
+        return NULL;
+
+    start->f   = f;
+    start->arg = arg;
+#if !A_TARGET_PLATFORM_IS_XBOX
+    SDL_Thread* t = SDL_CreateThread(Sys_RunThread, name, start);
+    if (t == NULL) {
+        Z_Free(start);
+        return NULL;
+    }
+    return (SysThread*)t;
+#else
+    A_UNUSED(name);
+    HANDLE h = CreateThread(NULL, 0, Sys_ThreadStart, start, 0, NULL);
+    if (h == NULL) {
+        Z_Free(start);
+        return NULL;
+    }
+    return (SysThread*)h;
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+}
+
+int Sys_JoinThread(SysThread* thread) {
+    assert(thread);
+    int ret = 0;
+#if !A_TARGET_PLATFORM_IS_XBOX
+    SDL_WaitThread((SDL_Thread*)thread, &ret);
+#else
+    HANDLE h = (HANDLE)thread;
+    WaitForSingleObject(h, INFINITE);
+    DWORD code = 0;
+    if (GetExitCodeThread(h, &code))
+        ret = (int)code;
+    CloseHandle(h);
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+    return ret;
+}
+
 #if !A_TARGET_PLATFORM_IS_XBOX
 SDL_Thread* sys_hThreads[32];
 #endif // !A_TARGET_PLATFORM_IS_XBOX
@@ -312,6 +531,14 @@ void Sys_ShutdownThreads(void) {
 //     A_memset(&sys_argv, 0, sizeof(sys_argv));
 // }
 
+bool Sys_Headless(void) {
+#if !A_TARGET_PLATFORM_IS_XBOX
+    return s_headless;
+#else
+    return false;
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+}
+
 A_NO_RETURN Sys_Exit(int ec) {
     A_exit(ec);
 }
@@ -324,7 +551,8 @@ void Sys_Shutdown(void) {
     //Sys_ShutdownCmdline();
     IN_Shutdown();
 #if !A_TARGET_PLATFORM_IS_XBOX
-    SDL_DestroyWindow(sys_sdlGlob.window);
+    if (sys_sdlGlob.window)
+        SDL_DestroyWindow(sys_sdlGlob.window);
     SDL_Quit();
 #endif // !A_TARGET_PLATFORM_IS_XBOX
 }
@@ -34,6 +34,11 @@ extern dvar_t*     vid_xpos;
 extern dvar_t*     vid_ypos;
 
 A_EXTERN_C void Sys_Init          (const char** argv);
+// Whether to run without a window, rendering offscreen instead, so the GL
+// build can run where there's no display (CI, build agents). Set with
+// `-headless` on the command line, or AERA_HEADLESS in the environment
+// set to anything but 0. Console commands can be piped in on stdin.
+A_EXTERN_C A_NO_DISCARD bool Sys_Headless(void);
 #if !A_TARGET_PLATFORM_IS_XBOX
 A_EXTERN_C bool Sys_HandleEvent   (void);
 #endif // A_TARGET_PLATFORM_IS_XBOX
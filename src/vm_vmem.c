@@ -2,95 +2,409 @@
 
 #include <assert.h>
 
+#include "acommon/a_atomic.h"
 #include "acommon/a_string.h"
 #include "acommon/z_mem.h"
 
+#include "cmd_commands.h"
+#include "com_defs.h"
 #include "com_print.h"
 
+#if Z_TRACE_ENABLED
+// The definitions below are the real thing, and the allocator's own heap
+// use isn't interesting: VM_*Traced already reported the caller.
+#undef VM_Alloc
+#undef VM_Zalloc
+#undef VM_AllocAt
+#undef VM_ArenaAlloc
+#undef VM_ArenaZalloc
+#undef Z_Alloc
+#undef Z_Zalloc
+#undef Z_Realloc
+#endif // Z_TRACE_ENABLED
+
+// Every VM_Alloc block starts with a header saying what it is, so VM_Free
+// needs neither a lookup nor a lock. Small blocks come out of slabs and are
+// recycled through a per-thread cache, with a locked central free list per
+// size class behind it. Large blocks go straight to the heap, which does
+// its own locking.
+//
+// Fixed-address allocations can't have a header, so they're tracked in an
+// open-addressing hash table keyed by pointer, with linear probing and
+// backward-shift deletion, so there are no tombstones to clean up. The
+// table doubles whenever it gets half full, and is guarded by a spinlock.
+// There's only ever a handful of them.
+typedef struct VmBlockHeader {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t size_class; // VM_LARGE_CLASS if not from a slab
+    size_t   n;
+} VmBlockHeader;
+
+#define VM_HEADER_SIZE                                                        \
+    ((sizeof(VmBlockHeader) + VM_ARENA_ALIGNMENT - 1) &                       \
+     ~(size_t)(VM_ARENA_ALIGNMENT - 1))
+
+#define VM_LIVE_MAGIC  0x564D4C56 // "VMLV"
+#define VM_FREED_MAGIC 0x564D4644 // "VMFD"
+
+// Block sizes, header included, are 32 << size_class.
+#define VM_SMALL_CLASS_COUNT 5
+#define VM_SMALL_MAX_BLOCK   (32 << (VM_SMALL_CLASS_COUNT - 1))
+#define VM_LARGE_CLASS       0xFFFF
+#define VM_SLAB_SIZE         (64 * 1024)
+// A thread's cache for a size class holds up to VM_CACHE_MAX blocks, and
+// moves them to and from the central list VM_CACHE_BATCH at a time.
+#define VM_CACHE_BATCH       32
+#define VM_CACHE_MAX         (VM_CACHE_BATCH * 2)
+
+A_STATIC_ASSERT(VM_CACHE_MAX > VM_CACHE_BATCH);
+
 typedef struct VmAllocation {
-    void*       p;
+    void*       p; // NULL if the slot is empty
     size_t      n;
     VmAllocType type;
 } VmAllocation;
 
-static VmAllocation s_allocs[VM_MAX_ALLOCATIONS];
-static size_t       s_totalAllocForType[VM_ALLOC_COUNT];
-static size_t       s_totalAlloc;
+#define VM_MIN_TABLE_BITS 10
 
-void VM_Init(void) {
-    A_memset(s_allocs, 0, sizeof(s_allocs));
-    A_memset(s_totalAllocForType, 0, sizeof(s_totalAllocForType));
-    s_totalAlloc = 0;
+typedef struct VmSlab VmSlab;
+struct VmSlab {
+    VmSlab* next;
+};
+
+#define VM_SLAB_HEADER_SIZE                                                   \
+    ((sizeof(VmSlab) + VM_ARENA_ALIGNMENT - 1) &                              \
+     ~(size_t)(VM_ARENA_ALIGNMENT - 1))
+
+typedef struct VmSizeClass {
+    volatile int32_t lock;
+    void*            free; // linked through the first word after the header
+    size_t           free_count;
+    VmSlab*          slabs;
+    size_t           slab_count;
+} VmSizeClass;
+
+typedef struct VmGlob {
+    volatile int32_t table_lock;
+    VmAllocation*    allocs;
+    uint32_t         bits;
+    size_t           capacity; // 1 << bits
+    size_t           count;
+    VmSizeClass      classes[VM_SMALL_CLASS_COUNT];
+    // Updated atomically, read without synchronization.
+    VmAllocStats     stats[VM_ALLOC_COUNT];
+    VmAllocStats     total;
+} VmGlob;
+static VmGlob s_vm;
+
+// Only ever touched by the thread it belongs to.
+typedef struct VmThreadCache {
+    void*   free  [VM_SMALL_CLASS_COUNT];
+    int32_t counts[VM_SMALL_CLASS_COUNT];
+} VmThreadCache;
+static A_THREAD_LOCAL VmThreadCache s_vmCache;
+
+static void VM_Bench_f(void);
+static void VM_Frame_f(void);
+static void VM_Stress_f(void);
+static void VM_Contention_f(void);
+static void VM_InitFrame(void);
+static void VM_ShutdownFrame(void);
+
+static size_t VM_HashPointer(const void* p, uint32_t bits) {
+    // Fibonacci hashing of the pointer folded down to 32 bits. The low bits
+    // of a heap pointer are always zero, but the multiply pushes the bits
+    // that do vary up into the top of the word, which is what gets used.
+    uint64_t x = (uint64_t)(uintptr_t)p;
+    uint32_t h = (uint32_t)(x ^ (x >> 32)) * 2654435769u;
+    return (size_t)(h >> (32 - bits));
 }
 
-static VmAllocation* VM_FindFreeAlloction(void) {
-    for (int i = 0; i < A_countof(s_allocs); i++) {
-        VmAllocation* a = &s_allocs[i];
-        if (a->p == NULL)
-            return a;
+static void VM_InsertAllocation(VmAllocation* allocs, uint32_t bits,
+                                const VmAllocation* a
+) {
+    size_t mask = ((size_t)1 << bits) - 1;
+    size_t i    = VM_HashPointer(a->p, bits);
+    while (allocs[i].p != NULL) {
+        assert(allocs[i].p != a->p);
+        i = (i + 1) & mask;
     }
+    allocs[i] = *a;
+}
 
-    return NULL;
+static bool VM_ResizeTable(uint32_t bits) {
+    size_t capacity = (size_t)1 << bits;
+    VmAllocation* allocs = (VmAllocation*)Z_Zalloc(capacity * sizeof(*allocs));
+    assert(allocs);
+    if (!allocs)
+        return false;
+
+    for (size_t i = 0; i < s_vm.capacity; i++) {
+        if (s_vm.allocs[i].p != NULL)
+            VM_InsertAllocation(allocs, bits, &s_vm.allocs[i]);
+    }
+
+    Z_Free(s_vm.allocs);
+    s_vm.allocs   = allocs;
+    s_vm.bits     = bits;
+    s_vm.capacity = capacity;
+    return true;
+}
+
+void VM_Init(void) {
+    A_memset(&s_vm, 0, sizeof(s_vm));
+    A_memset(&s_vmCache, 0, sizeof(s_vmCache));
+    bool b = VM_ResizeTable(VM_MIN_TABLE_BITS);
+    assert(b);
+    (void)b;
+    VM_InitFrame();
+    Cmd_AddCommand("vm_bench",      VM_Bench_f);
+    Cmd_AddCommand("vm_frame",      VM_Frame_f);
+    Cmd_AddCommand("vm_stress",     VM_Stress_f);
+    Cmd_AddCommand("vm_contention", VM_Contention_f);
 }
 
-static VmAllocation* VM_FindAllocForPointer(void* p) {
+static VmAllocation* VM_FindAllocForPointer(const void* p) {
     assert(p);
-    for (int i = 0; i < A_countof(s_allocs); i++) {
-        VmAllocation* a = &s_allocs[i];
-        if (a->p == p)
-            return a;
+    size_t mask = s_vm.capacity - 1;
+    size_t i    = VM_HashPointer(p, s_vm.bits);
+    while (s_vm.allocs[i].p != NULL) {
+        if (s_vm.allocs[i].p == p)
+            return &s_vm.allocs[i];
+        i = (i + 1) & mask;
     }
     assert(false && "pointer not found");
 
     return NULL;
 }
 
-A_NO_DISCARD void* VM_Alloc(size_t n, VmAllocType type) {
-    void* p = Z_Alloc(n);
-    assert(p);
-    assert((size_t)p != 0xDDDDDDDD);
-    assert((size_t)p != 0xDDDDDDE1);
-    VmAllocation* a = VM_FindFreeAlloction();
-    assert(a);
-    a->p = p;
-    a->n = n;
-    a->type = type;
+static void VM_RaisePeak(VmAllocStats* s, size_t bytes) {
+    size_t peak = A_atomic_load_size(&s->peak_bytes);
+    while (bytes > peak && !A_atomic_cas_size(&s->peak_bytes, peak, bytes))
+        peak = A_atomic_load_size(&s->peak_bytes);
+}
 
-    s_totalAlloc += n;
-    s_totalAllocForType[type] += n;
+static void VM_AddStats(size_t n, VmAllocType type) {
+    VmAllocStats* stats[2];
+    stats[0] = &s_vm.stats[type];
+    stats[1] = &s_vm.total;
+    for (int i = 0; i < A_countof(stats); i++) {
+        VmAllocStats* s = stats[i];
+        size_t bytes = A_atomic_fetch_add_size(&s->bytes, n) + n;
+        A_atomic_fetch_add_size(&s->count, 1);
+        A_atomic_fetch_add_size(&s->total_allocs, 1);
+        VM_RaisePeak(s, bytes);
+    }
+}
 
-    return p;
+static void VM_SubStats(size_t n, size_t count, VmAllocType type) {
+    A_atomic_fetch_add_size(&s_vm.stats[type].bytes, (size_t)0 - n);
+    A_atomic_fetch_add_size(&s_vm.stats[type].count, (size_t)0 - count);
+    A_atomic_fetch_add_size(&s_vm.total.bytes,       (size_t)0 - n);
+    A_atomic_fetch_add_size(&s_vm.total.count,       (size_t)0 - count);
 }
 
-A_NO_DISCARD void* VM_Zalloc(size_t n, VmAllocType type) {
-    void* p = Z_Zalloc(n);
-    assert(p);
-    assert((size_t)p != 0xDDDDDDDD);
-    assert((size_t)p != 0xDDDDDDE1);
-    VmAllocation* a = VM_FindFreeAlloction();
-    assert(a);
-    a->p = p;
-    a->n = n;
-    a->type = type;
+static bool VM_TrackAlloc(void* p, size_t n, VmAllocType type) {
+    assert(type < VM_ALLOC_COUNT);
+    A_spin_lock(&s_vm.table_lock);
+    if ((s_vm.count + 1) * 2 > s_vm.capacity) {
+        if (!VM_ResizeTable(s_vm.bits + 1)) {
+            A_spin_unlock(&s_vm.table_lock);
+            return false;
+        }
+    }
+
+    VmAllocation a;
+    a.p    = p;
+    a.n    = n;
+    a.type = type;
+    VM_InsertAllocation(s_vm.allocs, s_vm.bits, &a);
+    s_vm.count++;
+    A_spin_unlock(&s_vm.table_lock);
+
+    VM_AddStats(n, type);
+    return true;
+}
+
+// Removes `a` from the table by shifting back any later entries in its
+// probe sequence that would otherwise become unreachable. Must be called
+// with the table locked.
+static void VM_UntrackAlloc(VmAllocation* a) {
+    VM_SubStats(a->n, 1, a->type);
+    s_vm.count--;
+
+    size_t mask = s_vm.capacity - 1;
+    size_t i    = (size_t)(a - s_vm.allocs);
+    size_t j    = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (s_vm.allocs[j].p == NULL)
+            break;
+
+        size_t k = VM_HashPointer(s_vm.allocs[j].p, s_vm.bits);
+        if (A_HashSlotBetween(k, i, j))
+            continue;
+
+        s_vm.allocs[i] = s_vm.allocs[j];
+        i = j;
+    }
+    s_vm.allocs[i].p    = NULL;
+    s_vm.allocs[i].n    = 0;
+    s_vm.allocs[i].type = VM_ALLOC_UNKNOWN;
+}
+
+static void** VM_NextFree(void* block) {
+    return (void**)((char*)block + VM_HEADER_SIZE);
+}
+
+static int VM_SizeClass(size_t block_size) {
+    int c = 0;
+    while (((size_t)32 << c) < block_size)
+        c++;
+    return c;
+}
+
+// Fills the calling thread's (empty) cache for size class `c` with up to
+// VM_CACHE_BATCH blocks from the central list, carving a new slab if the
+// central list is empty.
+static bool VM_RefillCache(VmThreadCache* cache, int c) {
+    VmSizeClass* sc = &s_vm.classes[c];
+    size_t block_size = (size_t)32 << c;
+
+    A_spin_lock(&sc->lock);
+    if (sc->free == NULL) {
+        VmSlab* slab = (VmSlab*)Z_Alloc(VM_SLAB_SIZE);
+        if (!slab) {
+            A_spin_unlock(&sc->lock);
+            return false;
+        }
+        slab->next = sc->slabs;
+        sc->slabs  = slab;
+        sc->slab_count++;
 
-    s_totalAlloc += n;
-    s_totalAllocForType[type] += n;
+        // Carve back to front so the list hands out ascending addresses.
+        char*  base   = (char*)slab + VM_SLAB_HEADER_SIZE;
+        size_t blocks = (VM_SLAB_SIZE - VM_SLAB_HEADER_SIZE) / block_size;
+        for (size_t i = blocks; i-- > 0;) {
+            void* block = base + i * block_size;
+            ((VmBlockHeader*)block)->magic = VM_FREED_MAGIC;
+            *VM_NextFree(block) = sc->free;
+            sc->free = block;
+        }
+        sc->free_count += blocks;
+    }
+
+    void*   head  = sc->free;
+    void*   tail  = head;
+    int32_t taken = 1;
+    while (taken < VM_CACHE_BATCH && *VM_NextFree(tail) != NULL) {
+        tail = *VM_NextFree(tail);
+        taken++;
+    }
+    sc->free        = *VM_NextFree(tail);
+    sc->free_count -= (size_t)taken;
+    A_spin_unlock(&sc->lock);
+
+    *VM_NextFree(tail) = cache->free[c];
+    cache->free[c]     = head;
+    cache->counts[c]  += taken;
+    return true;
+}
+
+// Hands the first `count` blocks in the calling thread's cache for size
+// class `c` back to the central list.
+static void VM_DrainCache(VmThreadCache* cache, int c, int32_t count) {
+    if (count <= 0 || cache->free[c] == NULL)
+        return;
+
+    void*   head = cache->free[c];
+    void*   tail = head;
+    int32_t n    = 1;
+    while (n < count && *VM_NextFree(tail) != NULL) {
+        tail = *VM_NextFree(tail);
+        n++;
+    }
+    cache->free[c]    = *VM_NextFree(tail);
+    cache->counts[c] -= n;
+
+    VmSizeClass* sc = &s_vm.classes[c];
+    A_spin_lock(&sc->lock);
+    *VM_NextFree(tail) = sc->free;
+    sc->free           = head;
+    sc->free_count    += (size_t)n;
+    A_spin_unlock(&sc->lock);
+}
+
+void VM_FlushThreadCache(void) {
+    for (int c = 0; c < VM_SMALL_CLASS_COUNT; c++)
+        VM_DrainCache(&s_vmCache, c, s_vmCache.counts[c]);
+}
+
+static VmBlockHeader* VM_AllocBlock(size_t n, VmAllocType type) {
+    assert(type < VM_ALLOC_COUNT);
+    if (type >= VM_ALLOC_COUNT)
+        return NULL;
+
+    VmBlockHeader* h = NULL;
+    size_t block_size = VM_HEADER_SIZE + n;
+    if (block_size < n) {
+        return NULL;
+    } else if (block_size <= VM_SMALL_MAX_BLOCK) {
+        int c = VM_SizeClass(block_size);
+        VmThreadCache* cache = &s_vmCache;
+        if (cache->free[c] == NULL && !VM_RefillCache(cache, c))
+            return NULL;
+
+        h = (VmBlockHeader*)cache->free[c];
+        cache->free[c] = *VM_NextFree(h);
+        cache->counts[c]--;
+        assert(h->magic == VM_FREED_MAGIC);
+        h->size_class = (uint16_t)c;
+    } else {
+        h = (VmBlockHeader*)Z_Alloc(block_size);
+        if (!h)
+            return NULL;
+        h->size_class = VM_LARGE_CLASS;
+    }
 
+    h->magic = VM_LIVE_MAGIC;
+    h->type  = (uint16_t)type;
+    h->n     = n;
+    VM_AddStats(n, type);
+    return h;
+}
+
+A_NO_DISCARD void* VM_Alloc(size_t n, VmAllocType type) {
+    VmBlockHeader* h = VM_AllocBlock(n, type);
+    assert(h);
+    if (!h)
+        return NULL;
+
+    return (char*)h + VM_HEADER_SIZE;
+}
+
+A_NO_DISCARD void* VM_Zalloc(size_t n, VmAllocType type) {
+    VmBlockHeader* h = VM_AllocBlock(n, type);
+    assert(h);
+    if (!h)
+        return NULL;
+
+    void* p = (char*)h + VM_HEADER_SIZE;
+    A_memset(p, 0, n);
     return p;
 }
 
 A_NO_DISCARD void* VM_AllocAt(const void* p, size_t n, VmAllocType type) {
+    // Fails if something else is mapped there, which the caller reports.
     p = Z_AllocAt(p, n);
-    assert(p);
-    VmAllocation* a = VM_FindFreeAlloction();
-    assert(a);
-    a->p = (void*)p;
-    a->n = n;
-    a->type = type;
-
-    s_totalAlloc += n;
-    s_totalAllocForType[type] += n;
+    if (!p)
+        return NULL;
 
+    if (!VM_TrackAlloc((void*)p, n, type)) {
+        Z_FreeAt(p, n);
+        return NULL;
+    }
     return (void*)p;
 }
 
@@ -100,63 +414,911 @@ bool VM_Free(void* p, VmAllocType type) {
     if (p == NULL)
         return true;
 
-    VmAllocation* a = VM_FindAllocForPointer(p);
-    assert(a);
-    if (a == NULL) {
-        Com_Errorln(-1, "VM_Free: Attempt to free pointer %p not allocated by VM_Alloc.", p);
+    VmBlockHeader* h = (VmBlockHeader*)((char*)p - VM_HEADER_SIZE);
+    assert(h->magic == VM_LIVE_MAGIC);
+    if (h->magic != VM_LIVE_MAGIC) {
+        Com_Errorln(-1, "VM_Free: Attempt to free pointer %p not allocated by VM_Alloc (or already freed).", p);
         return false;
     }
-    assert(a->type == type);
-    if (a->type != type) {
+    assert(h->type == type);
+    if (h->type != type) {
         Com_Errorln(-1, "VM_Free: alloc type mismatch.", p);
         return false;
     }
 
-    Z_Free(p);
-    s_totalAllocForType[a->type] -= a->n;
-    s_totalAlloc -= a->n;
-    a->p = NULL;
-    a->n = 0;
-    a->type = VM_ALLOC_UNKNOWN;
+    VM_SubStats(h->n, 1, type);
+    h->magic = VM_FREED_MAGIC;
+    if (h->size_class == VM_LARGE_CLASS) {
+        Z_Free(h);
+        return true;
+    }
+
+    int c = h->size_class;
+    VmThreadCache* cache = &s_vmCache;
+    *VM_NextFree(h)  = cache->free[c];
+    cache->free[c]   = h;
+    cache->counts[c]++;
+    if (cache->counts[c] > VM_CACHE_MAX)
+        VM_DrainCache(cache, c, VM_CACHE_BATCH);
     return true;
 }
 
 bool VM_FreeAt(void* p, VmAllocType type) {
     assert((size_t)p != 0xDDDDDDDD);
     assert((size_t)p != 0xDDDDDDE1);
+    A_spin_lock(&s_vm.table_lock);
     VmAllocation* a = VM_FindAllocForPointer(p);
     assert(a);
     if (a == NULL) {
+        A_spin_unlock(&s_vm.table_lock);
         Com_Errorln(-1, "VM_Free: Attempt to free pointer %p not allocated by VM_Alloc.", p);
         return false;
     }
     assert(a->type == type);
     if (a->type != type) {
+        A_spin_unlock(&s_vm.table_lock);
         Com_Errorln(-1, "VM_Free: alloc type mismatch.", p);
         return false;
     }
 
-    Z_FreeAt(p, a->n);
-    s_totalAllocForType[a->type] -= a->n;
-    s_totalAlloc                 -= a->n;
-    a->p                          = NULL;
-    a->n                          = 0;
-    a->type                       = VM_ALLOC_UNKNOWN;
+    size_t n = a->n;
+    VM_UntrackAlloc(a);
+    A_spin_unlock(&s_vm.table_lock);
+    Z_FreeAt(p, n);
     return true;
 }
 
+const VmAllocStats* VM_GetAllocStats(VmAllocType type) {
+    assert(type < VM_ALLOC_COUNT);
+    return &s_vm.stats[type];
+}
+
+const VmAllocStats* VM_GetTotalAllocStats(void) {
+    return &s_vm.total;
+}
+
+static const char* s_vmAllocTypeNames[VM_ALLOC_COUNT] = {
+    "unknown",
+    "bsp",
+    "model",
+    "bitmap",
+    "dvar",
+    "tag_data",
+    "file",
+    "font",
+    "devgui",
+    "map",
+    "atom",
+    "collision",
+    "bvh",
+    "demo",
+    "capture",
+    "shader",
+};
+
+const char* VM_AllocTypeName(VmAllocType type) {
+    assert(type < VM_ALLOC_COUNT);
+    if (type >= VM_ALLOC_COUNT)
+        return "invalid";
+    return s_vmAllocTypeNames[type];
+}
+
+struct VmArenaChunk {
+    VmArenaChunk* next;
+    size_t        size; // usable bytes after the header
+    size_t        used;
+};
+
+#define VM_ARENA_HEADER_SIZE                                                  \
+    ((sizeof(VmArenaChunk) + VM_ARENA_ALIGNMENT - 1) &                        \
+     ~(size_t)(VM_ARENA_ALIGNMENT - 1))
+
+static char* VM_ArenaChunkData(VmArenaChunk* chunk) {
+    return (char*)chunk + VM_ARENA_HEADER_SIZE;
+}
+
+void VM_ArenaInit(A_OUT VmArena* arena, size_t chunk_size) {
+    assert(arena);
+    assert(chunk_size > 0);
+    A_memset(arena, 0, sizeof(*arena));
+    arena->chunk_size = chunk_size;
+}
+
+static VmArenaChunk* VM_ArenaNewChunk(VmArena* arena, size_t size) {
+    VmArenaChunk* chunk = 
+        (VmArenaChunk*)Z_Alloc(VM_ARENA_HEADER_SIZE + size);
+    assert(chunk);
+    if (!chunk)
+        return NULL;
+
+    chunk->size      = size;
+    chunk->used      = 0;
+    arena->reserved += VM_ARENA_HEADER_SIZE + size;
+    return chunk;
+}
+
+A_NO_DISCARD void* VM_ArenaAlloc(A_INOUT VmArena* arena, 
+                                 size_t n, VmAllocType type
+) {
+    assert(arena);
+    assert(arena->chunk_size > 0);
+    assert(type < VM_ALLOC_COUNT);
+
+    size_t aligned = (n + VM_ARENA_ALIGNMENT - 1) & 
+                     ~(size_t)(VM_ARENA_ALIGNMENT - 1);
+    if (aligned == 0)
+        aligned = VM_ARENA_ALIGNMENT;
+
+    char* p = NULL;
+    VmArenaChunk* head = arena->chunks;
+    if (head && head->size - head->used >= aligned) {
+        p = VM_ArenaChunkData(head) + head->used;
+        head->used += aligned;
+    } else if (aligned > arena->chunk_size / 4) {
+        // Big allocations get a chunk of their own, linked in behind the
+        // current one so its free space isn't thrown away.
+        VmArenaChunk* chunk = VM_ArenaNewChunk(arena, aligned);
+        if (!chunk)
+            return NULL;
+
+        chunk->used = aligned;
+        if (head) {
+            chunk->next = head->next;
+            head->next  = chunk;
+        } else {
+            chunk->next   = NULL;
+            arena->chunks = chunk;
+        }
+        p = VM_ArenaChunkData(chunk);
+    } else {
+        VmArenaChunk* chunk = VM_ArenaNewChunk(arena, arena->chunk_size);
+        if (!chunk)
+            return NULL;
+
+        chunk->used   = aligned;
+        chunk->next   = head;
+        arena->chunks = chunk;
+        p = VM_ArenaChunkData(chunk);
+    }
+
+    arena->bytes[type] += n;
+    arena->counts[type]++;
+
+    VM_AddStats(n, type);
+    return p;
+}
+
+A_NO_DISCARD void* VM_ArenaZalloc(A_INOUT VmArena* arena, 
+                                  size_t n, VmAllocType type
+) {
+    void* p = VM_ArenaAlloc(arena, n, type);
+    if (p)
+        A_memset(p, 0, n);
+    return p;
+}
+
+void VM_ArenaReset(A_INOUT VmArena* arena) {
+    assert(arena);
+    VmArenaChunk* chunk = arena->chunks;
+    while (chunk) {
+        VmArenaChunk* next = chunk->next;
+        Z_Free(chunk);
+        chunk = next;
+    }
+
+    for (int i = 0; i < VM_ALLOC_COUNT; i++) {
+        if (arena->counts[i] > 0)
+            VM_SubStats(arena->bytes[i], arena->counts[i], (VmAllocType)i);
+    }
+
+    size_t chunk_size = arena->chunk_size;
+    A_memset(arena, 0, sizeof(*arena));
+    arena->chunk_size = chunk_size;
+}
+
+#if Z_TRACE_ENABLED
+A_NO_DISCARD void* VM_AllocTraced(size_t n, VmAllocType type,
+                                  const char* file, int line
+) {
+    Z_Trace(file, line, n, (int)type);
+    return VM_Alloc(n, type);
+}
+
+A_NO_DISCARD void* VM_ZallocTraced(size_t n, VmAllocType type,
+                                   const char* file, int line
+) {
+    Z_Trace(file, line, n, (int)type);
+    return VM_Zalloc(n, type);
+}
+
+A_NO_DISCARD void* VM_AllocAtTraced(const void* p, size_t n, VmAllocType type,
+                                    const char* file, int line
+) {
+    Z_Trace(file, line, n, (int)type);
+    return VM_AllocAt(p, n, type);
+}
+
+A_NO_DISCARD void* VM_ArenaAllocTraced(A_INOUT VmArena* arena,
+                                       size_t n, VmAllocType type,
+                                       const char* file, int line
+) {
+    Z_Trace(file, line, n, (int)type);
+    return VM_ArenaAlloc(arena, n, type);
+}
+
+A_NO_DISCARD void* VM_ArenaZallocTraced(A_INOUT VmArena* arena,
+                                        size_t n, VmAllocType type,
+                                        const char* file, int line
+) {
+    Z_Trace(file, line, n, (int)type);
+    return VM_ArenaZalloc(arena, n, type);
+}
+#endif // Z_TRACE_ENABLED
+
+// Heap blocks for frame and scratch allocations that didn't fit. They're
+// kept in a list so they can be freed along with the buffer they spilled
+// out of.
+typedef struct VmSpill VmSpill;
+struct VmSpill {
+    VmSpill* next;
+};
+
+#define VM_SPILL_HEADER_SIZE                                                  \
+    ((sizeof(VmSpill) + VM_ARENA_ALIGNMENT - 1) &                             \
+     ~(size_t)(VM_ARENA_ALIGNMENT - 1))
+
+static void* VM_Spill(VmSpill** list, size_t n) {
+    VmSpill* spill = (VmSpill*)Z_Alloc(VM_SPILL_HEADER_SIZE + n);
+    assert(spill);
+    if (!spill)
+        return NULL;
+
+    spill->next = *list;
+    *list       = spill;
+    return (char*)spill + VM_SPILL_HEADER_SIZE;
+}
+
+// Frees spills until `until` is at the head of the list.
+static void VM_FreeSpills(VmSpill** list, VmSpill* until) {
+    while (*list != until) {
+        VmSpill* next = (*list)->next;
+        Z_Free(*list);
+        *list = next;
+    }
+}
+
+static size_t VM_AlignUp(size_t n) {
+    return (n + VM_ARENA_ALIGNMENT - 1) & ~(size_t)(VM_ARENA_ALIGNMENT - 1);
+}
+
+typedef struct VmFrameBuffer {
+    char*    base;
+    size_t   used;
+    VmSpill* spills;
+} VmFrameBuffer;
+
+typedef struct VmFrameGlob {
+    VmFrameBuffer buffers[2];
+    int           current;
+    size_t        last_used;       // by the last completed frame
+    size_t        high_water;
+    uint32_t      last_spills;     // by the last completed frame
+    uint32_t      spills;          // this frame
+    uint64_t      total_spills;
+    uint32_t      heap_calls_base; // Z_HeapCalls() when the frame began
+    uint32_t      last_heap_calls; // by the last completed frame
+    uint32_t      max_heap_calls;
+} VmFrameGlob;
+static VmFrameGlob s_vmFrame;
+
+static void VM_InitFrame(void) {
+    A_memset(&s_vmFrame, 0, sizeof(s_vmFrame));
+    for (int i = 0; i < A_countof(s_vmFrame.buffers); i++) {
+        s_vmFrame.buffers[i].base = (char*)Z_Alloc(VM_FRAME_SIZE);
+        assert(s_vmFrame.buffers[i].base);
+    }
+    s_vmFrame.heap_calls_base = Z_HeapCalls();
+}
+
+void VM_BeginFrame(void) {
+    VmFrameBuffer* cur = &s_vmFrame.buffers[s_vmFrame.current];
+    uint32_t heap_calls = Z_HeapCalls();
+    s_vmFrame.last_used       = cur->used;
+    s_vmFrame.last_spills     = s_vmFrame.spills;
+    s_vmFrame.last_heap_calls = heap_calls - s_vmFrame.heap_calls_base;
+    if (s_vmFrame.last_heap_calls > s_vmFrame.max_heap_calls)
+        s_vmFrame.max_heap_calls = s_vmFrame.last_heap_calls;
+
+    // The other buffer was last used two frames ago, so nothing can still
+    // be referencing it.
+    s_vmFrame.current = !s_vmFrame.current;
+    VmFrameBuffer* next = &s_vmFrame.buffers[s_vmFrame.current];
+    VM_FreeSpills(&next->spills, NULL);
+    next->used       = 0;
+    s_vmFrame.spills = 0;
+
+    // Freeing the spills counts too, but it belongs to the frame that made
+    // them.
+    s_vmFrame.heap_calls_base = Z_HeapCalls();
+}
+
+A_NO_DISCARD void* VM_FrameAlloc(size_t n) {
+    VmFrameBuffer* cur = &s_vmFrame.buffers[s_vmFrame.current];
+    size_t aligned = VM_AlignUp(n);
+    if (cur->base && VM_FRAME_SIZE - cur->used >= aligned) {
+        void* p = cur->base + cur->used;
+        cur->used += aligned;
+        if (cur->used > s_vmFrame.high_water)
+            s_vmFrame.high_water = cur->used;
+        return p;
+    }
+
+    s_vmFrame.spills++;
+    s_vmFrame.total_spills++;
+    return VM_Spill(&cur->spills, n);
+}
+
+A_NO_DISCARD void* VM_FrameZalloc(size_t n) {
+    void* p = VM_FrameAlloc(n);
+    if (p)
+        A_memset(p, 0, n);
+    return p;
+}
+
+A_NO_DISCARD char* VM_FrameStrndup(const char* s, size_t n) {
+    char* t = (char*)VM_FrameAlloc(n + 1);
+    if (!t)
+        return NULL;
+
+    A_memcpy(t, s, n);
+    t[n] = '\0';
+    return t;
+}
+
+A_NO_DISCARD char* VM_FrameStrdup(const char* s) {
+    return VM_FrameStrndup(s, A_cstrlen(s));
+}
+
+static void VM_ShutdownFrame(void) {
+    for (int i = 0; i < A_countof(s_vmFrame.buffers); i++) {
+        VM_FreeSpills(&s_vmFrame.buffers[i].spills, NULL);
+        Z_Free(s_vmFrame.buffers[i].base);
+    }
+    A_memset(&s_vmFrame, 0, sizeof(s_vmFrame));
+}
+
+// Scratch stacks are pooled: a thread claims a free one the first time it
+// needs scratch and hands it back from VM_ScratchThreadExit, so threads
+// spawned per job (like the BVH builders on every map load) reuse the same
+// buffers rather than each pinning a new one. A stack is only ever touched
+// by the thread holding it, apart from vm_frame reading the (word-sized)
+// stats and VM_Shutdown freeing them once every other thread has been
+// joined.
+typedef struct VmScratch {
+    volatile int32_t in_use;
+    uint64_t         tid;
+    char*            base;
+    size_t           used;
+    size_t           high_water;
+    uint32_t         spills;
+    VmSpill*         spill_list;
+} VmScratch;
+
+static void* volatile   s_vmScratch[VM_SCRATCH_MAX_THREADS];
+static A_THREAD_LOCAL VmScratch* s_vmThreadScratch;
+static A_THREAD_LOCAL VmScratch  s_vmRejectedScratch;
+
+// Takes a stack another thread handed back, or creates one in an empty
+// slot. NULL if every slot's held.
+static VmScratch* VM_ClaimScratch(void) {
+    for (int i = 0; i < VM_SCRATCH_MAX_THREADS; i++) {
+        VmScratch* s = (VmScratch*)A_atomic_load_ptr(&s_vmScratch[i]);
+        if (s && A_atomic_cas32(&s->in_use, 0, 1))
+            return s;
+    }
+
+    VmScratch* s = (VmScratch*)Z_Zalloc(sizeof(*s));
+    if (!s)
+        return NULL;
+
+    s->base = (char*)Z_Alloc(VM_SCRATCH_SIZE);
+    if (!s->base) {
+        Z_Free(s);
+        return NULL;
+    }
+
+    s->in_use = 1;
+    for (int i = 0; i < VM_SCRATCH_MAX_THREADS; i++) {
+        if (A_atomic_cas_ptr(&s_vmScratch[i], NULL, s))
+            return s;
+    }
+
+    Z_Free(s->base);
+    Z_Free(s);
+    return NULL;
+}
+
+static VmScratch* VM_GetScratch(void) {
+    if (s_vmThreadScratch)
+        return s_vmThreadScratch;
+
+    VmScratch* s = VM_ClaimScratch();
+    // Too many threads: everything this thread allocates spills.
+    if (!s)
+        s = &s_vmRejectedScratch;
+    s->tid            = Sys_ThreadId();
+    s_vmThreadScratch = s;
+    return s;
+}
+
+void VM_ScratchThreadExit(void) {
+    VmScratch* s = s_vmThreadScratch;
+    if (!s)
+        return;
+
+    // Anything still marked is leaked by the thread, so take it back.
+    assert(s->used == 0);
+    s->used = 0;
+    VM_FreeSpills(&s->spill_list, NULL);
+    s_vmThreadScratch = NULL;
+    if (s != &s_vmRejectedScratch)
+        A_atomic_store32(&s->in_use, 0);
+}
+
+A_NO_DISCARD VmScratchMark VM_ScratchMark(void) {
+    VmScratch* s = VM_GetScratch();
+    VmScratchMark mark;
+    mark.used  = s->used;
+    mark.spill = s->spill_list;
+    return mark;
+}
+
+A_NO_DISCARD void* VM_ScratchAlloc(size_t n) {
+    VmScratch* s = VM_GetScratch();
+    size_t aligned = VM_AlignUp(n);
+    if (s->base && VM_SCRATCH_SIZE - s->used >= aligned) {
+        void* p = s->base + s->used;
+        s->used += aligned;
+        if (s->used > s->high_water)
+            s->high_water = s->used;
+        return p;
+    }
+
+    s->spills++;
+    return VM_Spill(&s->spill_list, n);
+}
+
+A_NO_DISCARD void* VM_ScratchZalloc(size_t n) {
+    void* p = VM_ScratchAlloc(n);
+    if (p)
+        A_memset(p, 0, n);
+    return p;
+}
+
+void VM_ScratchRelease(VmScratchMark mark) {
+    VmScratch* s = VM_GetScratch();
+    // Releasing a mark that's already been released (or belongs to 
+    // another thread) would corrupt the stack.
+    assert(mark.used <= s->used);
+    if (mark.used > s->used)
+        return;
+
+    s->used = mark.used;
+    VM_FreeSpills(&s->spill_list, (VmSpill*)mark.spill);
+}
+
+static void VM_ShutdownScratch(void) {
+    for (int i = 0; i < VM_SCRATCH_MAX_THREADS; i++) {
+        VmScratch* s = (VmScratch*)A_atomic_exchange_ptr(&s_vmScratch[i], 
+                                                          NULL);
+        if (!s)
+            continue;
+
+        assert(s->used == 0);
+        VM_FreeSpills(&s->spill_list, NULL);
+        Z_Free(s->base);
+        Z_Free(s);
+    }
+    s_vmThreadScratch = NULL;
+}
+
+void VM_GetHeapInfo(A_OUT VmHeapInfo* info) {
+    assert(info);
+    A_memset(info, 0, sizeof(*info));
+    for (int c = 0; c < VM_SMALL_CLASS_COUNT; c++) {
+        VmSizeClass* sc = &s_vm.classes[c];
+        A_spin_lock(&sc->lock);
+        info->slab_bytes      += sc->slab_count * VM_SLAB_SIZE;
+        info->slab_free_bytes += sc->free_count * ((size_t)32 << c);
+        A_spin_unlock(&sc->lock);
+        info->slab_free_bytes += (size_t)s_vmCache.counts[c] *
+                                 ((size_t)32 << c);
+    }
+
+    for (int i = 0; i < A_countof(s_vmFrame.buffers); i++) {
+        if (s_vmFrame.buffers[i].base)
+            info->frame_bytes += VM_FRAME_SIZE;
+    }
+
+    for (int i = 0; i < VM_SCRATCH_MAX_THREADS; i++) {
+        if (A_atomic_load_ptr(&s_vmScratch[i]))
+            info->scratch_bytes += VM_SCRATCH_SIZE;
+    }
+}
+
+static void VM_Frame_f(void) {
+    Com_Println(CON_DEST_CLIENT,
+                "frame: %zu / %d KiB used last frame, high water %zu KiB, "
+                "%u spills last frame (%llu total)",
+                s_vmFrame.last_used / 1024, VM_FRAME_SIZE / 1024,
+                s_vmFrame.high_water / 1024, s_vmFrame.last_spills,
+                (unsigned long long)s_vmFrame.total_spills);
+    Com_Println(CON_DEST_CLIENT,
+                "heap calls: %u last frame, %u max",
+                s_vmFrame.last_heap_calls, s_vmFrame.max_heap_calls);
+
+    for (int i = 0; i < VM_SCRATCH_MAX_THREADS; i++) {
+        VmScratch* s = (VmScratch*)A_atomic_load_ptr(&s_vmScratch[i]);
+        if (!s)
+            continue;
+
+        // High water and spills are over every thread that's held it.
+        if (A_atomic_load32(&s->in_use)) {
+            Com_Println(CON_DEST_CLIENT,
+                        "scratch %d (thread %llu): high water %zu / %d KiB, "
+                        "%u spills",
+                        i, (unsigned long long)s->tid, s->high_water / 1024,
+                        VM_SCRATCH_SIZE / 1024, s->spills);
+        } else {
+            Com_Println(CON_DEST_CLIENT,
+                        "scratch %d (free): high water %zu / %d KiB, "
+                        "%u spills",
+                        i, s->high_water / 1024, VM_SCRATCH_SIZE / 1024,
+                        s->spills);
+        }
+    }
+}
+
+#define VM_BENCH_DEFAULT_PAIRS 100000
+
+// Times `pairs` alloc/free pairs twice: interleaved, which keeps the table
+// small, and as `pairs` allocs followed by `pairs` frees, which grows the
+// table and is closer to what a map load does.
+static void VM_Bench_f(void) {
+    int pairs = VM_BENCH_DEFAULT_PAIRS;
+    if (Cmd_Argc() > 1 && (!A_atoi(Cmd_Argv(1), &pairs) || pairs < 1)) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: vm_bench [pairs]");
+        return;
+    }
+
+    void** ptrs = (void**)Z_Alloc((size_t)pairs * sizeof(*ptrs));
+    if (!ptrs) {
+        Com_Println(CON_DEST_CLIENT, "vm_bench: out of memory.");
+        return;
+    }
+
+    uint64_t start = Sys_Nanoseconds();
+    for (int i = 0; i < pairs; i++) {
+        void* p = VM_Alloc(16 + (size_t)(i & 255) * 16, VM_ALLOC_UNKNOWN);
+        VM_Free(p, VM_ALLOC_UNKNOWN);
+    }
+    uint64_t interleaved = Sys_Nanoseconds() - start;
+
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < pairs; i++)
+        ptrs[i] = VM_Alloc(16 + (size_t)(i & 255) * 16, VM_ALLOC_UNKNOWN);
+    uint64_t alloc_all = Sys_Nanoseconds() - start;
+
+    start = Sys_Nanoseconds();
+    for (int i = 0; i < pairs; i++)
+        VM_Free(ptrs[i], VM_ALLOC_UNKNOWN);
+    uint64_t free_all = Sys_Nanoseconds() - start;
+
+    Z_Free(ptrs);
+
+    Com_Println(CON_DEST_CLIENT,
+                "vm_bench: %d interleaved pairs: %.3f ms (%.1f ns/pair)",
+                pairs, interleaved / 1e6, (double)interleaved / pairs);
+    Com_Println(CON_DEST_CLIENT,
+                "vm_bench: %d allocs then frees: %.3f ms + %.3f ms "
+                "(%.1f ns/alloc, %.1f ns/free)",
+                pairs, alloc_all / 1e6, free_all / 1e6,
+                (double)alloc_all / pairs, (double)free_all / pairs);
+    for (int c = 0; c < VM_SMALL_CLASS_COUNT; c++) {
+        VmSizeClass* sc = &s_vm.classes[c];
+        A_spin_lock(&sc->lock);
+        size_t slabs = sc->slab_count, free_count = sc->free_count;
+        A_spin_unlock(&sc->lock);
+        Com_Println(CON_DEST_CLIENT,
+                    "vm_bench: %d-byte blocks: %zu slabs, %zu blocks free "
+                    "centrally, %d cached on this thread.",
+                    32 << c, slabs, free_count, s_vmCache.counts[c]);
+    }
+}
+
+#define VM_TEST_MAX_THREADS         16
+#define VM_STRESS_DEFAULT_THREADS   4
+#define VM_STRESS_DEFAULT_OPS       200000
+#define VM_STRESS_SLOTS             256
+#define VM_STRESS_MAILBOX_SLOTS     64
+#define VM_STRESS_MIN_SIZE          8
+
+typedef struct VmStressThread {
+    uint32_t   rng;
+    int        ops;
+    SysThread* thread;
+    void*      slots[VM_STRESS_SLOTS];
+} VmStressThread;
+
+// Threads trade blocks through the mailbox, so that plenty of them get
+// freed by a different thread than the one that allocated them.
+static void* volatile   s_vmStressMailbox[VM_STRESS_MAILBOX_SLOTS];
+static volatile int32_t s_vmStressErrors;
+
+static uint32_t VM_StressRand(uint32_t* rng) {
+    // xorshift32
+    uint32_t x = *rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *rng = x;
+    return x;
+}
+
+static unsigned char VM_StressFill(size_t n) {
+    return (unsigned char)(n * 31 + 7);
+}
+
+// Blocks record their type in the first byte and their size in the next
+// four, and are filled with a pattern derived from the size after that, so
+// a block handed out twice or freed early shows up as a mismatch.
+static void* VM_StressAlloc(uint32_t* rng) {
+    uint32_t    r    = VM_StressRand(rng);
+    VmAllocType type = (VmAllocType)((r >> 24) % VM_ALLOC_COUNT);
+    size_t      n    = VM_STRESS_MIN_SIZE + (r >> 4) % 480;
+    if ((r & 15) == 0)
+        n += 1024 + (size_t)VM_StressRand(rng) % (64 * 1024);
+
+    unsigned char* p = (unsigned char*)VM_Alloc(n, type);
+    if (!p) {
+        A_atomic_fetch_add32(&s_vmStressErrors, 1);
+        return NULL;
+    }
+
+    uint32_t n32 = (uint32_t)n;
+    p[0] = (unsigned char)type;
+    A_memcpy(p + 1, &n32, sizeof(n32));
+    A_memset(p + 5, VM_StressFill(n), n - 5);
+    return p;
+}
+
+static void VM_StressFree(void* block) {
+    unsigned char* p = (unsigned char*)block;
+    uint32_t n32 = 0;
+    A_memcpy(&n32, p + 1, sizeof(n32));
+    unsigned char fill = VM_StressFill(n32);
+    for (uint32_t i = 5; i < n32; i++) {
+        if (p[i] != fill) {
+            A_atomic_fetch_add32(&s_vmStressErrors, 1);
+            break;
+        }
+    }
+    if (!VM_Free(p, (VmAllocType)p[0]))
+        A_atomic_fetch_add32(&s_vmStressErrors, 1);
+}
+
+static int VM_StressThreadMain(void* data) {
+    VmStressThread* t = (VmStressThread*)data;
+    for (int i = 0; i < t->ops; i++) {
+        uint32_t r    = VM_StressRand(&t->rng);
+        void**   slot = &t->slots[r % VM_STRESS_SLOTS];
+        if (*slot == NULL) {
+            *slot = VM_StressAlloc(&t->rng);
+        } else if (((r >> 8) & 7) == 0) {
+            void* other = A_atomic_exchange_ptr(
+                &s_vmStressMailbox[(r >> 12) % VM_STRESS_MAILBOX_SLOTS], *slot
+            );
+            *slot = NULL;
+            if (other)
+                VM_StressFree(other);
+        } else {
+            VM_StressFree(*slot);
+            *slot = NULL;
+        }
+    }
+
+    for (int i = 0; i < VM_STRESS_SLOTS; i++) {
+        if (t->slots[i])
+            VM_StressFree(t->slots[i]);
+        t->slots[i] = NULL;
+    }
+    VM_FlushThreadCache();
+    return 0;
+}
+
+// Hammers VM_Alloc and VM_Free from several threads at once, with
+// cross-thread frees, then checks that nothing was corrupted and that
+// every per-type counter is back exactly where it started.
+static void VM_Stress_f(void) {
+    int threads = VM_STRESS_DEFAULT_THREADS;
+    int ops     = VM_STRESS_DEFAULT_OPS;
+    if ((Cmd_Argc() > 1 && (!A_atoi(Cmd_Argv(1), &threads) ||
+                            threads < 1 || threads > VM_TEST_MAX_THREADS)) ||
+        (Cmd_Argc() > 2 && (!A_atoi(Cmd_Argv(2), &ops) || ops < 1))
+    ) {
+        Com_Println(CON_DEST_CLIENT, "USAGE: vm_stress [threads (1-%d)] [ops]",
+                    VM_TEST_MAX_THREADS);
+        return;
+    }
+
+    VmStressThread* t = (VmStressThread*)Z_Zalloc(threads * sizeof(*t));
+    if (!t) {
+        Com_Println(CON_DEST_CLIENT, "vm_stress: out of memory.");
+        return;
+    }
+
+    size_t bytes[VM_ALLOC_COUNT], counts[VM_ALLOC_COUNT];
+    for (int i = 0; i < VM_ALLOC_COUNT; i++) {
+        bytes[i]  = A_atomic_load_size(&s_vm.stats[i].bytes);
+        counts[i] = A_atomic_load_size(&s_vm.stats[i].count);
+    }
+    A_atomic_store32(&s_vmStressErrors, 0);
+
+    uint64_t start = Sys_Nanoseconds();
+    for (int i = 0; i < threads; i++) {
+        t[i].rng    = 2654435769u * (uint32_t)(i + 1);
+        t[i].ops    = ops;
+        t[i].thread = Sys_SpawnThread("vm_stress", VM_StressThreadMain, &t[i]);
+        // Still worth running, just with less contention.
+        if (!t[i].thread)
+            VM_StressThreadMain(&t[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        if (t[i].thread)
+            Sys_JoinThread(t[i].thread);
+    }
+    for (int i = 0; i < VM_STRESS_MAILBOX_SLOTS; i++) {
+        void* p = A_atomic_exchange_ptr(&s_vmStressMailbox[i], NULL);
+        if (p)
+            VM_StressFree(p);
+    }
+    uint64_t elapsed = Sys_Nanoseconds() - start;
+    Z_Free(t);
+
+    int32_t errors = A_atomic_load32(&s_vmStressErrors);
+    for (int i = 0; i < VM_ALLOC_COUNT; i++) {
+        size_t b = A_atomic_load_size(&s_vm.stats[i].bytes);
+        size_t c = A_atomic_load_size(&s_vm.stats[i].count);
+        if (b != bytes[i] || c != counts[i]) {
+            Com_Println(CON_DEST_CLIENT,
+                        "vm_stress: type %d: %zu bytes in %zu allocations, "
+                        "expected %zu in %zu.", i, b, c, bytes[i], counts[i]);
+            errors++;
+        }
+    }
+
+    Com_Println(CON_DEST_CLIENT,
+                "vm_stress: %d threads x %d ops in %.3f ms: %s (%d errors).",
+                threads, ops, elapsed / 1e6, errors ? "FAILED" : "passed",
+                errors);
+}
+
+#define VM_CONTENTION_DEFAULT_THREADS 4
+#define VM_CONTENTION_DEFAULT_PAIRS   200000
+#define VM_CONTENTION_BATCH           64
+
+typedef struct VmContentionThread {
+    int                     pairs;
+    size_t                  n;
+    const volatile int32_t* go;
+    SysThread*              thread;
+} VmContentionThread;
+
+static int VM_ContentionThreadMain(void* data) {
+    VmContentionThread* t = (VmContentionThread*)data;
+    void* ptrs[VM_CONTENTION_BATCH];
+    while (A_atomic_load32(t->go) == 0)
+        ;
+
+    for (int i = 0; i < t->pairs; i += VM_CONTENTION_BATCH) {
+        int batch = t->pairs - i < VM_CONTENTION_BATCH ?
+                    t->pairs - i : VM_CONTENTION_BATCH;
+        for (int j = 0; j < batch; j++)
+            ptrs[j] = VM_Alloc(t->n, VM_ALLOC_UNKNOWN);
+        for (int j = 0; j < batch; j++)
+            VM_Free(ptrs[j], VM_ALLOC_UNKNOWN);
+    }
+    VM_FlushThreadCache();
+    return 0;
+}
+
+// Runs `pairs` alloc/free pairs per thread (in batches, so the thread
+// caches actually have to go to the central lists) on 1, 2, 4, ...
+// threads at once, for a small and a large size, and reports throughput.
+// Flat throughput per thread means the allocator isn't contended.
+static void VM_Contention_f(void) {
+    int threads = VM_CONTENTION_DEFAULT_THREADS;
+    int pairs   = VM_CONTENTION_DEFAULT_PAIRS;
+    if ((Cmd_Argc() > 1 && (!A_atoi(Cmd_Argv(1), &threads) ||
+                            threads < 1 || threads > VM_TEST_MAX_THREADS)) ||
+        (Cmd_Argc() > 2 && (!A_atoi(Cmd_Argv(2), &pairs) || pairs < 1))
+    ) {
+        Com_Println(CON_DEST_CLIENT,
+                    "USAGE: vm_contention [max threads (1-%d)] [pairs]",
+                    VM_TEST_MAX_THREADS);
+        return;
+    }
+
+    static const size_t sizes[] = { 64, 4096 };
+    VmContentionThread t[VM_TEST_MAX_THREADS];
+    for (int s = 0; s < A_countof(sizes); s++) {
+        for (int count = 1; ; count *= 2) {
+            if (count > threads)
+                count = threads;
+
+            volatile int32_t go = 0;
+            int spawned = 0;
+            for (int i = 0; i < count; i++) {
+                t[i].pairs  = pairs;
+                t[i].n      = sizes[s];
+                t[i].go     = &go;
+                t[i].thread = Sys_SpawnThread("vm_contention",
+                                              VM_ContentionThreadMain, &t[i]);
+                if (!t[i].thread)
+                    break;
+                spawned++;
+            }
+
+            uint64_t start = Sys_Nanoseconds();
+            A_atomic_store32(&go, 1);
+            for (int i = 0; i < spawned; i++)
+                Sys_JoinThread(t[i].thread);
+            uint64_t elapsed = Sys_Nanoseconds() - start;
+
+            if (spawned < count) {
+                Com_Println(CON_DEST_CLIENT,
+                            "vm_contention: failed to start %d threads.",
+                            count);
+                return;
+            }
+
+            double total = (double)pairs * count;
+            Com_Println(CON_DEST_CLIENT,
+                        "vm_contention: %4zu bytes, %2d threads: "
+                        "%.2f M pairs/s (%.1f ns/pair per thread)",
+                        sizes[s], count, total / (elapsed / 1e3),
+                        (double)elapsed / pairs);
+            if (count == threads)
+                break;
+        }
+    }
+}
+
 void VM_Shutdown(void) {
-    //assert(s_totalAlloc == 0);
-    for (int i = 0; i < A_countof(s_allocs); i++) {
-        VmAllocation* a = &s_allocs[i];
-        //if (a->p != NULL)
-        //    Z_Free(a->p);
-        s_totalAlloc -= a->n;
-        s_totalAllocForType[a->type] -= a->n;
-        a->n = 0;
-        a->type = VM_ALLOC_UNKNOWN;
-    }
-    A_memset(s_allocs, 0, sizeof(s_allocs));
-    A_memset(s_totalAllocForType, 0, sizeof(s_totalAllocForType));
-    s_totalAlloc = 0;
+    //assert(s_vm.total.count == 0);
+    Cmd_RemoveCommand("vm_contention");
+    Cmd_RemoveCommand("vm_stress");
+    Cmd_RemoveCommand("vm_frame");
+    Cmd_RemoveCommand("vm_bench");
+    VM_ShutdownScratch();
+    VM_ShutdownFrame();
+    if (s_vm.total.count > 0) {
+        Com_DPrintln(CON_DEST_CLIENT,
+                     "VM_Shutdown: %zu allocations (%zu bytes) still live.",
+                     s_vm.total.count, s_vm.total.bytes);
+    }
+    // Like before, leaked allocations aren't freed, since some of them
+    // may be fixed-address mappings that outlive VM. Small ones go down
+    // with their slabs, though. Every other thread has been joined by now.
+    for (int c = 0; c < VM_SMALL_CLASS_COUNT; c++) {
+        VmSlab* slab = s_vm.classes[c].slabs;
+        while (slab) {
+            VmSlab* next = slab->next;
+            Z_Free(slab);
+            slab = next;
+        }
+    }
+    Z_Free(s_vm.allocs);
+    A_memset(&s_vm, 0, sizeof(s_vm));
+    A_memset(&s_vmCache, 0, sizeof(s_vmCache));
 }
@@ -1,8 +1,7 @@
 #pragma once
 
 #include "acommon/acommon.h"
-
-#define VM_MAX_ALLOCATIONS 16384
+#include "acommon/z_mem.h"
 
 typedef enum VmAllocType {
     VM_ALLOC_UNKNOWN,
@@ -15,10 +14,23 @@ typedef enum VmAllocType {
     VM_ALLOC_FONT,
     VM_ALLOC_DEVGUI,
     VM_ALLOC_MAP,
+    VM_ALLOC_ATOM,
+    VM_ALLOC_COLLISION,
+    VM_ALLOC_BVH,
+    VM_ALLOC_DEMO,
+    VM_ALLOC_CAPTURE,
+    VM_ALLOC_SHADER,
 
     VM_ALLOC_COUNT
 } VmAllocType;
 
+typedef struct VmAllocStats {
+    size_t   bytes;        // currently allocated
+    size_t   peak_bytes;
+    size_t   count;        // currently allocated
+    size_t   total_allocs; // since VM_Init
+} VmAllocStats;
+
 A_EXTERN_C              void  VM_Init    (void);
 A_EXTERN_C A_NO_DISCARD void* VM_Alloc   (size_t n, VmAllocType type);
 A_EXTERN_C A_NO_DISCARD void* VM_Zalloc  (size_t n, VmAllocType type);
@@ -26,3 +38,122 @@ A_EXTERN_C A_NO_DISCARD void* VM_AllocAt (const void* p, size_t n, VmAllocType t
 A_EXTERN_C              bool  VM_Free    (void* p, VmAllocType type);
 A_EXTERN_C              bool  VM_FreeAt  (void* p, VmAllocType type);
 A_EXTERN_C              void  VM_Shutdown(void);
+
+// Allocating and freeing are thread-safe, and blocks can be freed on a
+// different thread than the one that allocated them. Freed small blocks are cached
+// by the freeing thread, so threads other than the main one should call
+// VM_FlushThreadCache before they exit to hand theirs back.
+A_EXTERN_C              void  VM_FlushThreadCache(void);
+
+// The counters are updated atomically, so they're exact once other threads
+// are done, but a concurrent reader can see one updated before another.
+A_EXTERN_C const VmAllocStats* VM_GetAllocStats     (VmAllocType type);
+A_EXTERN_C const VmAllocStats* VM_GetTotalAllocStats(void);
+A_EXTERN_C const char*         VM_AllocTypeName     (VmAllocType type);
+
+// Memory VM holds on to beyond what's live, for working out fragmentation.
+// Other threads' small-block caches can't be seen, so slab_free_bytes only
+// covers the central free lists and the calling thread's cache.
+typedef struct VmHeapInfo {
+    size_t slab_bytes;
+    size_t slab_free_bytes;
+    size_t frame_bytes;   // both frame buffers, not counting spills
+    size_t scratch_bytes; // every thread's scratch stack
+} VmHeapInfo;
+
+A_EXTERN_C void VM_GetHeapInfo(A_OUT VmHeapInfo* info);
+
+// A bump allocator for data that all dies at once (e.g. everything loaded
+// with a map). Memory comes from `chunk_size` chunks, and nothing is freed
+// until VM_ArenaReset, which releases all of it. Arena allocations show up
+// in the per-type stats like any other. An arena belongs to one thread at a
+// time.
+#define VM_ARENA_DEFAULT_CHUNK_SIZE (1024 * 1024)
+#define VM_ARENA_ALIGNMENT          16
+
+typedef struct VmArenaChunk VmArenaChunk;
+
+typedef struct VmArena {
+    VmArenaChunk* chunks; // the first chunk is the one being bumped
+    size_t        chunk_size;
+    size_t        reserved; // bytes in all chunks, including headers
+    size_t        bytes[VM_ALLOC_COUNT];
+    size_t        counts[VM_ALLOC_COUNT];
+} VmArena;
+
+A_EXTERN_C              void  VM_ArenaInit  (A_OUT VmArena* arena, 
+                                             size_t chunk_size);
+A_EXTERN_C A_NO_DISCARD void* VM_ArenaAlloc (A_INOUT VmArena* arena, 
+                                             size_t n, VmAllocType type);
+A_EXTERN_C A_NO_DISCARD void* VM_ArenaZalloc(A_INOUT VmArena* arena, 
+                                             size_t n, VmAllocType type);
+A_EXTERN_C              void  VM_ArenaReset (A_INOUT VmArena* arena);
+
+// With allocation tracing enabled (see z_mem.h), the VM allocation
+// functions report their callers, along with the type.
+#if Z_TRACE_ENABLED
+A_EXTERN_C A_NO_DISCARD void* VM_AllocTraced      (size_t n, VmAllocType type,
+                                                   const char* file, int line);
+A_EXTERN_C A_NO_DISCARD void* VM_ZallocTraced     (size_t n, VmAllocType type,
+                                                   const char* file, int line);
+A_EXTERN_C A_NO_DISCARD void* VM_AllocAtTraced    (const void* p, size_t n,
+                                                   VmAllocType type,
+                                                   const char* file, int line);
+A_EXTERN_C A_NO_DISCARD void* VM_ArenaAllocTraced (A_INOUT VmArena* arena,
+                                                   size_t n, VmAllocType type,
+                                                   const char* file, int line);
+A_EXTERN_C A_NO_DISCARD void* VM_ArenaZallocTraced(A_INOUT VmArena* arena,
+                                                   size_t n, VmAllocType type,
+                                                   const char* file, int line);
+
+#define VM_Alloc(n, type)                                                     \
+    VM_AllocTraced((n), (type), __FILE__, __LINE__)
+#define VM_Zalloc(n, type)                                                    \
+    VM_ZallocTraced((n), (type), __FILE__, __LINE__)
+#define VM_AllocAt(p, n, type)                                                \
+    VM_AllocAtTraced((p), (n), (type), __FILE__, __LINE__)
+#define VM_ArenaAlloc(arena, n, type)                                         \
+    VM_ArenaAllocTraced((arena), (n), (type), __FILE__, __LINE__)
+#define VM_ArenaZalloc(arena, n, type)                                        \
+    VM_ArenaZallocTraced((arena), (n), (type), __FILE__, __LINE__)
+#endif // Z_TRACE_ENABLED
+
+// Frame allocations are valid until the end of the frame after the one
+// they were made in, so e.g. text taken from an input source can be handed
+// to the renderer. They're never freed individually. Main thread only.
+//
+// Scratch allocations are per-thread and stack-like: take a mark, allocate,
+// and release back to the mark when done. Meant for temporary buffers in
+// load jobs. A thread's stack comes from a pool of VM_SCRATCH_MAX_THREADS,
+// and goes back to it from VM_ScratchThreadExit, which Sys_SpawnThread's
+// threads call on their way out.
+//
+// Neither can fail: anything that doesn't fit spills to the heap (and gets
+// counted), and is released at the same time it otherwise would have been.
+#if !A_TARGET_PLATFORM_IS_XBOX
+#define VM_FRAME_SIZE   (1024 * 1024)      // per buffer, there are two
+#define VM_SCRATCH_SIZE (16 * 1024 * 1024) // per thread
+#else
+#define VM_FRAME_SIZE   (128 * 1024)
+#define VM_SCRATCH_SIZE (2 * 1024 * 1024)
+#endif // !A_TARGET_PLATFORM_IS_XBOX
+#define VM_SCRATCH_MAX_THREADS 16
+
+typedef struct VmScratchMark {
+    size_t used;
+    void*  spill;
+} VmScratchMark;
+
+// Must be called once at the start of every frame.
+A_EXTERN_C              void          VM_BeginFrame    (void);
+A_EXTERN_C A_NO_DISCARD void*         VM_FrameAlloc    (size_t n);
+A_EXTERN_C A_NO_DISCARD void*         VM_FrameZalloc   (size_t n);
+A_EXTERN_C A_NO_DISCARD char*         VM_FrameStrdup   (const char* s);
+A_EXTERN_C A_NO_DISCARD char*         VM_FrameStrndup  (const char* s, 
+                                                        size_t n);
+
+A_EXTERN_C A_NO_DISCARD VmScratchMark VM_ScratchMark   (void);
+A_EXTERN_C A_NO_DISCARD void*         VM_ScratchAlloc  (size_t n);
+A_EXTERN_C A_NO_DISCARD void*         VM_ScratchZalloc (size_t n);
+A_EXTERN_C              void          VM_ScratchRelease(VmScratchMark mark);
+A_EXTERN_C              void          VM_ScratchThreadExit(void);